@@ -1365,7 +1365,11 @@ void CaptureContext::SetEventID(const rdcarray<ICaptureViewer *> &exclude, uint3
   uint32_t prevEventID = m_EventID;
   m_EventID = eventId;
 
-  m_Replay.BlockInvoke([this, eventId, force](IReplayController *r) {
+  // changing event is what the user is waiting on, so let it jump ahead of queued tagged work that
+  // would be superseded anyway. Untagged modifications queued before it are never overtaken.
+  InvokePriority priority = force ? InvokePriority::Normal : InvokePriority::High;
+
+  m_Replay.BlockInvoke(priority, [this, eventId, force](IReplayController *r) {
     r->SetFrameEvent(eventId, force);
     m_CurD3D11PipelineState = r->GetD3D11PipelineState();
     m_CurD3D12PipelineState = r->GetD3D12PipelineState();
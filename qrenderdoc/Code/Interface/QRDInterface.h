@@ -679,6 +679,77 @@ protected:
 DECLARE_REFLECTION_STRUCT(ICaptureViewer);
 DECLARE_REFLECTION_STRUCT(ICaptureViewer *);
 
+DOCUMENT(R"(Specifies the priority of a call invoked onto the replay thread. A call is processed
+ahead of queued tagged calls of a lower priority, since those can be superseded anyway. Untagged
+calls are never overtaken, as they may modify state that later calls depend on. Otherwise calls
+are processed in the order they were made.
+
+.. data:: Low
+
+  The call can wait until there is no other work queued.
+
+.. data:: Normal
+
+  The default priority.
+
+.. data:: High
+
+  The call is processed before queued tagged calls of lower priority. This is used for work the user
+  is waiting on interactively, such as changing the current event.
+)");
+enum class InvokePriority : int
+{
+  Low = 0,
+  Normal,
+  High,
+};
+
+DECLARE_REFLECTION_ENUM(InvokePriority);
+
+DOCUMENT("The time taken by a call invoked onto the replay thread.");
+struct InvokeLatency
+{
+  DOCUMENT("The tag the call was made with, or empty if it was untagged.");
+  rdcstr tag;
+
+  DOCUMENT("The :class:`InvokePriority` the call was made with.");
+  InvokePriority priority = InvokePriority::Normal;
+
+  DOCUMENT(R"(The time in seconds the call spent queued, from being made until it started executing
+or was removed from the queue.
+)");
+  float queuedTime = 0.0f;
+
+  DOCUMENT("The time in seconds the call spent executing.");
+  float executionTime = 0.0f;
+
+  DOCUMENT(R"(``True`` if the call was cancelled, or superseded by a newer call with the same tag,
+before it could execute.
+)");
+  bool cancelled = false;
+
+  DOCUMENT("");
+  bool operator==(const InvokeLatency &o) const
+  {
+    return tag == o.tag && priority == o.priority && queuedTime == o.queuedTime &&
+           executionTime == o.executionTime && cancelled == o.cancelled;
+  }
+  bool operator<(const InvokeLatency &o) const
+  {
+    if(tag != o.tag)
+      return tag < o.tag;
+    if(priority != o.priority)
+      return priority < o.priority;
+    if(queuedTime != o.queuedTime)
+      return queuedTime < o.queuedTime;
+    if(executionTime != o.executionTime)
+      return executionTime < o.executionTime;
+    return cancelled < o.cancelled;
+  }
+};
+
+DECLARE_REFLECTION_STRUCT(InvokeLatency);
+
 DOCUMENT(R"(A manager for accessing the underlying replay information that isn't already abstracted
 in UI side structures. This manager controls and serialises access to the underlying
 :class:`~renderdoc.ReplayController`, as well as handling remote server connections.
@@ -826,6 +897,37 @@ This can be used to identify if a command is long-running to display a progress
 )");
   virtual float GetCurrentProcessingTime() = 0;
 
+  DOCUMENT(R"(Return the timings of the most recently finished calls on the replay thread, including
+those that were cancelled before executing.
+
+This can be used to measure how responsive the replay thread is to requests from the UI.
+
+:return: Up to the last 256 finished calls, oldest first.
+:rtype: ``list`` of :class:`InvokeLatency`
+)");
+  virtual rdcarray<InvokeLatency> GetInvokeLatencies() = 0;
+
+  DOCUMENT(R"(Cancel any queued calls with the given tag that haven't started executing yet.
+
+A call that is already executing is not interrupted.
+
+:param str tag: The tag to cancel calls for. An empty tag cancels nothing.
+:return: The number of calls that were cancelled.
+:rtype: ``int``
+)");
+  virtual int CancelInvoke(const rdcstr &tag) = 0;
+
+  DOCUMENT(R"(Make a tagged non-blocking invoke call onto the replay thread, with a given priority.
+
+This behaves as :meth:`AsyncInvoke`, except that the call is processed before any queued tagged
+calls of a lower priority.
+
+:param str tag: The tag to identify this callback.
+:param InvokePriority priority: The priority to process the callback with.
+:param InvokeCallback method: The function to callback on the replay thread.
+)");
+  virtual void AsyncInvoke(const rdcstr &tag, InvokePriority priority, InvokeCallback method) = 0;
+
   DOCUMENT(R"(Make a tagged non-blocking invoke call onto the replay thread.
 
 This tagged function is for cases when we might send a request - e.g. to pick a vertex or pixel -
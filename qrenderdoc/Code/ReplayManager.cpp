@@ -236,28 +236,35 @@ float ReplayManager::GetCurrentProcessingTime()
   return m_CommandTimer.isValid() ? double(m_CommandTimer.elapsed()) / 1000.0 : 0.0;
 }
 
+rdcarray<InvokeLatency> ReplayManager::GetInvokeLatencies()
+{
+  QMutexLocker lock(&m_TimerLock);
+
+  rdcarray<InvokeLatency> ret;
+
+  // once the ring has filled, the oldest entry is the next one to be overwritten
+  int count = m_Latencies.count();
+  int first = count < MaxLatencies ? 0 : m_NextLatency;
+
+  for(int i = 0; i < count; i++)
+    ret.push_back(m_Latencies[(first + i) % count]);
+
+  return ret;
+}
+
 void ReplayManager::AsyncInvoke(const rdcstr &tag, ReplayManager::InvokeCallback m)
+{
+  AsyncInvoke(tag, InvokePriority::Normal, m);
+}
+
+void ReplayManager::AsyncInvoke(const rdcstr &tag, InvokePriority priority,
+                                ReplayManager::InvokeCallback m)
 {
   QString qtag(tag);
 
-  {
-    QMutexLocker autolock(&m_RenderLock);
-    for(int i = 0; i < m_RenderQueue.count();)
-    {
-      if(m_RenderQueue[i]->tag == qtag)
-      {
-        InvokeHandle *cmd = m_RenderQueue.takeAt(i);
-        if(cmd->selfdelete)
-          delete cmd;
-      }
-      else
-      {
-        i++;
-      }
-    }
-  }
+  RemoveQueuedInvokes(qtag);
 
-  InvokeHandle *cmd = new InvokeHandle(m, qtag);
+  InvokeHandle *cmd = new InvokeHandle(m, qtag, priority);
   cmd->selfdelete = true;
 
   PushInvoke(cmd);
@@ -273,7 +280,12 @@ void ReplayManager::AsyncInvoke(ReplayManager::InvokeCallback m)
 
 void ReplayManager::BlockInvoke(ReplayManager::InvokeCallback m)
 {
-  InvokeHandle *cmd = new InvokeHandle(m);
+  BlockInvoke(InvokePriority::Normal, m);
+}
+
+void ReplayManager::BlockInvoke(InvokePriority priority, ReplayManager::InvokeCallback m)
+{
+  InvokeHandle *cmd = new InvokeHandle(m, QString(), priority);
 
   PushInvoke(cmd);
 
@@ -282,6 +294,11 @@ void ReplayManager::BlockInvoke(ReplayManager::InvokeCallback m)
   delete cmd;
 }
 
+int ReplayManager::CancelInvoke(const rdcstr &tag)
+{
+  return RemoveQueuedInvokes(QString(tag));
+}
+
 void ReplayManager::CancelReplayLoop()
 {
   m_Renderer->CancelReplayLoop();
@@ -410,11 +427,79 @@ void ReplayManager::PushInvoke(ReplayManager::InvokeHandle *cmd)
     return;
   }
 
+  cmd->queued.start();
+
   QMutexLocker autolock(&m_RenderLock);
-  m_RenderQueue.enqueue(cmd);
+
+  // insert after everything of the same or higher priority. Only tagged calls are overtaken, since
+  // those can be superseded anyway - an untagged call may modify state that later calls rely on, so
+  // nothing queued after it moves ahead of it.
+  int idx = m_RenderQueue.count();
+  while(idx > 0 && m_RenderQueue[idx - 1]->priority < cmd->priority &&
+        !m_RenderQueue[idx - 1]->tag.isEmpty())
+    idx--;
+
+  m_RenderQueue.insert(idx, cmd);
   m_RenderCondition.wakeAll();
 }
 
+void ReplayManager::FinishInvoke(ReplayManager::InvokeHandle *cmd, float executionTime,
+                                 bool cancelled)
+{
+  InvokeLatency latency;
+  latency.tag = cmd->tag;
+  latency.priority = cmd->priority;
+  latency.queuedTime = cmd->queuedTime;
+  latency.executionTime = executionTime;
+  latency.cancelled = cancelled;
+
+  {
+    QMutexLocker lock(&m_TimerLock);
+
+    if(m_Latencies.count() < MaxLatencies)
+      m_Latencies.push_back(latency);
+    else
+      m_Latencies[m_NextLatency] = latency;
+
+    m_NextLatency = (m_NextLatency + 1) % MaxLatencies;
+  }
+
+  // if it's a throwaway command, delete it
+  if(cmd->selfdelete)
+    delete cmd;
+  else
+    cmd->processed.release();
+}
+
+int ReplayManager::RemoveQueuedInvokes(const QString &tag)
+{
+  // untagged requests can't be removed, since they may be blocking invokes that are relying on
+  // being processed
+  if(tag.isEmpty())
+    return 0;
+
+  QList<InvokeHandle *> removed;
+
+  {
+    QMutexLocker autolock(&m_RenderLock);
+    for(int i = 0; i < m_RenderQueue.count();)
+    {
+      if(m_RenderQueue[i]->tag == tag)
+        removed.push_back(m_RenderQueue.takeAt(i));
+      else
+        i++;
+    }
+  }
+
+  for(InvokeHandle *cmd : removed)
+  {
+    cmd->queuedTime = float(double(cmd->queued.nsecsElapsed()) / 1.0e9);
+    FinishInvoke(cmd, 0.0f, true);
+  }
+
+  return removed.count();
+}
+
 void ReplayManager::run(int proxyRenderer, const QString &capturefile,
                         RENDERDOC_ProgressCallback progress)
 {
@@ -467,6 +552,10 @@ void ReplayManager::run(int proxyRenderer, const QString &capturefile,
     if(cmd == NULL)
       continue;
 
+    cmd->queuedTime = float(double(cmd->queued.nsecsElapsed()) / 1.0e9);
+
+    float executionTime = 0.0f;
+
     if(cmd->method != NULL)
     {
       {
@@ -478,15 +567,12 @@ void ReplayManager::run(int proxyRenderer, const QString &capturefile,
 
       {
         QMutexLocker lock(&m_TimerLock);
+        executionTime = float(double(m_CommandTimer.nsecsElapsed()) / 1.0e9);
         m_CommandTimer.invalidate();
       }
     }
 
-    // if it's a throwaway command, delete it
-    if(cmd->selfdelete)
-      delete cmd;
-    else
-      cmd->processed.release();
+    FinishInvoke(cmd, executionTime, false);
   }
 
   // clean up anything left in the queue
@@ -503,10 +589,8 @@ void ReplayManager::run(int proxyRenderer, const QString &capturefile,
       if(cmd == NULL)
         continue;
 
-      if(cmd->selfdelete)
-        delete cmd;
-      else
-        cmd->processed.release();
+      cmd->queuedTime = float(double(cmd->queued.nsecsElapsed()) / 1.0e9);
+      FinishInvoke(cmd, 0.0f, true);
     }
   }
 
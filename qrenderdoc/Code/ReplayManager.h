@@ -31,6 +31,7 @@
 #include <QString>
 #include <QThread>
 #include <QVariantMap>
+#include <QVector>
 #include <QWaitCondition>
 #include <functional>
 #include "Interface/QRDInterface.h"
@@ -54,6 +55,7 @@ public:
   bool IsRunning();
   ReplayStatus GetCreateStatus() { return m_CreateStatus; }
   float GetCurrentProcessingTime();
+  rdcarray<InvokeLatency> GetInvokeLatencies();
   // this tagged version is for cases when we might send a request - e.g. to pick a vertex or pixel
   // - and want to pre-empt it with a new request before the first has returned. Either because some
   // other work is taking a while or because we're sending requests faster than they can be
@@ -61,8 +63,14 @@ public:
   // the manager processes only the request on the top of the queue, so when a new tagged invoke
   // comes in, we remove any other requests in the queue before it that have the same tag
   void AsyncInvoke(const rdcstr &tag, InvokeCallback m);
+  void AsyncInvoke(const rdcstr &tag, InvokePriority priority, InvokeCallback m);
   void AsyncInvoke(InvokeCallback m);
   void BlockInvoke(InvokeCallback m);
+  // not exposed on the interface, since the python wrapper needs BlockInvoke to be the last method
+  void BlockInvoke(InvokePriority priority, InvokeCallback m);
+
+  // removes any queued requests with this tag that haven't started yet
+  int CancelInvoke(const rdcstr &tag);
 
   void CancelReplayLoop();
 
@@ -100,17 +108,23 @@ public:
 private:
   struct InvokeHandle
   {
-    InvokeHandle(InvokeCallback m, const QString &t = QString())
+    InvokeHandle(InvokeCallback m, const QString &t = QString(),
+                 InvokePriority p = InvokePriority::Normal)
     {
       tag = t;
       method = m;
+      priority = p;
       selfdelete = false;
     }
 
     QString tag;
     InvokeCallback method;
+    InvokePriority priority;
     QSemaphore processed;
     bool selfdelete;
+    // started when the handle is queued, and the time it had been queued for when it was taken off
+    QElapsedTimer queued;
+    float queuedTime = 0.0f;
   };
 
   void run(int proxyRenderer, const QString &capturefile, RENDERDOC_ProgressCallback progress);
@@ -118,6 +132,12 @@ private:
   QMutex m_TimerLock;
   QElapsedTimer m_CommandTimer;
 
+  // the last few finished invokes, in a ring. Protected by m_TimerLock
+  static const int MaxLatencies = 256;
+  QVector<InvokeLatency> m_Latencies;
+  int m_NextLatency = 0;
+
+  // sorted by priority, highest first, and by the order requests were made within a priority
   QMutex m_RenderLock;
   QQueue<InvokeHandle *> m_RenderQueue;
   QWaitCondition m_RenderCondition;
@@ -126,6 +146,8 @@ private:
   IReplayController *m_Renderer = NULL;
 
   void PushInvoke(InvokeHandle *cmd);
+  void FinishInvoke(InvokeHandle *cmd, float executionTime, bool cancelled);
+  int RemoveQueuedInvokes(const QString &tag);
 
   QMutex m_RemoteLock;
   RemoteHost *m_RemoteHost = NULL;
@@ -160,8 +160,10 @@ DEFINE_SAFE_EQUALITY(ConstantBlock)
 DEFINE_SAFE_EQUALITY(DebugMessage)
 DEFINE_SAFE_EQUALITY(EnvironmentModification)
 DEFINE_SAFE_EQUALITY(EventUsage)
+DEFINE_SAFE_EQUALITY(HookedCallProfile)
 DEFINE_SAFE_EQUALITY(PathEntry)
 DEFINE_SAFE_EQUALITY(PixelModification)
+DEFINE_SAFE_EQUALITY(RemoteSession)
 DEFINE_SAFE_EQUALITY(ResourceDescription)
 DEFINE_SAFE_EQUALITY(ResourceId)
 DEFINE_SAFE_EQUALITY(LineColumnInfo)
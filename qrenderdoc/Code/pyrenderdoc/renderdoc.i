@@ -94,6 +94,11 @@
 %ignore StructuredChunkList::operator=;
 %ignore StructuredBufferList::operator=;
 
+// the on-demand buffer source is internal, python accesses buffers through SDFile::GetBuffer
+%ignore ISDBufferSource;
+%ignore SDFile::SetBufferSource;
+%ignore SDFile::GetBufferSource;
+
 // these objects return a new copy which the python caller should own.
 %newobject SDObject::Duplicate;
 %newobject SDChunk::Duplicate;
@@ -259,8 +264,10 @@ TEMPLATE_ARRAY_INSTANTIATE(rdcarray, ConstantBlock)
 TEMPLATE_ARRAY_INSTANTIATE(rdcarray, DebugMessage)
 TEMPLATE_ARRAY_INSTANTIATE(rdcarray, EnvironmentModification)
 TEMPLATE_ARRAY_INSTANTIATE(rdcarray, EventUsage)
+TEMPLATE_ARRAY_INSTANTIATE(rdcarray, HookedCallProfile)
 TEMPLATE_ARRAY_INSTANTIATE(rdcarray, PathEntry)
 TEMPLATE_ARRAY_INSTANTIATE(rdcarray, PixelModification)
+TEMPLATE_ARRAY_INSTANTIATE(rdcarray, RemoteSession)
 TEMPLATE_ARRAY_INSTANTIATE(rdcarray, ResourceDescription)
 TEMPLATE_ARRAY_INSTANTIATE(rdcarray, ResourceId)
 TEMPLATE_ARRAY_INSTANTIATE(rdcarray, LineColumnInfo)
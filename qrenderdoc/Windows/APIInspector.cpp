@@ -110,7 +110,7 @@ void APIInspector::on_apiEvents_itemSelectionChanged()
   {
     if(m_Ctx.Replay().GetCaptureAccess())
     {
-      m_Ctx.Replay().AsyncInvoke([this, ev](IReplayController *) {
+      m_Ctx.Replay().AsyncInvoke(lit("APIInspectorCallstack"), [this, ev](IReplayController *) {
         rdcarray<rdcstr> stack = m_Ctx.Replay().GetCaptureAccess()->GetResolve(ev.callstack);
 
         GUIInvoke::call(this, [this, stack]() { addCallstack(stack); });
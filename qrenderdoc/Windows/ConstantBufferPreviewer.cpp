@@ -125,9 +125,13 @@ void ConstantBufferPreviewer::OnEventChanged(uint32_t eventId)
     return;
   }
 
+  // previews are unique per stage/slot/index, so a refresh still queued from an earlier event can
+  // be superseded by this one.
+  rdcstr tag = QFormatStr("CBufferPreview%1_%2_%3").arg((int)m_stage).arg(m_slot).arg(m_arrayIdx);
+
   if(!m_formatOverride.empty())
   {
-    m_Ctx.Replay().AsyncInvoke([this, offs, size, wasEmpty](IReplayController *r) {
+    m_Ctx.Replay().AsyncInvoke(tag, [this, offs, size, wasEmpty](IReplayController *r) {
       bytebuf data = r->GetBufferData(m_cbuffer, offs, size);
       rdcarray<ShaderVariable> vars = applyFormatOverride(data);
       GUIInvoke::call(this, [this, vars, wasEmpty] {
@@ -145,7 +149,7 @@ void ConstantBufferPreviewer::OnEventChanged(uint32_t eventId)
   }
   else
   {
-    m_Ctx.Replay().AsyncInvoke([this, entryPoint, offs, wasEmpty](IReplayController *r) {
+    m_Ctx.Replay().AsyncInvoke(tag, [this, entryPoint, offs, wasEmpty](IReplayController *r) {
       rdcarray<ShaderVariable> vars = r->GetCBufferVariableContents(
           m_shader, entryPoint.toUtf8().data(), m_slot, m_cbuffer, offs);
       GUIInvoke::call(this, [this, vars, wasEmpty] {
@@ -1632,7 +1632,11 @@ void MainWindow::messageCheck()
       statusProgress->hide();
     }
 
-    m_Ctx.Replay().AsyncInvoke([this](IReplayController *r) {
+    // polled on a timer, so a check that hasn't run yet is superseded by the next one and should
+    // never hold up a refresh the user is waiting on.
+    rdcstr tag = lit("MessageCheck");
+
+    m_Ctx.Replay().AsyncInvoke(tag, InvokePriority::Low, [this](IReplayController *r) {
       rdcarray<DebugMessage> msgs = r->GetDebugMessages();
 
       bool disconnected = false;
@@ -228,7 +228,7 @@ void ResourceInspector::Inspect(ResourceId id)
   const SDFile &file = m_Ctx.GetStructuredFile();
   const ResourceDescription *desc = m_Ctx.GetResource(id);
 
-  m_Ctx.Replay().AsyncInvoke([this, id](IReplayController *r) {
+  m_Ctx.Replay().AsyncInvoke(lit("ResourceInspectorUsage"), [this, id](IReplayController *r) {
     rdcarray<EventUsage> usage = r->GetUsage(id);
 
     rdcarray<ShaderEntryPoint> entries = r->GetShaderEntryPoints(id);
@@ -1363,7 +1363,8 @@ void TextureViewer::UI_OnTextureSelectionChanged(bool newdraw)
   if(ui->autoFit->isChecked())
     AutoFitRange();
 
-  m_Ctx.Replay().AsyncInvoke([this](IReplayController *r) {
+  // this always displays the latest selection, so any update still queued is superseded
+  m_Ctx.Replay().AsyncInvoke(lit("TextureUpdate"), [this](IReplayController *r) {
     RT_UpdateVisualRange(r);
 
     RT_UpdateAndDisplay(r);
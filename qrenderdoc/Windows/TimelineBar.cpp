@@ -137,7 +137,10 @@ void TimelineBar::HighlightResourceUsage(ResourceId id)
   m_UsageEvents.clear();
   m_UsageTarget = m_Ctx.GetResourceName(id);
 
-  m_Ctx.Replay().AsyncInvoke([this, id](IReplayController *r) {
+  // tagged so that an older usage query still queued doesn't append its events to these
+  rdcstr tag = lit("TimelineUsage");
+
+  m_Ctx.Replay().AsyncInvoke(tag, InvokePriority::Low, [this, id](IReplayController *r) {
     rdcarray<EventUsage> usage = r->GetUsage(id);
 
     GUIInvoke::call(this, [this, usage]() {
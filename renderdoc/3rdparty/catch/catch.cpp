@@ -26,6 +26,7 @@
 #define CATCH_CONFIG_NOSTDOUT
 #include "catch.hpp"
 #include "api/replay/renderdoc_replay.h"
+#include "api/replay/version.h"
 #include "serialise/serialiser.h"
 #include "strings/string_utils.h"
 
@@ -267,6 +268,33 @@ public:
 
 std::ostream *stream = NULL;
 
+static std::string benchmarkOutput;
+
+void RecordBenchmark(const char *name, double value, const char *unit)
+{
+  WARN(StringFormat::Fmt("%s: %.3f %s", name, value, unit));
+
+  if(benchmarkOutput.empty())
+    return;
+
+  FILE *f = FileIO::fopen(benchmarkOutput.c_str(), "ab");
+
+  if(!f)
+  {
+    RDCERR("Couldn't open benchmark output file %s", benchmarkOutput.c_str());
+    return;
+  }
+
+  std::string line = StringFormat::Fmt(
+      "{\"test\": \"%s\", \"name\": \"%s\", \"value\": %f, \"unit\": \"%s\", "
+      "\"version\": \"%s\", \"timestamp\": %llu}\n",
+      Catch::getResultCapture().getCurrentTestName().c_str(), name, value, unit, GitVersionHash,
+      Timing::GetUnixTimestamp());
+
+  FileIO::fwrite(line.c_str(), 1, line.size(), f);
+  FileIO::fclose(f);
+}
+
 namespace Catch
 {
 std::ostream &cout()
@@ -295,6 +323,12 @@ extern "C" RENDERDOC_API int RENDERDOC_CC RENDERDOC_RunUnitTests(const rdcstr &c
   session.configData().name = "RenderDoc";
   session.configData().shouldDebugBreak = OSUtility::DebuggerPresent();
 
+  benchmarkOutput.clear();
+
+  session.cli(session.cli() |
+              Catch::clara::Opt(benchmarkOutput, "file")["--benchmark-out"](
+                  "append results from benchmark tests to a file, as one line of JSON each"));
+
   const char **argv = new const char *[args.size() + 1];
   argv[0] = command.c_str();
   for(size_t i = 0; i < args.size(); i++)
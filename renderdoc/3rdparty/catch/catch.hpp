@@ -31,4 +31,9 @@
 
 #include "api/replay/stringise.h"
 
-#include "official/catch.hpp"
\ No newline at end of file
+#include "official/catch.hpp"
+
+// records a measurement from a benchmark test. It's always reported as a warning, and if the tests
+// were run with --benchmark-out <file> it's also appended to that file as a line of JSON, so
+// results can be compared between builds.
+void RecordBenchmark(const char *name, double value, const char *unit);
@@ -333,6 +333,9 @@ typedef enum RENDERDOC_OverlayBits {
   // Show a list of recent captures, and how many captures have been made
   eRENDERDOC_Overlay_CaptureList = 0x8,
 
+  // Show how many chunks are held in memory for capturing, and how much memory they take
+  eRENDERDOC_Overlay_ChunkMemory = 0x10,
+
   // Default values for the overlay mask
   eRENDERDOC_Overlay_Default = (eRENDERDOC_Overlay_Enabled | eRENDERDOC_Overlay_FrameRate |
                                 eRENDERDOC_Overlay_FrameNumber | eRENDERDOC_Overlay_CaptureList),
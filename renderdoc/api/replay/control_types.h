@@ -518,6 +518,81 @@ struct NewChildData
 
 DECLARE_REFLECTION_STRUCT(NewChildData);
 
+DOCUMENT(R"(The CPU time spent in one hooked API entry point, as measured by the target's call
+profiler.
+
+Wrapper time is the time spent in RenderDoc's wrapper for the entry point, excluding the driver call
+it makes and any other hooked calls it makes in turn. Driver time is the time spent in that driver
+call. Times are totals in microseconds over every call made while profiling was enabled, split by
+whether or not a frame was being captured.
+)");
+struct HookedCallProfile
+{
+  DOCUMENT("");
+  HookedCallProfile() = default;
+  HookedCallProfile(const HookedCallProfile &) = default;
+
+  DOCUMENT("Compares two ``HookedCallProfile`` objects for equality.");
+  bool operator==(const HookedCallProfile &o) const
+  {
+    return name == o.name && backgroundCalls == o.backgroundCalls &&
+           backgroundWrapperMicroseconds == o.backgroundWrapperMicroseconds &&
+           backgroundDriverMicroseconds == o.backgroundDriverMicroseconds &&
+           capturingCalls == o.capturingCalls &&
+           capturingWrapperMicroseconds == o.capturingWrapperMicroseconds &&
+           capturingDriverMicroseconds == o.capturingDriverMicroseconds;
+  }
+  DOCUMENT("Compares two ``HookedCallProfile`` objects for less-than.");
+  bool operator<(const HookedCallProfile &o) const
+  {
+    if(!(name == o.name))
+      return name < o.name;
+    if(!(backgroundCalls == o.backgroundCalls))
+      return backgroundCalls < o.backgroundCalls;
+    if(!(capturingCalls == o.capturingCalls))
+      return capturingCalls < o.capturingCalls;
+    return false;
+  }
+
+  DOCUMENT("The name of the entry point.");
+  rdcstr name;
+
+  DOCUMENT("The number of calls made while not capturing a frame.");
+  uint64_t backgroundCalls = 0;
+  DOCUMENT("The time spent in the wrapper while not capturing a frame.");
+  double backgroundWrapperMicroseconds = 0.0;
+  DOCUMENT("The time spent in the driver while not capturing a frame.");
+  double backgroundDriverMicroseconds = 0.0;
+
+  DOCUMENT("The number of calls made while capturing a frame.");
+  uint64_t capturingCalls = 0;
+  DOCUMENT("The time spent in the wrapper while capturing a frame.");
+  double capturingWrapperMicroseconds = 0.0;
+  DOCUMENT("The time spent in the driver while capturing a frame.");
+  double capturingDriverMicroseconds = 0.0;
+};
+
+DECLARE_REFLECTION_STRUCT(HookedCallProfile);
+
+DOCUMENT("A hooked call profile returned by the target.");
+struct CallProfileData
+{
+  DOCUMENT("");
+  CallProfileData() = default;
+  CallProfileData(const CallProfileData &) = default;
+
+  DOCUMENT(R"(The :class:`HookedCallProfile` for each entry point that has been called, with the
+most time spent in the wrapper first.
+)");
+  rdcarray<HookedCallProfile> calls;
+  DOCUMENT(R"(The most recent calls as a Chrome trace in JSON, which can be saved and loaded at
+``chrome://tracing``. Empty if no trace was requested.
+)");
+  rdcstr trace;
+};
+
+DECLARE_REFLECTION_STRUCT(CallProfileData);
+
 DOCUMENT("A message from a target control connection.");
 struct TargetControlMessage
 {
@@ -545,6 +620,8 @@ or has finished, it will be -1.0
 
   DOCUMENT("The number of the capturable windows");
   uint32_t capturableWindowCount = 0;
+  DOCUMENT("The :class:`hooked call profile <CallProfileData>`.");
+  CallProfileData callProfile;
 };
 
 DECLARE_REFLECTION_STRUCT(TargetControlMessage);
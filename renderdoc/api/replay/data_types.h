@@ -88,6 +88,52 @@ struct PathEntry
 
 DECLARE_REFLECTION_STRUCT(PathEntry);
 
+DOCUMENT("Properties of a client session connected to a remote server.");
+struct RemoteSession
+{
+  DOCUMENT("");
+  RemoteSession() : sessionId(0), connectedSeconds(0), current(false) {}
+  RemoteSession(const RemoteSession &) = default;
+  bool operator==(const RemoteSession &o) const
+  {
+    return clientAddress == o.clientAddress && captureFile == o.captureFile &&
+           sessionId == o.sessionId && connectedSeconds == o.connectedSeconds &&
+           current == o.current;
+  }
+  bool operator<(const RemoteSession &o) const
+  {
+    if(!(sessionId == o.sessionId))
+      return sessionId < o.sessionId;
+    if(!(clientAddress == o.clientAddress))
+      return clientAddress < o.clientAddress;
+    if(!(captureFile == o.captureFile))
+      return captureFile < o.captureFile;
+    if(!(connectedSeconds == o.connectedSeconds))
+      return connectedSeconds < o.connectedSeconds;
+    if(!(current == o.current))
+      return current < o.current;
+    return false;
+  }
+  DOCUMENT("The IP address that the client connected from.");
+  rdcstr clientAddress;
+
+  DOCUMENT(R"(The path on the remote system of the capture that the session has open, or empty if no
+capture is open.
+)");
+  rdcstr captureFile;
+
+  DOCUMENT("The server-assigned ID of the session, unique for as long as the server is running.");
+  uint32_t sessionId;
+
+  DOCUMENT("The number of seconds since the client connected.");
+  uint32_t connectedSeconds;
+
+  DOCUMENT("``True`` if this is the session that requested the list.");
+  bool current;
+};
+
+DECLARE_REFLECTION_STRUCT(RemoteSession);
+
 DOCUMENT("Properties of a section in a renderdoc capture file.");
 struct SectionProperties
 {
@@ -1323,6 +1323,24 @@ target control connection.
 )");
   virtual void DeleteCapture(uint32_t captureId) = 0;
 
+  DOCUMENT(R"(Enable or disable profiling of the target's hooked API calls.
+
+While enabled the target measures the CPU time spent in each hooked entry point, split between
+RenderDoc's wrapper and the driver. Profiling adds some overhead of its own, so it is disabled again
+when this connection closes.
+
+:param bool enabled: ``True`` to start profiling, ``False`` to stop.
+)");
+  virtual void SetCallProfiling(bool enabled) = 0;
+
+  DOCUMENT(R"(Request the target's hooked call profile, which arrives as a
+:data:`TargetControlMessageType.CallProfile` message.
+
+:param bool includeTrace: ``True`` to also send the target's most recent calls as a Chrome trace.
+:param bool reset: ``True`` to clear the profile on the target after it has been sent.
+)");
+  virtual void RequestCallProfile(bool includeTrace, bool reset) = 0;
+
   DOCUMENT(R"(Query to see if a message has been received from the remote system.
 
 The details of the types of messages that can be received are listed under
@@ -1470,6 +1488,16 @@ struct IRemoteServer : public ICaptureAccess
 )");
   virtual bool Ping() = 0;
 
+  DOCUMENT(R"(Retrieve the list of client sessions currently connected to the remote server.
+
+A server can serve several clients at once, each with its own capture open. The list includes the
+session making the request.
+
+:return: The sessions connected to the server.
+:rtype: ``list`` of :class:`RemoteSession`
+)");
+  virtual rdcarray<RemoteSession> ListSessions() = 0;
+
   DOCUMENT(R"(Retrieve a list of renderers available for local proxying.
 
 These will be strings like "D3D11" or "OpenGL".
@@ -1545,6 +1573,10 @@ This function will block until the copy is fully complete, or an error has occur
 This is primarily useful for when a capture is only stored locally and must be replayed remotely, as
 the capture must be available on the machine where the replay happens.
 
+The file is sent in blocks that are checked on arrival. If an earlier copy of the same file was
+interrupted, or it was already copied in this connection, only the blocks the remote system doesn't
+already have are sent.
+
 :param str filename: The path to the file on the local system.
 :param ProgressCallback progress: A callback that will be repeatedly called with an updated progress
   value for the copy. Can be ``None`` if no progress is desired.
@@ -1557,6 +1589,11 @@ the capture must be available on the machine where the replay happens.
 
 This function will block until the copy is fully complete, or an error has occurred.
 
+The file is received in blocks that are checked on arrival, and any blocks already present in an
+existing file at ``localpath`` are not sent again. If the copy is interrupted, what was received so
+far is kept next to ``localpath`` with a ``.partial`` extension, and copying to the same path again
+resumes from there.
+
 :param str remotepath: The remote path where the file should be copied from.
 :param str localpath: The local path where the file should be saved.
 :param ProgressCallback progress: A callback that will be repeatedly called with an updated progress
@@ -1781,6 +1818,20 @@ The data is copied internally so it can be destroyed after calling this function
 )");
   virtual void SetStructuredData(const SDFile &file) = 0;
 
+  DOCUMENT(R"(Returns the serialised contents of a single chunk in the frame capture, without
+decompressing or structuring the rest of the capture.
+
+The capture must have a :data:`SectionType.ChunkIndex` section, which captures made before it was
+added don't have. Only the compressed blocks containing the chunk are read.
+
+:param int chunkIndex: The index of the chunk, as in :data:`SDFile.chunks` or
+  :data:`APIEvent.chunkIndex`.
+:return: The raw bytes of the chunk including its header, or empty if the chunk index is invalid or
+  the capture has no chunk index.
+:rtype: ``bytes``
+)");
+  virtual bytebuf GetChunkContents(uint32_t chunkIndex) = 0;
+
   DOCUMENT(R"(Retrieves the embedded thumbnail from the capture.
 
 .. note:: The only supported values for :paramref:`GetThumbnail.type` are :attr:`FileType.JPG`,
@@ -2022,6 +2073,10 @@ from external sources.
 This function will block until a remote connection tells the server to shut down, or the
 ``killReplay`` callback returns ``True``.
 
+Several clients can be served at once, each with its own capture open. The number of sessions and
+the storage each one may use for copied captures are limited by the ``maxsessions`` and
+``sessionstorage`` settings in the server's ``remoteserver.conf``.
+
 :param str host: The name of the interface to listen on.
 :param int port: The port to listen on, or the default port if 0.
 :param KillCallback killReplay: A callback that returns a ``bool`` indicating if the server should
@@ -83,6 +83,14 @@ version of RenderDoc that addes a new section type. They should be considered eq
   lossless.
 
   The name for this section will be "renderdoc/internal/exthumb".
+
+.. data:: ChunkIndex
+
+  This section contains an index into the frame capture section, listing where each chunk starts and
+  where each independently compressed block starts. This allows individual chunks to be read without
+  decompressing the whole frame capture.
+
+  The name for this section will be "renderdoc/internal/chunkindex".
 )");
 enum class SectionType : uint32_t
 {
@@ -95,6 +103,7 @@ enum class SectionType : uint32_t
   ResourceRenames,
   AMDRGPProfile,
   ExtendedThumbnail,
+  ChunkIndex,
   Count,
 };
 
@@ -3170,6 +3179,14 @@ DOCUMENT(R"(The type of message received from or sent to an application target c
 .. data:: CaptureProgress
 
   Progress update on an on-going frame capture.
+
+.. data:: CapturableWindowCount
+
+  The number of windows that can be captured has changed.
+
+.. data:: CallProfile
+
+  The target's hooked call profile, in response to a request.
 )");
 enum class TargetControlMessageType : uint32_t
 {
@@ -3182,7 +3199,8 @@ enum class TargetControlMessageType : uint32_t
   RegisterAPI,
   NewChild,
   CaptureProgress,
-  CapturableWindowCount
+  CapturableWindowCount,
+  CallProfile,
 };
 
 DECLARE_REFLECTION_ENUM(TargetControlMessageType);
@@ -781,6 +781,15 @@ struct StructuredBufferList : public rdcarray<bytebuf *>
 
 DECLARE_REFLECTION_STRUCT(StructuredBufferList);
 
+// Internal interface for buffers in an SDFile that are loaded when they're accessed, rather than
+// stored in full in SDFile::buffers. See SDFile::GetBuffer
+struct ISDBufferSource
+{
+  virtual ~ISDBufferSource() {}
+  // fills data with the contents of buffer idx. Returns false if the buffer isn't loaded on demand
+  virtual bool GetBuffer(size_t idx, bytebuf &data) = 0;
+};
+
 DOCUMENT("Contains the structured information in a file. Owns the buffers and chunks.");
 struct SDFile
 {
@@ -792,6 +801,8 @@ struct SDFile
 
     for(bytebuf *buf : buffers)
       delete buf;
+
+    delete m_BufferSource;
   }
 
   DOCUMENT("A ``list`` of :class:`SDChunk` objects with the chunks in order.");
@@ -803,14 +814,63 @@ struct SDFile
   DOCUMENT("The version of this structured stream, typically only used internally.");
   uint64_t version = 0;
 
+  DOCUMENT(R"(Retrieve the contents of a serialised buffer.
+
+When structured data is exported from a capture, buffers may not be read from the capture until
+they're accessed. In that case the buffer's entry in :data:`buffers` is empty and this function must
+be used to get the contents.
+
+Structured data returned from a capture file always has every buffer loaded in :data:`buffers`.
+
+:param int idx: The index of the buffer.
+:return: A copy of the contents of the buffer.
+:rtype: bytes
+)");
+  bytebuf GetBuffer(size_t idx) const
+  {
+    bytebuf ret;
+    if(m_BufferSource && m_BufferSource->GetBuffer(idx, ret))
+      return ret;
+
+    return *buffers[idx];
+  }
+
+  DOCUMENT("Load any buffers that are loaded on demand, so that :data:`buffers` is complete.");
+  void LoadAllBuffers()
+  {
+    if(m_BufferSource == NULL)
+      return;
+
+    for(size_t i = 0; i < buffers.size(); i++)
+    {
+      bytebuf data;
+      if(m_BufferSource->GetBuffer(i, data))
+        buffers[i]->swap(data);
+    }
+
+    SetBufferSource(NULL);
+  }
+
+  // internal - where buffers are loaded from if they're loaded on demand. The file owns the source,
+  // and deletes any previous one.
+  void SetBufferSource(ISDBufferSource *source)
+  {
+    delete m_BufferSource;
+    m_BufferSource = source;
+  }
+  ISDBufferSource *GetBufferSource() const { return m_BufferSource; }
   inline void Swap(SDFile &other)
   {
     chunks.swap(other.chunks);
     buffers.swap(other.buffers);
     std::swap(version, other.version);
+    std::swap(m_BufferSource, other.m_BufferSource);
   }
 
 protected:
   SDFile(const SDFile &) = delete;
   SDFile &operator=(const SDFile &) = delete;
+
+private:
+  ISDBufferSource *m_BufferSource = NULL;
 };
@@ -28,6 +28,7 @@
 #include <string.h>
 #include <string>
 #include "common/threading.h"
+#include "common/worker_pool.h"
 #include "os/os_specific.h"
 #include "strings/string_utils.h"
 
@@ -223,6 +224,323 @@ bool FindDiffRange(void *a, void *b, size_t bufSize, size_t &diffStart, size_t &
   return diffStart < bufSize;
 }
 
+// SSE2 is always available on x64, and on x86 when the compiler has been told it can use it. AVX2
+// needs checking for at runtime, and compiling with per-function targets where the compiler
+// supports them.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SSE_DIFF OPTION_ON
+#include <emmintrin.h>
+
+#if defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#define AVX2_DIFF OPTION_ON
+#define AVX2_TARGET
+#elif defined(__GNUC__) || defined(__clang__)
+#include <immintrin.h>
+#define AVX2_DIFF OPTION_ON
+#define AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define AVX2_DIFF OPTION_OFF
+#endif
+
+#else
+#define SSE_DIFF OPTION_OFF
+#define AVX2_DIFF OPTION_OFF
+#endif
+
+namespace
+{
+// SkipEqual returns the offset of the first byte in [offs, end) that differs between a and b, or
+// end if there isn't one.
+//
+// SkipDifferent returns the offset of the first vector-sized block in [offs, end) where a and b are
+// equal, or end if there isn't one. Equal runs shorter than a vector can be skipped over, but
+// they'll be shorter than any sensible coalescing gap anyway.
+
+size_t SkipEqualScalar(const byte *a, const byte *b, size_t offs, size_t end)
+{
+  for(; offs + 8 <= end; offs += 8)
+  {
+    uint64_t va, vb;
+    memcpy(&va, a + offs, 8);
+    memcpy(&vb, b + offs, 8);
+    if(va != vb)
+      break;
+  }
+
+  while(offs < end && a[offs] == b[offs])
+    offs++;
+
+  return offs;
+}
+
+size_t SkipDifferentScalar(const byte *a, const byte *b, size_t offs, size_t end)
+{
+  for(; offs + 8 <= end; offs += 8)
+  {
+    uint64_t va, vb;
+    memcpy(&va, a + offs, 8);
+    memcpy(&vb, b + offs, 8);
+    if(va == vb)
+      return offs;
+  }
+
+  while(offs < end && a[offs] != b[offs])
+    offs++;
+
+  return offs;
+}
+
+#if ENABLED(SSE_DIFF)
+
+inline uint32_t CountTrailingZeroes(uint32_t value)
+{
+#if defined(_MSC_VER)
+  unsigned long idx = 0;
+  _BitScanForward(&idx, value);
+  return idx;
+#else
+  return (uint32_t)__builtin_ctz(value);
+#endif
+}
+
+size_t SkipEqualSSE(const byte *a, const byte *b, size_t offs, size_t end)
+{
+  // most memory is unchanged, so check 64 bytes at a time while it is
+  for(; offs + 64 <= end; offs += 64)
+  {
+    __m128i x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + offs)),
+                               _mm_loadu_si128((const __m128i *)(b + offs)));
+    __m128i x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + offs + 16)),
+                               _mm_loadu_si128((const __m128i *)(b + offs + 16)));
+    __m128i x2 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + offs + 32)),
+                               _mm_loadu_si128((const __m128i *)(b + offs + 32)));
+    __m128i x3 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + offs + 48)),
+                               _mm_loadu_si128((const __m128i *)(b + offs + 48)));
+
+    __m128i any = _mm_or_si128(_mm_or_si128(x0, x1), _mm_or_si128(x2, x3));
+
+    if(_mm_movemask_epi8(_mm_cmpeq_epi8(any, _mm_setzero_si128())) != 0xffff)
+      break;
+  }
+
+  for(; offs + 16 <= end; offs += 16)
+  {
+    __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + offs)),
+                                _mm_loadu_si128((const __m128i *)(b + offs)));
+    uint32_t mask = (uint32_t)_mm_movemask_epi8(eq) ^ 0xffff;
+    if(mask)
+      return offs + CountTrailingZeroes(mask);
+  }
+
+  return SkipEqualScalar(a, b, offs, end);
+}
+
+size_t SkipDifferentSSE(const byte *a, const byte *b, size_t offs, size_t end)
+{
+  for(; offs + 16 <= end; offs += 16)
+  {
+    __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + offs)),
+                                _mm_loadu_si128((const __m128i *)(b + offs)));
+    if(_mm_movemask_epi8(eq) == 0xffff)
+      return offs;
+  }
+
+  return SkipDifferentScalar(a, b, offs, end);
+}
+
+#endif    // ENABLED(SSE_DIFF)
+
+#if ENABLED(AVX2_DIFF)
+
+AVX2_TARGET size_t SkipEqualAVX2(const byte *a, const byte *b, size_t offs, size_t end)
+{
+  for(; offs + 128 <= end; offs += 128)
+  {
+    __m256i x0 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(a + offs)),
+                                  _mm256_loadu_si256((const __m256i *)(b + offs)));
+    __m256i x1 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(a + offs + 32)),
+                                  _mm256_loadu_si256((const __m256i *)(b + offs + 32)));
+    __m256i x2 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(a + offs + 64)),
+                                  _mm256_loadu_si256((const __m256i *)(b + offs + 64)));
+    __m256i x3 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(a + offs + 96)),
+                                  _mm256_loadu_si256((const __m256i *)(b + offs + 96)));
+
+    __m256i any = _mm256_or_si256(_mm256_or_si256(x0, x1), _mm256_or_si256(x2, x3));
+
+    if(!_mm256_testz_si256(any, any))
+      break;
+  }
+
+  for(; offs + 32 <= end; offs += 32)
+  {
+    __m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + offs)),
+                                   _mm256_loadu_si256((const __m256i *)(b + offs)));
+    uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(eq);
+    if(mask)
+      return offs + CountTrailingZeroes(mask);
+  }
+
+  return SkipEqualSSE(a, b, offs, end);
+}
+
+AVX2_TARGET size_t SkipDifferentAVX2(const byte *a, const byte *b, size_t offs, size_t end)
+{
+  for(; offs + 32 <= end; offs += 32)
+  {
+    __m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + offs)),
+                                   _mm256_loadu_si256((const __m256i *)(b + offs)));
+    if((uint32_t)_mm256_movemask_epi8(eq) == 0xffffffffU)
+      return offs;
+  }
+
+  return SkipDifferentSSE(a, b, offs, end);
+}
+
+bool CPUSupportsAVX2()
+{
+#if defined(_MSC_VER)
+  int info[4] = {};
+
+  // the OS has to save the AVX registers as well as the CPU supporting them
+  __cpuid(info, 1);
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  bool avx = (info[2] & (1 << 28)) != 0;
+  if(!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+    return false;
+
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#endif    // ENABLED(AVX2_DIFF)
+
+typedef size_t (*SkipFunction)(const byte *a, const byte *b, size_t offs, size_t end);
+
+struct DiffFunctions
+{
+  DiffFunctions()
+  {
+#if ENABLED(AVX2_DIFF)
+    if(CPUSupportsAVX2())
+    {
+      SkipEqual = &SkipEqualAVX2;
+      SkipDifferent = &SkipDifferentAVX2;
+      return;
+    }
+#endif
+
+#if ENABLED(SSE_DIFF)
+    SkipEqual = &SkipEqualSSE;
+    SkipDifferent = &SkipDifferentSSE;
+#else
+    SkipEqual = &SkipEqualScalar;
+    SkipDifferent = &SkipDifferentScalar;
+#endif
+  }
+
+  SkipFunction SkipEqual;
+  SkipFunction SkipDifferent;
+};
+
+const DiffFunctions &GetDiffFunctions()
+{
+  static DiffFunctions funcs;
+  return funcs;
+}
+
+void AddDiffRange(std::vector<std::pair<size_t, size_t> > &ranges, size_t start, size_t end,
+                  size_t coalesceGap)
+{
+  if(!ranges.empty() && start - ranges.back().second <= coalesceGap)
+    ranges.back().second = end;
+  else
+    ranges.push_back(std::make_pair(start, end));
+}
+
+void FindDiffRangesInSlice(const byte *a, const byte *b, size_t begin, size_t end,
+                           size_t coalesceGap, std::vector<std::pair<size_t, size_t> > &ranges)
+{
+  const DiffFunctions &funcs = GetDiffFunctions();
+
+  size_t offs = funcs.SkipEqual(a, b, begin, end);
+
+  while(offs < end)
+  {
+    size_t diffStart = offs;
+
+    // find the end of the differing run, then walk back to be byte-accurate
+    size_t diffEnd = funcs.SkipDifferent(a, b, diffStart + 1, end);
+    while(diffEnd > diffStart + 1 && a[diffEnd - 1] == b[diffEnd - 1])
+      diffEnd--;
+
+    AddDiffRange(ranges, diffStart, diffEnd, coalesceGap);
+
+    offs = funcs.SkipEqual(a, b, diffEnd, end);
+  }
+}
+
+// below this size it isn't worth waking up threads to help
+const size_t ParallelDiffSliceSize = 16 * 1024 * 1024;
+};
+
+bool FindDiffRanges(const void *a, const void *b, size_t bufSize, size_t coalesceGap,
+                    std::vector<std::pair<size_t, size_t> > &ranges)
+{
+  ranges.clear();
+
+  const byte *abyte = (const byte *)a;
+  const byte *bbyte = (const byte *)b;
+
+  size_t numSlices = bufSize / ParallelDiffSliceSize;
+
+  if(numSlices <= 1)
+  {
+    FindDiffRangesInSlice(abyte, bbyte, 0, bufSize, coalesceGap, ranges);
+    return !ranges.empty();
+  }
+
+  WorkerPool &workers = WorkerPool::Get();
+
+  // the calling thread does one slice itself
+  numSlices = RDCMIN(numSlices, workers.NumWorkers() + 1);
+
+  // split the buffer evenly, on 4kB boundaries, and diff each part on a worker
+  size_t sliceSize = AlignUp(bufSize / numSlices, (size_t)4096);
+
+  std::vector<std::vector<std::pair<size_t, size_t> > > sliceRanges(numSlices);
+
+  for(size_t i = 1; i < numSlices; i++)
+  {
+    size_t begin = RDCMIN(i * sliceSize, bufSize);
+    size_t end = RDCMIN(begin + sliceSize, bufSize);
+    std::vector<std::pair<size_t, size_t> > *dst = &sliceRanges[i];
+
+    workers.Run(
+        [abyte, bbyte, begin, end, coalesceGap, dst]() {
+          FindDiffRangesInSlice(abyte, bbyte, begin, end, coalesceGap, *dst);
+        },
+        &sliceRanges);
+  }
+
+  // do the first slice on this thread
+  FindDiffRangesInSlice(abyte, bbyte, 0, RDCMIN(sliceSize, bufSize), coalesceGap, sliceRanges[0]);
+
+  workers.Wait(&sliceRanges);
+
+  // stitch the slices together, coalescing across the boundaries
+  for(const std::vector<std::pair<size_t, size_t> > &slice : sliceRanges)
+    for(const std::pair<size_t, size_t> &range : slice)
+      AddDiffRange(ranges, range.first, range.second, coalesceGap);
+
+  return !ranges.empty();
+}
+
 uint32_t CalcNumMips(int w, int h, int d)
 {
   int mipLevels = 1;
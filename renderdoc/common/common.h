@@ -156,6 +156,14 @@ inline T AlignUpPtr(T x, A a)
   (((uint32_t)(d) << 24) | ((uint32_t)(c) << 16) | ((uint32_t)(b) << 8) | (uint32_t)(a))
 
 bool FindDiffRange(void *a, void *b, size_t bufSize, size_t &diffStart, size_t &diffEnd);
+
+// finds every range of bytes that differs between a and b, as [start, end) offsets in ascending
+// order. Ranges separated by no more than coalesceGap equal bytes are merged, since serialising a
+// few unchanged bytes is cheaper than another range. Differences are searched for a vector at a
+// time, so shorter equal runs than that - up to 63 bytes, depending on alignment - may be merged
+// into a range too, even when coalesceGap is 0. Large buffers are compared on several threads.
+bool FindDiffRanges(const void *a, const void *b, size_t bufSize, size_t coalesceGap,
+                    std::vector<std::pair<size_t, size_t> > &ranges);
 uint32_t CalcNumMips(int Width, int Height, int Depth);
 
 byte *AllocAlignedBuffer(uint64_t size, uint64_t alignment = 64);
@@ -0,0 +1,250 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "common/common.h"
+#include "common/timing.h"
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "3rdparty/catch/catch.hpp"
+
+typedef std::vector<std::pair<size_t, size_t> > DiffRanges;
+
+TEST_CASE("Test finding diff ranges", "[diff]")
+{
+  // odd sizes and offsets, so the scalar tails of the vector loops are exercised
+  const size_t size = 100003;
+
+  std::vector<byte> a(size), b(size);
+  for(size_t i = 0; i < size; i++)
+    a[i] = b[i] = byte(i * 7);
+
+  DiffRanges ranges;
+
+  SECTION("Identical buffers have no ranges")
+  {
+    CHECK_FALSE(FindDiffRanges(a.data(), b.data(), size, 0, ranges));
+    CHECK(ranges.empty());
+
+    CHECK_FALSE(FindDiffRanges(a.data(), b.data(), 0, 0, ranges));
+    CHECK_FALSE(FindDiffRanges(a.data(), b.data(), 5, 0, ranges));
+  };
+
+  SECTION("Ranges are byte-accurate")
+  {
+    for(size_t pos : {(size_t)0, (size_t)1, (size_t)15, (size_t)64, (size_t)777, size - 1})
+    {
+      b = a;
+      b[pos]++;
+
+      REQUIRE(FindDiffRanges(a.data(), b.data(), size, 0, ranges));
+      REQUIRE(ranges.size() == 1);
+      CHECK(ranges[0].first == pos);
+      CHECK(ranges[0].second == pos + 1);
+
+      // and the same as the single range
+      size_t diffStart = 0, diffEnd = 0;
+      REQUIRE(FindDiffRange(a.data(), b.data(), size, diffStart, diffEnd));
+      CHECK(diffStart == pos);
+      CHECK(diffEnd == pos + 1);
+    }
+
+    for(size_t i = 1001; i < 1234; i++)
+      b[i] ^= 0xff;
+
+    REQUIRE(FindDiffRanges(a.data(), b.data(), size, 0, ranges));
+    REQUIRE(ranges.size() == 2);
+    CHECK(ranges[0].first == 1001);
+    CHECK(ranges[0].second == 1234);
+    CHECK(ranges[1].first == size - 1);
+    CHECK(ranges[1].second == size);
+  };
+
+  SECTION("Ranges separated by short gaps are merged")
+  {
+    b[1000]++;
+    b[1100]++;
+    b[50000]++;
+
+    REQUIRE(FindDiffRanges(a.data(), b.data(), size, 4096, ranges));
+    REQUIRE(ranges.size() == 2);
+    CHECK(ranges[0].first == 1000);
+    CHECK(ranges[0].second == 1101);
+    CHECK(ranges[1].first == 50000);
+    CHECK(ranges[1].second == 50001);
+
+    // a gap of exactly coalesceGap bytes is merged, one more isn't
+    REQUIRE(FindDiffRanges(a.data(), b.data(), size, 99, ranges));
+    CHECK(ranges.size() == 2);
+    REQUIRE(FindDiffRanges(a.data(), b.data(), size, 98, ranges));
+    CHECK(ranges.size() == 3);
+  };
+
+  SECTION("Every changed byte is covered")
+  {
+    uint32_t seed = 0x1234567;
+    for(int i = 0; i < 500; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      b[(seed >> 8) % size]++;
+    }
+
+    REQUIRE(FindDiffRanges(a.data(), b.data(), size, 0, ranges));
+
+    std::vector<bool> covered(size);
+    size_t prevEnd = 0;
+    for(const std::pair<size_t, size_t> &r : ranges)
+    {
+      CHECK(r.first >= prevEnd);
+      CHECK(r.first < r.second);
+      CHECK(a[r.first] != b[r.first]);
+      CHECK(a[r.second - 1] != b[r.second - 1]);
+      prevEnd = r.second;
+
+      for(size_t i = r.first; i < r.second; i++)
+        covered[i] = true;
+    }
+
+    for(size_t i = 0; i < size; i++)
+    {
+      if(a[i] != b[i] && !covered[i])
+      {
+        FAIL("Byte " << i << " differs but isn't in a range");
+      }
+    }
+  };
+};
+
+TEST_CASE("Test finding diff ranges in large buffers", "[diff]")
+{
+  // large enough to be split across threads, where there are several cores
+  const size_t size = 64 * 1024 * 1024 + 123;
+
+  byte *a = AllocAlignedBuffer(size);
+  byte *b = AllocAlignedBuffer(size);
+  memset(a, 0x5a, size);
+  memset(b, 0x5a, size);
+
+  // a run that crosses where the buffer would be split must come back as one range
+  const size_t middle = size / 2 - 4096;
+  memset(b + middle, 0, 2 * 4096 + 17);
+  b[10] = 0;
+  b[size - 3] = 0;
+
+  DiffRanges ranges;
+  REQUIRE(FindDiffRanges(a, b, size, 0, ranges));
+  REQUIRE(ranges.size() == 3);
+  CHECK(ranges[0].first == 10);
+  CHECK(ranges[0].second == 11);
+  CHECK(ranges[1].first == middle);
+  CHECK(ranges[1].second == middle + 2 * 4096 + 17);
+  CHECK(ranges[2].first == size - 3);
+  CHECK(ranges[2].second == size - 2);
+
+  FreeAlignedBuffer(a);
+  FreeAlignedBuffer(b);
+};
+
+// hidden behind [.] so it doesn't run with the normal tests. Run it with "[benchmark][diff]".
+TEST_CASE("Benchmark finding diff ranges", "[.][benchmark][diff]")
+{
+  // the size of a large persistently mapped buffer
+  const size_t size = 128 * 1024 * 1024;
+
+  byte *a = AllocAlignedBuffer(size);
+  byte *b = AllocAlignedBuffer(size);
+
+  for(size_t i = 0; i < size; i++)
+    a[i] = byte(i / 13);
+  memcpy(b, a, size);
+
+  const int iterations = 5;
+
+  // compares the single range against the separate ranges, in how much data they'd serialise
+  // and how long they take to find
+  auto run = [&](const char *name) {
+    double singleTime = 0.0, rangesTime = 0.0;
+    size_t singleBytes = 0, rangesBytes = 0, numRanges = 0;
+
+    DiffRanges ranges;
+
+    for(int i = 0; i < iterations; i++)
+    {
+      PerformanceTimer timer;
+
+      size_t diffStart = 0, diffEnd = 0;
+      if(FindDiffRange(a, b, size, diffStart, diffEnd))
+        singleBytes = diffEnd - diffStart;
+
+      singleTime += timer.GetMilliseconds();
+
+      timer.Restart();
+
+      FindDiffRanges(a, b, size, 4096, ranges);
+
+      rangesTime += timer.GetMilliseconds();
+    }
+
+    rangesBytes = 0;
+    numRanges = ranges.size();
+    for(const std::pair<size_t, size_t> &r : ranges)
+      rangesBytes += r.second - r.first;
+
+    std::string prefix = name;
+    RecordBenchmark((prefix + " single range time").c_str(), singleTime / iterations, "ms");
+    RecordBenchmark((prefix + " single range bytes").c_str(), double(singleBytes), "bytes");
+    RecordBenchmark((prefix + " ranges time").c_str(), rangesTime / iterations, "ms");
+    RecordBenchmark((prefix + " ranges bytes").c_str(), double(rangesBytes), "bytes");
+    RecordBenchmark((prefix + " ranges count").c_str(), double(numRanges), "ranges");
+  };
+
+  run("unchanged");
+
+  // a ring buffer written at both ends, e.g. per-frame constants at the start and streamed
+  // vertices wrapping around at the end
+  memset(b + 1024, 0, 64 * 1024);
+  memset(b + size - 256 * 1024, 0, 128 * 1024);
+  run("two writes");
+
+  // writes scattered through the whole buffer
+  memcpy(b, a, size);
+  uint32_t seed = 0x1234567;
+  for(int i = 0; i < 2000; i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    size_t offs = (seed % (size / 256)) * 256;
+    memset(b + offs, 0, 64);
+  }
+  run("scattered writes");
+
+  // everything changed
+  for(size_t i = 0; i < size; i++)
+    b[i] = ~a[i];
+  run("all changed");
+
+  FreeAlignedBuffer(a);
+  FreeAlignedBuffer(b);
+};
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -0,0 +1,172 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017-2018 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "common/threading.h"
+
+// the hash used to place keys in a ConcurrentHashMap. Specialise this for any key type that
+// std::hash doesn't support.
+template <typename T>
+struct ConcurrentHash
+{
+  size_t operator()(const T &t) const { return std::hash<T>()(t); }
+};
+
+// A hash map for data that is read far more often than it is modified, from many threads at once.
+//
+// Keys are spread across a fixed number of shards, each with its own reader/writer lock. Lookups
+// then never contend with each other, and only wait on writes that land in the same shard.
+//
+// No lock is held outside of a call, so values are returned by copy - a reference could be
+// invalidated by another thread's write as soon as the shard is unlocked. For the same reason there
+// is no iteration, only a Snapshot() of the contents.
+template <typename K, typename V, typename Hash = ConcurrentHash<K>>
+class ConcurrentHashMap
+{
+public:
+  ConcurrentHashMap() = default;
+  ConcurrentHashMap(const ConcurrentHashMap &) = delete;
+  ConcurrentHashMap &operator=(const ConcurrentHashMap &) = delete;
+
+  // returns true and fills out value if the key is present
+  bool Find(const K &key, V &value) const
+  {
+    const Shard &shard = GetShard(key);
+
+    SCOPED_READLOCK(shard.lock);
+
+    auto it = shard.map.find(key);
+    if(it == shard.map.end())
+      return false;
+
+    value = it->second;
+    return true;
+  }
+
+  bool Contains(const K &key) const
+  {
+    const Shard &shard = GetShard(key);
+
+    SCOPED_READLOCK(shard.lock);
+
+    return shard.map.find(key) != shard.map.end();
+  }
+
+  // inserts the key or replaces its value, returns true if the key was already present
+  bool Set(const K &key, const V &value)
+  {
+    Shard &shard = GetShard(key);
+
+    SCOPED_WRITELOCK(shard.lock);
+
+    auto it = shard.map.find(key);
+    if(it != shard.map.end())
+    {
+      it->second = value;
+      return true;
+    }
+
+    shard.map.insert(std::make_pair(key, value));
+    return false;
+  }
+
+  // returns true if the key was present and has been removed
+  bool Erase(const K &key)
+  {
+    Shard &shard = GetShard(key);
+
+    SCOPED_WRITELOCK(shard.lock);
+
+    return shard.map.erase(key) > 0;
+  }
+
+  size_t Size() const
+  {
+    size_t ret = 0;
+    for(const Shard &shard : m_Shards)
+    {
+      SCOPED_READLOCK(shard.lock);
+      ret += shard.map.size();
+    }
+    return ret;
+  }
+
+  bool Empty() const { return Size() == 0; }
+  void Clear()
+  {
+    for(Shard &shard : m_Shards)
+    {
+      SCOPED_WRITELOCK(shard.lock);
+      shard.map.clear();
+    }
+  }
+
+  // returns a copy of the contents in no particular order. With concurrent writes, each shard is
+  // consistent but the whole may not be.
+  std::vector<std::pair<K, V>> Snapshot() const
+  {
+    std::vector<std::pair<K, V>> ret;
+    for(const Shard &shard : m_Shards)
+    {
+      SCOPED_READLOCK(shard.lock);
+      ret.insert(ret.end(), shard.map.begin(), shard.map.end());
+    }
+    return ret;
+  }
+
+  // as Snapshot(), but sorted by key. Anywhere the order is visible, like the order resources are
+  // serialised into a capture, must use this so it doesn't change from run to run with the hashes.
+  std::vector<std::pair<K, V>> SortedSnapshot() const
+  {
+    std::vector<std::pair<K, V>> ret = Snapshot();
+    std::sort(ret.begin(), ret.end(),
+              [](const std::pair<K, V> &a, const std::pair<K, V> &b) { return a.first < b.first; });
+    return ret;
+  }
+
+private:
+  static const uint32_t ShardBits = 6;
+
+  struct Shard
+  {
+    mutable Threading::RWLock lock;
+    std::unordered_map<K, V, Hash> map;
+  };
+
+  uint32_t ShardIndex(const K &key) const
+  {
+    // pointer keys especially have low bits that are always 0, so mix the hash and take the top bits
+    uint64_t h = uint64_t(Hash()(key)) * 0x9E3779B97F4A7C15ULL;
+    return uint32_t(h >> (64 - ShardBits));
+  }
+
+  Shard &GetShard(const K &key) { return m_Shards[ShardIndex(key)]; }
+  const Shard &GetShard(const K &key) const { return m_Shards[ShardIndex(key)]; }
+  Shard m_Shards[1 << ShardBits];
+};
@@ -0,0 +1,482 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "shader_cache.h"
+#include <algorithm>
+
+namespace
+{
+// the layout of the files themselves, independent of the version of what's cached in them
+static const uint32_t FileFormat = 2;
+
+struct DataHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t format;
+  uint32_t padding;
+};
+
+static const uint32_t EntryMarker = 0x59524e45;    // 'ENRY'
+
+struct EntryHeader
+{
+  uint32_t marker;
+  uint32_t checksum;
+  uint64_t hash;
+  uint32_t length;
+  uint32_t padding;
+};
+
+uint32_t EntryChecksum(uint64_t hash, const byte *data, uint32_t length)
+{
+  // FNV-1a, seeded with the hash and length so that an all-zero entry doesn't check out
+  uint32_t ret = 2166136261U ^ uint32_t(hash) ^ uint32_t(hash >> 32) ^ length;
+  for(uint32_t i = 0; i < length; i++)
+    ret = (ret ^ data[i]) * 16777619U;
+  return ret;
+}
+
+struct IndexHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  // the length of the data file covered by the index. Anything after this is scanned on open.
+  uint64_t dataLength;
+  uint64_t count;
+};
+};
+
+ShaderCacheFile::~ShaderCacheFile()
+{
+  Close();
+}
+
+bool ShaderCacheFile::Open(const std::string &path, uint32_t magicNumber, uint32_t versionNumber)
+{
+  Close();
+
+  m_Path = path;
+  m_Magic = magicNumber;
+  m_Version = versionNumber;
+
+  if(!LoadData())
+  {
+    Reset();
+    return !m_AppendFailed;
+  }
+
+  uint64_t indexedLength = LoadIndex();
+
+  // anything past the last complete entry may be another process's append that's still in flight,
+  // so it's left alone for now. See TruncateTornTail.
+  m_ScannedLength = ScanEntries(indexedLength);
+
+  // rewrite the index on close if it's missing entries, so we don't scan for them every time
+  m_IndexDirty = !m_Unindexed.empty() || indexedLength != m_ScannedLength;
+
+  RDCDEBUG("Opened shader cache with %u indexed and %u unindexed entries", (uint32_t)m_NumIndexed,
+           (uint32_t)m_Unindexed.size());
+
+  return true;
+}
+
+void ShaderCacheFile::Close()
+{
+  if(m_AppendFile)
+    FileIO::fclose(m_AppendFile);
+  m_AppendFile = NULL;
+
+  if(m_IndexDirty && !m_Path.empty())
+    WriteIndex();
+
+  UnloadData();
+  UnloadIndex();
+
+  m_Unindexed.clear();
+  m_Added.clear();
+  m_Path.clear();
+  m_AppendFailed = false;
+  m_IndexDirty = false;
+  m_ScannedLength = 0;
+}
+
+bool ShaderCacheFile::Find(uint64_t hash, const byte *&data, uint32_t &length) const
+{
+  uint64_t offset = 0;
+
+  // entries found by scanning are newer than the index, so they take precedence
+  auto unindexed = m_Unindexed.find(hash);
+  if(unindexed != m_Unindexed.end())
+  {
+    offset = unindexed->second;
+  }
+  else
+  {
+    const IndexEntry *end = m_Index + m_NumIndexed;
+    const IndexEntry key = {hash, 0};
+    const IndexEntry *it = std::lower_bound(m_Index, end, key);
+
+    if(it == end || it->hash != hash)
+      return false;
+
+    offset = it->offset;
+  }
+
+  // the index is only trusted as far as the data it points to agrees with it
+  if(!ValidEntry(offset))
+  {
+    RDCERR("Invalid shader cache entry for %llx at %llu", hash, offset);
+    return false;
+  }
+
+  EntryHeader header;
+  memcpy(&header, m_Data + offset, sizeof(header));
+
+  if(header.hash != hash)
+  {
+    RDCERR("Invalid shader cache entry for %llx at %llu", hash, offset);
+    return false;
+  }
+
+  data = m_Data + offset + sizeof(EntryHeader);
+  length = header.length;
+
+  return true;
+}
+
+void ShaderCacheFile::Add(uint64_t hash, const byte *data, uint32_t length)
+{
+  if(m_Path.empty() || m_AppendFailed)
+    return;
+
+  if(!m_AppendFile)
+  {
+    m_AppendFile = FileIO::fopen(m_Path.c_str(), "ab");
+
+    if(!m_AppendFile)
+    {
+      RDCERR("Error opening shader cache for write");
+      m_AppendFailed = true;
+      return;
+    }
+
+    // unbuffered, so each entry goes to the file in one write
+    setvbuf(m_AppendFile, NULL, _IONBF, 0);
+
+    TruncateTornTail();
+  }
+
+  std::vector<byte> entry(sizeof(EntryHeader) + length);
+
+  EntryHeader header = {EntryMarker, EntryChecksum(hash, data, length), hash, length, 0};
+  memcpy(entry.data(), &header, sizeof(header));
+  memcpy(entry.data() + sizeof(header), data, length);
+
+  // in append mode the write always lands at the current end of the file, even if other processes
+  // have appended since, and afterwards our position is the end of what we wrote.
+  if(FileIO::fwrite(entry.data(), 1, entry.size(), m_AppendFile) != entry.size())
+  {
+    RDCERR("Error writing to shader cache");
+    m_AppendFailed = true;
+    return;
+  }
+
+  m_Added.push_back({hash, FileIO::ftell64(m_AppendFile) - entry.size()});
+  m_IndexDirty = true;
+}
+
+void ShaderCacheFile::TruncateTornTail()
+{
+  if(m_ScannedLength >= m_DataLength)
+    return;
+
+  // if anything has been appended since we scanned the file, the tail could be that append still
+  // being written. Otherwise it's a torn entry from a process that died mid-write, and anything we
+  // appended would land after it.
+  FileIO::fseek64(m_AppendFile, 0, SEEK_END);
+  if(FileIO::ftell64(m_AppendFile) != m_DataLength)
+    return;
+
+  RDCWARN("Truncating %llu bytes of torn entries from shader cache",
+          m_DataLength - m_ScannedLength);
+
+  FileIO::ftruncateat(m_AppendFile, m_ScannedLength);
+}
+
+bool ShaderCacheFile::LoadData()
+{
+  FILE *f = FileIO::fopen(m_Path.c_str(), "rb");
+
+  if(!f)
+    return false;
+
+  FileIO::fseek64(f, 0, SEEK_END);
+  uint64_t len = FileIO::ftell64(f);
+  FileIO::fseek64(f, 0, SEEK_SET);
+
+  bool ret = false;
+
+  if(len < sizeof(DataHeader))
+  {
+    RDCERR("Invalid shader cache");
+  }
+  else
+  {
+    m_DataMapping = FileIO::mmapfile(f, len);
+
+    if(m_DataMapping)
+    {
+      m_Data = m_DataMapping;
+    }
+    else
+    {
+      m_DataStorage.resize((size_t)len);
+      FileIO::fread(m_DataStorage.data(), 1, (size_t)len, f);
+      m_Data = m_DataStorage.data();
+    }
+
+    m_DataLength = len;
+
+    DataHeader header;
+    memcpy(&header, m_Data, sizeof(header));
+
+    if(header.magic != m_Magic || header.version != m_Version || header.format != FileFormat)
+      RDCDEBUG("Out of date or invalid shader cache magic: %x version: %u", header.magic,
+               header.version);
+    else
+      ret = true;
+  }
+
+  FileIO::fclose(f);
+
+  return ret;
+}
+
+uint64_t ShaderCacheFile::LoadIndex()
+{
+  std::string indexPath = m_Path + ".index";
+
+  FILE *f = FileIO::fopen(indexPath.c_str(), "rb");
+
+  if(!f)
+    return sizeof(DataHeader);
+
+  FileIO::fseek64(f, 0, SEEK_END);
+  uint64_t len = FileIO::ftell64(f);
+  FileIO::fseek64(f, 0, SEEK_SET);
+
+  IndexHeader header = {};
+  if(len >= sizeof(header))
+    FileIO::fread(&header, 1, sizeof(header), f);
+
+  if(len < sizeof(header) || header.magic != m_Magic || header.version != m_Version ||
+     header.dataLength < sizeof(DataHeader) || header.dataLength > m_DataLength ||
+     header.count != (len - sizeof(header)) / sizeof(IndexEntry) ||
+     (len - sizeof(header)) % sizeof(IndexEntry) != 0)
+  {
+    RDCWARN("Invalid or out of date shader cache index, rebuilding");
+    FileIO::fclose(f);
+    return sizeof(DataHeader);
+  }
+
+  if(header.count > 0)
+  {
+    m_IndexMapping = FileIO::mmapfile(f, len);
+
+    if(m_IndexMapping)
+    {
+      m_IndexMappingLength = len;
+      m_Index = (const IndexEntry *)(m_IndexMapping + sizeof(header));
+    }
+    else
+    {
+      m_IndexStorage.resize((size_t)header.count);
+      FileIO::fread(m_IndexStorage.data(), sizeof(IndexEntry), (size_t)header.count, f);
+      m_Index = m_IndexStorage.data();
+    }
+
+    m_NumIndexed = (size_t)header.count;
+  }
+
+  FileIO::fclose(f);
+
+  return header.dataLength;
+}
+
+uint64_t ShaderCacheFile::ScanEntries(uint64_t offset)
+{
+  uint64_t end = offset;
+
+  while(offset < m_DataLength)
+  {
+    if(!ValidEntry(offset))
+    {
+      // a torn entry from a process that died mid-write. Look for the next valid entry after it,
+      // and if there isn't one leave the rest to be scanned again next time.
+      offset++;
+      continue;
+    }
+
+    EntryHeader header;
+    memcpy(&header, m_Data + offset, sizeof(header));
+
+    m_Unindexed[header.hash] = offset;
+    offset += sizeof(EntryHeader) + header.length;
+    end = offset;
+  }
+
+  return end;
+}
+
+bool ShaderCacheFile::ValidEntry(uint64_t offset) const
+{
+  if(offset < sizeof(DataHeader) || offset > m_DataLength ||
+     m_DataLength - offset < sizeof(EntryHeader))
+    return false;
+
+  EntryHeader header;
+  memcpy(&header, m_Data + offset, sizeof(header));
+
+  if(header.marker != EntryMarker || m_DataLength - offset - sizeof(EntryHeader) < header.length)
+    return false;
+
+  return header.checksum ==
+         EntryChecksum(header.hash, m_Data + offset + sizeof(EntryHeader), header.length);
+}
+
+void ShaderCacheFile::UnloadData()
+{
+  FileIO::munmapfile(m_DataMapping, m_DataLength);
+  m_DataMapping = NULL;
+  m_DataStorage.clear();
+  m_Data = NULL;
+  m_DataLength = 0;
+}
+
+void ShaderCacheFile::UnloadIndex()
+{
+  FileIO::munmapfile(m_IndexMapping, m_IndexMappingLength);
+  m_IndexMapping = NULL;
+  m_IndexMappingLength = 0;
+  m_IndexStorage.clear();
+  m_Index = NULL;
+  m_NumIndexed = 0;
+}
+
+void ShaderCacheFile::Reset()
+{
+  UnloadData();
+  UnloadIndex();
+  m_Unindexed.clear();
+
+  // don't leave an index around that refers to the old data
+  FileIO::Delete((m_Path + ".index").c_str());
+
+  // other processes may still have the old file mapped, so write a new one and move it into place
+  // rather than truncating it.
+  std::string tempPath = m_Path + StringFormat::Fmt(".%u.tmp", Process::GetCurrentPID());
+
+  FILE *f = FileIO::fopen(tempPath.c_str(), "wb");
+
+  if(!f)
+  {
+    RDCERR("Error opening shader cache for write");
+    m_AppendFailed = true;
+    return;
+  }
+
+  DataHeader header = {m_Magic, m_Version, FileFormat, 0};
+  FileIO::fwrite(&header, 1, sizeof(header), f);
+  FileIO::fclose(f);
+
+  if(!FileIO::Move(tempPath.c_str(), m_Path.c_str(), true))
+  {
+    RDCERR("Error replacing shader cache");
+    FileIO::Delete(tempPath.c_str());
+    m_AppendFailed = true;
+    return;
+  }
+
+  m_ScannedLength = sizeof(header);
+  m_IndexDirty = true;
+}
+
+void ShaderCacheFile::WriteIndex()
+{
+  // other processes may have appended since we opened the cache. Pick up their entries too, so the
+  // index we write doesn't claim to cover data it's missing entries from.
+  UnloadData();
+  if(LoadData())
+    m_ScannedLength = ScanEntries(RDCMIN(m_ScannedLength, m_DataLength));
+
+  // what we added ourselves is normally found again by the scan above, which is the most reliable
+  // record of where it ended up, so scanned entries go last.
+  std::vector<IndexEntry> entries(m_Index, m_Index + m_NumIndexed);
+  entries.insert(entries.end(), m_Added.begin(), m_Added.end());
+  for(auto it = m_Unindexed.begin(); it != m_Unindexed.end(); ++it)
+    entries.push_back({it->first, it->second});
+
+  // the entries are in the order they were written, so when a hash is duplicated keep the last
+  std::stable_sort(entries.begin(), entries.end());
+
+  size_t count = 0;
+  for(size_t i = 0; i < entries.size(); i++)
+  {
+    if(i + 1 < entries.size() && entries[i + 1].hash == entries[i].hash)
+      continue;
+
+    entries[count++] = entries[i];
+  }
+  entries.resize(count);
+
+  // the old index can't be overwritten while it's mapped
+  UnloadIndex();
+
+  std::string indexPath = m_Path + ".index";
+  std::string tempPath = indexPath + StringFormat::Fmt(".%u.tmp", Process::GetCurrentPID());
+
+  FILE *f = FileIO::fopen(tempPath.c_str(), "wb");
+
+  if(!f)
+  {
+    RDCERR("Error opening shader cache index for write");
+    return;
+  }
+
+  IndexHeader header = {m_Magic, m_Version, m_ScannedLength, count};
+  FileIO::fwrite(&header, 1, sizeof(header), f);
+  FileIO::fwrite(entries.data(), sizeof(IndexEntry), count, f);
+  FileIO::fclose(f);
+
+  // another process may have the old index mapped, so replace it rather than overwriting it
+  if(!FileIO::Move(tempPath.c_str(), indexPath.c_str(), true))
+  {
+    RDCERR("Error replacing shader cache index");
+    FileIO::Delete(tempPath.c_str());
+    return;
+  }
+
+  RDCDEBUG("Wrote shader cache index with %u entries", (uint32_t)count);
+}
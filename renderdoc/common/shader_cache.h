@@ -24,162 +24,140 @@
 
 #pragma once
 
+#include <map>
+#include <vector>
 #include "os/os_specific.h"
 
-template <typename ResultType, typename ShaderCallbacks>
-bool LoadShaderCache(const char *filename, const uint32_t magicNumber, const uint32_t versionNumber,
-                     std::map<uint32_t, ResultType> &resultCache, const ShaderCallbacks &callbacks)
+// An on-disk cache of compiled shader blobs keyed by a 64-bit hash.
+//
+// The data file is a header followed by entries that are only ever appended, so adding a shader
+// never rewrites what's already there. Alongside it is an index file of (hash, offset) pairs sorted
+// by hash, which is memory-mapped and binary searched on lookup. Entries are only read when they're
+// looked up, so opening the cache costs the same regardless of how many shaders are in it.
+//
+// The index is rewritten when the cache is closed if anything was added. Entries appended after the
+// index was last written (e.g. by another process, or one that didn't close cleanly) are found by
+// scanning the tail of the data file on open.
+//
+// Several processes can use the same cache at once. Each entry is appended with a single write to
+// the file opened for append, and carries a marker and checksum so that a torn or in-flight entry
+// is skipped rather than trusted. A torn entry at the end of the file is only cut off before we
+// append, if the file hasn't grown since it was scanned, so it's not an append still in flight.
+// Otherwise files are never rewritten in place, since another process may have them mapped - a new
+// data file or index is written to a temporary file and renamed over the old one.
+class ShaderCacheFile
 {
-  string shadercache = FileIO::GetAppFolderFilename(filename);
-
-  FILE *f = FileIO::fopen(shadercache.c_str(), "rb");
+public:
+  ShaderCacheFile() = default;
+  ~ShaderCacheFile();
 
-  if(!f)
-    return false;
+  // opens the cache at path, discarding its contents if the magic or version don't match or if the
+  // file is corrupt. Returns false if the cache couldn't be opened at all, in which case lookups
+  // always miss and additions are dropped.
+  bool Open(const std::string &path, uint32_t magicNumber, uint32_t versionNumber);
+  void Close();
 
-  FileIO::fseek64(f, 0, SEEK_END);
-  uint64_t cachelen = FileIO::ftell64(f);
-  FileIO::fseek64(f, 0, SEEK_SET);
+  // looks up an entry that was in the cache when it was opened. The returned data is only valid
+  // until the cache is closed.
+  bool Find(uint64_t hash, const byte *&data, uint32_t &length) const;
 
-  bool ret = true;
+  void Add(uint64_t hash, const byte *data, uint32_t length);
 
-  // header: magic number, file version, number of entries
-  if(cachelen < sizeof(uint32_t) * 3)
+  size_t GetNumEntries() const { return m_NumIndexed + m_Unindexed.size() + m_Added.size(); }
+private:
+  struct IndexEntry
   {
-    RDCERR("Invalid shader cache");
-    ret = false;
-  }
-  else
-  {
-    byte *cache = new byte[(size_t)cachelen];
-    FileIO::fread(cache, 1, (size_t)cachelen, f);
-
-    uint32_t *header = (uint32_t *)cache;
-
-    uint32_t fileMagic = header[0];
-    uint32_t fileVer = header[1];
-
-    if(fileMagic != magicNumber || fileVer != versionNumber)
-    {
-      RDCDEBUG("Out of date or invalid shader cache magic: %d version: %d", fileMagic, fileVer);
-      ret = false;
-    }
-    else
-    {
-      uint32_t numentries = header[2];
-
-      // assume at least 16 bytes for any cache entry. 8 bytes for hash and length, and 8 bytes
-      // data.
-      if(numentries > cachelen / 16LLU)
-      {
-        RDCERR("Invalid shader cache - more entries %u than are feasible in a %llu byte cache",
-               numentries, cachelen);
-        ret = false;
-      }
-      else
-      {
-        byte *ptr = cache + sizeof(uint32_t) * 3;
-
-        int64_t bufsize = (int64_t)cachelen - sizeof(uint32_t) * 3;
-
-        for(uint32_t i = 0; i < numentries; i++)
-        {
-          if((size_t)bufsize < sizeof(uint32_t))
-          {
-            RDCERR("Invalid shader cache - truncated, not enough data for shader hash");
-            ret = false;
-            break;
-          }
-
-          uint32_t hash = *(uint32_t *)ptr;
-          ptr += sizeof(uint32_t);
-          bufsize -= sizeof(uint32_t);
-
-          if((size_t)bufsize < sizeof(uint32_t))
-          {
-            RDCERR("Invalid shader cache - truncated, not enough data for shader length");
-            ret = false;
-            break;
-          }
-
-          uint32_t len = *(uint32_t *)ptr;
-          ptr += sizeof(uint32_t);
-          bufsize -= sizeof(uint32_t);
-
-          if(bufsize < len)
-          {
-            RDCERR("Invalid shader cache - truncated, not enough data for shader buffer");
-            ret = false;
-            break;
-          }
-
-          byte *data = ptr;
-          ptr += len;
-          bufsize -= len;
-
-          ResultType result;
-          bool created = callbacks.Create(len, data, &result);
-
-          if(!created)
-          {
-            RDCERR("Couldn't create blob of size %u from shadercache", len);
-            ret = false;
-            break;
-          }
-
-          resultCache[hash] = result;
-        }
-
-        if(ret == true && bufsize != 0)
-        {
-          RDCERR("Invalid shader cache - trailing data");
-          ret = false;
-        }
-
-        RDCDEBUG("Successfully loaded %d shaders from shader cache", resultCache.size());
-      }
-    }
-
-    delete[] cache;
-  }
-
-  FileIO::fclose(f);
-
-  return ret;
-}
-
+    uint64_t hash;
+    uint64_t offset;
+
+    bool operator<(const IndexEntry &o) const { return hash < o.hash; }
+  };
+
+  ShaderCacheFile(const ShaderCacheFile &) = delete;
+  ShaderCacheFile &operator=(const ShaderCacheFile &) = delete;
+
+  bool LoadData();
+  uint64_t LoadIndex();
+  uint64_t ScanEntries(uint64_t offset);
+  bool ValidEntry(uint64_t offset) const;
+  void TruncateTornTail();
+  void UnloadData();
+  void UnloadIndex();
+  void Reset();
+  void WriteIndex();
+
+  std::string m_Path;
+  uint32_t m_Magic = 0, m_Version = 0;
+
+  // the data file as it was when opened. Mapped if possible, otherwise read into m_DataStorage
+  const byte *m_DataMapping = NULL;
+  std::vector<byte> m_DataStorage;
+  const byte *m_Data = NULL;
+  uint64_t m_DataLength = 0;
+
+  const byte *m_IndexMapping = NULL;
+  uint64_t m_IndexMappingLength = 0;
+  std::vector<IndexEntry> m_IndexStorage;
+  const IndexEntry *m_Index = NULL;
+  size_t m_NumIndexed = 0;
+
+  // entries past the end of what the index covers, found by scanning
+  std::map<uint64_t, uint64_t> m_Unindexed;
+
+  // how much of the data file has been scanned for entries
+  uint64_t m_ScannedLength = 0;
+
+  FILE *m_AppendFile = NULL;
+  bool m_AppendFailed = false;
+  std::vector<IndexEntry> m_Added;
+  bool m_IndexDirty = false;
+};
+
+// looks up a shader, first in the results that have already been created from the cache, then in
+// the file. Blobs are only created from the file the first time they're looked up.
 template <typename ResultType, typename ShaderCallbacks>
-void SaveShaderCache(const char *filename, uint32_t magicNumber, uint32_t versionNumber,
-                     const std::map<uint32_t, ResultType> &cache, const ShaderCallbacks &callbacks)
+bool FindCachedShader(ShaderCacheFile &file, std::map<uint64_t, ResultType> &resultCache,
+                      uint64_t hash, ResultType &result, const ShaderCallbacks &callbacks)
 {
-  string shadercache = FileIO::GetAppFolderFilename(filename);
+  auto it = resultCache.find(hash);
+  if(it != resultCache.end())
+  {
+    result = it->second;
+    return true;
+  }
 
-  FILE *f = FileIO::fopen(shadercache.c_str(), "wb");
+  const byte *data = NULL;
+  uint32_t length = 0;
+  if(!file.Find(hash, data, length))
+    return false;
 
-  if(!f)
+  if(!callbacks.Create(length, data, &result))
   {
-    RDCERR("Error opening shader cache for write");
-    return;
+    RDCERR("Couldn't create blob of size %u from shadercache", length);
+    return false;
   }
 
-  FileIO::fwrite(&magicNumber, 1, sizeof(magicNumber), f);
-  FileIO::fwrite(&versionNumber, 1, sizeof(versionNumber), f);
-  uint32_t numentries = (uint32_t)cache.size();
-  FileIO::fwrite(&numentries, 1, sizeof(numentries), f);
+  resultCache[hash] = result;
+  return true;
+}
 
-  for(auto it = cache.begin(); it != cache.end(); ++it)
-  {
-    uint32_t hash = it->first;
-    uint32_t len = callbacks.GetSize(it->second);
-    const byte *data = callbacks.GetData(it->second);
-    FileIO::fwrite(&hash, 1, sizeof(hash), f);
-    FileIO::fwrite(&len, 1, sizeof(len), f);
-    FileIO::fwrite(data, 1, len, f);
+// adds a newly compiled shader, which the result cache takes ownership of, and appends it to the
+// file.
+template <typename ResultType, typename ShaderCallbacks>
+void AddCachedShader(ShaderCacheFile &file, std::map<uint64_t, ResultType> &resultCache,
+                     uint64_t hash, ResultType result, const ShaderCallbacks &callbacks)
+{
+  resultCache[hash] = result;
+  file.Add(hash, callbacks.GetData(result), callbacks.GetSize(result));
+}
 
+template <typename ResultType, typename ShaderCallbacks>
+void DestroyShaderCache(ShaderCacheFile &file, std::map<uint64_t, ResultType> &resultCache,
+                        const ShaderCallbacks &callbacks)
+{
+  for(auto it = resultCache.begin(); it != resultCache.end(); ++it)
     callbacks.Destroy(it->second);
-  }
-
-  FileIO::fclose(f);
+  resultCache.clear();
 
-  RDCDEBUG("Successfully wrote %u shaders to shader cache", numentries);
+  file.Close();
 }
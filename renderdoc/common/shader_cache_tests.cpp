@@ -0,0 +1,279 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "common/shader_cache.h"
+#include "common/globalconfig.h"
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "3rdparty/catch/catch.hpp"
+
+static const uint32_t testMagic = 0xf00dcac4;
+
+static std::string CacheEntry(uint64_t hash)
+{
+  std::string ret = "shader ";
+  for(int i = 0; i < int(hash % 37); i++)
+    ret += char('a' + i % 26);
+  return ret;
+}
+
+static bool HasEntry(const ShaderCacheFile &cache, uint64_t hash)
+{
+  const byte *data = NULL;
+  uint32_t length = 0;
+
+  if(!cache.Find(hash, data, length))
+    return false;
+
+  return std::string((const char *)data, (const char *)data + length) == CacheEntry(hash);
+}
+
+static void AddEntries(ShaderCacheFile &cache, uint64_t first, uint64_t count)
+{
+  for(uint64_t hash = first; hash < first + count; hash++)
+  {
+    std::string entry = CacheEntry(hash * 0x9e3779b97f4a7c15ULL);
+    cache.Add(hash * 0x9e3779b97f4a7c15ULL, (const byte *)entry.data(), (uint32_t)entry.size());
+  }
+}
+
+static bool HasEntries(const ShaderCacheFile &cache, uint64_t first, uint64_t count)
+{
+  for(uint64_t hash = first; hash < first + count; hash++)
+    if(!HasEntry(cache, hash * 0x9e3779b97f4a7c15ULL))
+      return false;
+
+  return true;
+}
+
+TEST_CASE("Test indexed shader cache", "[shadercache]")
+{
+  std::string path = FileIO::GetTempFolderFilename() + "renderdoc_shadercache_test.cache";
+  std::string indexPath = path + ".index";
+
+  FileIO::Delete(path.c_str());
+  FileIO::Delete(indexPath.c_str());
+
+  {
+    ShaderCacheFile cache;
+    REQUIRE(cache.Open(path, testMagic, 1));
+    CHECK(cache.GetNumEntries() == 0);
+
+    AddEntries(cache, 1, 100);
+    CHECK(cache.GetNumEntries() == 100);
+  }
+
+  CHECK(FileIO::exists(indexPath.c_str()));
+
+  SECTION("Entries are found after reopening")
+  {
+    ShaderCacheFile cache;
+    REQUIRE(cache.Open(path, testMagic, 1));
+    CHECK(cache.GetNumEntries() == 100);
+
+    CHECK(HasEntries(cache, 1, 100));
+    CHECK_FALSE(HasEntry(cache, 0));
+    CHECK_FALSE(HasEntry(cache, 12345));
+
+    // entries appended later are indexed along with the existing ones
+    AddEntries(cache, 101, 50);
+    cache.Close();
+
+    REQUIRE(cache.Open(path, testMagic, 1));
+    CHECK(cache.GetNumEntries() == 150);
+    CHECK(HasEntries(cache, 1, 150));
+  };
+
+  SECTION("Entries missing from the index are found by scanning")
+  {
+    FileIO::Delete(indexPath.c_str());
+
+    ShaderCacheFile cache;
+    REQUIRE(cache.Open(path, testMagic, 1));
+    CHECK(cache.GetNumEntries() == 100);
+    CHECK(HasEntries(cache, 1, 100));
+    cache.Close();
+
+    CHECK(FileIO::exists(indexPath.c_str()));
+  };
+
+  SECTION("Re-adding an entry replaces it")
+  {
+    ShaderCacheFile cache;
+    REQUIRE(cache.Open(path, testMagic, 1));
+
+    std::string entry = "replaced";
+    cache.Add(0x9e3779b97f4a7c15ULL, (const byte *)entry.data(), (uint32_t)entry.size());
+    cache.Close();
+
+    REQUIRE(cache.Open(path, testMagic, 1));
+    CHECK(cache.GetNumEntries() == 100);
+
+    const byte *data = NULL;
+    uint32_t length = 0;
+    REQUIRE(cache.Find(0x9e3779b97f4a7c15ULL, data, length));
+    CHECK(std::string((const char *)data, (const char *)data + length) == entry);
+  };
+
+  SECTION("A different version discards the cache")
+  {
+    ShaderCacheFile cache;
+    REQUIRE(cache.Open(path, testMagic, 2));
+    CHECK(cache.GetNumEntries() == 0);
+    CHECK_FALSE(HasEntry(cache, 0x9e3779b97f4a7c15ULL));
+
+    AddEntries(cache, 1, 10);
+    cache.Close();
+
+    REQUIRE(cache.Open(path, testMagic, 2));
+    CHECK(cache.GetNumEntries() == 10);
+    CHECK(HasEntries(cache, 1, 10));
+  };
+
+  SECTION("A partially written entry is skipped")
+  {
+    FILE *f = FileIO::fopen(path.c_str(), "r+b");
+    REQUIRE(f);
+    FileIO::fseek64(f, 0, SEEK_END);
+    uint64_t length = FileIO::ftell64(f);
+    FileIO::ftruncateat(f, length - 3);
+    FileIO::fclose(f);
+
+    // the index now covers more data than the file has, so it's rebuilt by scanning
+    ShaderCacheFile cache;
+    REQUIRE(cache.Open(path, testMagic, 1));
+    CHECK(HasEntries(cache, 1, 99));
+    CHECK_FALSE(HasEntry(cache, 100 * 0x9e3779b97f4a7c15ULL));
+
+    // the partial entry could be another process still appending, so it isn't cut off on open
+    f = FileIO::fopen(path.c_str(), "rb");
+    REQUIRE(f);
+    FileIO::fseek64(f, 0, SEEK_END);
+    CHECK(FileIO::ftell64(f) == length - 3);
+    FileIO::fclose(f);
+
+    // nothing has been appended since, so it's cut off before appending. Adding the same entry back
+    // leaves the file as it was.
+    AddEntries(cache, 100, 1);
+    cache.Close();
+
+    f = FileIO::fopen(path.c_str(), "rb");
+    REQUIRE(f);
+    FileIO::fseek64(f, 0, SEEK_END);
+    CHECK(FileIO::ftell64(f) == length);
+    FileIO::fclose(f);
+
+    FileIO::Delete(indexPath.c_str());
+
+    REQUIRE(cache.Open(path, testMagic, 1));
+    CHECK(cache.GetNumEntries() == 100);
+    CHECK(HasEntries(cache, 1, 100));
+  };
+
+  SECTION("A partial entry that's still being appended isn't cut off")
+  {
+    FILE *f = FileIO::fopen(path.c_str(), "r+b");
+    REQUIRE(f);
+    FileIO::fseek64(f, 0, SEEK_END);
+    uint64_t length = FileIO::ftell64(f);
+    FileIO::ftruncateat(f, length - 3);
+    FileIO::fclose(f);
+
+    ShaderCacheFile cache;
+    REQUIRE(cache.Open(path, testMagic, 1));
+
+    // the file grows after we've scanned it, as if another process is still writing the entry
+    f = FileIO::fopen(path.c_str(), "ab");
+    REQUIRE(f);
+    byte more[2] = {};
+    FileIO::fwrite(more, 1, sizeof(more), f);
+    FileIO::fclose(f);
+
+    AddEntries(cache, 101, 1);
+    cache.Close();
+
+    f = FileIO::fopen(path.c_str(), "rb");
+    REQUIRE(f);
+    FileIO::fseek64(f, 0, SEEK_END);
+    CHECK(FileIO::ftell64(f) > length - 1);
+    FileIO::fclose(f);
+
+    REQUIRE(cache.Open(path, testMagic, 1));
+    CHECK(HasEntries(cache, 1, 99));
+    CHECK(HasEntries(cache, 101, 1));
+  };
+
+  SECTION("Entries from several appenders at once are all indexed")
+  {
+    ShaderCacheFile a, b;
+    REQUIRE(a.Open(path, testMagic, 1));
+    REQUIRE(b.Open(path, testMagic, 1));
+
+    // interleave the appends, as two processes could
+    for(uint64_t i = 0; i < 50; i++)
+    {
+      AddEntries(a, 101 + i, 1);
+      AddEntries(b, 151 + i, 1);
+    }
+
+    // each index includes the other's entries, whichever is written last
+    b.Close();
+    a.Close();
+
+    ShaderCacheFile cache;
+    REQUIRE(cache.Open(path, testMagic, 1));
+    CHECK(cache.GetNumEntries() == 200);
+    CHECK(HasEntries(cache, 1, 200));
+  };
+
+  SECTION("Replacing the cache doesn't disturb another user of it")
+  {
+    ShaderCacheFile a;
+    REQUIRE(a.Open(path, testMagic, 1));
+
+    const byte *data = NULL;
+    uint32_t length = 0;
+    REQUIRE(a.Find(0x9e3779b97f4a7c15ULL, data, length));
+
+    // a different version discards the file, while a still has the old one mapped
+    ShaderCacheFile b;
+    REQUIRE(b.Open(path, testMagic, 2));
+    AddEntries(b, 1, 10);
+
+    CHECK(std::string((const char *)data, (const char *)data + length) ==
+          CacheEntry(0x9e3779b97f4a7c15ULL));
+
+    b.Close();
+    a.Close();
+
+    REQUIRE(b.Open(path, testMagic, 2));
+    CHECK(HasEntries(b, 1, 10));
+  };
+
+  FileIO::Delete(path.c_str());
+  FileIO::Delete(indexPath.c_str());
+};
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -23,6 +23,7 @@
  ******************************************************************************/
 
 #include "common/threading.h"
+#include "common/worker_pool.h"
 #include "os/os_specific.h"
 
 #if ENABLED(ENABLE_UNIT_TESTS)
@@ -71,4 +72,69 @@ TEST_CASE("Test spin lock", "[threading]")
   CHECK(finalValue == value);
 }
 
+TEST_CASE("Test worker pool", "[threading]")
+{
+  WorkerPool &pool = WorkerPool::Get();
+
+  REQUIRE(pool.NumWorkers() >= 2);
+
+  // any distinct pointers will do to identify each set of jobs
+  int ownerA = 0, ownerB = 0;
+
+  SECTION("Wait only waits for the owner's jobs")
+  {
+    volatile int32_t a = 0, b = 0;
+    Threading::Semaphore release;
+
+    for(int i = 0; i < 100; i++)
+      pool.Run([&a]() { Atomic::Inc32(&a); }, &ownerA);
+
+    // this job can't finish until we've waited for the others
+    pool.Run(
+        [&b, &release]() {
+          release.WaitForWake();
+          Atomic::Inc32(&b);
+        },
+        &ownerB);
+
+    pool.Wait(&ownerA);
+
+    CHECK(a == 100);
+    CHECK(b == 0);
+
+    release.Wake(1);
+    pool.Wait(&ownerB);
+
+    CHECK(b == 1);
+  };
+
+  SECTION("Cancel discards jobs that haven't started")
+  {
+    volatile int32_t blocked = 0, cancelled = 0;
+    Threading::Semaphore release;
+
+    size_t numWorkers = pool.NumWorkers();
+
+    // occupy every worker, so nothing queued behind these can start
+    for(size_t i = 0; i < numWorkers; i++)
+      pool.Run(
+          [&blocked, &release]() {
+            release.WaitForWake();
+            Atomic::Inc32(&blocked);
+          },
+          &ownerA);
+
+    for(int i = 0; i < 100; i++)
+      pool.Run([&cancelled]() { Atomic::Inc32(&cancelled); }, &ownerB);
+
+    pool.Cancel(&ownerB);
+
+    release.Wake((uint32_t)numWorkers);
+    pool.Wait(&ownerA);
+
+    CHECK(blocked == (int32_t)numWorkers);
+    CHECK(cancelled == 0);
+  };
+}
+
 #endif    // ENABLED(ENABLE_UNIT_TESTS)
\ No newline at end of file
@@ -0,0 +1,189 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+
+#include "worker_pool.h"
+#include "common/common.h"
+
+WorkerPool &WorkerPool::Get()
+{
+  // deliberately leaked, since it can't be destroyed at exit while a worker might be waiting or
+  // already killed. Shutdown() tidies up the threads when the application shuts down cleanly.
+  static WorkerPool *pool = new WorkerPool();
+  return *pool;
+}
+
+void WorkerPool::StartWorkers()
+{
+  if(!m_Threads.empty() || m_Shutdown)
+    return;
+
+  // leave a core for the thread queueing work, which usually keeps going alongside the jobs. There
+  // are always at least two workers, so one job can wait on others.
+  uint32_t numThreads = RDCCLAMP(Threading::NumberOfCores(), 3U, 9U) - 1;
+
+  for(uint32_t i = 0; i < numThreads; i++)
+    m_Threads.push_back(Threading::CreateThread([this]() { WorkerThread(); }));
+}
+
+size_t WorkerPool::NumWorkers()
+{
+  SCOPED_LOCK(m_Lock);
+  StartWorkers();
+  return m_Threads.size();
+}
+
+void WorkerPool::Run(const std::function<void()> &job, const void *owner)
+{
+  bool queued = false;
+
+  {
+    SCOPED_LOCK(m_Lock);
+
+    StartWorkers();
+
+    if(!m_Shutdown)
+    {
+      m_Jobs.push_back({owner, job});
+      m_Outstanding[owner]++;
+      queued = true;
+    }
+  }
+
+  // after shutdown there's nobody to run it, so run it here
+  if(queued)
+    m_WorkAvailable.Wake(1);
+  else
+    job();
+}
+
+void WorkerPool::Wait(const void *owner)
+{
+  for(;;)
+  {
+    {
+      SCOPED_LOCK(m_Lock);
+
+      auto it = m_Outstanding.find(owner);
+      if(it == m_Outstanding.end())
+        return;
+
+      m_Waiters++;
+    }
+
+    // woken whenever any job finishes, so check again
+    m_JobFinished.WaitForWake();
+  }
+}
+
+void WorkerPool::Cancel(const void *owner)
+{
+  {
+    SCOPED_LOCK(m_Lock);
+
+    auto it = m_Outstanding.find(owner);
+    if(it == m_Outstanding.end())
+      return;
+
+    for(auto job = m_Jobs.begin(); job != m_Jobs.end();)
+    {
+      if(job->owner == owner)
+      {
+        job = m_Jobs.erase(job);
+        it->second--;
+      }
+      else
+      {
+        ++job;
+      }
+    }
+
+    if(it->second == 0)
+      m_Outstanding.erase(it);
+  }
+
+  Wait(owner);
+}
+
+void WorkerPool::Shutdown()
+{
+  std::vector<Threading::ThreadHandle> threads;
+
+  {
+    SCOPED_LOCK(m_Lock);
+    m_Shutdown = true;
+    threads.swap(m_Threads);
+  }
+
+  // each queued job has its own wake, so the workers only see these once the queue is drained
+  m_WorkAvailable.Wake((uint32_t)threads.size());
+
+  for(Threading::ThreadHandle t : threads)
+  {
+    Threading::JoinThread(t);
+    Threading::CloseThread(t);
+  }
+}
+
+void WorkerPool::WorkerThread()
+{
+  for(;;)
+  {
+    m_WorkAvailable.WaitForWake();
+
+    Job job;
+
+    {
+      SCOPED_LOCK(m_Lock);
+
+      if(m_Jobs.empty())
+      {
+        if(m_Shutdown)
+          break;
+
+        continue;
+      }
+
+      job = m_Jobs.front();
+      m_Jobs.pop_front();
+    }
+
+    job.func();
+
+    uint32_t waiters = 0;
+
+    {
+      SCOPED_LOCK(m_Lock);
+
+      auto it = m_Outstanding.find(job.owner);
+      if(--it->second == 0)
+        m_Outstanding.erase(it);
+
+      std::swap(waiters, m_Waiters);
+    }
+
+    if(waiters > 0)
+      m_JobFinished.Wake(waiters);
+  }
+}
@@ -0,0 +1,89 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <vector>
+#include "common/threading.h"
+
+// A pool of worker threads shared by everything that runs short background jobs, so that each
+// user doesn't start its own threads. The threads are started on first use and kept until
+// Shutdown(), which must be called from an application thread - never while the library is being
+// unloaded, since the threads may already have been killed.
+//
+// Each job can be given an owner, which is any pointer identifying who queued it. An owner can
+// wait for all of its jobs to finish, or cancel the ones that haven't started, before it's
+// destroyed.
+//
+// Jobs shouldn't wait on other jobs in the pool unless there's only ever one such job queued at
+// once, otherwise every worker could end up waiting on jobs that nobody is free to run.
+class WorkerPool
+{
+public:
+  static WorkerPool &Get();
+
+  size_t NumWorkers();
+
+  // queues job to run on a worker. After Shutdown() it runs immediately on the calling thread.
+  void Run(const std::function<void()> &job, const void *owner = NULL);
+
+  // blocks until every job queued by owner has finished. This can't be called from one of owner's
+  // own jobs.
+  void Wait(const void *owner);
+  // discards any of owner's jobs that haven't started, then waits for the rest
+  void Cancel(const void *owner);
+
+  // finishes any queued jobs, then stops and joins the workers
+  void Shutdown();
+
+private:
+  WorkerPool() = default;
+  ~WorkerPool() = default;
+
+  struct Job
+  {
+    const void *owner;
+    std::function<void()> func;
+  };
+
+  void StartWorkers();
+  void WorkerThread();
+
+  Threading::CriticalSection m_Lock;
+  std::deque<Job> m_Jobs;
+  // the number of queued or running jobs for each owner
+  std::map<const void *, uint32_t> m_Outstanding;
+  Threading::Semaphore m_WorkAvailable;
+
+  // woken once for each thread in Wait(), whenever a job finishes
+  Threading::Semaphore m_JobFinished;
+  uint32_t m_Waiters = 0;
+
+  std::vector<Threading::ThreadHandle> m_Threads;
+  bool m_Shutdown = false;
+};
@@ -0,0 +1,444 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "call_profiler.h"
+#include <algorithm>
+#include <map>
+#include "common/threading.h"
+#include "core/core.h"
+
+// in chrome_json_codec.cpp
+std::string ChromeTraceJSON(const SDFile &structData, RENDERDOC_ProgressCallback progress);
+
+namespace CallProfiler
+{
+volatile bool g_Enabled = false;
+
+// counters are allocated in pages as entry points are first called, so a thread only pays for the
+// entry points it uses. Index 0 collects any calls past the limit.
+static const uint32_t PageSize = 256;
+static const uint32_t MaxPages = 16;
+static const uint32_t MaxCalls = PageSize * MaxPages;
+
+// the number of most recent calls kept on each thread for trace export
+static const uint32_t MaxEvents = 16384;
+
+struct Counters
+{
+  // indexed by whether a frame was being captured
+  uint64_t calls[2];
+  uint64_t wrapperTicks[2];
+  uint64_t driverTicks[2];
+};
+
+struct Event
+{
+  uint32_t index;
+  uint64_t start;
+  uint64_t duration;
+  uint64_t driverStart;
+  uint64_t driverDuration;
+};
+
+// these are never freed, since another thread may be reading them at any time. When a thread exits
+// its data is kept for the next new thread to reuse.
+struct ThreadData
+{
+  Counters &Get(uint32_t index)
+  {
+    Counters *page = pages[index / PageSize];
+    if(page == NULL)
+    {
+      page = new Counters[PageSize];
+      memset(page, 0, sizeof(Counters) * PageSize);
+      pages[index / PageSize] = page;
+    }
+    return page[index % PageSize];
+  }
+
+  uint64_t threadID = 0;
+  // the reset generation these counters belong to
+  uint32_t generation = 0;
+
+  CallScope *current = NULL;
+
+  Counters *volatile pages[MaxPages] = {};
+
+  Event *events = NULL;
+  volatile uint64_t numEvents = 0;
+};
+
+static Threading::CriticalSection lock;
+static uint64_t threadSlot = 0;
+static volatile uint32_t generation = 1;
+static std::vector<ThreadData *> threads;
+// data of exited threads, still in threads until it's reused
+static std::vector<ThreadData *> freeThreads;
+// the counters of exited threads whose data was reused, for the generation in retiredGeneration
+static std::vector<Counters> retired;
+static uint32_t retiredGeneration = 0;
+static std::vector<std::string> names = {"Other"};
+static std::map<std::string, uint32_t> nameLookup;
+
+static void ClearThreadData(ThreadData *data)
+{
+  for(uint32_t p = 0; p < MaxPages; p++)
+    if(data->pages[p])
+      memset(data->pages[p], 0, sizeof(Counters) * PageSize);
+  data->numEvents = 0;
+  data->generation = generation;
+}
+
+static void ThreadExited(void *value)
+{
+  SCOPED_LOCK(lock);
+  freeThreads.push_back((ThreadData *)value);
+}
+
+// must be called with the lock held
+static ThreadData *ReuseThreadData()
+{
+  ThreadData *data = freeThreads.back();
+  freeThreads.pop_back();
+
+  // keep the exited thread's counters in the totals. Its recorded calls are dropped.
+  if(data->generation == generation)
+  {
+    if(retiredGeneration != generation)
+    {
+      retired.clear();
+      retiredGeneration = generation;
+    }
+
+    retired.resize(MaxCalls);
+
+    for(uint32_t p = 0; p < MaxPages; p++)
+    {
+      const Counters *page = data->pages[p];
+      if(page == NULL)
+        continue;
+
+      for(uint32_t i = 0; i < PageSize; i++)
+      {
+        Counters &total = retired[p * PageSize + i];
+        for(int c = 0; c < 2; c++)
+        {
+          total.calls[c] += page[i].calls[c];
+          total.wrapperTicks[c] += page[i].wrapperTicks[c];
+          total.driverTicks[c] += page[i].driverTicks[c];
+        }
+      }
+    }
+  }
+
+  ClearThreadData(data);
+
+  return data;
+}
+
+static ThreadData *GetThreadData()
+{
+  ThreadData *data = (ThreadData *)Threading::GetTLSValue(threadSlot);
+
+  if(data == NULL)
+  {
+    {
+      SCOPED_LOCK(lock);
+
+      if(!freeThreads.empty())
+      {
+        data = ReuseThreadData();
+      }
+      else
+      {
+        data = new ThreadData;
+        data->generation = generation;
+        data->events = new Event[MaxEvents];
+        threads.push_back(data);
+      }
+
+      data->threadID = Threading::GetCurrentID();
+    }
+
+    Threading::SetTLSValue(threadSlot, data);
+  }
+  else if(data->generation != generation)
+  {
+    // counters were reset since this thread last made a call. Only this thread writes to them so
+    // it clears them lazily here.
+    ClearThreadData(data);
+  }
+
+  return data;
+}
+
+void SetEnabled(bool enabled)
+{
+  SCOPED_LOCK(lock);
+
+  if(enabled && threadSlot == 0)
+    threadSlot = Threading::AllocateTLSSlot(&ThreadExited);
+
+  g_Enabled = enabled;
+}
+
+void Reset()
+{
+  SCOPED_LOCK(lock);
+  generation++;
+}
+
+size_t NumAllocatedThreads()
+{
+  SCOPED_LOCK(lock);
+  return threads.size();
+}
+
+uint32_t RegisterCall(const char *name)
+{
+  SCOPED_LOCK(lock);
+
+  auto it = nameLookup.find(name);
+  if(it != nameLookup.end())
+    return it->second;
+
+  uint32_t index = 0;
+
+  if(names.size() < MaxCalls)
+  {
+    index = (uint32_t)names.size();
+    names.push_back(name);
+  }
+  else
+  {
+    RDCWARN("Too many hooked calls to profile, counting %s as Other", name);
+  }
+
+  nameLookup[name] = index;
+  return index;
+}
+
+rdcarray<HookedCallProfile> GetProfile()
+{
+  std::vector<Counters> totals;
+  std::vector<std::string> callNames;
+
+  {
+    SCOPED_LOCK(lock);
+
+    callNames = names;
+    totals.resize(names.size());
+    memset(totals.data(), 0, sizeof(Counters) * totals.size());
+
+    if(retiredGeneration == generation)
+      memcpy(totals.data(), retired.data(),
+             sizeof(Counters) * RDCMIN(totals.size(), retired.size()));
+
+    for(ThreadData *data : threads)
+    {
+      // threads that haven't made a call since the last reset have nothing to add
+      if(data->generation != generation)
+        continue;
+
+      for(uint32_t p = 0; p < MaxPages; p++)
+      {
+        const Counters *page = data->pages[p];
+        if(page == NULL)
+          continue;
+
+        for(uint32_t i = 0; i < PageSize && p * PageSize + i < totals.size(); i++)
+        {
+          Counters &total = totals[p * PageSize + i];
+          for(int c = 0; c < 2; c++)
+          {
+            total.calls[c] += page[i].calls[c];
+            total.wrapperTicks[c] += page[i].wrapperTicks[c];
+            total.driverTicks[c] += page[i].driverTicks[c];
+          }
+        }
+      }
+    }
+  }
+
+  const double microsPerTick = 1000.0 / Timing::GetTickFrequency();
+
+  rdcarray<HookedCallProfile> ret;
+
+  for(size_t i = 0; i < totals.size(); i++)
+  {
+    const Counters &total = totals[i];
+
+    if(total.calls[0] == 0 && total.calls[1] == 0)
+      continue;
+
+    HookedCallProfile call;
+    call.name = callNames[i];
+    call.backgroundCalls = total.calls[0];
+    call.backgroundWrapperMicroseconds = double(total.wrapperTicks[0]) * microsPerTick;
+    call.backgroundDriverMicroseconds = double(total.driverTicks[0]) * microsPerTick;
+    call.capturingCalls = total.calls[1];
+    call.capturingWrapperMicroseconds = double(total.wrapperTicks[1]) * microsPerTick;
+    call.capturingDriverMicroseconds = double(total.driverTicks[1]) * microsPerTick;
+    ret.push_back(call);
+  }
+
+  std::sort(ret.begin(), ret.end(), [](const HookedCallProfile &a, const HookedCallProfile &b) {
+    return a.backgroundWrapperMicroseconds + a.capturingWrapperMicroseconds >
+           b.backgroundWrapperMicroseconds + b.capturingWrapperMicroseconds;
+  });
+
+  return ret;
+}
+
+std::string GetChromeTrace()
+{
+  // gather calls first so the trace can start at the earliest one
+  std::vector<std::pair<uint64_t, Event> > calls;
+  uint64_t base = ~0ULL;
+
+  {
+    SCOPED_LOCK(lock);
+
+    for(ThreadData *data : threads)
+    {
+      if(data->generation != generation)
+        continue;
+
+      // the owning thread may be writing events while we read, so only take those that were
+      // already complete and aren't about to be overwritten
+      uint64_t end = data->numEvents;
+      uint64_t begin = end > MaxEvents / 2 ? end - MaxEvents / 2 : 0;
+
+      for(uint64_t e = begin; e < end; e++)
+      {
+        const Event &ev = data->events[e % MaxEvents];
+        calls.push_back(std::make_pair(data->threadID, ev));
+        base = RDCMIN(base, ev.start);
+      }
+    }
+  }
+
+  // parents are recorded after their children finish, so sort to keep them first
+  std::sort(calls.begin(), calls.end(),
+            [](const std::pair<uint64_t, Event> &a, const std::pair<uint64_t, Event> &b) {
+              if(a.first != b.first)
+                return a.first < b.first;
+              if(a.second.start != b.second.start)
+                return a.second.start < b.second.start;
+              return a.second.duration > b.second.duration;
+            });
+
+  const double microsPerTick = 1000.0 / Timing::GetTickFrequency();
+
+  SDFile structData;
+
+  {
+    SCOPED_LOCK(lock);
+
+    for(const std::pair<uint64_t, Event> &call : calls)
+    {
+      const Event &ev = call.second;
+
+      SDChunk *chunk = new SDChunk(names[ev.index].c_str());
+      chunk->metadata.threadID = call.first;
+      chunk->metadata.timestampMicro = uint64_t(double(ev.start - base) * microsPerTick);
+      chunk->metadata.durationMicro = int64_t(double(ev.duration) * microsPerTick);
+      structData.chunks.push_back(chunk);
+
+      if(ev.driverDuration > 0)
+      {
+        chunk = new SDChunk("Driver");
+        chunk->metadata.threadID = call.first;
+        chunk->metadata.timestampMicro = uint64_t(double(ev.driverStart - base) * microsPerTick);
+        chunk->metadata.durationMicro = int64_t(double(ev.driverDuration) * microsPerTick);
+        structData.chunks.push_back(chunk);
+      }
+    }
+  }
+
+  return ChromeTraceJSON(structData, RENDERDOC_ProgressCallback());
+}
+
+void CallScope::Begin(uint32_t &index, const char *name)
+{
+  if(index == ~0U)
+    index = RegisterCall(name);
+
+  m_Thread = GetThreadData();
+  m_Parent = m_Thread->current;
+  m_Thread->current = this;
+
+  m_Index = index;
+  m_Capturing = RenderDoc::Inst().IsFrameCapturing();
+  m_Start = Timing::GetTick();
+}
+
+void CallScope::End()
+{
+  uint64_t duration = Timing::GetTick() - m_Start;
+
+  // don't count nested hooked calls against this one. If we were in the driver when they happened
+  // they're already part of the driver time.
+  if(m_Parent && !m_Parent->m_InDriver)
+    m_Parent->m_ChildTicks += duration;
+  m_Thread->current = m_Parent;
+
+  uint64_t excluded = m_DriverTicks + m_ChildTicks;
+
+  Counters &counters = m_Thread->Get(m_Index);
+  counters.calls[m_Capturing]++;
+  counters.wrapperTicks[m_Capturing] += duration > excluded ? duration - excluded : 0;
+  counters.driverTicks[m_Capturing] += m_DriverTicks;
+
+  Event &ev = m_Thread->events[m_Thread->numEvents % MaxEvents];
+  ev.index = m_Index;
+  ev.start = m_Start;
+  ev.duration = duration;
+  ev.driverStart = m_DriverStart;
+  ev.driverDuration = m_DriverTicks;
+  m_Thread->numEvents++;
+}
+
+void DriverScope::Begin()
+{
+  ThreadData *data = (ThreadData *)Threading::GetTLSValue(threadSlot);
+
+  // only driver calls made from a profiled hook are timed
+  if(data == NULL || data->current == NULL || data->current->m_InDriver)
+    return;
+
+  m_Call = data->current;
+  m_Call->m_InDriver = true;
+  m_Start = Timing::GetTick();
+
+  if(m_Call->m_DriverTicks == 0)
+    m_Call->m_DriverStart = m_Start;
+}
+
+void DriverScope::End()
+{
+  m_Call->m_DriverTicks += Timing::GetTick() - m_Start;
+  m_Call->m_InDriver = false;
+}
+};
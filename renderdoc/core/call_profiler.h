@@ -0,0 +1,138 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include "api/replay/renderdoc_replay.h"
+#include "common/common.h"
+
+// Measures the CPU time spent in each hooked API entry point, split into the time in RenderDoc's
+// wrapper and the time in the driver call it makes. It's disabled by default, and then a hook only
+// pays for checking a flag. While enabled each thread accumulates its own counters and keeps a ring
+// of its most recent calls for trace export, so no locks are taken on the hot path.
+//
+// Hooks are profiled with SCOPED_CALL_PROFILE at entry, and the driver call inside is bracketed
+// with SCOPED_DRIVER_PROFILE - both drivers do this in their SERIALISE_TIME_CALL. Any time in a
+// wrapper that isn't bracketed is counted as wrapper time.
+namespace CallProfiler
+{
+struct ThreadData;
+
+// checked by every hook, so it's kept inline
+extern volatile bool g_Enabled;
+
+void SetEnabled(bool enabled);
+inline bool IsEnabled()
+{
+  return g_Enabled;
+}
+
+// clears the counters and recorded calls on all threads
+void Reset();
+
+// returns the totals over all threads for every entry point called while enabled, most expensive
+// first. Counters are read while other threads may be updating them, so calls in flight may or may
+// not be included.
+rdcarray<HookedCallProfile> GetProfile();
+
+// returns the most recently recorded calls on each thread as JSON in the format the chrome.json
+// capture exporter writes, which can be loaded in chrome://tracing
+std::string GetChromeTrace();
+
+// returns how many threads' counters and recorded calls are allocated. These are reused by new
+// threads once their thread exits, and the exited thread's counters stay in the totals.
+size_t NumAllocatedThreads();
+
+// returns the index that an entry point's counters are stored at
+uint32_t RegisterCall(const char *name);
+
+class CallScope
+{
+public:
+  CallScope(uint32_t &index, const char *name)
+  {
+    if(IsEnabled())
+      Begin(index, name);
+  }
+  ~CallScope()
+  {
+    if(m_Thread)
+      End();
+  }
+
+  // no copying
+  CallScope(const CallScope &) = delete;
+  CallScope &operator=(const CallScope &) = delete;
+
+private:
+  friend class DriverScope;
+
+  void Begin(uint32_t &index, const char *name);
+  void End();
+
+  ThreadData *m_Thread = NULL;
+  CallScope *m_Parent = NULL;
+  uint32_t m_Index = 0;
+  bool m_Capturing = false;
+  bool m_InDriver = false;
+  uint64_t m_Start = 0;
+  uint64_t m_DriverStart = 0;
+  // time in this scope that shouldn't be counted against the wrapper
+  uint64_t m_DriverTicks = 0;
+  uint64_t m_ChildTicks = 0;
+};
+
+class DriverScope
+{
+public:
+  DriverScope()
+  {
+    if(IsEnabled())
+      Begin();
+  }
+  ~DriverScope()
+  {
+    if(m_Call)
+      End();
+  }
+
+  // no copying
+  DriverScope(const DriverScope &) = delete;
+  DriverScope &operator=(const DriverScope &) = delete;
+
+private:
+  void Begin();
+  void End();
+
+  CallScope *m_Call = NULL;
+  uint64_t m_Start = 0;
+};
+};
+
+#define SCOPED_CALL_PROFILE(name)                             \
+  static uint32_t CONCAT(callProfileIndex, __LINE__) = ~0U;   \
+  CallProfiler::CallScope CONCAT(callProfileScope, __LINE__)( \
+      CONCAT(callProfileIndex, __LINE__), name);
+
+#define SCOPED_DRIVER_PROFILE() CallProfiler::DriverScope CONCAT(driverProfileScope, __LINE__);
@@ -0,0 +1,225 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "call_profiler.h"
+#include "common/threading.h"
+#include "common/timing.h"
+#include "os/os_specific.h"
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "3rdparty/catch/catch.hpp"
+
+// busy-wait rather than sleep, so the time is spent where the profiler can see it
+static void Spin(double ms)
+{
+  PerformanceTimer timer;
+  while(timer.GetMilliseconds() < ms)
+  {
+  }
+}
+
+static void InnerCall()
+{
+  SCOPED_CALL_PROFILE("TestInner");
+
+  Spin(1.0);
+
+  {
+    SCOPED_DRIVER_PROFILE();
+    Spin(5.0);
+  }
+}
+
+static void OuterCall()
+{
+  SCOPED_CALL_PROFILE("TestOuter");
+
+  Spin(1.0);
+
+  {
+    SCOPED_DRIVER_PROFILE();
+    Spin(10.0);
+  }
+
+  InnerCall();
+}
+
+static const HookedCallProfile *Find(const rdcarray<HookedCallProfile> &profile, const char *name)
+{
+  for(const HookedCallProfile &call : profile)
+    if(call.name == name)
+      return &call;
+  return NULL;
+}
+
+TEST_CASE("Test hooked call profiler", "[callprofiler]")
+{
+  CallProfiler::SetEnabled(false);
+  CallProfiler::Reset();
+
+  SECTION("Nothing is recorded while disabled")
+  {
+    OuterCall();
+
+    CHECK(CallProfiler::GetProfile().empty());
+  };
+
+  SECTION("Driver time and nested calls are excluded from wrapper time")
+  {
+    CallProfiler::SetEnabled(true);
+
+    OuterCall();
+    OuterCall();
+
+    CallProfiler::SetEnabled(false);
+
+    rdcarray<HookedCallProfile> profile = CallProfiler::GetProfile();
+
+    REQUIRE(profile.size() == 2);
+
+    const HookedCallProfile *outer = Find(profile, "TestOuter");
+    const HookedCallProfile *inner = Find(profile, "TestInner");
+
+    REQUIRE(outer);
+    REQUIRE(inner);
+
+    CHECK(outer->backgroundCalls == 2);
+    CHECK(inner->backgroundCalls == 2);
+    CHECK(outer->capturingCalls == 0);
+    CHECK(outer->capturingWrapperMicroseconds == 0.0);
+
+    // each call spent 1ms in the wrapper, and a much larger time elsewhere that must not be counted
+    CHECK(outer->backgroundWrapperMicroseconds >= 2000.0);
+    CHECK(outer->backgroundWrapperMicroseconds < 10000.0);
+    CHECK(outer->backgroundDriverMicroseconds >= 20000.0);
+
+    CHECK(inner->backgroundWrapperMicroseconds >= 2000.0);
+    CHECK(inner->backgroundWrapperMicroseconds < 10000.0);
+    CHECK(inner->backgroundDriverMicroseconds >= 10000.0);
+
+    // sorted by wrapper time, most expensive first
+    CHECK(profile[0].backgroundWrapperMicroseconds >= profile[1].backgroundWrapperMicroseconds);
+
+    CallProfiler::Reset();
+    CHECK(CallProfiler::GetProfile().empty());
+  };
+
+  SECTION("Calls are totalled across threads")
+  {
+    CallProfiler::SetEnabled(true);
+
+    std::vector<Threading::ThreadHandle> threads;
+
+    for(int i = 0; i < 4; i++)
+    {
+      threads.push_back(Threading::CreateThread([]() {
+        for(int c = 0; c < 100; c++)
+        {
+          SCOPED_CALL_PROFILE("TestThreaded");
+        }
+      }));
+    }
+
+    for(Threading::ThreadHandle t : threads)
+    {
+      Threading::JoinThread(t);
+      Threading::CloseThread(t);
+    }
+
+    CallProfiler::SetEnabled(false);
+
+    rdcarray<HookedCallProfile> profile = CallProfiler::GetProfile();
+
+    const HookedCallProfile *threaded = Find(profile, "TestThreaded");
+
+    REQUIRE(threaded);
+    CHECK(threaded->backgroundCalls == 400);
+  };
+
+  SECTION("Exited threads' data is reused and their counters kept")
+  {
+    CallProfiler::SetEnabled(true);
+
+    // make a call here first, so this thread's data isn't what's counted below
+    OuterCall();
+
+    size_t allocated = 0;
+
+    for(int i = 0; i < 4; i++)
+    {
+      Threading::ThreadHandle t = Threading::CreateThread([]() {
+        for(int c = 0; c < 100; c++)
+        {
+          SCOPED_CALL_PROFILE("TestExiting");
+        }
+      });
+
+      Threading::JoinThread(t);
+      Threading::CloseThread(t);
+
+      // only the first thread needs new data, the rest reuse it
+      if(i == 0)
+        allocated = CallProfiler::NumAllocatedThreads();
+      else
+        CHECK(CallProfiler::NumAllocatedThreads() == allocated);
+    }
+
+    CallProfiler::SetEnabled(false);
+
+    rdcarray<HookedCallProfile> profile = CallProfiler::GetProfile();
+
+    const HookedCallProfile *exiting = Find(profile, "TestExiting");
+
+    REQUIRE(exiting);
+    CHECK(exiting->backgroundCalls == 400);
+
+    // counters kept from exited threads are cleared by a reset like any others
+    CallProfiler::Reset();
+    CHECK(CallProfiler::GetProfile().empty());
+  };
+
+  SECTION("Recent calls are exported as a chrome trace")
+  {
+    CallProfiler::SetEnabled(true);
+
+    OuterCall();
+
+    CallProfiler::SetEnabled(false);
+
+    std::string trace = CallProfiler::GetChromeTrace();
+
+    CHECK(trace.find("traceEvents") != std::string::npos);
+    CHECK(trace.find("\"TestOuter\"") != std::string::npos);
+    CHECK(trace.find("\"TestInner\"") != std::string::npos);
+    CHECK(trace.find("\"Driver\"") != std::string::npos);
+
+    // the outer call started first, so it comes before the inner one
+    CHECK(trace.find("\"TestOuter\"") < trace.find("\"TestInner\""));
+  };
+
+  CallProfiler::Reset();
+};
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -28,7 +28,9 @@
 #include <algorithm>
 #include "api/replay/version.h"
 #include "common/common.h"
+#include "common/worker_pool.h"
 #include "hooks/hooks.h"
+#include "jpeg-compressor/jpge.h"
 #include "replay/replay_driver.h"
 #include "serialise/rdcfile.h"
 #include "serialise/serialiser.h"
@@ -234,6 +236,10 @@ RenderDoc::RenderDoc()
 
   m_Overlay = eRENDERDOC_Overlay_Default;
 
+#if ENABLED(RDOC_DEVEL)
+  m_Overlay |= eRENDERDOC_Overlay_ChunkMemory;
+#endif
+
   m_VulkanCheck = NULL;
   m_VulkanInstall = NULL;
 
@@ -351,6 +357,22 @@ RenderDoc::~RenderDoc()
   for(auto it = m_ShutdownFunctions.begin(); it != m_ShutdownFunctions.end(); ++it)
     (*it)();
 
+  // we can't wait for the capture writer here for the same reason as the target control thread
+  // below, and on windows the worker pool's threads have already been killed by the time we're
+  // unloaded. Captures are drained as they're queued so normally there's nothing left, but write
+  // any the writer hasn't started on this thread.
+  {
+    std::vector<PendingCapture *> captures;
+
+    {
+      SCOPED_LOCK(m_CaptureWriteLock);
+      captures.swap(m_CaptureWrites);
+    }
+
+    for(PendingCapture *capture : captures)
+      WriteCapture(capture);
+  }
+
   for(size_t i = 0; i < m_Captures.size(); i++)
   {
     if(m_Captures[i].retrieved)
@@ -394,6 +416,12 @@ void RenderDoc::Shutdown()
     UnloadCrashHandler();
   }
 
+  DrainCaptureWrites(CaptureShutdownWaitMS);
+  FlushCaptureWrites();
+
+  // nothing else should be queueing work after this point, anything that does runs inline
+  WorkerPool::Get().Shutdown();
+
   if(m_RemoteThread)
   {
     // explicitly wait for thread to shutdown, this call is not from module unloading and
@@ -644,6 +672,12 @@ string RenderDoc::GetOverlayText(RDCDriver driver, uint32_t frameNumber, int fla
 
     if((overlay & eRENDERDOC_Overlay_CaptureList) && capturesEnabled)
     {
+      uint32_t pendingWrites = NumPendingCaptureWrites();
+      if(pendingWrites > 0)
+        overlayText += StringFormat::Fmt("Writing %u capture(s) to disk.\n", pendingWrites);
+
+      SCOPED_LOCK(m_CaptureLock);
+
       overlayText += StringFormat::Fmt("%d Captures saved.\n", (uint32_t)m_Captures.size());
 
       uint64_t now = Timing::GetUnixTimestamp();
@@ -656,10 +690,14 @@ string RenderDoc::GetOverlayText(RDCDriver driver, uint32_t frameNumber, int fla
       }
     }
 
-#if ENABLED(RDOC_DEVEL)
-    overlayText += StringFormat::Fmt("%llu chunks - %.2f MB\n", Chunk::NumLiveChunks(),
-                                     float(Chunk::TotalMem()) / 1024.0f / 1024.0f);
-#endif
+    if(overlay & eRENDERDOC_Overlay_ChunkMemory)
+    {
+      overlayText += StringFormat::Fmt("%llu chunks - %.2f MB\n", Chunk::NumLiveChunks(),
+                                       float(Chunk::TotalMem()) / 1024.0f / 1024.0f);
+      overlayText +=
+          StringFormat::Fmt("%llu chunk pages - %.2f MB\n", ChunkAllocator::NumLivePages(),
+                            float(ChunkAllocator::TotalMem()) / 1024.0f / 1024.0f);
+    }
   }
   else if(capturesEnabled)
   {
@@ -721,20 +759,24 @@ RDCFile *RenderDoc::CreateRDC(RDCDriver driver, uint32_t frameNum, void *thpixel
 {
   RDCFile *ret = new RDCFile;
 
-  m_CurrentLogFile = StringFormat::Fmt("%s_frame%u.rdc", m_CaptureFileTemplate.c_str(), frameNum);
+  std::string filename =
+      StringFormat::Fmt("%s_frame%u.rdc", m_CaptureFileTemplate.c_str(), frameNum);
 
   // make sure we don't stomp another capture if we make multiple captures in the same frame.
   {
     SCOPED_LOCK(m_CaptureLock);
     int altnum = 2;
-    while(std::find_if(m_Captures.begin(), m_Captures.end(), [this](const CaptureData &o) {
-            return o.path == m_CurrentLogFile;
+    while(std::find_if(m_Captures.begin(), m_Captures.end(), [&filename](const CaptureData &o) {
+            return o.path == filename;
           }) != m_Captures.end())
     {
-      m_CurrentLogFile =
+      filename =
           StringFormat::Fmt("%s_frame%u_%d.rdc", m_CaptureFileTemplate.c_str(), frameNum, altnum);
       altnum++;
     }
+
+    // captures can be created on the capture writer thread, so this is only set under the lock
+    m_CurrentLogFile = filename;
   }
 
   RDCThumb th;
@@ -754,13 +796,13 @@ RDCFile *RenderDoc::CreateRDC(RDCDriver driver, uint32_t frameNum, void *thpixel
 
   ret->SetData(driver, ToStr(driver).c_str(), OSUtility::GetMachineIdent(), thumb);
 
-  FileIO::CreateParentDirectory(m_CurrentLogFile);
+  FileIO::CreateParentDirectory(filename);
 
-  ret->Create(m_CurrentLogFile.c_str());
+  ret->Create(filename.c_str());
 
   if(ret->ErrorCode() != ContainerError::NoError)
   {
-    RDCERR("Error creating RDC at '%s'", m_CurrentLogFile.c_str());
+    RDCERR("Error creating RDC at '%s'", filename.c_str());
     SAFE_DELETE(ret);
   }
 
@@ -1140,9 +1182,9 @@ void RenderDoc::FinishCaptureWriting(RDCFile *rdc, uint32_t frameNumber)
       delete w;
     }
 
-    RDCLOG("Written to disk: %s", m_CurrentLogFile.c_str());
+    RDCLOG("Written to disk: %s", rdc->GetFilename().c_str());
 
-    CaptureData cap(m_CurrentLogFile, Timing::GetUnixTimestamp(), rdc->GetDriver(), frameNumber);
+    CaptureData cap(rdc->GetFilename(), Timing::GetUnixTimestamp(), rdc->GetDriver(), frameNumber);
     {
       SCOPED_LOCK(m_CaptureLock);
       m_Captures.push_back(cap);
@@ -1154,6 +1196,269 @@ void RenderDoc::FinishCaptureWriting(RDCFile *rdc, uint32_t frameNumber)
   RenderDoc::Inst().SetProgress(CaptureProgress::FileWriting, 1.0f);
 }
 
+PendingCapture::~PendingCapture()
+{
+  SAFE_DELETE_ARRAY(thumbPixels);
+  SAFE_DELETE(frameCapture);
+  for(Chunk *chunk : frameChunks)
+    SAFE_DELETE(chunk);
+}
+
+void PendingCapture::AddFrameChunks(const std::vector<Chunk *> &sortedChunks,
+                                    std::vector<Chunk *> &released)
+{
+  std::sort(released.begin(), released.end());
+  std::vector<bool> used(released.size(), false);
+
+  frameChunks.reserve(frameChunks.size() + sortedChunks.size());
+
+  for(Chunk *chunk : sortedChunks)
+  {
+    auto it = std::lower_bound(released.begin(), released.end(), chunk);
+    if(it != released.end() && *it == chunk)
+    {
+      used[it - released.begin()] = true;
+      frameChunks.push_back(chunk);
+    }
+    else
+    {
+      frameChunks.push_back(chunk->Duplicate());
+    }
+  }
+
+  // anything released that didn't make it into the frame is ours to free
+  for(size_t i = 0; i < released.size(); i++)
+    if(!used[i])
+      delete released[i];
+
+  released.clear();
+}
+
+uint64_t PendingCapture::GetSize() const
+{
+  uint64_t size = frameCapture ? frameCapture->GetOffset() : 0;
+  for(Chunk *chunk : frameChunks)
+    size += chunk->GetLength();
+  return size;
+}
+
+void RenderDoc::QueueCaptureWrite(PendingCapture *capture)
+{
+  uint64_t size = capture->GetSize();
+  bool writeHere = false;
+  bool startWriter = false;
+
+  // if we're over budget, wait for the writer to catch up. A capture that's over budget by itself
+  // can't be queued without exceeding it, so once nothing else is pending it's written here.
+  for(;;)
+  {
+    {
+      SCOPED_LOCK(m_CaptureWriteLock);
+
+      if(size > CaptureWriteBudget)
+      {
+        if(m_PendingCaptureWrites == 0)
+        {
+          m_PendingCaptureWrites++;
+          m_PendingCaptureBytes += size;
+          writeHere = true;
+          break;
+        }
+      }
+      else if(m_PendingCaptureBytes + size <= CaptureWriteBudget)
+      {
+        m_PendingCaptureWrites++;
+        m_PendingCaptureBytes += size;
+        m_CaptureWrites.push_back(capture);
+
+        if(!m_CaptureWriterActive)
+          m_CaptureWriterActive = startWriter = true;
+
+        break;
+      }
+
+      m_CaptureWriteWaiters++;
+    }
+
+    m_CaptureWriteFinished.WaitForWake();
+  }
+
+  if(writeHere)
+  {
+    RDCLOG("Capture of %llu bytes is over the write budget, writing synchronously", size);
+    WriteCapture(capture);
+  }
+  else
+  {
+    if(startWriter)
+      WorkerPool::Get().Run([this]() { CaptureWriterJob(); }, this);
+
+    // if the writer is still busy with an earlier capture, write this one here rather than leaving
+    // it queued. That way at most one capture is ever left to the writer, whose thread may be
+    // killed before we get a chance to wait for it at shutdown.
+    DrainCaptureWrites(CaptureQueueWaitMS);
+  }
+}
+
+void RenderDoc::DrainCaptureWrites(uint32_t timeoutMS)
+{
+  PerformanceTimer timer;
+
+  for(;;)
+  {
+    {
+      SCOPED_LOCK(m_CaptureWriteLock);
+
+      if(m_CaptureWrites.empty() || timer.GetMilliseconds() >= timeoutMS)
+        break;
+    }
+
+    Threading::Sleep(1);
+  }
+
+  std::vector<PendingCapture *> captures;
+
+  {
+    SCOPED_LOCK(m_CaptureWriteLock);
+    captures.swap(m_CaptureWrites);
+  }
+
+  for(PendingCapture *capture : captures)
+    WriteCapture(capture);
+}
+
+void RenderDoc::FlushCaptureWrites()
+{
+  for(;;)
+  {
+    {
+      SCOPED_LOCK(m_CaptureWriteLock);
+
+      if(m_PendingCaptureWrites == 0)
+        return;
+
+      m_CaptureWriteWaiters++;
+    }
+
+    m_CaptureWriteFinished.WaitForWake();
+  }
+}
+
+uint32_t RenderDoc::NumPendingCaptureWrites()
+{
+  SCOPED_LOCK(m_CaptureWriteLock);
+  return m_PendingCaptureWrites;
+}
+
+void RenderDoc::CaptureWriterJob()
+{
+  for(;;)
+  {
+    PendingCapture *capture = NULL;
+
+    {
+      SCOPED_LOCK(m_CaptureWriteLock);
+
+      // once the queue is empty the next QueueCaptureWrite starts a new job
+      if(m_CaptureWrites.empty())
+      {
+        m_CaptureWriterActive = false;
+        return;
+      }
+
+      capture = m_CaptureWrites.front();
+      m_CaptureWrites.erase(m_CaptureWrites.begin());
+    }
+
+    WriteCapture(capture);
+  }
+}
+
+void RenderDoc::WriteCapture(PendingCapture *capture)
+{
+  uint64_t size = capture->GetSize();
+
+  byte *jpgbuf = NULL;
+  int len = capture->thumbWidth * capture->thumbHeight;
+  uint16_t thwidth = capture->thumbWidth;
+  uint16_t thheight = capture->thumbHeight;
+
+  if(capture->thumbPixels && len > 0)
+  {
+    // jpge::compress_image_to_jpeg_file_in_memory requires at least 1024 bytes
+    len = RDCMAX(len, 1024);
+
+    jpgbuf = new byte[len];
+
+    jpge::params p;
+    p.m_quality = 80;
+
+    bool success = jpge::compress_image_to_jpeg_file_in_memory(jpgbuf, len, thwidth, thheight, 3,
+                                                               capture->thumbPixels, p);
+
+    if(!success)
+    {
+      RDCERR("Failed to compress to jpg");
+      SAFE_DELETE_ARRAY(jpgbuf);
+      thwidth = 0;
+      thheight = 0;
+    }
+  }
+
+  RDCFile *rdc = CreateRDC(capture->driver, capture->frameNumber, jpgbuf, len, thwidth, thheight,
+                           FileType::JPG);
+
+  SAFE_DELETE_ARRAY(jpgbuf);
+
+  if(rdc)
+  {
+    SectionProperties props;
+
+    // Compress with LZ4 so that it's fast
+    props.flags = SectionFlags::LZ4Compressed;
+    props.version = capture->sectionVersion;
+    props.type = SectionType::FrameCapture;
+
+    StreamWriter *w = rdc->WriteSection(props);
+
+    uint64_t offset = capture->frameCapture->GetOffset();
+
+    w->Write(capture->frameCapture->GetData(), offset);
+
+    // the frame's chunks follow, each freed as soon as it's been written
+    for(Chunk *&chunk : capture->frameChunks)
+    {
+      capture->chunkOffsets.push_back(offset);
+      offset += chunk->GetLength();
+
+      w->Write(chunk->GetData(), chunk->GetLength());
+      SAFE_DELETE(chunk);
+    }
+
+    w->Finish();
+
+    delete w;
+
+    rdc->WriteChunkIndex(capture->chunkOffsets);
+  }
+
+  FinishCaptureWriting(rdc, capture->frameNumber);
+
+  delete capture;
+
+  uint32_t waiters = 0;
+
+  {
+    SCOPED_LOCK(m_CaptureWriteLock);
+    m_PendingCaptureWrites--;
+    m_PendingCaptureBytes -= size;
+    std::swap(waiters, m_CaptureWriteWaiters);
+  }
+
+  if(waiters > 0)
+    m_CaptureWriteFinished.Wake(waiters);
+}
+
 void RenderDoc::AddDeviceFrameCapturer(void *dev, IFrameCapturer *cap)
 {
   if(dev == NULL || cap == NULL)
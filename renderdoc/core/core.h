@@ -45,6 +45,7 @@ using std::pair;
 using std::set;
 
 class Chunk;
+class StreamWriter;
 
 // not provided by tinyexr, just do by hand
 bool is_exr_file(FILE *f);
@@ -231,6 +232,40 @@ struct CaptureData
   bool retrieved;
 };
 
+// a finished frame capture that a driver has serialised into memory, to be compressed and written
+// to disk on the capture writer thread. See RenderDoc::QueueCaptureWrite.
+struct PendingCapture
+{
+  PendingCapture() = default;
+  ~PendingCapture();
+  PendingCapture(const PendingCapture &) = delete;
+  PendingCapture &operator=(const PendingCapture &) = delete;
+
+  RDCDriver driver = RDCDriver::Unknown;
+  uint32_t frameNumber = 0;
+  uint32_t sectionVersion = 0;
+
+  // RGB8 thumbnail pixels, compressed to a JPG when the capture is written
+  byte *thumbPixels = NULL;
+  uint16_t thumbWidth = 0;
+  uint16_t thumbHeight = 0;
+
+  // the start of the uncompressed frame capture section, and the offset of each chunk within it
+  StreamWriter *frameCapture = NULL;
+  std::vector<uint64_t> chunkOffsets;
+
+  // the frame's own chunks, written after frameCapture. The capture owns these, so that chunks
+  // which would be freed after the capture anyway are handed over rather than copied.
+  std::vector<Chunk *> frameChunks;
+
+  // appends sortedChunks to frameChunks. Chunks in released belong to the caller's discarded
+  // records and are taken as-is, any others are duplicated. Unused chunks in released are deleted.
+  void AddFrameChunks(const std::vector<Chunk *> &sortedChunks, std::vector<Chunk *> &released);
+
+  // the total uncompressed size of the frame capture section
+  uint64_t GetSize() const;
+};
+
 enum class LoadProgress
 {
   DebugManagerInit,
@@ -357,7 +392,12 @@ public:
   template <typename ProgressType>
   void SetProgress(ProgressType section, float delta)
   {
-    RENDERDOC_ProgressCallback cb = m_ProgressCallbacks[TypeName<ProgressType>()];
+    // capture progress is also set from the capture writer thread, so don't insert here
+    auto it = m_ProgressCallbacks.find(TypeName<ProgressType>());
+    if(it == m_ProgressCallbacks.end())
+      return;
+
+    RENDERDOC_ProgressCallback cb = it->second;
     if(!cb || section < ProgressType::First || section >= ProgressType::Count)
       return;
 
@@ -412,6 +452,18 @@ public:
                      uint16_t thwidth, uint16_t thheight, FileType thformat);
   void FinishCaptureWriting(RDCFile *rdc, uint32_t frameNumber);
 
+  // hands a serialised capture over to be written on the capture writer thread, which takes
+  // ownership of it. If the captures still waiting to be written are over the memory budget, this
+  // blocks until enough of them have been written. A capture that's over budget by itself waits
+  // for the writer to go idle and is then written on the calling thread, as is a capture that the
+  // writer doesn't pick up promptly because it's still writing an earlier one. FinishCaptureWriting
+  // is called once it's done.
+  void QueueCaptureWrite(PendingCapture *capture);
+  // blocks until every queued capture has been written. This must only be called from application
+  // threads, never while the library is being unloaded.
+  void FlushCaptureWrites();
+  uint32_t NumPendingCaptureWrites();
+
   void AddChildProcess(uint32_t pid, uint32_t ident)
   {
     SCOPED_LOCK(m_ChildLock);
@@ -594,6 +646,35 @@ private:
   Threading::CriticalSection m_CaptureLock;
   vector<CaptureData> m_Captures;
 
+  // how many bytes of serialised captures can be waiting to be written before the application
+  // blocks on QueueCaptureWrite.
+  static const uint64_t CaptureWriteBudget = 1024ULL * 1024 * 1024;
+  // how long a newly queued capture waits for the writer to pick it up, and how long Shutdown
+  // waits for the writer, before writing the remaining captures on the calling thread.
+  static const uint32_t CaptureQueueWaitMS = 50;
+  static const uint32_t CaptureShutdownWaitMS = 5000;
+
+  // runs on the WorkerPool, writing queued captures until there are none left. This is the only
+  // job in the pool that waits on other jobs, for the parallel compression.
+  void CaptureWriterJob();
+  void WriteCapture(PendingCapture *capture);
+  // waits up to timeoutMS for the writer to take every queued capture, then writes any it hasn't
+  // taken on the calling thread.
+  void DrainCaptureWrites(uint32_t timeoutMS);
+
+  Threading::CriticalSection m_CaptureWriteLock;
+  // captures waiting for the writer, in the order they were queued
+  std::vector<PendingCapture *> m_CaptureWrites;
+  // captures queued or being written, and the total size of their frame capture data
+  uint32_t m_PendingCaptureWrites = 0;
+  uint64_t m_PendingCaptureBytes = 0;
+  // woken once for each thread waiting in QueueCaptureWrite or FlushCaptureWrites, whenever a
+  // capture finishes writing
+  Threading::Semaphore m_CaptureWriteFinished;
+  uint32_t m_CaptureWriteWaiters = 0;
+  // whether a CaptureWriterJob is queued or running
+  bool m_CaptureWriterActive = false;
+
   Threading::CriticalSection m_ChildLock;
   vector<pair<uint32_t, uint32_t> > m_Children;
 
@@ -23,11 +23,14 @@
  * THE SOFTWARE.
  ******************************************************************************/
 
+#include <algorithm>
 #include <sstream>
 #include <utility>
+#include "3rdparty/zstd/xxhash.h"
 #include "android/android.h"
 #include "api/replay/renderdoc_replay.h"
 #include "api/replay/version.h"
+#include "common/timing.h"
 #include "core/core.h"
 #include "os/os_specific.h"
 #include "replay/replay_controller.h"
@@ -36,8 +39,14 @@
 #include "strings/string_utils.h"
 #include "replay_proxy.h"
 
+// bumped when the protocol changes within a version. Both sides of the replay proxy must also agree
+// on how it transfers and evicts resource contents, since deltas are sent against data each side
+// assumes the other still has.
+static const uint32_t RemoteServerProtocolRevision = 2;
+
 static const uint32_t RemoteServerProtocolVersion =
-    uint32_t(RENDERDOC_VERSION_MAJOR * 1000) | RENDERDOC_VERSION_MINOR;
+    (uint32_t(RENDERDOC_VERSION_MAJOR * 1000) | RENDERDOC_VERSION_MINOR) |
+    (RemoteServerProtocolRevision << 24);
 
 enum RemoteServerPacket
 {
@@ -69,6 +78,7 @@ enum RemoteServerPacket
   eRemoteServer_GetSectionProperties,
   eRemoteServer_GetSectionContents,
   eRemoteServer_WriteSection,
+  eRemoteServer_ListSessions,
   eRemoteServer_RemoteServerCount,
 };
 
@@ -81,7 +91,14 @@ RDCCOMPILE_ASSERT((int)eRemoteServer_RemoteServerCount < (int)eReplayProxy_First
 struct ClientThread
 {
   ClientThread()
-      : socket(NULL), allowExecution(false), killThread(false), killServer(false), thread(0)
+      : socket(NULL),
+        allowExecution(false),
+        killThread(false),
+        killServer(false),
+        thread(0),
+        id(0),
+        ip(0),
+        connectTime(0)
   {
   }
 
@@ -92,8 +109,524 @@ struct ClientThread
   bool killServer;
 
   Threading::ThreadHandle thread;
+
+  uint32_t id;
+  uint32_t ip;
+  uint64_t connectTime;
+
+  // the capture this session has open, protected by the session list lock
+  std::string captureFile;
+};
+
+struct RemoteServerSessions
+{
+  // protects the list of sessions and their open capture files
+  Threading::CriticalSection lock;
+  std::vector<ClientThread *> active;
+
+  // loading a capture sets global state such as the progress callback, so only one session can be
+  // loading at a time.
+  Threading::CriticalSection loadLock;
+
+  // drivers keep some replay state in globals, such as the current D3D11 device or GL's active
+  // contexts and current chunk, so sessions replaying captures from the same driver take turns.
+  // Sessions replaying captures from different drivers still run concurrently.
+  Threading::CriticalSection &GetReplayLock(RDCDriver driver)
+  {
+    SCOPED_LOCK(lock);
+    return replayLocks[driver];
+  }
+
+  std::map<RDCDriver, Threading::CriticalSection> replayLocks;
+
+  uint32_t maxSessions = 4;
+  // the maximum bytes of captures each session can copy to the server, or 0 for no limit
+  uint64_t sessionStorage = 0;
+
+  // the partial files that captures are currently being copied into, protected by the lock
+  std::set<std::string> transfers;
+};
+
+// Captures are copied in fixed-size blocks, each identified by a hash of its contents. The sender
+// first sends the size and the hash of every block, then the receiver asks for only the blocks it
+// doesn't already have. Blocks are written into a partial file that's kept if the transfer fails,
+// so a later transfer of the same file resumes from the blocks that made it. Blocks can also be
+// found anywhere in a previous version of the file, so sending an edited capture again only sends
+// the blocks that changed. Any block that arrives corrupted is asked for again.
+static const uint64_t TransferBlockSize = 1024 * 1024;
+static const uint32_t MaxTransferRounds = 4;
+// sent in place of the size when the sender can't read the file
+static const uint64_t TransferMissingFile = ~0ULL;
+// partial files from interrupted transfers are kept this long, in seconds, to be resumed
+static const uint64_t PartialTransferLifetime = 24 * 60 * 60;
+
+static uint64_t TransferBlockLength(uint64_t fileSize, size_t index)
+{
+  return RDCMIN(TransferBlockSize, fileSize - index * TransferBlockSize);
+}
+
+static uint64_t GetOpenFileSize(FILE *f)
+{
+  FileIO::fseek64(f, 0, SEEK_END);
+  return FileIO::ftell64(f);
+}
+
+static void HashFileBlocks(FILE *f, uint64_t fileSize, std::vector<uint64_t> &hashes)
+{
+  bytebuf block;
+  block.resize((size_t)TransferBlockSize);
+
+  hashes.resize(size_t((fileSize + TransferBlockSize - 1) / TransferBlockSize));
+
+  FileIO::fseek64(f, 0, SEEK_SET);
+
+  for(size_t i = 0; i < hashes.size(); i++)
+  {
+    size_t read = FileIO::fread(block.data(), 1, (size_t)TransferBlockLength(fileSize, i), f);
+    hashes[i] = XXH64(block.data(), read, 0);
+  }
+}
+
+// reports a transfer through the progress callback as blocks arrive or are sent, and its throughput
+// to the log every few seconds while it runs and once it's finished.
+struct TransferProgress
+{
+  TransferProgress(const char *v, const std::string &p, uint64_t s, RENDERDOC_ProgressCallback c)
+      : verb(v), path(p), size(s), callback(c)
+  {
+  }
+
+  // bytes that are already in place, e.g. from an interrupted transfer
+  void Skip(uint64_t bytes)
+  {
+    done += bytes;
+    Report();
+  }
+
+  // bytes that were moved over the network
+  void Add(uint64_t bytes)
+  {
+    transferred += bytes;
+    done += bytes;
+    Report();
+
+    double now = timer.GetMilliseconds();
+    if(now - lastLog >= LogIntervalMS)
+    {
+      lastLog = now;
+      Log("Transfer");
+    }
+  }
+
+  void Finish()
+  {
+    if(callback)
+      callback(1.0f);
+    Log("Finished");
+  }
+
+  void Report()
+  {
+    if(callback && size > 0)
+      callback(float(double(RDCMIN(done, size)) / double(size)));
+  }
+
+  void Log(const char *state)
+  {
+    double seconds = RDCMAX(timer.GetMilliseconds() / 1000.0, 0.001);
+
+    RDCLOG("%s: %s '%s': %llu of %llu bytes done, %llu transferred in %.2fs (%.1f MB/s)", state,
+           verb, path.c_str(), done, size, transferred, seconds,
+           double(transferred) / (1024.0 * 1024.0) / seconds);
+  }
+
+  static const uint32_t LogIntervalMS = 5000;
+
+  const char *verb;
+  std::string path;
+  uint64_t size;
+  RENDERDOC_ProgressCallback callback;
+
+  PerformanceTimer timer;
+  double lastLog = 0.0;
+  uint64_t done = 0;
+  uint64_t transferred = 0;
 };
 
+static bool SendCaptureBlocks(ReadSerialiser &reader, WriteSerialiser &writer,
+                              RemoteServerPacket packet, const std::string &path,
+                              RENDERDOC_ProgressCallback progress)
+{
+  FILE *f = FileIO::fopen(path.c_str(), "rb");
+
+  uint64_t size = 0;
+  std::vector<uint64_t> hashes;
+
+  if(f)
+  {
+    size = GetOpenFileSize(f);
+    HashFileBlocks(f, size, hashes);
+  }
+  else
+  {
+    RDCERR("Couldn't open '%s' to send", path.c_str());
+    size = TransferMissingFile;
+  }
+
+  {
+    WRITE_DATA_SCOPE();
+    SCOPED_SERIALISE_CHUNK(packet);
+    SERIALISE_ELEMENT(size);
+    SERIALISE_ELEMENT(hashes);
+  }
+
+  TransferProgress transfer("Sending", path, f ? size : 0, progress);
+
+  bytebuf data;
+  bool firstRound = true;
+
+  for(;;)
+  {
+    std::vector<uint32_t> needed;
+
+    {
+      READ_DATA_SCOPE();
+      RemoteServerPacket type = ser.ReadChunk<RemoteServerPacket>();
+
+      if(type == packet)
+      {
+        SERIALISE_ELEMENT(needed);
+      }
+
+      ser.EndChunk();
+
+      if(ser.IsErrored() || type != packet)
+      {
+        RDCERR("Network error sending '%s'", path.c_str());
+        if(f)
+          FileIO::fclose(f);
+        return false;
+      }
+    }
+
+    if(needed.empty())
+      break;
+
+    // everything not asked for the first time is already on the other side
+    if(firstRound)
+    {
+      firstRound = false;
+      uint64_t remaining = 0;
+      for(uint32_t index : needed)
+        if(index < hashes.size())
+          remaining += TransferBlockLength(size, index);
+
+      transfer.Skip(size - remaining);
+    }
+    else
+    {
+      // blocks asked for again were corrupted on the way, and count again
+      for(uint32_t index : needed)
+        if(index < hashes.size())
+          transfer.done -= RDCMIN(transfer.done, TransferBlockLength(size, index));
+    }
+
+    for(uint32_t index : needed)
+    {
+      data.resize(0);
+
+      if(f && index < hashes.size())
+      {
+        data.resize((size_t)TransferBlockLength(size, index));
+
+        FileIO::fseek64(f, index * TransferBlockSize, SEEK_SET);
+        data.resize(FileIO::fread(data.data(), 1, data.size(), f));
+      }
+
+      {
+        WRITE_DATA_SCOPE();
+        SCOPED_SERIALISE_CHUNK(packet);
+        SERIALISE_ELEMENT(index);
+        SERIALISE_ELEMENT(data);
+      }
+
+      transfer.Add(data.size());
+    }
+  }
+
+  if(f == NULL)
+    return false;
+
+  FileIO::fclose(f);
+
+  transfer.Finish();
+
+  return !writer.IsErrored();
+}
+
+// receives a capture sent by SendCaptureBlocks into dest, reusing the blocks in an interrupted
+// transfer at partial and in a previous version of the file at dest. Captures bigger than sizeLimit
+// are refused. Returns the path of the received file, which is partial if it couldn't be moved over
+// dest, or an empty string on failure.
+static std::string ReceiveCaptureBlocks(ReadSerialiser &reader, WriteSerialiser &writer,
+                                        RemoteServerPacket packet, const std::string &dest,
+                                        const std::string &partial, uint64_t sizeLimit,
+                                        RENDERDOC_ProgressCallback progress)
+{
+  uint64_t size = 0;
+  std::vector<uint64_t> hashes;
+
+  {
+    READ_DATA_SCOPE();
+    RemoteServerPacket type = ser.ReadChunk<RemoteServerPacket>();
+
+    if(type == packet)
+    {
+      SERIALISE_ELEMENT(size);
+      SERIALISE_ELEMENT(hashes);
+    }
+
+    ser.EndChunk();
+
+    if(ser.IsErrored() || type != packet)
+    {
+      RDCERR("Network error receiving '%s'", dest.c_str());
+      return "";
+    }
+  }
+
+  FILE *f = NULL;
+
+  if(size == TransferMissingFile)
+  {
+    // leave any existing file alone
+    RDCERR("'%s' couldn't be read by the sender", dest.c_str());
+  }
+  else if(hashes.size() != (size + TransferBlockSize - 1) / TransferBlockSize)
+  {
+    RDCERR("Received inconsistent block list for '%s'", dest.c_str());
+  }
+  else if(size > sizeLimit)
+  {
+    RDCWARN("Receiving %llu bytes for '%s' would exceed the limit of %llu bytes", size,
+            dest.c_str(), sizeLimit);
+  }
+  else
+  {
+    FileIO::CreateParentDirectory(partial);
+
+    f = FileIO::fopen(partial.c_str(), "r+b");
+    if(f == NULL)
+      f = FileIO::fopen(partial.c_str(), "w+b");
+
+    if(f == NULL)
+      RDCERR("Couldn't open '%s' to receive into", partial.c_str());
+  }
+
+  std::vector<uint32_t> needed;
+  bool failed = (f == NULL);
+
+  TransferProgress transfer("Receiving", dest, f ? size : 0, progress);
+
+  if(f)
+  {
+    bytebuf block;
+    block.resize((size_t)TransferBlockSize);
+
+    // blocks left from an interrupted transfer are already in the right place
+    std::vector<uint64_t> existing;
+    HashFileBlocks(f, GetOpenFileSize(f), existing);
+
+    for(uint32_t i = 0; i < hashes.size(); i++)
+    {
+      if(i < existing.size() && existing[i] == hashes[i])
+        transfer.Skip(TransferBlockLength(size, i));
+      else
+        needed.push_back(i);
+    }
+
+    // blocks from a previous version can be anywhere in it
+    FILE *basis = needed.empty() ? NULL : FileIO::fopen(dest.c_str(), "rb");
+
+    if(basis)
+    {
+      uint64_t basisSize = GetOpenFileSize(basis);
+
+      std::vector<uint64_t> basisHashes;
+      HashFileBlocks(basis, basisSize, basisHashes);
+
+      std::map<uint64_t, uint32_t> basisBlocks;
+      for(uint32_t i = 0; i < basisHashes.size(); i++)
+        basisBlocks.insert(std::make_pair(basisHashes[i], i));
+
+      std::vector<uint32_t> stillNeeded;
+
+      for(uint32_t index : needed)
+      {
+        auto it = basisBlocks.find(hashes[index]);
+        size_t length = (size_t)TransferBlockLength(size, index);
+
+        if(it != basisBlocks.end())
+        {
+          FileIO::fseek64(basis, it->second * TransferBlockSize, SEEK_SET);
+
+          if(FileIO::fread(block.data(), 1, length, basis) == length &&
+             XXH64(block.data(), length, 0) == hashes[index])
+          {
+            FileIO::fseek64(f, index * TransferBlockSize, SEEK_SET);
+            FileIO::fwrite(block.data(), 1, length, f);
+            transfer.Skip(length);
+            continue;
+          }
+        }
+
+        stillNeeded.push_back(index);
+      }
+
+      needed.swap(stillNeeded);
+
+      FileIO::fclose(basis);
+    }
+
+    RDCLOG("Receiving '%s': reusing %llu of %llu bytes, %zu blocks needed", dest.c_str(),
+           transfer.done, size, needed.size());
+  }
+
+  for(uint32_t round = 0;; round++)
+  {
+    if(!needed.empty() && (failed || round == MaxTransferRounds))
+    {
+      if(!failed)
+        RDCERR("Blocks of '%s' still corrupted after %u attempts", dest.c_str(), round);
+
+      // an empty list tells the sender we're finished
+      failed = true;
+      needed.clear();
+    }
+
+    {
+      WRITE_DATA_SCOPE();
+      SCOPED_SERIALISE_CHUNK(packet);
+      SERIALISE_ELEMENT(needed);
+    }
+
+    if(needed.empty())
+      break;
+
+    std::vector<uint32_t> corrupted;
+
+    for(uint32_t expected : needed)
+    {
+      uint32_t index = 0;
+      bytebuf data;
+
+      {
+        READ_DATA_SCOPE();
+        RemoteServerPacket type = ser.ReadChunk<RemoteServerPacket>();
+
+        if(type == packet)
+        {
+          SERIALISE_ELEMENT(index);
+          SERIALISE_ELEMENT(data);
+        }
+
+        ser.EndChunk();
+
+        if(ser.IsErrored() || type != packet)
+        {
+          // keep what we have so the transfer can resume from here next time
+          RDCERR("Network error receiving '%s', %llu of %llu bytes kept in '%s'", dest.c_str(),
+                 transfer.done, size, partial.c_str());
+          FileIO::fclose(f);
+          return "";
+        }
+      }
+
+      if(index != expected || data.size() != TransferBlockLength(size, index) ||
+         XXH64(data.data(), data.size(), 0) != hashes[index])
+      {
+        corrupted.push_back(expected);
+        continue;
+      }
+
+      FileIO::fseek64(f, index * TransferBlockSize, SEEK_SET);
+      FileIO::fwrite(data.data(), 1, data.size(), f);
+
+      transfer.Add(data.size());
+    }
+
+    if(!corrupted.empty())
+      RDCWARN("%zu blocks of '%s' were corrupted, requesting them again", corrupted.size(),
+              dest.c_str());
+
+    needed.swap(corrupted);
+  }
+
+  if(failed)
+  {
+    if(f)
+      FileIO::fclose(f);
+    return "";
+  }
+
+  FileIO::ftruncateat(f, size);
+  FileIO::fclose(f);
+
+  transfer.Finish();
+
+  // the destination could be in use, e.g. if it's open for replay
+  if(!FileIO::Move(partial.c_str(), dest.c_str(), true))
+  {
+    RDCWARN("Couldn't replace '%s', leaving received file at '%s'", dest.c_str(), partial.c_str());
+    return partial;
+  }
+
+  return dest;
+}
+
+static uint64_t GetStoredFileSize(const std::string &path)
+{
+  uint64_t size = 0;
+
+  FILE *f = FileIO::fopen(path.c_str(), "rb");
+  if(f)
+  {
+    size = GetOpenFileSize(f);
+    FileIO::fclose(f);
+  }
+
+  return size;
+}
+
+// deletes the partial files in dir left by transfers that were interrupted too long ago to resume
+static void ExpirePartialTransfers(const std::string &dir, RemoteServerSessions *sessions)
+{
+  std::vector<PathEntry> files = FileIO::GetFilesInDirectory(dir.c_str());
+
+  uint64_t now = Timing::GetUnixTimestamp();
+
+  SCOPED_LOCK(sessions->lock);
+
+  for(const PathEntry &file : files)
+  {
+    std::string name = file.filename;
+
+    if(name.find("remotecopy_") != 0 || !endswith(name, ".partial"))
+      continue;
+
+    if(now - RDCMIN(now, uint64_t(file.lastmod)) < PartialTransferLifetime)
+      continue;
+
+    std::string path = dir + "/" + name;
+
+    if(sessions->transfers.find(path) != sessions->transfers.end())
+      continue;
+
+    RDCLOG("Removing expired partial transfer '%s'", path.c_str());
+    FileIO::Delete(path.c_str());
+  }
+}
+
 static void InactiveRemoteClientThread(ClientThread *threadData)
 {
   uint32_t ip = threadData->socket->GetRemoteIP();
@@ -148,7 +681,7 @@ static void InactiveRemoteClientThread(ClientThread *threadData)
   }
 }
 
-static void ActiveRemoteClientThread(ClientThread *threadData,
+static void ActiveRemoteClientThread(ClientThread *threadData, RemoteServerSessions *sessions,
                                      RENDERDOC_PreviewWindowCallback previewWindow)
 {
   Network::Socket *&client = threadData->socket;
@@ -200,11 +733,19 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
   }
 
   std::vector<std::string> tempFiles;
+  // captures copied to the server, and the partial files left by interrupted copies. Both count
+  // towards the session's storage limit
+  std::vector<std::string> copies;
+  std::vector<std::string> partials;
+  // partial files only this session can resume, deleted when it ends
+  std::vector<std::string> sessionPartials;
   IRemoteDriver *remoteDriver = NULL;
   IReplayDriver *replayDriver = NULL;
   ReplayProxy *proxy = NULL;
   RDCFile *rdc = NULL;
   Callstack::StackResolver *resolver = NULL;
+  // held whenever the replay driver is used, see RemoteServerSessions::GetReplayLock
+  Threading::CriticalSection *replayLock = NULL;
 
   WriteSerialiser writer(new StreamWriter(client, Ownership::Nothing), Ownership::Stream);
   ReadSerialiser reader(new StreamReader(client, Ownership::Nothing), Ownership::Stream);
@@ -234,11 +775,45 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
       reader.EndChunk();
 
       if(proxy)
+      {
+        SCOPED_LOCK(*replayLock);
         proxy->RefreshPreviewWindow();
+      }
 
       WRITE_DATA_SCOPE();
       SCOPED_SERIALISE_CHUNK(eRemoteServer_Ping);
     }
+    else if(type == eRemoteServer_ListSessions)
+    {
+      reader.EndChunk();
+
+      rdcarray<RemoteSession> list;
+
+      uint64_t now = Timing::GetUnixTimestamp();
+
+      {
+        SCOPED_LOCK(sessions->lock);
+
+        for(ClientThread *session : sessions->active)
+        {
+          uint32_t sessionIP = session->ip;
+
+          RemoteSession desc;
+          desc.clientAddress = StringFormat::Fmt(
+              "%u.%u.%u.%u", Network::GetIPOctet(sessionIP, 0), Network::GetIPOctet(sessionIP, 1),
+              Network::GetIPOctet(sessionIP, 2), Network::GetIPOctet(sessionIP, 3));
+          desc.captureFile = session->captureFile;
+          desc.sessionId = session->id;
+          desc.connectedSeconds = uint32_t(now - RDCMIN(now, session->connectTime));
+          desc.current = (session == threadData);
+          list.push_back(desc);
+        }
+      }
+
+      WRITE_DATA_SCOPE();
+      SCOPED_SERIALISE_CHUNK(eRemoteServer_ListSessions);
+      SERIALISE_ELEMENT(list);
+    }
     else if(type == eRemoteServer_RemoteDriverList)
     {
       reader.EndChunk();
@@ -301,45 +876,103 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
 
       reader.EndChunk();
 
-      {
-        WRITE_DATA_SCOPE();
-        SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureFromRemote);
-
-        StreamReader fileStream(FileIO::fopen(path.c_str(), "rb"));
-        ser.SerialiseStream(path, fileStream);
-      }
+      SendCaptureBlocks(reader, writer, eRemoteServer_CopyCaptureFromRemote, path, NULL);
     }
     else if(type == eRemoteServer_CopyCaptureToRemote)
     {
+      // the path of the capture on the client, which identifies it between transfers
+      std::string source;
+
+      {
+        READ_DATA_SCOPE();
+        SERIALISE_ELEMENT(source);
+      }
+
+      reader.EndChunk();
+
       std::string path;
       std::string dummy, dummy2;
       FileIO::GetDefaultFiles("remotecopy", path, dummy, dummy2);
 
-      RDCLOG("Copying file to local path '%s'.", path.c_str());
+      // the partial file is named after the client and its capture, so an interrupted transfer of
+      // the same capture can resume. The finished copy is unique to this session, since other
+      // sessions may have an older copy open.
+      std::string dir = dirname(path);
+      std::string base = StringFormat::Fmt("%s/remotecopy_%016llx", dir.c_str(),
+                                           strhash64(source.c_str(), ip));
+      std::string partial = base + ".partial";
+
+      path = StringFormat::Fmt("%s_session%u.rdc", base.c_str(), threadData->id);
 
-      FileIO::CreateParentDirectory(path);
+      ExpirePartialTransfers(dir, sessions);
 
       {
-        READ_DATA_SCOPE();
+        SCOPED_LOCK(sessions->lock);
+
+        // if another session is copying the same capture, fall back to a partial file of our own
+        if(sessions->transfers.find(partial) != sessions->transfers.end())
+        {
+          partial = StringFormat::Fmt("%s_session%u.partial", base.c_str(), threadData->id);
 
-        StreamWriter streamWriter(FileIO::fopen(path.c_str(), "wb"), Ownership::Stream);
+          if(std::find(sessionPartials.begin(), sessionPartials.end(), partial) ==
+             sessionPartials.end())
+            sessionPartials.push_back(partial);
+        }
 
-        ser.SerialiseStream(path.c_str(), streamWriter, NULL);
+        sessions->transfers.insert(partial);
       }
 
-      reader.EndChunk();
+      RDCLOG("Copying file to local path '%s'.", path.c_str());
 
-      if(reader.IsErrored())
+      // a previous copy of the same capture in this session, or what's left of an interrupted
+      // one, will be replaced so it doesn't count towards the limit
+      uint64_t sizeLimit = ~0ULL;
+      if(sessions->sessionStorage > 0)
       {
-        FileIO::Delete(path.c_str());
+        uint64_t usedBytes = 0;
+
+        for(const std::string &file : copies)
+          if(file != path)
+            usedBytes += GetStoredFileSize(file);
+
+        for(const std::string &file : partials)
+          if(file != partial)
+            usedBytes += GetStoredFileSize(file);
 
+        sizeLimit = sessions->sessionStorage - RDCMIN(sessions->sessionStorage, usedBytes);
+      }
+
+      std::string dest = path;
+      path = ReceiveCaptureBlocks(reader, writer, eRemoteServer_CopyCaptureToRemote, dest, partial,
+                                  sizeLimit, NULL);
+
+      {
+        SCOPED_LOCK(sessions->lock);
+        sessions->transfers.erase(partial);
+      }
+
+      partials.erase(std::remove(partials.begin(), partials.end(), partial), partials.end());
+
+      // an interrupted transfer leaves its partial file to be resumed
+      if(path.empty() && FileIO::exists(partial.c_str()))
+        partials.push_back(partial);
+
+      if(reader.IsErrored() || writer.IsErrored())
+      {
         RDCERR("Network error receiving file");
         break;
       }
 
-      RDCLOG("File received.");
+      if(!path.empty())
+      {
+        RDCLOG("File received.");
 
-      tempFiles.push_back(path);
+        if(std::find(copies.begin(), copies.end(), path) == copies.end())
+          copies.push_back(path);
+
+        if(std::find(tempFiles.begin(), tempFiles.end(), path) == tempFiles.end())
+          tempFiles.push_back(path);
+      }
 
       {
         WRITE_DATA_SCOPE();
@@ -412,6 +1045,12 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
       {
         if(RenderDoc::Inst().HasRemoteDriver(rdc->GetDriver()))
         {
+          SCOPED_LOCK(sessions->loadLock);
+
+          replayLock = &sessions->GetReplayLock(rdc->GetDriver());
+
+          SCOPED_LOCK(*replayLock);
+
           bool kill = false;
           float progress = 0.0f;
 
@@ -477,6 +1116,12 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
         }
       }
 
+      if(status == ReplayStatus::Succeeded)
+      {
+        SCOPED_LOCK(sessions->lock);
+        threadData->captureFile = path;
+      }
+
       {
         WRITE_DATA_SCOPE();
         SCOPED_SERIALISE_CHUNK(eRemoteServer_LogOpened);
@@ -722,15 +1367,27 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
     {
       reader.EndChunk();
 
-      SAFE_DELETE(proxy);
+      if(replayLock)
+      {
+        SCOPED_LOCK(*replayLock);
+
+        SAFE_DELETE(proxy);
 
-      if(remoteDriver)
-        remoteDriver->Shutdown();
-      remoteDriver = NULL;
-      replayDriver = NULL;
+        if(remoteDriver)
+          remoteDriver->Shutdown();
+        remoteDriver = NULL;
+        replayDriver = NULL;
+      }
+
+      replayLock = NULL;
 
       SAFE_DELETE(rdc);
       SAFE_DELETE(resolver);
+
+      {
+        SCOPED_LOCK(sessions->lock);
+        threadData->captureFile.clear();
+      }
     }
     else if(type == eRemoteServer_ExecuteAndInject)
     {
@@ -769,7 +1426,12 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
     }
     else if((int)type >= eReplayProxy_First && proxy)
     {
-      bool ok = proxy->Tick(type);
+      bool ok = false;
+
+      {
+        SCOPED_LOCK(*replayLock);
+        ok = proxy->Tick(type);
+      }
 
       if(!ok)
         break;
@@ -778,12 +1440,18 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
     }
   }
 
-  SAFE_DELETE(proxy);
+  if(replayLock)
+  {
+    SCOPED_LOCK(*replayLock);
+
+    SAFE_DELETE(proxy);
+
+    if(remoteDriver)
+      remoteDriver->Shutdown();
+    remoteDriver = NULL;
+    replayDriver = NULL;
+  }
 
-  if(remoteDriver)
-    remoteDriver->Shutdown();
-  remoteDriver = NULL;
-  replayDriver = NULL;
   SAFE_DELETE(rdc);
   SAFE_DELETE(resolver);
 
@@ -792,10 +1460,12 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
     FileIO::Delete(tempFiles[i].c_str());
   }
 
-  RDCLOG("Closing active connection from %u.%u.%u.%u.", Network::GetIPOctet(ip, 0),
-         Network::GetIPOctet(ip, 1), Network::GetIPOctet(ip, 2), Network::GetIPOctet(ip, 3));
+  // other partial files are kept for a later session to resume, until they expire
+  for(const std::string &partial : sessionPartials)
+    FileIO::Delete(partial.c_str());
 
-  RDCLOG("Ready for new active connection...");
+  RDCLOG("Closing session %u from %u.%u.%u.%u.", threadData->id, Network::GetIPOctet(ip, 0),
+         Network::GetIPOctet(ip, 1), Network::GetIPOctet(ip, 2), Network::GetIPOctet(ip, 3));
 
   SAFE_DELETE(client);
 }
@@ -812,6 +1482,8 @@ void RenderDoc::BecomeRemoteServer(const char *listenhost, uint16_t port,
   std::vector<std::pair<uint32_t, uint32_t> > listenRanges;
   bool allowExecution = true;
 
+  RemoteServerSessions sessions;
+
   FILE *f = FileIO::fopen(FileIO::GetAppFolderFilename("remoteserver.conf").c_str(), "r");
 
   while(f && !FileIO::feof(f))
@@ -850,6 +1522,25 @@ void RenderDoc::BecomeRemoteServer(const char *listenhost, uint16_t port,
 
       continue;
     }
+    else if(line.substr(0, sizeof("maxsessions") - 1) == "maxsessions")
+    {
+      uint32_t maxSessions = (uint32_t)atoi(line.c_str() + sizeof("maxsessions") - 1);
+
+      if(maxSessions > 0)
+        sessions.maxSessions = maxSessions;
+      else
+        RDCLOG("Couldn't parse session count from: %s", line.c_str());
+
+      continue;
+    }
+    else if(line.substr(0, sizeof("sessionstorage") - 1) == "sessionstorage")
+    {
+      // specified in megabytes
+      sessions.sessionStorage = strtoull(line.c_str() + sizeof("sessionstorage") - 1, NULL, 10);
+      sessions.sessionStorage *= 1024 * 1024;
+
+      continue;
+    }
 
     RDCLOG("Malformed line '%s'. See documentation for file format.", line.c_str());
   }
@@ -887,9 +1578,21 @@ void RenderDoc::BecomeRemoteServer(const char *listenhost, uint16_t port,
   else
     RDCLOG("Blocking execution commands");
 
+  RDCLOG("Allowing up to %u simultaneous sessions", sessions.maxSessions);
+
+  if(sessions.sessionStorage > 0)
+    RDCLOG("Limiting each session to %llu MB of copied captures",
+           sessions.sessionStorage / (1024 * 1024));
+
+  {
+    std::string path, dummy, dummy2;
+    FileIO::GetDefaultFiles("remotecopy", path, dummy, dummy2);
+    ExpirePartialTransfers(dirname(path), &sessions);
+  }
+
   RDCLOG("Replay host ready for requests...");
 
-  ClientThread *activeClientData = NULL;
+  uint32_t nextSessionId = 1;
 
   std::vector<ClientThread *> inactives;
 
@@ -897,8 +1600,42 @@ void RenderDoc::BecomeRemoteServer(const char *listenhost, uint16_t port,
   {
     Network::Socket *client = sock->AcceptClient(false);
 
-    if(activeClientData && activeClientData->killServer)
+    std::vector<ClientThread *> finished;
+    bool killServer = false;
+
+    // reap any finished sessions, after removing them from the list so no other session is looking
+    // at them
+    {
+      SCOPED_LOCK(sessions.lock);
+
+      for(size_t i = 0; i < sessions.active.size();)
+      {
+        killServer |= sessions.active[i]->killServer;
+
+        if(sessions.active[i]->socket == NULL)
+        {
+          finished.push_back(sessions.active[i]);
+          sessions.active.erase(sessions.active.begin() + i);
+          continue;
+        }
+
+        i++;
+      }
+    }
+
+    for(ClientThread *session : finished)
+    {
+      Threading::JoinThread(session->thread);
+      Threading::CloseThread(session->thread);
+
+      delete session;
+    }
+
+    if(killServer)
+    {
+      SAFE_DELETE(client);
       break;
+    }
 
     // reap any dead inactive threads
     for(size_t i = 0; i < inactives.size(); i++)
@@ -913,16 +1650,6 @@ void RenderDoc::BecomeRemoteServer(const char *listenhost, uint16_t port,
       }
     }
 
-    // reap our active connection possibly
-    if(activeClientData && activeClientData->socket == NULL)
-    {
-      Threading::JoinThread(activeClientData->thread);
-      Threading::CloseThread(activeClientData->thread);
-
-      delete activeClientData;
-      activeClientData = NULL;
-    }
-
     if(client == NULL)
     {
       if(!sock->Connected())
@@ -964,17 +1691,35 @@ void RenderDoc::BecomeRemoteServer(const char *listenhost, uint16_t port,
       continue;
     }
 
-    if(activeClientData == NULL)
+    size_t numSessions = 0;
+
+    {
+      SCOPED_LOCK(sessions.lock);
+      numSessions = sessions.active.size();
+    }
+
+    if(numSessions < sessions.maxSessions)
     {
-      activeClientData = new ClientThread();
-      activeClientData->socket = client;
-      activeClientData->allowExecution = allowExecution;
+      ClientThread *session = new ClientThread();
+      session->socket = client;
+      session->allowExecution = allowExecution;
+      session->id = nextSessionId++;
+      session->ip = ip;
+      session->connectTime = Timing::GetUnixTimestamp();
+
+      {
+        SCOPED_LOCK(sessions.lock);
+        sessions.active.push_back(session);
+      }
 
-      activeClientData->thread = Threading::CreateThread([activeClientData, previewWindow]() {
-        ActiveRemoteClientThread(activeClientData, previewWindow);
+      RemoteServerSessions *sessionList = &sessions;
+
+      session->thread = Threading::CreateThread([session, sessionList, previewWindow]() {
+        ActiveRemoteClientThread(session, sessionList, previewWindow);
       });
 
-      RDCLOG("Making active connection");
+      RDCLOG("Making active connection as session %u (%zu of %u)", session->id, numSessions + 1,
+             sessions.maxSessions);
     }
     else
     {
@@ -987,18 +1732,27 @@ void RenderDoc::BecomeRemoteServer(const char *listenhost, uint16_t port,
 
       inactives.push_back(inactive);
 
-      RDCLOG("Refusing inactive connection");
+      RDCLOG("Refusing inactive connection, all %u sessions are in use", sessions.maxSessions);
     }
   }
 
-  if(activeClientData && activeClientData->socket != NULL)
+  // shut down sessions. They're removed from the list first, and will all be gone before anything
+  // can look at it again.
+  std::vector<ClientThread *> remaining;
+
+  {
+    SCOPED_LOCK(sessions.lock);
+    remaining.swap(sessions.active);
+  }
+
+  for(ClientThread *session : remaining)
   {
-    activeClientData->killThread = true;
+    session->killThread = true;
 
-    Threading::JoinThread(activeClientData->thread);
-    Threading::CloseThread(activeClientData->thread);
+    Threading::JoinThread(session->thread);
+    Threading::CloseThread(session->thread);
 
-    delete activeClientData;
+    delete session;
   }
 
   // shut down client threads
@@ -1077,6 +1831,38 @@ public:
     return type == eRemoteServer_Ping;
   }
 
+  rdcarray<RemoteSession> ListSessions()
+  {
+    if(!Connected())
+      return {};
+
+    {
+      WRITE_DATA_SCOPE();
+      SCOPED_SERIALISE_CHUNK(eRemoteServer_ListSessions);
+    }
+
+    rdcarray<RemoteSession> sessions;
+
+    {
+      READ_DATA_SCOPE();
+
+      RemoteServerPacket type = ser.ReadChunk<RemoteServerPacket>();
+
+      if(type == eRemoteServer_ListSessions)
+      {
+        SERIALISE_ELEMENT(sessions);
+      }
+      else
+      {
+        RDCERR("Unexpected response to list sessions request");
+      }
+
+      ser.EndChunk();
+    }
+
+    return sessions;
+  }
+
   rdcarray<rdcstr> LocalProxies()
   {
     rdcarray<rdcstr> out;
@@ -1305,41 +2091,30 @@ public:
       SERIALISE_ELEMENT(path);
     }
 
-    {
-      READ_DATA_SCOPE();
-      RemoteServerPacket type = ser.ReadChunk<RemoteServerPacket>();
-
-      if(type == eRemoteServer_CopyCaptureFromRemote)
-      {
-        StreamWriter streamWriter(FileIO::fopen(localpath, "wb"), Ownership::Stream);
-
-        ser.SerialiseStream(localpath, streamWriter, progress);
-
-        if(ser.IsErrored())
-        {
-          RDCERR("Network error receiving file");
-          return;
-        }
-      }
-      else
-      {
-        RDCERR("Unexpected response to capture copy request");
-      }
+    // if a previous attempt was interrupted, this picks up where it left off
+    std::string dest = localpath;
+    std::string received = ReceiveCaptureBlocks(reader, writer, eRemoteServer_CopyCaptureFromRemote,
+                                                dest, dest + ".partial", ~0ULL, progress);
 
-      ser.EndChunk();
-    }
+    if(received.empty())
+      RDCERR("Failed to copy '%s' from remote", remotepath);
+    else if(received != dest)
+      RDCERR("Copied '%s' from remote to '%s' instead of '%s'", remotepath, received.c_str(),
+             localpath);
   }
 
   rdcstr CopyCaptureToRemote(const char *filename, RENDERDOC_ProgressCallback progress)
   {
+    std::string source = FileIO::GetFullPathname(filename);
+
     {
       WRITE_DATA_SCOPE();
       SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureToRemote);
-
-      StreamReader fileStream(FileIO::fopen(filename, "rb"));
-      ser.SerialiseStream(filename, fileStream, progress);
+      SERIALISE_ELEMENT(source);
     }
 
+    SendCaptureBlocks(reader, writer, eRemoteServer_CopyCaptureToRemote, filename, progress);
+
     std::string path;
 
     {
@@ -1883,3 +2658,373 @@ RENDERDOC_CreateRemoteServerConnection(const char *host, uint32_t port, IRemoteS
 
   return ReplayStatus::Succeeded;
 }
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "3rdparty/catch/catch.hpp"
+
+// runs a remote server on a local port for the duration of a test
+struct LocalRemoteServer
+{
+  LocalRemoteServer(uint16_t p) : port(p)
+  {
+    thread = Threading::CreateThread([this]() {
+      RenderDoc::Inst().BecomeRemoteServer(
+          "localhost", port, [this]() { return Atomic::CmpExch32(&kill, 0, 0) != 0; },
+          [](bool, const rdcarray<WindowingSystem> &) {
+            WindowingData ret = {WindowingSystem::Unknown};
+            return ret;
+          });
+    });
+  }
+
+  ~LocalRemoteServer()
+  {
+    Atomic::Inc32(&kill);
+    Threading::JoinThread(thread);
+    Threading::CloseThread(thread);
+  }
+
+  // retries while the server is still starting up
+  ReplayStatus Connect(IRemoteServer *&server)
+  {
+    ReplayStatus status = ReplayStatus::NetworkIOFailed;
+
+    for(int i = 0; i < 50 && status == ReplayStatus::NetworkIOFailed; i++)
+    {
+      server = NULL;
+      status = RENDERDOC_CreateRemoteServerConnection("localhost", port, &server);
+
+      if(status == ReplayStatus::NetworkIOFailed)
+        Threading::Sleep(20);
+    }
+
+    return status;
+  }
+
+  uint16_t port;
+  volatile int32_t kill = 0;
+  Threading::ThreadHandle thread;
+};
+
+TEST_CASE("Remote server session limit and listing", "[remoteserver]")
+{
+  LocalRemoteServer server(39931);
+
+  IRemoteServer *a = NULL, *b = NULL;
+
+  REQUIRE((server.Connect(a) == ReplayStatus::Succeeded));
+  REQUIRE((server.Connect(b) == ReplayStatus::Succeeded));
+
+  rdcarray<RemoteSession> fromA = a->ListSessions();
+  rdcarray<RemoteSession> fromB = b->ListSessions();
+
+  REQUIRE(fromA.size() == 2);
+  REQUIRE(fromB.size() == 2);
+
+  CHECK(fromA[0].sessionId != fromA[1].sessionId);
+
+  // each client sees the same sessions, with only its own marked as current
+  uint32_t idA = 0, idB = 0;
+  for(size_t i = 0; i < 2; i++)
+  {
+    CHECK(fromA[i].clientAddress == "127.0.0.1");
+    CHECK(fromA[i].captureFile.empty());
+    CHECK(fromA[i].sessionId == fromB[i].sessionId);
+    CHECK(fromA[i].current != fromB[i].current);
+
+    if(fromA[i].current)
+      idA = fromA[i].sessionId;
+    if(fromB[i].current)
+      idB = fromB[i].sessionId;
+  }
+
+  CHECK(idA != 0);
+  CHECK(idB != 0);
+  CHECK(idA != idB);
+
+  // fill the remaining sessions, after which connections are refused as busy
+  IRemoteServer *c = NULL, *d = NULL, *e = NULL;
+
+  REQUIRE((server.Connect(c) == ReplayStatus::Succeeded));
+  REQUIRE((server.Connect(d) == ReplayStatus::Succeeded));
+  CHECK((server.Connect(e) == ReplayStatus::NetworkRemoteBusy));
+
+  CHECK(a->ListSessions().size() == 4);
+
+  // closing a session frees its slot once the server has noticed
+  d->ShutdownConnection();
+
+  size_t remaining = 4;
+  for(int i = 0; i < 100 && remaining != 3; i++)
+  {
+    Threading::Sleep(10);
+    remaining = a->ListSessions().size();
+  }
+
+  CHECK(remaining == 3);
+
+  REQUIRE((server.Connect(e) == ReplayStatus::Succeeded));
+
+  rdcarray<RemoteSession> fromE = e->ListSessions();
+  CHECK(fromE.size() == 4);
+
+  for(const RemoteSession &session : fromE)
+    if(session.current)
+      CHECK(session.sessionId > idA);
+
+  a->ShutdownConnection();
+  b->ShutdownConnection();
+  c->ShutdownConnection();
+  e->ShutdownConnection();
+}
+
+// a connected pair of sockets on a local port
+struct LoopbackSockets
+{
+  LoopbackSockets(uint16_t port)
+  {
+    Network::Socket *listen = Network::CreateServerSocket("localhost", port, 1);
+    if(listen)
+    {
+      a = Network::CreateClientSocket("localhost", port, 1000);
+      b = listen->AcceptClient(true);
+      delete listen;
+    }
+  }
+
+  ~LoopbackSockets()
+  {
+    SAFE_DELETE(a);
+    SAFE_DELETE(b);
+  }
+
+  Network::Socket *a = NULL, *b = NULL;
+};
+
+static std::vector<byte> ReadWholeFile(const std::string &path)
+{
+  std::vector<byte> ret;
+
+  FILE *f = FileIO::fopen(path.c_str(), "rb");
+  if(f)
+  {
+    ret.resize((size_t)GetOpenFileSize(f));
+    FileIO::fseek64(f, 0, SEEK_SET);
+    ret.resize(FileIO::fread(ret.data(), 1, ret.size(), f));
+    FileIO::fclose(f);
+  }
+
+  return ret;
+}
+
+static void WriteWholeFile(const std::string &path, const std::vector<byte> &data)
+{
+  FILE *f = FileIO::fopen(path.c_str(), "wb");
+  if(f)
+  {
+    FileIO::fwrite(data.data(), 1, data.size(), f);
+    FileIO::fclose(f);
+  }
+}
+
+TEST_CASE("Capture transfer resume and corruption", "[remoteserver]")
+{
+  const RemoteServerPacket packet = eRemoteServer_CopyCaptureToRemote;
+
+  std::string dest = FileIO::GetTempFolderFilename() + "/renderdoc_transfer_test.rdc";
+  std::string partial = dest + ".partial";
+
+  FileIO::Delete(dest.c_str());
+  FileIO::Delete(partial.c_str());
+
+  // three and a bit blocks
+  std::vector<byte> src(size_t(TransferBlockSize * 3 + 12345));
+  for(size_t i = 0; i < src.size(); i++)
+    src[i] = byte((i * 2654435761U) >> 13);
+
+  std::vector<uint64_t> hashes;
+  for(size_t i = 0; i * TransferBlockSize < src.size(); i++)
+    hashes.push_back(XXH64(src.data() + i * TransferBlockSize,
+                           (size_t)TransferBlockLength(src.size(), i), 0));
+
+  uint16_t port = 39941;
+
+  // sends src the way SendCaptureBlocks does, recording the blocks asked for in each round. The
+  // block at corruptIndex is corrupted the first time it's sent, and the connection is dropped once
+  // dropAfter blocks have been sent.
+  auto fakeSend = [&](Network::Socket *sock, uint32_t corruptIndex, uint32_t dropAfter,
+                      std::vector<std::vector<uint32_t>> &rounds) {
+    WriteSerialiser writer(new StreamWriter(sock, Ownership::Nothing), Ownership::Stream);
+    ReadSerialiser reader(new StreamReader(sock, Ownership::Nothing), Ownership::Stream);
+
+    writer.SetStreamingMode(true);
+    reader.SetStreamingMode(true);
+
+    uint64_t size = src.size();
+
+    {
+      WRITE_DATA_SCOPE();
+      SCOPED_SERIALISE_CHUNK(packet);
+      SERIALISE_ELEMENT(size);
+      SERIALISE_ELEMENT(hashes);
+    }
+
+    uint32_t sent = 0;
+
+    for(;;)
+    {
+      std::vector<uint32_t> needed;
+
+      {
+        READ_DATA_SCOPE();
+        ser.ReadChunk<RemoteServerPacket>();
+        SERIALISE_ELEMENT(needed);
+        ser.EndChunk();
+
+        if(ser.IsErrored() || needed.empty())
+          return;
+      }
+
+      rounds.push_back(needed);
+
+      for(uint32_t index : needed)
+      {
+        if(sent == dropAfter)
+        {
+          sock->Shutdown();
+          return;
+        }
+
+        bytebuf data;
+        data.resize((size_t)TransferBlockLength(size, index));
+        memcpy(data.data(), src.data() + index * TransferBlockSize, data.size());
+
+        if(index == corruptIndex)
+        {
+          data[0] ^= 0xff;
+          corruptIndex = ~0U;
+        }
+
+        {
+          WRITE_DATA_SCOPE();
+          SCOPED_SERIALISE_CHUNK(packet);
+          SERIALISE_ELEMENT(index);
+          SERIALISE_ELEMENT(data);
+        }
+
+        sent++;
+      }
+    }
+  };
+
+  auto receive = [&](Network::Socket *sock, float &progress) {
+    WriteSerialiser writer(new StreamWriter(sock, Ownership::Nothing), Ownership::Stream);
+    ReadSerialiser reader(new StreamReader(sock, Ownership::Nothing), Ownership::Stream);
+
+    writer.SetStreamingMode(true);
+    reader.SetStreamingMode(true);
+
+    return ReceiveCaptureBlocks(reader, writer, packet, dest, partial, ~0ULL,
+                                [&progress](float p) { progress = p; });
+  };
+
+  auto transfer = [&](uint32_t corruptIndex, uint32_t dropAfter,
+                      std::vector<std::vector<uint32_t>> &rounds, float &progress) {
+    LoopbackSockets sockets(port++);
+    REQUIRE(sockets.a);
+    REQUIRE(sockets.b);
+
+    Threading::ThreadHandle sender = Threading::CreateThread(
+        [&]() { fakeSend(sockets.a, corruptIndex, dropAfter, rounds); });
+
+    std::string ret = receive(sockets.b, progress);
+
+    Threading::JoinThread(sender);
+    Threading::CloseThread(sender);
+
+    return ret;
+  };
+
+  const std::vector<uint32_t> allBlocks = {0, 1, 2, 3};
+
+  SECTION("Corrupted blocks are asked for again")
+  {
+    std::vector<std::vector<uint32_t>> rounds;
+    float progress = 0.0f;
+
+    CHECK(transfer(1, ~0U, rounds, progress) == dest);
+
+    REQUIRE(rounds.size() == 2);
+    CHECK(rounds[0] == allBlocks);
+    CHECK(rounds[1] == std::vector<uint32_t>({1}));
+
+    CHECK(progress == 1.0f);
+    CHECK(ReadWholeFile(dest) == src);
+    CHECK_FALSE(FileIO::exists(partial.c_str()));
+  }
+
+  SECTION("Interrupted transfers resume")
+  {
+    std::vector<byte> previous = {1, 2, 3};
+    WriteWholeFile(dest, previous);
+
+    std::vector<std::vector<uint32_t>> rounds;
+    float progress = 0.0f;
+
+    CHECK(transfer(~0U, 2, rounds, progress) == "");
+
+    // the destination is untouched and the blocks that arrived are kept
+    CHECK(ReadWholeFile(dest) == previous);
+    CHECK(FileIO::exists(partial.c_str()));
+    CHECK(progress > 0.0f);
+    CHECK(progress < 1.0f);
+
+    rounds.clear();
+
+    CHECK(transfer(~0U, ~0U, rounds, progress) == dest);
+
+    REQUIRE(rounds.size() == 1);
+    CHECK(rounds[0] == std::vector<uint32_t>({2, 3}));
+
+    CHECK(progress == 1.0f);
+    CHECK(ReadWholeFile(dest) == src);
+    CHECK_FALSE(FileIO::exists(partial.c_str()));
+  }
+
+  SECTION("A missing file doesn't replace the destination")
+  {
+    std::vector<byte> previous = {1, 2, 3};
+    WriteWholeFile(dest, previous);
+
+    LoopbackSockets sockets(port++);
+    REQUIRE(sockets.a);
+    REQUIRE(sockets.b);
+
+    std::string missing = dest + ".missing";
+
+    Threading::ThreadHandle sender = Threading::CreateThread([&]() {
+      WriteSerialiser writer(new StreamWriter(sockets.a, Ownership::Nothing), Ownership::Stream);
+      ReadSerialiser reader(new StreamReader(sockets.a, Ownership::Nothing), Ownership::Stream);
+
+      writer.SetStreamingMode(true);
+      reader.SetStreamingMode(true);
+
+      CHECK_FALSE(SendCaptureBlocks(reader, writer, packet, missing, NULL));
+    });
+
+    float progress = 0.0f;
+    CHECK(receive(sockets.b, progress) == "");
+
+    Threading::JoinThread(sender);
+    Threading::CloseThread(sender);
+
+    CHECK(ReadWholeFile(dest) == previous);
+    CHECK_FALSE(FileIO::exists(partial.c_str()));
+  }
+
+  FileIO::Delete(dest.c_str());
+  FileIO::Delete(partial.c_str());
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -24,9 +24,14 @@
  ******************************************************************************/
 
 #include "replay_proxy.h"
+#include <algorithm>
 #include "3rdparty/lz4/lz4.h"
 #include "serialise/lz4io.h"
 
+// the budget for the reference copies of resource contents that deltas are computed against. This
+// must be the same on both sides of the connection.
+static const uint64_t MaxProxyDataBytes = 512ULL * 1024 * 1024;
+
 template <>
 std::string DoStringise(const ReplayProxyPacket &el)
 {
@@ -119,6 +124,13 @@ std::string DoStringise(const ReplayProxyPacket &el)
     CheckError(packet, expectedPacket);         \
   }
 
+// as END_PARAMS, for functions that can be used with PipelineCalls. While a batch of calls is being
+// issued this returns as soon as the parameters are sent, without waiting for the result.
+#define END_PARAMS_PIPELINED(retval)                              \
+  END_PARAMS();                                                   \
+  if(paramser.IsWriting() && m_PipelinePhase == Pipeline_Issuing) \
+    return retval;
+
 // begin serialising a return value. We begin a chunk here in either the writing or reading case
 // since this chunk is used purely to send/receive the return value and is fully handled within the
 // function.
@@ -164,6 +176,20 @@ struct RemoteExecution
 };
 #define REMOTE_EXECUTION() RemoteExecution exec(this);
 
+// held on the host side for the duration of any use of the connection, or of the caches that are
+// shared with the prefetch thread. The lock is recursive so proxied calls can nest.
+struct ConnectionLock
+{
+  ReplayProxy *m_Proxy;
+  ConnectionLock(ReplayProxy *proxy)
+  {
+    m_Proxy = proxy;
+    m_Proxy->LockConnection();
+  }
+  ~ConnectionLock() { m_Proxy->UnlockConnection(); }
+};
+#define CONNECTION_LOCK() ConnectionLock connectionLock(this);
+
 // uncomment the following to print verbose debugging prints for the remote proxy packets
 //#define PROXY_DEBUG(...) RDCDEBUG(__VA_ARGS__)
 
@@ -175,16 +201,22 @@ struct RemoteExecution
 #endif
 
 // dispatches to the right implementation of the Proxied_ function, depending on whether we're on
-// the remote server or not.
-#define PROXY_FUNCTION(name, ...)                                     \
-  PROXY_DEBUG("Proxying out %s", #name);                              \
-  if(m_RemoteServer)                                                  \
-    return CONCAT(Proxied_, name)(m_Reader, m_Writer, ##__VA_ARGS__); \
-  else                                                                \
+// the remote server or not. When collecting the results of pipelined calls, the parameters have
+// already been sent so they're written to a scratch serialiser instead.
+#define PROXY_FUNCTION(name, ...)                                                   \
+  PROXY_DEBUG("Proxying out %s", #name);                                            \
+  CONNECTION_LOCK();                                                                \
+  if(m_RemoteServer)                                                                \
+    return CONCAT(Proxied_, name)(m_Reader, m_Writer, ##__VA_ARGS__);               \
+  else if(m_PipelinePhase == Pipeline_Collecting)                                   \
+    return CONCAT(Proxied_, name)(*m_PipelineParamWriter, m_Reader, ##__VA_ARGS__); \
+  else                                                                              \
     return CONCAT(Proxied_, name)(m_Writer, m_Reader, ##__VA_ARGS__);
 
 ReplayProxy::~ReplayProxy()
 {
+  ShutdownPrefetchThread();
+
   ShutdownRemoteExecutionThread();
 
   ShutdownPreviewWindow();
@@ -343,6 +375,9 @@ std::vector<ResourceId> ReplayProxy::Proxied_GetTextures(ParamSerialiser &params
 
   SERIALISE_RETURN(ret);
 
+  if(paramser.IsWriting())
+    m_UnfetchedTextures.insert(ret.begin(), ret.end());
+
   return ret;
 }
 
@@ -362,7 +397,7 @@ TextureDescription ReplayProxy::Proxied_GetTexture(ParamSerialiser &paramser,
   {
     BEGIN_PARAMS();
     SERIALISE_ELEMENT(id);
-    END_PARAMS();
+    END_PARAMS_PIPELINED(ret);
   }
 
   {
@@ -381,6 +416,20 @@ TextureDescription ReplayProxy::Proxied_GetTexture(ParamSerialiser &paramser,
 
 TextureDescription ReplayProxy::GetTexture(ResourceId id)
 {
+  {
+    CONNECTION_LOCK();
+
+    if(!m_RemoteServer && m_PipelinePhase == Pipeline_None)
+    {
+      if(m_UnfetchedTextures.find(id) != m_UnfetchedTextures.end())
+        FetchDescriptions();
+
+      auto it = m_TextureDescs.find(id);
+      if(it != m_TextureDescs.end())
+        return it->second;
+    }
+  }
+
   PROXY_FUNCTION(GetTexture, id);
 }
 
@@ -405,6 +454,9 @@ std::vector<ResourceId> ReplayProxy::Proxied_GetBuffers(ParamSerialiser &paramse
 
   SERIALISE_RETURN(ret);
 
+  if(paramser.IsWriting())
+    m_UnfetchedBuffers.insert(ret.begin(), ret.end());
+
   return ret;
 }
 
@@ -452,7 +504,7 @@ BufferDescription ReplayProxy::Proxied_GetBuffer(ParamSerialiser &paramser,
   {
     BEGIN_PARAMS();
     SERIALISE_ELEMENT(id);
-    END_PARAMS();
+    END_PARAMS_PIPELINED(ret);
   }
 
   {
@@ -468,6 +520,20 @@ BufferDescription ReplayProxy::Proxied_GetBuffer(ParamSerialiser &paramser,
 
 BufferDescription ReplayProxy::GetBuffer(ResourceId id)
 {
+  {
+    CONNECTION_LOCK();
+
+    if(!m_RemoteServer && m_PipelinePhase == Pipeline_None)
+    {
+      if(m_UnfetchedBuffers.find(id) != m_UnfetchedBuffers.end())
+        FetchDescriptions();
+
+      auto it = m_BufferDescs.find(id);
+      if(it != m_BufferDescs.end())
+        return it->second;
+    }
+  }
+
   PROXY_FUNCTION(GetBuffer, id);
 }
 
@@ -553,8 +619,14 @@ FrameRecord ReplayProxy::Proxied_GetFrameRecord(ParamSerialiser &paramser, Retur
 
   if(paramser.IsWriting())
   {
+    // keep a copy with its own pointers, for finding the draws around the selected event
+    m_FrameRecord = ret;
+    m_Drawcalls.clear();
+    SetupDrawcallPointers(m_Drawcalls, m_FrameRecord.drawcallList);
+
     // re-configure the drawcall pointers, since they will be invalid
-    SetupDrawcallPointers(m_Drawcalls, ret.drawcallList);
+    std::vector<DrawcallDescription *> drawcallTable;
+    SetupDrawcallPointers(drawcallTable, ret.drawcallList);
   }
 
   return ret;
@@ -576,6 +648,11 @@ ResourceId ReplayProxy::Proxied_GetLiveID(ParamSerialiser &paramser, ReturnSeria
 
     if(m_LocalTextures.find(id) != m_LocalTextures.end())
       return id;
+
+    // a repeated ID in a pipelined batch is only sent once. By the time its result is collected the
+    // first one will have been cached above.
+    if(m_PipelinePhase == Pipeline_Issuing && !m_PipelinedLiveIDs.insert(id).second)
+      return ResourceId();
   }
 
   if(paramser.IsErrored() || retser.IsErrored() || m_IsErrored)
@@ -588,7 +665,7 @@ ResourceId ReplayProxy::Proxied_GetLiveID(ParamSerialiser &paramser, ReturnSeria
   {
     BEGIN_PARAMS();
     SERIALISE_ELEMENT(id);
-    END_PARAMS();
+    END_PARAMS_PIPELINED(ret);
   }
 
   {
@@ -1027,7 +1104,7 @@ rdcarray<ShaderEntryPoint> ReplayProxy::Proxied_GetShaderEntryPoints(ParamSerial
   {
     BEGIN_PARAMS();
     SERIALISE_ELEMENT(id);
-    END_PARAMS();
+    END_PARAMS_PIPELINED(ret);
   }
 
   {
@@ -1060,11 +1137,16 @@ ShaderReflection *ReplayProxy::Proxied_GetShader(ParamSerialiser &paramser, Retu
   if(retser.IsReading() && m_ShaderReflectionCache.find(key) != m_ShaderReflectionCache.end())
     return m_ShaderReflectionCache[key];
 
+  // as with GetLiveID, only send a repeated shader in a pipelined batch once
+  if(retser.IsReading() && m_PipelinePhase == Pipeline_Issuing &&
+     !m_PipelinedShaders.insert(key).second)
+    return NULL;
+
   {
     BEGIN_PARAMS();
     SERIALISE_ELEMENT(id);
     SERIALISE_ELEMENT(entry);
-    END_PARAMS();
+    END_PARAMS_PIPELINED(ret);
   }
 
   {
@@ -1541,6 +1623,8 @@ void ReplayProxy::Proxied_SavePipelineState(ParamSerialiser &paramser, ReturnSer
 
     if(retser.IsReading())
     {
+      std::vector<PipelineShader> shaders;
+
       if(m_APIProps.pipelineType == GraphicsAPI::D3D11)
       {
         D3D11Pipe::Shader *stages[] = {
@@ -1551,11 +1635,11 @@ void ReplayProxy::Proxied_SavePipelineState(ParamSerialiser &paramser, ReturnSer
 
         for(int i = 0; i < 6; i++)
           if(stages[i]->resourceId != ResourceId())
-            stages[i]->reflection = GetShader(GetLiveID(stages[i]->resourceId), ShaderEntryPoint());
+            shaders.push_back({stages[i]->resourceId, ShaderEntryPoint(), &stages[i]->reflection});
 
         if(m_D3D11PipelineState.inputAssembly.resourceId != ResourceId())
-          m_D3D11PipelineState.inputAssembly.bytecode = GetShader(
-              GetLiveID(m_D3D11PipelineState.inputAssembly.resourceId), ShaderEntryPoint());
+          shaders.push_back({m_D3D11PipelineState.inputAssembly.resourceId, ShaderEntryPoint(),
+                             &m_D3D11PipelineState.inputAssembly.bytecode});
       }
       else if(m_APIProps.pipelineType == GraphicsAPI::D3D12)
       {
@@ -1567,7 +1651,7 @@ void ReplayProxy::Proxied_SavePipelineState(ParamSerialiser &paramser, ReturnSer
 
         for(int i = 0; i < 6; i++)
           if(stages[i]->resourceId != ResourceId())
-            stages[i]->reflection = GetShader(GetLiveID(stages[i]->resourceId), ShaderEntryPoint());
+            shaders.push_back({stages[i]->resourceId, ShaderEntryPoint(), &stages[i]->reflection});
       }
       else if(m_APIProps.pipelineType == GraphicsAPI::OpenGL)
       {
@@ -1579,8 +1663,8 @@ void ReplayProxy::Proxied_SavePipelineState(ParamSerialiser &paramser, ReturnSer
 
         for(int i = 0; i < 6; i++)
           if(stages[i]->shaderResourceId != ResourceId())
-            stages[i]->reflection =
-                GetShader(GetLiveID(stages[i]->shaderResourceId), ShaderEntryPoint());
+            shaders.push_back(
+                {stages[i]->shaderResourceId, ShaderEntryPoint(), &stages[i]->reflection});
       }
       else if(m_APIProps.pipelineType == GraphicsAPI::Vulkan)
       {
@@ -1592,10 +1676,14 @@ void ReplayProxy::Proxied_SavePipelineState(ParamSerialiser &paramser, ReturnSer
 
         for(int i = 0; i < 6; i++)
           if(stages[i]->resourceId != ResourceId())
-            stages[i]->reflection =
-                GetShader(GetLiveID(stages[i]->resourceId),
-                          ShaderEntryPoint(stages[i]->entryPoint, stages[i]->stage));
+            shaders.push_back({stages[i]->resourceId,
+                               ShaderEntryPoint(stages[i]->entryPoint, stages[i]->stage),
+                               &stages[i]->reflection});
       }
+
+      FetchPipelineShaders(shaders);
+
+      StartPrefetch();
     }
   }
 
@@ -1631,6 +1719,15 @@ void ReplayProxy::Proxied_ReplayLog(ParamSerialiser &paramser, ReturnSerialiser
   {
     m_TextureProxyCache.clear();
     m_BufferProxyCache.clear();
+    m_PrefetchedTextureData.clear();
+    m_PrefetchedBufferData.clear();
+    m_ReplayGeneration++;
+
+    // descriptions can change during replay
+    m_TextureDescs.clear();
+    m_BufferDescs.clear();
+    m_UnfetchedTextures.clear();
+    m_UnfetchedBuffers.clear();
   }
 
   m_EventID = endEventID;
@@ -1689,11 +1786,16 @@ void ReplayProxy::Proxied_FetchStructuredFile(ParamSerialiser &paramser, ReturnS
     for(size_t b = 0; b < (size_t)bufferCount; b++)
     {
       if(retser.IsReading())
+      {
         file->buffers[b] = new bytebuf;
-
-      bytebuf *buf = file->buffers[b];
-
-      ser.Serialise("buffer", *buf);
+        ser.Serialise("buffer", *file->buffers[b]);
+      }
+      else
+      {
+        // buffers might be loaded on demand, send the contents rather than the placeholder
+        bytebuf buf = file->GetBuffer(b);
+        ser.Serialise("buffer", buf);
+      }
     }
 
     SERIALISE_ELEMENT(packet);
@@ -1965,7 +2067,7 @@ void ReplayProxy::Proxied_CacheBufferData(ParamSerialiser &paramser, ReturnSeria
   {
     BEGIN_PARAMS();
     SERIALISE_ELEMENT(buff);
-    END_PARAMS();
+    END_PARAMS_PIPELINED();
   }
 
   bytebuf data;
@@ -1982,10 +2084,18 @@ void ReplayProxy::Proxied_CacheBufferData(ParamSerialiser &paramser, ReturnSeria
     SERIALISE_ELEMENT(packet);
   }
 
-  DeltaTransferBytes(retser, m_ProxyBufferData[buff], data);
+  bytebuf &referenceData = m_ProxyBufferData[buff];
+
+  m_ProxyDataBytes -= referenceData.size();
+  DeltaTransferBytes(retser, referenceData, data);
+  m_ProxyDataBytes += referenceData.size();
 
   retser.EndChunk();
 
+  ProxyDataKey key = {false, {buff, 0, 0}};
+  MarkProxyDataUsed(key, m_ProxyBufferUse[buff]);
+  TrimProxyData();
+
   CheckError(packet, expectedPacket);
 }
 
@@ -2008,7 +2118,7 @@ void ReplayProxy::Proxied_CacheTextureData(ParamSerialiser &paramser, ReturnSeri
     SERIALISE_ELEMENT(arrayIdx);
     SERIALISE_ELEMENT(mip);
     SERIALISE_ELEMENT(params);
-    END_PARAMS();
+    END_PARAMS_PIPELINED();
   }
 
   bytebuf data;
@@ -2026,10 +2136,18 @@ void ReplayProxy::Proxied_CacheTextureData(ParamSerialiser &paramser, ReturnSeri
   }
 
   TextureCacheEntry entry = {tex, arrayIdx, mip};
-  DeltaTransferBytes(retser, m_ProxyTextureData[entry], data);
+  bytebuf &referenceData = m_ProxyTextureData[entry];
+
+  m_ProxyDataBytes -= referenceData.size();
+  DeltaTransferBytes(retser, referenceData, data);
+  m_ProxyDataBytes += referenceData.size();
 
   retser.EndChunk();
 
+  ProxyDataKey key = {true, entry};
+  MarkProxyDataUsed(key, m_ProxyTextureUse[entry]);
+  TrimProxyData();
+
   CheckError(packet, expectedPacket);
 }
 
@@ -2120,6 +2238,8 @@ void ReplayProxy::RemapProxyTextureIfNeeded(TextureDescription &tex, GetTextureD
 
 void ReplayProxy::EnsureTexCached(ResourceId texid, uint32_t arrayIdx, uint32_t mip)
 {
+  CONNECTION_LOCK();
+
   if(m_Reader.IsErrored() || m_Writer.IsErrored())
     return;
 
@@ -2151,6 +2271,9 @@ void ReplayProxy::EnsureTexCached(ResourceId texid, uint32_t arrayIdx, uint32_t
 
     const ProxyTextureProperties &proxy = m_ProxyTextures[texid];
 
+    // the prefetch thread may already have fetched the data at this event
+    bool prefetched = m_PrefetchedTextureData.find(entry) != m_PrefetchedTextureData.end();
+
     for(uint32_t sample = 0; sample < proxy.msSamp; sample++)
     {
       // MSAA array textures are remapped so it's:
@@ -2163,7 +2286,8 @@ void ReplayProxy::EnsureTexCached(ResourceId texid, uint32_t arrayIdx, uint32_t
       sampleArrayEntry.arrayIdx = sampleArrayIdx;
 
 #if ENABLED(TRANSFER_RESOURCE_CONTENTS_DELTAS)
-      CacheTextureData(texid, sampleArrayIdx, mip, proxy.params);
+      if(!prefetched || m_ProxyTextureData.find(sampleArrayEntry) == m_ProxyTextureData.end())
+        CacheTextureData(texid, sampleArrayIdx, mip, proxy.params);
 #else
       GetTextureData(texid, sampleArrayIdx, mip, proxy.params, m_ProxyTextureData[entry]);
 #endif
@@ -2180,6 +2304,8 @@ void ReplayProxy::EnsureTexCached(ResourceId texid, uint32_t arrayIdx, uint32_t
 
 void ReplayProxy::EnsureBufCached(ResourceId bufid)
 {
+  CONNECTION_LOCK();
+
   if(m_Reader.IsErrored() || m_Writer.IsErrored())
     return;
 
@@ -2194,7 +2320,9 @@ void ReplayProxy::EnsureBufCached(ResourceId bufid)
     ResourceId proxyid = m_ProxyBufferIds[bufid];
 
 #if ENABLED(TRANSFER_RESOURCE_CONTENTS_DELTAS)
-    CacheBufferData(bufid);
+    if(m_PrefetchedBufferData.find(bufid) == m_PrefetchedBufferData.end() ||
+       m_ProxyBufferData.find(bufid) == m_ProxyBufferData.end())
+      CacheBufferData(bufid);
 #else
     GetBufferData(bufid, 0, 0, m_ProxyBufferData[bufid]);
 #endif
@@ -2383,7 +2511,16 @@ void ReplayProxy::BeginRemoteExecution()
   }
   else
   {
-    // don't do anything, we go immediately to EndRemoteExecution and start reading packets
+    // a function that doesn't support pipelining would wait here for its own result, while the
+    // results for earlier calls in the batch are still unread.
+    if(m_PipelinePhase == Pipeline_Issuing)
+    {
+      RDCERR("Proxied function called while issuing pipelined calls doesn't support pipelining");
+      m_IsErrored = true;
+    }
+
+    // otherwise don't do anything, we go immediately to EndRemoteExecution and start reading
+    // packets
   }
 }
 
@@ -2483,6 +2620,464 @@ void ReplayProxy::RemoteExecutionThreadEntry()
   }
 }
 
+void ReplayProxy::PipelineCalls(const std::vector<std::function<void()>> &calls)
+{
+  CONNECTION_LOCK();
+
+  m_PipelinedLiveIDs.clear();
+  m_PipelinedShaders.clear();
+
+  // the server reads the next request only once it has sent the previous result. If we sent too
+  // many requests at once, we could fill the socket buffers while the server is blocked sending us
+  // a large result, and neither side would make progress. Requests are small, so a fixed limit is
+  // enough to avoid that.
+  const size_t MaxPipelinedCalls = 64;
+
+  for(size_t start = 0; start < calls.size(); start += MaxPipelinedCalls)
+  {
+    size_t end = RDCMIN(calls.size(), start + MaxPipelinedCalls);
+
+    m_PipelinePhase = Pipeline_Issuing;
+
+    for(size_t i = start; i < end; i++)
+      calls[i]();
+
+    // the results come back in the same order the requests were sent, so running the calls again in
+    // the same order reads each one's result.
+    WriteSerialiser paramWriter(new StreamWriter(StreamWriter::DefaultScratchSize),
+                                Ownership::Stream);
+    m_PipelineParamWriter = &paramWriter;
+    m_PipelinePhase = Pipeline_Collecting;
+
+    for(size_t i = start; i < end; i++)
+      calls[i]();
+
+    m_PipelineParamWriter = NULL;
+  }
+
+  m_PipelinePhase = Pipeline_None;
+}
+
+void ReplayProxy::FetchPipelineShaders(std::vector<PipelineShader> &shaders)
+{
+  if(shaders.empty())
+    return;
+
+  // the live IDs are needed before the shaders can be requested, so this takes two round-trips
+  // however many shaders are bound.
+  std::vector<ResourceId> liveIDs(shaders.size());
+  std::vector<std::function<void()>> calls;
+
+  for(size_t i = 0; i < shaders.size(); i++)
+    calls.push_back([this, &shaders, &liveIDs, i]() { liveIDs[i] = GetLiveID(shaders[i].id); });
+
+  PipelineCalls(calls);
+
+  calls.clear();
+
+  for(size_t i = 0; i < shaders.size(); i++)
+    calls.push_back([this, &shaders, &liveIDs, i]() {
+      *shaders[i].reflection = GetShader(liveIDs[i], shaders[i].entry);
+    });
+
+  PipelineCalls(calls);
+}
+
+void ReplayProxy::FetchDescriptions()
+{
+  std::vector<ResourceId> textures(m_UnfetchedTextures.begin(), m_UnfetchedTextures.end());
+  std::vector<ResourceId> buffers(m_UnfetchedBuffers.begin(), m_UnfetchedBuffers.end());
+
+  m_UnfetchedTextures.clear();
+  m_UnfetchedBuffers.clear();
+
+  if(m_Reader.IsErrored() || m_Writer.IsErrored() || m_IsErrored)
+    return;
+
+  std::vector<TextureDescription> texDescs(textures.size());
+  std::vector<BufferDescription> bufDescs(buffers.size());
+  std::vector<std::function<void()>> calls;
+
+  for(size_t i = 0; i < textures.size(); i++)
+    calls.push_back([this, &textures, &texDescs, i]() { texDescs[i] = GetTexture(textures[i]); });
+  for(size_t i = 0; i < buffers.size(); i++)
+    calls.push_back([this, &buffers, &bufDescs, i]() { bufDescs[i] = GetBuffer(buffers[i]); });
+
+  PipelineCalls(calls);
+
+  if(m_Reader.IsErrored() || m_Writer.IsErrored() || m_IsErrored)
+    return;
+
+  for(size_t i = 0; i < textures.size(); i++)
+    m_TextureDescs[textures[i]] = texDescs[i];
+  for(size_t i = 0; i < buffers.size(); i++)
+    m_BufferDescs[buffers[i]] = bufDescs[i];
+}
+
+void ReplayProxy::LockConnection()
+{
+  if(m_RemoteServer)
+    return;
+
+  Atomic::Inc32(&m_ConnectionWaiters);
+  m_ConnectionLock.Lock();
+  Atomic::Dec32(&m_ConnectionWaiters);
+}
+
+void ReplayProxy::UnlockConnection()
+{
+  if(m_RemoteServer)
+    return;
+
+  m_ConnectionLock.Unlock();
+}
+
+void ReplayProxy::StartPrefetch()
+{
+#if ENABLED(TRANSFER_RESOURCE_CONTENTS_DELTAS)
+  std::vector<PrefetchResource> resources;
+
+  PipeState pipe;
+  pipe.SetStates(m_APIProps, &m_D3D11PipelineState, &m_D3D12PipelineState, &m_GLPipelineState,
+                 &m_VulkanPipelineState);
+
+  // the render targets and vertex/index buffers are almost always fetched together once one of
+  // them is, either to display them or for mesh previews.
+  rdcarray<BoundResource> targets = pipe.GetOutputTargets();
+  targets.push_back(pipe.GetDepthTarget());
+
+  rdcarray<BoundVBuffer> vbuffers = pipe.GetVBuffers();
+  vbuffers.push_back(pipe.GetIBuffer());
+
+  for(const BoundResource &t : targets)
+    if(t.resourceId != ResourceId())
+      resources.push_back(
+          {t.resourceId, true, (uint32_t)RDCMAX(0, t.firstSlice), (uint32_t)RDCMAX(0, t.firstMip)});
+
+  for(const BoundVBuffer &vb : vbuffers)
+    if(vb.resourceId != ResourceId())
+      resources.push_back({vb.resourceId, false, 0, 0});
+
+  // then the targets of the draws either side, nearest first
+  const DrawcallDescription *draw = NULL;
+  if(!m_Drawcalls.empty())
+  {
+    // not every event has a drawcall, so start from the nearest one at or before it
+    for(size_t eid = RDCMIN((size_t)m_EventID, m_Drawcalls.size() - 1); draw == NULL; eid--)
+    {
+      draw = m_Drawcalls[eid];
+      if(eid == 0)
+        break;
+    }
+  }
+
+  std::vector<const DrawcallDescription *> draws;
+  if(draw)
+  {
+    draws.push_back(draw);
+
+    const DrawcallDescription *prev = draw->previous;
+    const DrawcallDescription *next = draw->next;
+
+    for(uint32_t i = 0; i < PrefetchNeighbourDraws; i++)
+    {
+      if(prev)
+        draws.push_back(prev);
+      if(next)
+        draws.push_back(next);
+
+      prev = prev ? prev->previous : NULL;
+      next = next ? next->next : NULL;
+    }
+  }
+
+  for(const DrawcallDescription *d : draws)
+  {
+    for(ResourceId id : d->outputs)
+      if(id != ResourceId())
+        resources.push_back({id, true, 0, 0});
+
+    if(d->depthOut != ResourceId())
+      resources.push_back({d->depthOut, true, 0, 0});
+  }
+
+  if(resources.empty())
+    return;
+
+  {
+    SCOPED_LOCK(m_PrefetchJobLock);
+    m_PrefetchJob.swap(resources);
+    m_PrefetchJobGeneration = m_ReplayGeneration;
+    m_PrefetchJobPending = true;
+  }
+
+  if(m_PrefetchThread == 0)
+    m_PrefetchThread = Threading::CreateThread([this]() { PrefetchThreadEntry(); });
+
+  m_PrefetchAvailable.Wake(1);
+#endif
+}
+
+void ReplayProxy::PrefetchThreadEntry()
+{
+  for(;;)
+  {
+    m_PrefetchAvailable.WaitForWake();
+
+    if(Atomic::CmpExch32(&m_PrefetchKill, 0, 0) != 0)
+      break;
+
+    std::vector<PrefetchResource> resources;
+    uint32_t replayGeneration = 0;
+
+    {
+      SCOPED_LOCK(m_PrefetchJobLock);
+
+      if(!m_PrefetchJobPending)
+        continue;
+
+      resources.swap(m_PrefetchJob);
+      replayGeneration = m_PrefetchJobGeneration;
+      m_PrefetchJobPending = false;
+    }
+
+    PrefetchResources(resources, replayGeneration);
+  }
+}
+
+void ReplayProxy::ShutdownPrefetchThread()
+{
+  if(m_PrefetchThread)
+  {
+    Atomic::Inc32(&m_PrefetchKill);
+    m_PrefetchAvailable.Wake(1);
+
+    Threading::JoinThread(m_PrefetchThread);
+    Threading::CloseThread(m_PrefetchThread);
+    m_PrefetchThread = 0;
+  }
+}
+
+bool ReplayProxy::BeginPrefetchBatch(uint32_t replayGeneration)
+{
+  // let anyone waiting for the connection go first
+  while(Atomic::CmpExch32(&m_ConnectionWaiters, 0, 0) != 0)
+    Threading::Sleep(0);
+
+  m_ConnectionLock.Lock();
+
+  if(m_ReplayGeneration != replayGeneration || Atomic::CmpExch32(&m_PrefetchKill, 0, 0) != 0 ||
+     m_Reader.IsErrored() || m_Writer.IsErrored() || m_IsErrored)
+  {
+    m_ConnectionLock.Unlock();
+    return false;
+  }
+
+  return true;
+}
+
+void ReplayProxy::PrefetchResources(const std::vector<PrefetchResource> &resources,
+                                    uint32_t replayGeneration)
+{
+  struct PrefetchItem
+  {
+    bool texture;
+    // for buffers only the ID is used
+    TextureCacheEntry entry;
+    GetTextureDataParams params;
+    uint32_t msSamp;
+  };
+
+  std::vector<PrefetchItem> items;
+
+  {
+    if(!BeginPrefetchBatch(replayGeneration))
+      return;
+
+    // the pipeline state and drawcalls refer to resources by their original IDs
+    std::vector<ResourceId> liveIDs(resources.size());
+    std::vector<std::function<void()>> calls;
+
+    for(size_t i = 0; i < resources.size(); i++)
+      calls.push_back([this, &resources, &liveIDs, i]() { liveIDs[i] = GetLiveID(resources[i].id); });
+
+    PipelineCalls(calls);
+
+    std::set<TextureCacheEntry> uniqueTextures;
+    std::set<ResourceId> uniqueBuffers;
+
+    for(size_t i = 0; i < resources.size(); i++)
+    {
+      ResourceId id = liveIDs[i];
+
+      if(id == ResourceId())
+        continue;
+
+      PrefetchItem item = {resources[i].texture, {id, 0, 0}};
+
+      if(item.texture)
+      {
+        // only textures we know about are prefetched. This skips buffers bound as render targets or
+        // UAVs, and anything created locally.
+        auto it = m_TextureInfo.find(id);
+        if(it == m_TextureInfo.end() || m_LocalTextures.find(id) != m_LocalTextures.end())
+          continue;
+
+        // 3D textures shouldn't cache by array index, since we fetch the whole texture at once.
+        item.entry.arrayIdx = it->second.dimension == 3 ? 0 : resources[i].arrayIdx;
+        item.entry.mip = resources[i].mip;
+
+        if(!uniqueTextures.insert(item.entry).second)
+          continue;
+
+        // fetch with the same parameters the proxy texture will use
+        auto proxy = m_ProxyTextures.find(id);
+        if(proxy != m_ProxyTextures.end())
+        {
+          item.params = proxy->second.params;
+          item.msSamp = proxy->second.msSamp;
+        }
+        else
+        {
+          TextureDescription desc = it->second;
+          RemapProxyTextureIfNeeded(desc, item.params);
+          item.msSamp = RDCMAX(1U, desc.msSamp);
+        }
+      }
+      else
+      {
+        if(!uniqueBuffers.insert(id).second)
+          continue;
+
+        item.msSamp = 1;
+      }
+
+      items.push_back(item);
+    }
+
+    // fetch the descriptions of buffers that don't have proxies yet, for when they're created
+    std::map<ResourceId, BufferDescription> bufDescs;
+    calls.clear();
+
+    for(ResourceId id : uniqueBuffers)
+      if(m_ProxyBufferIds.find(id) == m_ProxyBufferIds.end() &&
+         m_BufferDescs.find(id) == m_BufferDescs.end())
+        calls.push_back([this, &bufDescs, id]() { bufDescs[id] = GetBuffer(id); });
+
+    PipelineCalls(calls);
+
+    m_BufferDescs.insert(bufDescs.begin(), bufDescs.end());
+
+    m_ConnectionLock.Unlock();
+  }
+
+  // fetch the contents in batches, in the order they were listed so the selected event comes first
+  size_t next = 0;
+
+  while(next < items.size())
+  {
+    if(!BeginPrefetchBatch(replayGeneration))
+      return;
+
+    std::vector<const PrefetchItem *> fetched;
+    std::vector<std::function<void()>> calls;
+
+    for(; next < items.size() && calls.size() < PrefetchBatchSize; next++)
+    {
+      const PrefetchItem &item = items[next];
+
+      // skip anything that's been fetched on demand in the meantime
+      if(item.texture)
+      {
+        if(m_TextureProxyCache.find(item.entry) != m_TextureProxyCache.end())
+          continue;
+
+        for(uint32_t sample = 0; sample < item.msSamp; sample++)
+          calls.push_back([this, &item, sample]() {
+            CacheTextureData(item.entry.replayid, item.entry.arrayIdx * item.msSamp + sample,
+                             item.entry.mip, item.params);
+          });
+      }
+      else
+      {
+        if(m_BufferProxyCache.find(item.entry.replayid) != m_BufferProxyCache.end())
+          continue;
+
+        calls.push_back([this, &item]() { CacheBufferData(item.entry.replayid); });
+      }
+
+      fetched.push_back(&item);
+    }
+
+    PipelineCalls(calls);
+
+    // the reference data may have been evicted again if the budget is very tight, in which case
+    // it's left to be fetched on demand.
+    for(const PrefetchItem *item : fetched)
+    {
+      if(item->texture)
+      {
+        bool complete = true;
+
+        for(uint32_t sample = 0; sample < item->msSamp; sample++)
+        {
+          TextureCacheEntry sampleArrayEntry = item->entry;
+          sampleArrayEntry.arrayIdx = item->entry.arrayIdx * item->msSamp + sample;
+
+          if(m_ProxyTextureData.find(sampleArrayEntry) == m_ProxyTextureData.end())
+            complete = false;
+        }
+
+        if(complete)
+          m_PrefetchedTextureData.insert(item->entry);
+      }
+      else if(m_ProxyBufferData.find(item->entry.replayid) != m_ProxyBufferData.end())
+      {
+        m_PrefetchedBufferData.insert(item->entry.replayid);
+      }
+    }
+
+    m_ConnectionLock.Unlock();
+  }
+}
+
+void ReplayProxy::MarkProxyDataUsed(const ProxyDataKey &key, uint64_t &lastUse)
+{
+  if(lastUse != 0)
+    m_ProxyDataLRU.erase(lastUse);
+
+  lastUse = ++m_ProxyDataTick;
+  m_ProxyDataLRU[lastUse] = key;
+}
+
+void ReplayProxy::TrimProxyData()
+{
+  // the most recently used entry is never evicted, even if it's over the budget on its own, since
+  // it's about to be used.
+  while(m_ProxyDataBytes > MaxProxyDataBytes && m_ProxyDataLRU.size() > 1)
+  {
+    auto oldest = m_ProxyDataLRU.begin();
+    const ProxyDataKey &key = oldest->second;
+
+    if(key.texture)
+    {
+      auto it = m_ProxyTextureData.find(key.entry);
+      m_ProxyDataBytes -= it->second.size();
+      m_ProxyTextureData.erase(it);
+      m_ProxyTextureUse.erase(key.entry);
+    }
+    else
+    {
+      auto it = m_ProxyBufferData.find(key.entry.replayid);
+      m_ProxyDataBytes -= it->second.size();
+      m_ProxyBufferData.erase(it);
+      m_ProxyBufferUse.erase(key.entry.replayid);
+    }
+
+    m_ProxyDataLRU.erase(oldest);
+  }
+}
+
 bool ReplayProxy::CheckError(ReplayProxyPacket receivedPacket, ReplayProxyPacket expectedPacket)
 {
   if(m_Writer.IsErrored() || m_Reader.IsErrored() || m_IsErrored)
@@ -2610,3 +3205,436 @@ bool ReplayProxy::Tick(int type)
 
   return true;
 }
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "3rdparty/catch/catch.hpp"
+#include "core/resource_manager.h"
+
+// a driver with a fixed set of textures, buffers and shaders, which counts the queries made of it.
+// Only what the proxy needs to start up and the queries under test are implemented.
+class PipelineTestDriver : public IReplayDriver
+{
+public:
+  PipelineTestDriver()
+  {
+    for(uint32_t i = 0; i < 40; i++)
+    {
+      TextureDescription tex = {};
+      tex.resourceId = ResourceIDGen::GetNewUniqueID();
+      tex.width = 16 + i;
+      tex.height = 32 + i;
+      textures[tex.resourceId] = tex;
+      texIDs.push_back(tex.resourceId);
+
+      BufferDescription buf = {};
+      buf.resourceId = ResourceIDGen::GetNewUniqueID();
+      buf.length = 1024 + i;
+      buffers[buf.resourceId] = buf;
+      bufIDs.push_back(buf.resourceId);
+
+      ShaderReflection *refl = new ShaderReflection;
+      refl->resourceId = ResourceIDGen::GetNewUniqueID();
+      refl->entryPoint = StringFormat::Fmt("main%u", i);
+      refl->stage = ShaderStage::Pixel;
+      shaders[refl->resourceId] = refl;
+      shaderIDs.push_back(refl->resourceId);
+
+      liveIDs[ResourceIDGen::GetNewUniqueID()] = tex.resourceId;
+    }
+
+    // a draw rendering to each texture in turn
+    for(auto it = liveIDs.begin(); it != liveIDs.end(); ++it)
+    {
+      DrawcallDescription draw;
+      draw.eventId = (uint32_t)frame.drawcallList.size() * 10 + 10;
+      draw.flags = DrawFlags::Drawcall;
+      draw.outputs[0] = it->first;
+      frame.drawcallList.push_back(draw);
+    }
+  }
+
+  ~PipelineTestDriver()
+  {
+    for(auto it = shaders.begin(); it != shaders.end(); ++it)
+      delete it->second;
+  }
+
+  std::map<ResourceId, TextureDescription> textures;
+  std::map<ResourceId, BufferDescription> buffers;
+  std::map<ResourceId, ShaderReflection *> shaders;
+  std::map<ResourceId, ResourceId> liveIDs;
+  std::vector<ResourceId> texIDs, bufIDs, shaderIDs;
+
+  FrameRecord frame;
+  VKPipe::State vkState;
+
+  int32_t textureQueries = 0, bufferQueries = 0, shaderQueries = 0, liveIDQueries = 0;
+  int32_t textureDataQueries = 0;
+
+  void Shutdown() {}
+  APIProperties GetAPIProperties()
+  {
+    APIProperties ret = {};
+    ret.localRenderer = GraphicsAPI::Vulkan;
+    ret.pipelineType = GraphicsAPI::Vulkan;
+    return ret;
+  }
+  const SDFile &GetStructuredFile() { return file; }
+  std::vector<ResourceId> GetTextures() { return texIDs; }
+  std::vector<ResourceId> GetBuffers() { return bufIDs; }
+  TextureDescription GetTexture(ResourceId id)
+  {
+    Atomic::Inc32(&textureQueries);
+    return textures[id];
+  }
+  BufferDescription GetBuffer(ResourceId id)
+  {
+    Atomic::Inc32(&bufferQueries);
+    return buffers[id];
+  }
+  ShaderReflection *GetShader(ResourceId shader, ShaderEntryPoint entry)
+  {
+    Atomic::Inc32(&shaderQueries);
+    return shaders[shader];
+  }
+  ResourceId GetLiveID(ResourceId id)
+  {
+    Atomic::Inc32(&liveIDQueries);
+    return liveIDs[id];
+  }
+
+  const std::vector<ResourceDescription> &GetResources() { return resources; }
+  vector<DebugMessage> GetDebugMessages() { return {}; }
+  rdcarray<ShaderEntryPoint> GetShaderEntryPoints(ResourceId shader) { return {}; }
+  vector<string> GetDisassemblyTargets() { return {}; }
+  string DisassembleShader(ResourceId pipeline, const ShaderReflection *refl, const string &target)
+  {
+    return "";
+  }
+  vector<EventUsage> GetUsage(ResourceId id) { return {}; }
+  void SavePipelineState() {}
+  const D3D11Pipe::State *GetD3D11PipelineState() { return NULL; }
+  const D3D12Pipe::State *GetD3D12PipelineState() { return NULL; }
+  const GLPipe::State *GetGLPipelineState() { return NULL; }
+  const VKPipe::State *GetVulkanPipelineState() { return &vkState; }
+  FrameRecord GetFrameRecord() { return frame; }
+  ReplayStatus ReadLogInitialisation(RDCFile *rdc, bool storeStructuredBuffers)
+  {
+    return ReplayStatus::Succeeded;
+  }
+  void ReplayLog(uint32_t endEventID, ReplayLogType replayType) {}
+  vector<uint32_t> GetPassEvents(uint32_t eventId) { return {}; }
+  void InitPostVSBuffers(uint32_t eventId) {}
+  void InitPostVSBuffers(const vector<uint32_t> &passEvents) {}
+  MeshFormat GetPostVSBuffers(uint32_t eventId, uint32_t instID, uint32_t viewID,
+                              MeshDataStage stage)
+  {
+    return {};
+  }
+  void GetBufferData(ResourceId buff, uint64_t offset, uint64_t len, bytebuf &retData) {}
+  void GetTextureData(ResourceId tex, uint32_t arrayIdx, uint32_t mip,
+                      const GetTextureDataParams &params, bytebuf &data)
+  {
+    Atomic::Inc32(&textureDataQueries);
+    data.resize(64);
+  }
+  void BuildTargetShader(ShaderEncoding sourceEncoding, bytebuf source, string entry,
+                         const ShaderCompileFlags &compileFlags, ShaderStage type, ResourceId *id,
+                         string *errors)
+  {
+  }
+  rdcarray<ShaderEncoding> GetTargetShaderEncodings() { return {}; }
+  void ReplaceResource(ResourceId from, ResourceId to) {}
+  void RemoveReplacement(ResourceId id) {}
+  void FreeTargetResource(ResourceId id) {}
+  vector<GPUCounter> EnumerateCounters() { return {}; }
+  CounterDescription DescribeCounter(GPUCounter counterID) { return {}; }
+  vector<CounterResult> FetchCounters(const vector<GPUCounter> &counterID) { return {}; }
+  void FillCBufferVariables(ResourceId shader, string entryPoint, uint32_t cbufSlot,
+                            vector<ShaderVariable> &outvars, const bytebuf &data)
+  {
+  }
+  vector<PixelModification> PixelHistory(vector<EventUsage> events, ResourceId target, uint32_t x,
+                                         uint32_t y, uint32_t slice, uint32_t mip,
+                                         uint32_t sampleIdx, CompType typeHint)
+  {
+    return {};
+  }
+  ShaderDebugTrace DebugVertex(uint32_t eventId, uint32_t vertid, uint32_t instid, uint32_t idx,
+                               uint32_t instOffset, uint32_t vertOffset)
+  {
+    return {};
+  }
+  ShaderDebugTrace DebugPixel(uint32_t eventId, uint32_t x, uint32_t y, uint32_t sample,
+                              uint32_t primitive)
+  {
+    return {};
+  }
+  ShaderDebugTrace DebugThread(uint32_t eventId, const uint32_t groupid[3],
+                               const uint32_t threadid[3])
+  {
+    return {};
+  }
+  ResourceId RenderOverlay(ResourceId texid, CompType typeHint, DebugOverlay overlay,
+                           uint32_t eventId, const vector<uint32_t> &passEvents)
+  {
+    return ResourceId();
+  }
+  bool IsRenderOutput(ResourceId id) { return false; }
+  void FileChanged() {}
+  bool NeedRemapForFetch(const ResourceFormat &format) { return false; }
+
+  bool IsRemoteProxy() { return false; }
+  vector<WindowingSystem> GetSupportedWindowSystems() { return {}; }
+  AMDRGPControl *GetRGPControl() { return NULL; }
+  uint64_t MakeOutputWindow(WindowingData window, bool depth) { return 0; }
+  void DestroyOutputWindow(uint64_t id) {}
+  bool CheckResizeOutputWindow(uint64_t id) { return false; }
+  void GetOutputWindowDimensions(uint64_t id, int32_t &w, int32_t &h) {}
+  void ClearOutputWindowColor(uint64_t id, FloatVector col) {}
+  void ClearOutputWindowDepth(uint64_t id, float depth, uint8_t stencil) {}
+  void BindOutputWindow(uint64_t id, bool depth) {}
+  bool IsOutputWindowVisible(uint64_t id) { return false; }
+  void FlipOutputWindow(uint64_t id) {}
+  bool GetMinMax(ResourceId texid, uint32_t sliceFace, uint32_t mip, uint32_t sample,
+                 CompType typeHint, float *minval, float *maxval)
+  {
+    return false;
+  }
+  bool GetHistogram(ResourceId texid, uint32_t sliceFace, uint32_t mip, uint32_t sample,
+                    CompType typeHint, float minval, float maxval, bool channels[4],
+                    vector<uint32_t> &histogram)
+  {
+    return false;
+  }
+  ResourceId CreateProxyTexture(const TextureDescription &templateTex) { return ResourceId(); }
+  void SetProxyTextureData(ResourceId texid, uint32_t arrayIdx, uint32_t mip, byte *data,
+                           size_t dataSize)
+  {
+  }
+  bool IsTextureSupported(const ResourceFormat &format) { return false; }
+  ResourceId CreateProxyBuffer(const BufferDescription &templateBuf) { return ResourceId(); }
+  void SetProxyBufferData(ResourceId bufid, byte *data, size_t dataSize) {}
+  void RenderMesh(uint32_t eventId, const vector<MeshFormat> &secondaryDraws,
+                  const MeshDisplay &cfg)
+  {
+  }
+  bool RenderTexture(TextureDisplay cfg) { return false; }
+  void BuildCustomShader(string source, string entry, const ShaderCompileFlags &compileFlags,
+                         ShaderStage type, ResourceId *id, string *errors)
+  {
+  }
+  ResourceId ApplyCustomShader(ResourceId shader, ResourceId texid, uint32_t mip, uint32_t arrayIdx,
+                               uint32_t sampleIdx, CompType typeHint)
+  {
+    return ResourceId();
+  }
+  void FreeCustomShader(ResourceId id) {}
+  void RenderCheckerboard() {}
+  void RenderHighlightBox(float w, float h, float scale) {}
+  void PickPixel(ResourceId texture, uint32_t x, uint32_t y, uint32_t sliceFace, uint32_t mip,
+                 uint32_t sample, CompType typeHint, float pixel[4])
+  {
+  }
+  uint32_t PickVertex(uint32_t eventId, int32_t width, int32_t height, const MeshDisplay &cfg,
+                      uint32_t x, uint32_t y)
+  {
+    return 0;
+  }
+
+private:
+  SDFile file;
+  std::vector<ResourceDescription> resources;
+};
+
+TEST_CASE("Test pipelined proxy calls", "[replayproxy]")
+{
+  PipelineTestDriver remote, local;
+
+  Network::Socket *listen = Network::CreateServerSocket("localhost", 39951, 1);
+  REQUIRE(listen);
+
+  Network::Socket *client = Network::CreateClientSocket("localhost", 39951, 1000);
+  Network::Socket *server = listen->AcceptClient(true);
+  SAFE_DELETE(listen);
+
+  REQUIRE(client);
+  REQUIRE(server);
+
+  // the server side loops like the remote server does, until the client hangs up
+  Threading::ThreadHandle serverThread = Threading::CreateThread([&]() {
+    WriteSerialiser writer(new StreamWriter(server, Ownership::Nothing), Ownership::Stream);
+    ReadSerialiser reader(new StreamReader(server, Ownership::Nothing), Ownership::Stream);
+
+    writer.SetStreamingMode(true);
+    reader.SetStreamingMode(true);
+
+    ReplayProxy *proxy =
+        new ReplayProxy(reader, writer, &remote, NULL, RENDERDOC_PreviewWindowCallback());
+
+    for(;;)
+    {
+      ReplayProxyPacket type = reader.ReadChunk<ReplayProxyPacket>();
+
+      if(reader.IsErrored() || !proxy->Tick(type))
+        break;
+    }
+
+    proxy->Shutdown();
+  });
+
+  {
+    WriteSerialiser writer(new StreamWriter(client, Ownership::Nothing), Ownership::Stream);
+    ReadSerialiser reader(new StreamReader(client, Ownership::Nothing), Ownership::Stream);
+
+    writer.SetStreamingMode(true);
+    reader.SetStreamingMode(true);
+
+    ReplayProxy *proxy = new ReplayProxy(reader, writer, &local);
+
+    // listing the resources doesn't fetch any descriptions
+    CHECK(proxy->GetTextures() == remote.texIDs);
+    CHECK(proxy->GetBuffers() == remote.bufIDs);
+
+    CHECK(remote.textureQueries == 0);
+    CHECK(remote.bufferQueries == 0);
+
+    // the first description asked for fetches the rest of the listed ones with it, and they're
+    // cached until the next replay
+    for(ResourceId id : remote.texIDs)
+      CHECK((proxy->GetTexture(id) == remote.textures[id]));
+    for(ResourceId id : remote.bufIDs)
+      CHECK((proxy->GetBuffer(id) == remote.buffers[id]));
+
+    CHECK(remote.textureQueries == (int32_t)remote.texIDs.size());
+    CHECK(remote.bufferQueries == (int32_t)remote.bufIDs.size());
+
+    CHECK((proxy->GetTexture(remote.texIDs[0]) == remote.textures[remote.texIDs[0]]));
+    CHECK(remote.textureQueries == (int32_t)remote.texIDs.size());
+
+    proxy->ReplayLog(10, eReplay_WithoutDraw);
+
+    CHECK((proxy->GetTexture(remote.texIDs[0]) == remote.textures[remote.texIDs[0]]));
+    CHECK(remote.textureQueries == (int32_t)remote.texIDs.size() + 1);
+
+    // more calls than fit in one batch, mixing the queries and repeating the live IDs and shaders
+    std::vector<ResourceId> origIDs;
+    for(auto it = remote.liveIDs.begin(); it != remote.liveIDs.end(); ++it)
+      origIDs.push_back(it->first);
+
+    const size_t numCalls = 200;
+    std::vector<TextureDescription> texDescs(numCalls);
+    std::vector<BufferDescription> bufDescs(numCalls);
+    std::vector<ShaderReflection *> refls(numCalls);
+    std::vector<ResourceId> liveIDs(numCalls);
+    std::vector<std::function<void()>> calls;
+    std::set<ResourceId> uniqueShaders, uniqueOrigIDs;
+
+    for(size_t i = 0; i < numCalls; i++)
+    {
+      ResourceId tex = remote.texIDs[i % remote.texIDs.size()];
+      ResourceId buf = remote.bufIDs[(i * 7) % remote.bufIDs.size()];
+      ResourceId shad = remote.shaderIDs[(i / 2) % remote.shaderIDs.size()];
+      ResourceId orig = origIDs[(i * 3) % origIDs.size()];
+
+      if(i % 4 == 2)
+        uniqueShaders.insert(shad);
+      if(i % 4 == 3)
+        uniqueOrigIDs.insert(orig);
+
+      switch(i % 4)
+      {
+        case 0: calls.push_back([&, i, tex]() { texDescs[i] = proxy->GetTexture(tex); }); break;
+        case 1: calls.push_back([&, i, buf]() { bufDescs[i] = proxy->GetBuffer(buf); }); break;
+        case 2:
+          calls.push_back([&, i, shad]() {
+            refls[i] = proxy->GetShader(shad, ShaderEntryPoint("main", ShaderStage::Pixel));
+          });
+          break;
+        case 3: calls.push_back([&, i, orig]() { liveIDs[i] = proxy->GetLiveID(orig); }); break;
+      }
+    }
+
+    remote.textureQueries = remote.bufferQueries = 0;
+
+    proxy->PipelineCalls(calls);
+
+    CHECK(remote.textureQueries == (int32_t)numCalls / 4);
+    CHECK(remote.bufferQueries == (int32_t)numCalls / 4);
+
+    // repeated shaders and live IDs are only requested once
+    CHECK(remote.shaderQueries == (int32_t)uniqueShaders.size());
+    CHECK(remote.liveIDQueries == (int32_t)uniqueOrigIDs.size());
+
+    for(size_t i = 0; i < numCalls; i++)
+    {
+      ResourceId tex = remote.texIDs[i % remote.texIDs.size()];
+      ResourceId buf = remote.bufIDs[(i * 7) % remote.bufIDs.size()];
+      ResourceId shad = remote.shaderIDs[(i / 2) % remote.shaderIDs.size()];
+      ResourceId orig = origIDs[(i * 3) % origIDs.size()];
+
+      switch(i % 4)
+      {
+        case 0: CHECK((texDescs[i] == remote.textures[tex])); break;
+        case 1: CHECK((bufDescs[i] == remote.buffers[buf])); break;
+        case 2:
+          REQUIRE(refls[i]);
+          CHECK(refls[i]->resourceId == shad);
+          CHECK(refls[i]->entryPoint == remote.shaders[shad]->entryPoint);
+          break;
+        case 3: CHECK(liveIDs[i] == remote.liveIDs[orig]); break;
+      }
+    }
+
+#if ENABLED(TRANSFER_RESOURCE_CONTENTS_DELTAS)
+    // selecting an event prefetches the targets of its draw and the two either side in the
+    // background, and they aren't fetched again when they're displayed.
+    proxy->GetFrameRecord();
+    proxy->ReplayLog(40, eReplay_WithoutDraw);
+    proxy->SavePipelineState();
+
+    PerformanceTimer timer;
+    while(Atomic::CmpExch32(&remote.textureDataQueries, 0, 0) < 5 && timer.GetMilliseconds() < 5000)
+      Threading::Sleep(1);
+
+    CHECK(remote.textureDataQueries == 5);
+
+    TextureDisplay cfg = {};
+
+    for(uint32_t i = 1; i <= 5; i++)
+    {
+      cfg.resourceId = remote.texIDs[i];
+      proxy->RenderTexture(cfg);
+    }
+
+    CHECK(remote.textureDataQueries == 5);
+
+    // anything else is fetched on demand
+    cfg.resourceId = remote.texIDs[6];
+    proxy->RenderTexture(cfg);
+
+    CHECK(remote.textureDataQueries == 6);
+
+    // and nothing prefetched is used after the next replay
+    proxy->ReplayLog(50, eReplay_WithoutDraw);
+
+    cfg.resourceId = remote.texIDs[3];
+    proxy->RenderTexture(cfg);
+
+    CHECK(remote.textureDataQueries == 7);
+#endif
+
+    proxy->Shutdown();
+  }
+
+  // hanging up ends the server loop
+  SAFE_DELETE(client);
+
+  Threading::JoinThread(serverThread);
+  Threading::CloseThread(serverThread);
+
+  SAFE_DELETE(server);
+}
+
+#endif
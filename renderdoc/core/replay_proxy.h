@@ -158,6 +158,17 @@ public:
   void EndRemoteExecution();
   void RemoteExecutionThreadEntry();
 
+  // on the host side the connection is shared with the prefetch thread, so it's locked around each
+  // proxied call. Callers waiting on the lock go ahead of the prefetch thread.
+  void LockConnection();
+  void UnlockConnection();
+
+  // Issues several proxied calls back-to-back and then reads their results in order, so that the
+  // batch costs one round-trip to the remote server instead of one per call. Each call is run
+  // twice, first to send its parameters and then to read its result, so it should only store the
+  // return value. Only functions that end their parameters with END_PARAMS_PIPELINED can be used.
+  void PipelineCalls(const std::vector<std::function<void()>> &calls);
+
   bool IsRemoteProxy() { return !m_RemoteServer; }
   void Shutdown() { delete this; }
   ReplayStatus ReadLogInitialisation(RDCFile *rdc, bool storeStructuredBuffers)
@@ -562,6 +573,69 @@ private:
 
   bool CheckError(ReplayProxyPacket receivedPacket, ReplayProxyPacket expectedPacket);
 
+  struct PipelineShader
+  {
+    ResourceId id;
+    ShaderEntryPoint entry;
+    ShaderReflection **reflection;
+  };
+
+  // fetches the reflection for each shader in a pipeline state, with pipelined calls
+  void FetchPipelineShaders(std::vector<PipelineShader> &shaders);
+
+  // the IDs from GetTextures/GetBuffers are usually all asked for in turn straight afterwards, so
+  // the first time one of them is asked for, the descriptions of any listed IDs that haven't been
+  // fetched are fetched together with pipelined calls. The descriptions are cached until the next
+  // replay, since they can change during replay.
+  void FetchDescriptions();
+  std::set<ResourceId> m_UnfetchedTextures;
+  std::set<ResourceId> m_UnfetchedBuffers;
+  std::map<ResourceId, TextureDescription> m_TextureDescs;
+  std::map<ResourceId, BufferDescription> m_BufferDescs;
+
+  struct PrefetchResource
+  {
+    ResourceId id;
+    bool texture;
+    uint32_t arrayIdx;
+    uint32_t mip;
+  };
+
+  // when an event is selected, the contents of the render targets and vertex/index buffers bound
+  // there, and the render targets of the PrefetchNeighbourDraws draws either side of it, are
+  // fetched on the prefetch thread. They're fetched in small pipelined batches, giving way to any
+  // proxied call from the replay thread in between, so an on-demand fetch never waits for more than
+  // one batch. Once the event changes the rest of the prefetch is abandoned.
+  //
+  // Only the reference data is fetched there, the replay thread uploads it into the proxy resources
+  // when they're first used at the event without fetching them again. Prefetching the neighbouring
+  // draws' targets means stepping to one of them usually only transfers a small delta.
+  static const uint32_t PrefetchNeighbourDraws = 2;
+  static const size_t PrefetchBatchSize = 8;
+
+  void StartPrefetch();
+  void PrefetchThreadEntry();
+  void ShutdownPrefetchThread();
+  void PrefetchResources(const std::vector<PrefetchResource> &resources, uint32_t replayGeneration);
+  // waits for any waiting callers, then takes the connection lock. Returns false without the lock
+  // if the prefetch should be abandoned.
+  bool BeginPrefetchBatch(uint32_t replayGeneration);
+
+  Threading::CriticalSection m_ConnectionLock;
+  volatile int32_t m_ConnectionWaiters = 0;
+
+  Threading::ThreadHandle m_PrefetchThread = 0;
+  Threading::Semaphore m_PrefetchAvailable;
+  volatile int32_t m_PrefetchKill = 0;
+
+  Threading::CriticalSection m_PrefetchJobLock;
+  std::vector<PrefetchResource> m_PrefetchJob;
+  uint32_t m_PrefetchJobGeneration = 0;
+  bool m_PrefetchJobPending = false;
+
+  // incremented on every replay, so that a prefetch for an earlier event can tell it's out of date
+  uint32_t m_ReplayGeneration = 0;
+
   struct TextureCacheEntry
   {
     ResourceId replayid;
@@ -582,6 +656,10 @@ private:
   // deltas. It is cleared any time we set event.
   set<TextureCacheEntry> m_TextureProxyCache;
   set<ResourceId> m_BufferProxyCache;
+  // like the above, but for reference data fetched by the prefetch thread at the current event and
+  // not yet uploaded to the proxy resources.
+  std::set<TextureCacheEntry> m_PrefetchedTextureData;
+  std::set<ResourceId> m_PrefetchedBufferData;
 
   struct ProxyTextureProperties
   {
@@ -606,6 +684,24 @@ private:
   std::map<TextureCacheEntry, bytebuf> m_ProxyTextureData;
   std::map<ResourceId, bytebuf> m_ProxyBufferData;
 
+  // the reference data above is bounded by a byte budget, evicting the least recently used entries
+  // first. Both sides see the same sequence of cache calls and sizes, so they evict identically and
+  // stay in sync. Evicting only means the next transfer of that resource isn't delta-encoded.
+  struct ProxyDataKey
+  {
+    bool texture;
+    TextureCacheEntry entry;
+  };
+
+  void MarkProxyDataUsed(const ProxyDataKey &key, uint64_t &lastUse);
+  void TrimProxyData();
+
+  uint64_t m_ProxyDataBytes = 0;
+  uint64_t m_ProxyDataTick = 0;
+  std::map<uint64_t, ProxyDataKey> m_ProxyDataLRU;
+  std::map<TextureCacheEntry, uint64_t> m_ProxyTextureUse;
+  std::map<ResourceId, uint64_t> m_ProxyBufferUse;
+
   // this lists any textures which are only created locally (e.g. custom visualisation shaders) and
   // should not be treated as proxied.
   std::set<ResourceId> m_LocalTextures;
@@ -633,6 +729,22 @@ private:
 
   std::map<ShaderReflKey, ShaderReflection *> m_ShaderReflectionCache;
 
+  enum PipelinePhase
+  {
+    Pipeline_None,
+    Pipeline_Issuing,
+    Pipeline_Collecting,
+  };
+
+  PipelinePhase m_PipelinePhase = Pipeline_None;
+  // while collecting pipelined results, the re-serialised parameters are discarded into this.
+  WriteSerialiser *m_PipelineParamWriter = NULL;
+
+  // the IDs and shaders requested so far in the current pipelined batch, so that repeats aren't
+  // sent twice.
+  std::set<ResourceId> m_PipelinedLiveIDs;
+  std::set<ShaderReflKey> m_PipelinedShaders;
+
   // reader from the other side of the host <-> remote connection
   ReadSerialiser &m_Reader;
   // writer to the other side of the host <-> remote connection
@@ -681,6 +793,8 @@ private:
 
   bool m_IsErrored = false;
 
+  // on the remote server this is the frame shown in the preview window. On the host side it's a
+  // copy of the frame record with m_Drawcalls pointing into it, to find neighbouring draws.
   FrameRecord m_FrameRecord;
   APIProperties m_APIProps;
   std::map<ResourceId, TextureDescription> m_TextureInfo;
@@ -24,6 +24,7 @@
  ******************************************************************************/
 
 #include "resource_manager.h"
+#include <algorithm>
 
 namespace ResourceIDGen
 {
@@ -92,6 +93,308 @@ bool MarkReferenced(std::map<ResourceId, FrameRefType> &refs, ResourceId id, Fra
   return false;
 }
 
+void ChunkMergeList::Merge(std::vector<Chunk *> &chunks)
+{
+  typedef std::pair<int32_t, Chunk *> Entry;
+
+  chunks.clear();
+  chunks.reserve(m_Entries.size());
+
+  // records only ever append chunks with increasing IDs, but chunks added with an explicit ID can
+  // still leave a run out of order, so sort any that need it.
+  for(const Run &run : m_Runs)
+  {
+    auto begin = m_Entries.begin() + run.begin, end = m_Entries.begin() + run.end;
+    auto lessID = [](const Entry &a, const Entry &b) { return a.first < b.first; };
+
+    if(!std::is_sorted(begin, end, lessID))
+      std::stable_sort(begin, end, lessID);
+  }
+
+  // a min-heap of the runs that still have chunks, keyed by the ID at each run's cursor. The begin
+  // of each run is used as its cursor. Equal IDs are ordered by which run was added first.
+  std::vector<Run> heap;
+  heap.reserve(m_Runs.size());
+  for(const Run &run : m_Runs)
+    heap.push_back(run);
+
+  auto after = [this](const Run &a, const Run &b) {
+    int32_t idA = m_Entries[a.begin].first, idB = m_Entries[b.begin].first;
+    return idA > idB || (idA == idB && a.end > b.end);
+  };
+
+  std::make_heap(heap.begin(), heap.end(), after);
+
+  int32_t lastID = 0;
+
+  while(!heap.empty())
+  {
+    std::pop_heap(heap.begin(), heap.end(), after);
+
+    Run &run = heap.back();
+
+    // keep taking from this run while it's still ahead of every other run, so long stretches of
+    // chunks from one record don't each need a heap operation.
+    do
+    {
+      const Entry &entry = m_Entries[run.begin];
+      run.begin++;
+
+      if(!chunks.empty() && entry.first == lastID)
+        continue;
+
+      chunks.push_back(entry.second);
+      lastID = entry.first;
+    } while(run.begin < run.end && (heap.size() == 1 || !after(run, heap.front())));
+
+    if(run.begin == run.end)
+      heap.pop_back();
+    else
+      std::push_heap(heap.begin(), heap.end(), after);
+  }
+}
+
+// each thread's log is a list of blocks with a single producer (the thread) and a single consumer
+// (whoever is draining). Entries are published by incrementing the block's count after they're
+// written, so the consumer never sees a partially written entry.
+struct FrameRefLog::Block
+{
+  static const int32_t Capacity = 1024;
+
+  Entry entries[Capacity];
+  // number of published entries. Goes to Capacity+1 once next is set, so the consumer knows it can
+  // move on and free this block.
+  volatile int32_t count = 0;
+  Block *next = NULL;
+};
+
+struct FrameRefLog::ThreadLog
+{
+  // drain after this many blocks so a thread can't log unboundedly while nothing is draining.
+  static const uint32_t DrainBlocks = 64;
+  static const uint32_t SeenCacheSize = 256;
+
+  ThreadLog(int64_t id) : owner(id) { head = tail = new Block(); }
+  ~ThreadLog()
+  {
+    while(head)
+    {
+      Block *next = head->next;
+      delete head;
+      head = next;
+    }
+  }
+
+  // the ID of the FrameRefLog this belongs to
+  const int64_t owner;
+
+  // one reference for the owning thread and one for the FrameRefLog, released when the thread
+  // exits and when the FrameRefLog is destroyed respectively.
+  volatile int32_t refCount = 2;
+  volatile int32_t threadExited = 0;
+  volatile int32_t orphaned = 0;
+
+  // only accessed by the owning thread
+  Block *tail;
+  uint32_t numBlocks = 0;
+  int32_t generation = -1;
+  ResourceId seen[SeenCacheSize];
+
+  // only accessed by the draining thread
+  Block *head;
+  int32_t consumed = 0;
+};
+
+// the logs a thread has made to any FrameRefLog, only accessed by that thread
+struct FrameRefLog::ThreadLogList
+{
+  std::vector<ThreadLog *> logs;
+};
+
+static int64_t nextFrameRefLogID = 0;
+
+FrameRefLog::FrameRefLog()
+{
+  m_ID = Atomic::Inc64(&nextFrameRefLogID);
+}
+
+FrameRefLog::~FrameRefLog()
+{
+  // threads still holding one of our logs drop it the next time they need a new log, or exit
+  for(ThreadLog *log : m_Logs)
+  {
+    Atomic::Inc32(&log->orphaned);
+    ReleaseThreadLog(log);
+  }
+}
+
+uint64_t FrameRefLog::GetTLSSlot()
+{
+  static uint64_t slot = Threading::AllocateTLSSlot(&FrameRefLog::ThreadExited);
+  return slot;
+}
+
+void FrameRefLog::ThreadExited(void *value)
+{
+  ThreadLogList *list = (ThreadLogList *)value;
+
+  // the increment is a full barrier, so a drain that sees the flag also sees every entry
+  for(ThreadLog *log : list->logs)
+  {
+    Atomic::Inc32(&log->threadExited);
+    ReleaseThreadLog(log);
+  }
+
+  delete list;
+}
+
+void FrameRefLog::ReleaseThreadLog(ThreadLog *log)
+{
+  if(Atomic::Dec32(&log->refCount) == 0)
+    delete log;
+}
+
+FrameRefLog::ThreadLog *FrameRefLog::GetThreadLog()
+{
+  uint64_t slot = GetTLSSlot();
+  ThreadLogList *list = (ThreadLogList *)Threading::GetTLSValue(slot);
+
+  if(list)
+  {
+    for(ThreadLog *log : list->logs)
+      if(log->owner == m_ID)
+        return log;
+
+    // drop any logs whose FrameRefLog has gone
+    for(size_t i = 0; i < list->logs.size();)
+    {
+      if(Atomic::CmpExch32(&list->logs[i]->orphaned, 0, 0) != 0)
+      {
+        ReleaseThreadLog(list->logs[i]);
+        list->logs.erase(list->logs.begin() + i);
+        continue;
+      }
+
+      i++;
+    }
+  }
+  else
+  {
+    list = new ThreadLogList();
+    Threading::SetTLSValue(slot, list);
+  }
+
+  ThreadLog *log = new ThreadLog(m_ID);
+  list->logs.push_back(log);
+
+  SCOPED_LOCK(m_LogsLock);
+  m_Logs.push_back(log);
+
+  return log;
+}
+
+bool FrameRefLog::IsNewReference(ResourceId id)
+{
+  ThreadLog *log = GetThreadLog();
+
+  int32_t generation = m_Generation;
+  if(log->generation != generation)
+  {
+    for(uint32_t i = 0; i < ThreadLog::SeenCacheSize; i++)
+      log->seen[i] = ResourceId();
+    log->generation = generation;
+  }
+
+  ResourceId &seen = log->seen[ConcurrentHash<ResourceId>()(id) % ThreadLog::SeenCacheSize];
+
+  if(seen == id)
+    return false;
+
+  seen = id;
+  return true;
+}
+
+bool FrameRefLog::Log(ResourceId id, FrameRefType refType, ResourceRecord *record)
+{
+  ThreadLog *log = GetThreadLog();
+
+  Block *block = log->tail;
+  bool drain = false;
+
+  if(block->count == Block::Capacity)
+  {
+    Block *next = new Block();
+    block->next = next;
+    // the increment is a full barrier, so next is visible before the consumer sees the count
+    Atomic::Inc32(&block->count);
+
+    log->tail = block = next;
+    drain = (++log->numBlocks % ThreadLog::DrainBlocks) == 0;
+  }
+
+  Entry &entry = block->entries[block->count];
+  entry.id = id;
+  entry.tick = Timing::GetTick();
+  entry.record = record;
+  entry.refType = refType;
+
+  Atomic::Inc32(&block->count);
+
+  return drain;
+}
+
+void FrameRefLog::Drain(std::vector<Entry> &entries)
+{
+  size_t first = entries.size();
+
+  {
+    SCOPED_LOCK(m_LogsLock);
+
+    for(size_t i = 0; i < m_Logs.size();)
+    {
+      ThreadLog *log = m_Logs[i];
+
+      // check before draining, so that if the thread has exited every entry is drained below
+      bool exited = Atomic::CmpExch32(&log->threadExited, 0, 0) != 0;
+
+      for(;;)
+      {
+        Block *block = log->head;
+
+        // atomic read, so that the entries up to count are visible
+        int32_t count = Atomic::CmpExch32(&block->count, 0, 0);
+
+        entries.insert(entries.end(), block->entries + log->consumed,
+                       block->entries + RDCMIN(count, int32_t(Block::Capacity)));
+
+        if(count <= Block::Capacity)
+        {
+          log->consumed = count;
+          break;
+        }
+
+        log->head = block->next;
+        log->consumed = 0;
+        delete block;
+      }
+
+      // nothing more can be logged by a thread that's gone
+      if(exited)
+      {
+        m_Logs.erase(m_Logs.begin() + i);
+        ReleaseThreadLog(log);
+        continue;
+      }
+
+      i++;
+    }
+  }
+
+  // each thread's entries are already in order, we just need to interleave them
+  std::stable_sort(entries.begin() + first, entries.end(),
+                   [](const Entry &a, const Entry &b) { return a.tick < b.tick; });
+}
+
 bool ResourceRecord::MarkResourceFrameReferenced(ResourceId id, FrameRefType refType)
 {
   if(id == ResourceId())
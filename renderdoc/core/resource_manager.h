@@ -28,6 +28,7 @@
 #include <map>
 #include <set>
 #include "api/replay/renderdoc_replay.h"
+#include "common/concurrent_map.h"
 #include "common/threading.h"
 #include "core/core.h"
 #include "os/os_specific.h"
@@ -66,8 +67,83 @@ ResourceId GetNewUniqueID();
 void SetReplayResourceIDs();
 };
 
+template <>
+struct ConcurrentHash<ResourceId>
+{
+  size_t operator()(const ResourceId &id) const
+  {
+    // the ID is opaque, but it's just a 64-bit counter
+    RDCCOMPILE_ASSERT(sizeof(ResourceId) == sizeof(uint64_t), "ResourceId should be 64-bit");
+    uint64_t val;
+    memcpy(&val, &id, sizeof(val));
+    return std::hash<uint64_t>()(val);
+  }
+};
+
 struct ResourceRecord;
 
+// Frame references are made from every thread on almost every call while capturing. Instead of
+// taking a lock to update the frame's reference map each time, each thread appends its references
+// to its own log without any locking. The logs are drained when the references are needed, in the
+// order the references were made, so applying them gives the same result as applying directly.
+class FrameRefLog
+{
+public:
+  struct Entry
+  {
+    ResourceId id;
+    // when the reference was made, to order references made on different threads
+    uint64_t tick;
+    // if non-NULL, a reference was added to this record when logging that the entry now owns
+    ResourceRecord *record;
+    FrameRefType refType;
+  };
+
+  FrameRefLog();
+  ~FrameRefLog();
+
+  // returns true if the calling thread hasn't logged this ID since the last Reset(), and remembers
+  // it. This is conservative - it may return true more than once for the same ID.
+  bool IsNewReference(ResourceId id);
+
+  // log a reference from the calling thread. Returns true once the thread has logged enough that
+  // the logs should be drained to bound memory use.
+  bool Log(ResourceId id, FrameRefType refType, ResourceRecord *record);
+
+  // append all logged entries from every thread in the order they were made, removing them from the
+  // logs. Must only be called from one thread at a time.
+  void Drain(std::vector<Entry> &entries);
+
+  // forget which IDs have been logged, so IsNewReference() returns true for them again.
+  void Reset() { Atomic::Inc32(&m_Generation); }
+  // how many threads' logs are currently held. Logs of exited threads are freed once drained.
+  size_t NumThreadLogs()
+  {
+    SCOPED_LOCK(m_LogsLock);
+    return m_Logs.size();
+  }
+
+private:
+  struct Block;
+  struct ThreadLog;
+  struct ThreadLogList;
+
+  ThreadLog *GetThreadLog();
+
+  // every FrameRefLog shares one TLS slot, holding the calling thread's list of logs
+  static uint64_t GetTLSSlot();
+  static void ThreadExited(void *value);
+  static void ReleaseThreadLog(ThreadLog *log);
+
+  // identifies this FrameRefLog's logs in each thread's list. A later FrameRefLog can be allocated
+  // at the same address, so the pointer can't be used.
+  int64_t m_ID;
+  volatile int32_t m_Generation = 0;
+
+  Threading::CriticalSection m_LogsLock;
+  std::vector<ThreadLog *> m_Logs;
+};
+
 class ResourceRecordHandler
 {
 public:
@@ -79,6 +155,37 @@ public:
   virtual void DestroyResourceRecord(ResourceRecord *record) = 0;
 };
 
+// Gathers the chunks of several resource records and produces them in global chunk ID order for
+// writing to a capture. Each record's chunk list is already sorted by ID, so rather than inserting
+// every chunk into a map the lists are kept as flat runs and combined with a k-way merge.
+class ChunkMergeList
+{
+public:
+  void Add(const std::vector<std::pair<int32_t, Chunk *>> &chunks)
+  {
+    if(chunks.empty())
+      return;
+
+    Run run = {m_Entries.size(), m_Entries.size() + chunks.size()};
+    m_Entries.insert(m_Entries.end(), chunks.begin(), chunks.end());
+    m_Runs.push_back(run);
+  }
+
+  size_t NumChunks() const { return m_Entries.size(); }
+  // fills chunks with every added chunk in ID order. If the same ID was added more than once, only
+  // the first is kept.
+  void Merge(std::vector<Chunk *> &chunks);
+
+private:
+  struct Run
+  {
+    size_t begin, end;
+  };
+
+  std::vector<std::pair<int32_t, Chunk *>> m_Entries;
+  std::vector<Run> m_Runs;
+};
+
 // This is a generic resource record, that APIs can inherit from and use.
 // A resource is an API object that gets tracked on its own, has dependencies on other resources
 // and has its own stream of chunks.
@@ -136,7 +243,7 @@ struct ResourceRecord
   }
 
   void MarkDataUnwritten() { DataWritten = false; }
-  void Insert(map<int32_t, Chunk *> &recordlist)
+  void Insert(ChunkMergeList &recordlist)
   {
     bool dataWritten = DataWritten;
 
@@ -151,10 +258,7 @@ struct ResourceRecord
     }
 
     if(!dataWritten)
-    {
-      for(auto it = m_Chunks.begin(); it != m_Chunks.end(); ++it)
-        recordlist[it->first] = it->second;
-    }
+      recordlist.Add(m_Chunks);
   }
 
   void AddRef() { Atomic::Inc32(&RefCount); }
@@ -208,13 +312,14 @@ struct ResourceRecord
     UnlockChunks();
   }
 
-  void AppendFrom(ResourceRecord *other)
+  // the duplicated chunks are sub-allocated from arena, if it's specified
+  void AppendFrom(ResourceRecord *other, ChunkAllocator *arena = NULL)
   {
     LockChunks();
     other->LockChunks();
 
     for(auto it = other->m_Chunks.begin(); it != other->m_Chunks.end(); ++it)
-      AddChunk(it->second->Duplicate());
+      AddChunk(it->second->Duplicate(arena));
 
     for(auto it = other->Parents.begin(); it != other->Parents.end(); ++it)
       AddParent(*it);
@@ -232,6 +337,24 @@ struct ResourceRecord
     UnlockChunks();
   }
 
+  void DetachChunksFromArena()
+  {
+    LockChunks();
+    for(auto it = m_Chunks.begin(); it != m_Chunks.end(); ++it)
+      it->second->DetachFromArena();
+    UnlockChunks();
+  }
+
+  // hands ownership of this record's chunks to the caller, leaving the record without any
+  void ReleaseChunks(std::vector<Chunk *> &chunks)
+  {
+    LockChunks();
+    for(auto it = m_Chunks.begin(); it != m_Chunks.end(); ++it)
+      chunks.push_back(it->second);
+    m_Chunks.clear();
+    UnlockChunks();
+  }
+
   Chunk *GetLastChunk() const
   {
     RDCASSERT(HasChunks());
@@ -346,6 +469,10 @@ public:
   // clear the list of frame-referenced resources - e.g. if you're about to recapture a frame
   void ClearReferencedResources();
 
+  // once a frame capture has ended and its chunks are freed, copy any chunks recorded during it that
+  // are still in a resource record out of the chunk arena, so they don't keep its pages alive.
+  void DetachChunksFromArena();
+
   // indicates this resource could have been modified by the GPU,
   // so it's now suspect and the data we have on it might well be out of date
   // and to be correct its contents should be serialised out at the start
@@ -386,6 +513,10 @@ public:
   // That means this resource should be included in the final serialise out
   inline void MarkResourceFrameReferenced(ResourceId id, FrameRefType refType);
 
+  // merge references logged by MarkResourceFrameReferenced into m_FrameReferencedResources.
+  // Anything that looks at the frame's references must call this first.
+  void MergeFrameReferences();
+
   ///////////////////////////////////////////
   // Replay-side methods
 
@@ -437,26 +568,21 @@ protected:
   virtual void Apply_InitialState(WrappedResourceType live, InitialContentData initial) = 0;
   virtual std::vector<ResourceId> InitialContentResources();
 
-  // very coarse lock, protects EVERYTHING. This could certainly be improved and it may be a
-  // bottleneck
-  // for performance. Given that the main use cases are write-rarely read-often the lock should be
-  // optimised
-  // for that as we only want to make sure we're not modifying the objects together, by far the most
-  // common
-  // operation is looking up data.
+  // coarse lock, protects everything except the lookup tables below that are ConcurrentHashMaps.
+  // Those are looked up from every thread on almost every call, and are internally synchronised so
+  // that lookups don't contend with each other.
   Threading::CriticalSection m_Lock;
 
-  // easy optimisation win - don't use maps everywhere. It's convenient but not optimal, and
-  // profiling will
-  // likely prove that some or all of these could be a problem
-
   // used during capture - map from real resource to its wrapper (other way can be done just with an
   // Unwrap)
-  map<RealResourceType, WrappedResourceType> m_WrapperMap;
+  ConcurrentHashMap<RealResourceType, WrappedResourceType> m_WrapperMap;
 
   // used during capture - holds resources referenced in current frame (and how they're referenced)
   map<ResourceId, FrameRefType> m_FrameReferencedResources;
 
+  // used during capture - references made from any thread, not yet merged into the map above
+  FrameRefLog m_FrameRefLog;
+
   // used during capture - holds resources marked as dirty, needing initial contents
   set<ResourceId> m_DirtyResources;
   set<ResourceId> m_PendingDirtyResources;
@@ -469,19 +595,19 @@ protected:
 
   // used during capture or replay - map of resources currently alive with their real IDs, used in
   // capture and replay.
-  map<ResourceId, WrappedResourceType> m_CurrentResourceMap;
+  ConcurrentHashMap<ResourceId, WrappedResourceType> m_CurrentResourceMap;
 
   // used during replay - maps back and forth from original id to live id and vice-versa
-  map<ResourceId, ResourceId> m_OriginalIDs, m_LiveIDs;
+  ConcurrentHashMap<ResourceId, ResourceId> m_OriginalIDs, m_LiveIDs;
 
   // used during replay - holds resources allocated and the original id that they represent
   map<ResourceId, WrappedResourceType> m_LiveResourceMap;
 
   // used during capture - holds resource records by id.
-  map<ResourceId, RecordType *> m_ResourceRecords;
+  ConcurrentHashMap<ResourceId, RecordType *> m_ResourceRecords;
 
   // used during replay - holds current resource replacements
-  map<ResourceId, ResourceId> m_Replacements;
+  ConcurrentHashMap<ResourceId, ResourceId> m_Replacements;
 };
 
 template <typename Configuration>
@@ -507,7 +633,7 @@ void ResourceManager<Configuration>::Shutdown()
       m_LiveResourceMap.erase(removeit);
   }
 
-  RDCASSERT(m_ResourceRecords.empty());
+  RDCASSERT(m_ResourceRecords.Empty());
 }
 
 template <typename Configuration>
@@ -515,7 +641,7 @@ ResourceManager<Configuration>::~ResourceManager()
 {
   RDCASSERT(m_LiveResourceMap.empty());
   RDCASSERT(m_InitialContents.empty());
-  RDCASSERT(m_ResourceRecords.empty());
+  RDCASSERT(m_ResourceRecords.Empty());
 
   if(RenderDoc::Inst().GetCrashHandler())
     RenderDoc::Inst().GetCrashHandler()->UnregisterMemoryRegion(this);
@@ -524,20 +650,51 @@ ResourceManager<Configuration>::~ResourceManager()
 template <typename Configuration>
 void ResourceManager<Configuration>::MarkResourceFrameReferenced(ResourceId id, FrameRefType refType)
 {
-  SCOPED_LOCK(m_Lock);
-
   if(id == ResourceId())
     return;
 
-  bool newRef = MarkReferenced(m_FrameReferencedResources, id, refType);
+  // the first time this thread references the resource, keep its record alive until the references
+  // are cleared. If another thread got there first the extra reference is dropped when merging.
+  RecordType *record = NULL;
 
-  if(newRef)
+  if(m_FrameRefLog.IsNewReference(id))
   {
-    RecordType *record = GetResourceRecord(id);
+    record = GetResourceRecord(id);
 
     if(record)
       record->AddRef();
   }
+
+  if(m_FrameRefLog.Log(id, refType, record))
+    MergeFrameReferences();
+}
+
+template <typename Configuration>
+void ResourceManager<Configuration>::MergeFrameReferences()
+{
+  SCOPED_LOCK(m_Lock);
+
+  std::vector<FrameRefLog::Entry> entries;
+  m_FrameRefLog.Drain(entries);
+
+  for(const FrameRefLog::Entry &entry : entries)
+  {
+    bool newRef = MarkReferenced(m_FrameReferencedResources, entry.id, entry.refType);
+
+    if(newRef && entry.record == NULL)
+    {
+      // logged after the references were cleared, but by a thread that hadn't noticed yet
+      RecordType *record = GetResourceRecord(entry.id);
+
+      if(record)
+        record->AddRef();
+    }
+    else if(!newRef && entry.record)
+    {
+      // already holding a reference from an earlier entry
+      entry.record->Delete(this);
+    }
+  }
 }
 
 template <typename Configuration>
@@ -677,6 +834,8 @@ void ResourceManager<Configuration>::Serialise_InitialContentsNeeded(WriteSerial
 
   SCOPED_LOCK(m_Lock);
 
+  MergeFrameReferences();
+
   std::vector<WrittenRecord> WrittenRecords;
 
   // reasonable estimate, and these records are small
@@ -797,27 +956,46 @@ void ResourceManager<Configuration>::MarkUnwrittenResources()
 {
   SCOPED_LOCK(m_Lock);
 
-  for(auto it = m_ResourceRecords.begin(); it != m_ResourceRecords.end(); ++it)
+  for(auto &it : m_ResourceRecords.Snapshot())
+  {
+    it.second->MarkDataUnwritten();
+  }
+}
+
+template <typename Configuration>
+void ResourceManager<Configuration>::DetachChunksFromArena()
+{
+  // nothing to do if every page was freed with the frame
+  if(ChunkAllocator::NumLivePages() == 0)
+    return;
+
+  SCOPED_LOCK(m_Lock);
+
+  for(auto &it : m_ResourceRecords.Snapshot())
   {
-    it->second->MarkDataUnwritten();
+    it.second->DetachChunksFromArena();
   }
 }
 
 template <typename Configuration>
 void ResourceManager<Configuration>::InsertReferencedChunks(WriteSerialiser &ser)
 {
-  map<int32_t, Chunk *> sortedChunks;
+  ChunkMergeList recordlist;
 
   SCOPED_LOCK(m_Lock);
 
+  MergeFrameReferences();
+
   RDCDEBUG("%u frame resource records", (uint32_t)m_FrameReferencedResources.size());
 
   if(RenderDoc::Inst().GetCaptureOptions().refAllResources)
   {
-    float num = float(m_ResourceRecords.size());
+    std::vector<std::pair<ResourceId, RecordType *>> records = m_ResourceRecords.SortedSnapshot();
+
+    float num = float(records.size());
     float idx = 0.0f;
 
-    for(auto it = m_ResourceRecords.begin(); it != m_ResourceRecords.end(); ++it)
+    for(auto it = records.begin(); it != records.end(); ++it)
     {
       RenderDoc::Inst().SetProgress(CaptureProgress::AddReferencedResources, idx / num);
       idx += 1.0f;
@@ -826,7 +1004,7 @@ void ResourceManager<Configuration>::InsertReferencedChunks(WriteSerialiser &ser
          it->second->InternalResource)
         continue;
 
-      it->second->Insert(sortedChunks);
+      it->second->Insert(recordlist);
     }
   }
   else
@@ -841,14 +1019,17 @@ void ResourceManager<Configuration>::InsertReferencedChunks(WriteSerialiser &ser
 
       RecordType *record = GetResourceRecord(it->first);
       if(record)
-        record->Insert(sortedChunks);
+        record->Insert(recordlist);
     }
   }
 
+  std::vector<Chunk *> sortedChunks;
+  recordlist.Merge(sortedChunks);
+
   RDCDEBUG("%u frame resource chunks", (uint32_t)sortedChunks.size());
 
-  for(auto it = sortedChunks.begin(); it != sortedChunks.end(); it++)
-    it->second->Write(ser);
+  for(Chunk *chunk : sortedChunks)
+    chunk->Write(ser);
 
   RDCDEBUG("inserted to serialiser");
 }
@@ -858,6 +1039,8 @@ void ResourceManager<Configuration>::PrepareInitialContents()
 {
   SCOPED_LOCK(m_Lock);
 
+  MergeFrameReferences();
+
   RDCDEBUG("Preparing up to %u potentially dirty resources", (uint32_t)m_DirtyResources.size());
   uint32_t prepared = 0;
 
@@ -893,15 +1076,15 @@ void ResourceManager<Configuration>::PrepareInitialContents()
 
   prepared = 0;
 
-  for(auto it = m_CurrentResourceMap.begin(); it != m_CurrentResourceMap.end(); ++it)
+  for(auto &it : m_CurrentResourceMap.SortedSnapshot())
   {
-    if(it->second == (WrappedResourceType)RecordType::NullResource)
+    if(it.second == (WrappedResourceType)RecordType::NullResource)
       continue;
 
-    if(Force_InitialState(it->second, true))
+    if(Force_InitialState(it.second, true))
     {
       prepared++;
-      Prepare_InitialState(it->second);
+      Prepare_InitialState(it.second);
     }
   }
 
@@ -913,6 +1096,8 @@ void ResourceManager<Configuration>::InsertInitialContentsChunks(WriteSerialiser
 {
   SCOPED_LOCK(m_Lock);
 
+  MergeFrameReferences();
+
   uint32_t dirty = 0;
   uint32_t skipped = 0;
 
@@ -1003,16 +1188,16 @@ void ResourceManager<Configuration>::InsertInitialContentsChunks(WriteSerialiser
 
   dirty = 0;
 
-  for(auto it = m_CurrentResourceMap.begin(); it != m_CurrentResourceMap.end(); ++it)
+  for(auto &it : m_CurrentResourceMap.SortedSnapshot())
   {
-    if(it->second == (WrappedResourceType)RecordType::NullResource)
+    if(it.second == (WrappedResourceType)RecordType::NullResource)
       continue;
 
-    if(Force_InitialState(it->second, false))
+    if(Force_InitialState(it.second, false))
     {
       dirty++;
 
-      auto preparedChunk = m_InitialChunks.find(it->first);
+      auto preparedChunk = m_InitialChunks.find(it.first);
       if(preparedChunk != m_InitialChunks.end())
       {
         preparedChunk->second->Write(ser);
@@ -1020,11 +1205,11 @@ void ResourceManager<Configuration>::InsertInitialContentsChunks(WriteSerialiser
       }
       else
       {
-        uint32_t size = GetSize_InitialState(it->first, it->second);
+        uint32_t size = GetSize_InitialState(it.first, it.second);
 
         SCOPED_SERIALISE_CHUNK(SystemChunk::InitialContents, size);
 
-        Serialise_InitialState(ser, it->first, it->second);
+        Serialise_InitialState(ser, it.first, it.second);
       }
     }
   }
@@ -1044,6 +1229,8 @@ void ResourceManager<Configuration>::ApplyInitialContentsNonChunks(WriteSerialis
 {
   SCOPED_LOCK(m_Lock);
 
+  MergeFrameReferences();
+
   for(auto it = m_DirtyResources.begin(); it != m_DirtyResources.end(); ++it)
   {
     ResourceId id = *it;
@@ -1078,6 +1265,8 @@ void ResourceManager<Configuration>::ClearReferencedResources()
 {
   SCOPED_LOCK(m_Lock);
 
+  MergeFrameReferences();
+
   for(auto it = m_FrameReferencedResources.begin(); it != m_FrameReferencedResources.end(); ++it)
   {
     RecordType *record = GetResourceRecord(it->first);
@@ -1087,6 +1276,7 @@ void ResourceManager<Configuration>::ClearReferencedResources()
   }
 
   m_FrameReferencedResources.clear();
+  m_FrameRefLog.Reset();
 }
 
 template <typename Configuration>
@@ -1095,74 +1285,51 @@ void ResourceManager<Configuration>::ReplaceResource(ResourceId from, ResourceId
   SCOPED_LOCK(m_Lock);
 
   if(HasLiveResource(to))
-    m_Replacements[from] = to;
+    m_Replacements.Set(from, to);
 }
 
 template <typename Configuration>
 bool ResourceManager<Configuration>::HasReplacement(ResourceId from)
 {
-  SCOPED_LOCK(m_Lock);
-
-  return m_Replacements.find(from) != m_Replacements.end();
+  return m_Replacements.Contains(from);
 }
 
 template <typename Configuration>
 void ResourceManager<Configuration>::RemoveReplacement(ResourceId id)
 {
-  SCOPED_LOCK(m_Lock);
-
-  auto it = m_Replacements.find(id);
-
-  if(it == m_Replacements.end())
-    return;
-
-  m_Replacements.erase(it);
+  m_Replacements.Erase(id);
 }
 
 template <typename Configuration>
 typename Configuration::RecordType *ResourceManager<Configuration>::GetResourceRecord(ResourceId id)
 {
-  SCOPED_LOCK(m_Lock);
-
-  auto it = m_ResourceRecords.find(id);
-
-  if(it == m_ResourceRecords.end())
-    return NULL;
-
-  return it->second;
+  RecordType *ret = NULL;
+  m_ResourceRecords.Find(id, ret);
+  return ret;
 }
 
 template <typename Configuration>
 bool ResourceManager<Configuration>::HasResourceRecord(ResourceId id)
 {
-  SCOPED_LOCK(m_Lock);
-
-  auto it = m_ResourceRecords.find(id);
-
-  if(it == m_ResourceRecords.end())
-    return false;
-
-  return true;
+  return m_ResourceRecords.Contains(id);
 }
 
 template <typename Configuration>
 typename Configuration::RecordType *ResourceManager<Configuration>::AddResourceRecord(ResourceId id)
 {
-  SCOPED_LOCK(m_Lock);
+  RecordType *ret = new RecordType(id);
 
-  RDCASSERT(m_ResourceRecords.find(id) == m_ResourceRecords.end(), id);
+  bool existed = m_ResourceRecords.Set(id, ret);
+  RDCASSERT(!existed, id);
 
-  return (m_ResourceRecords[id] = new RecordType(id));
+  return ret;
 }
 
 template <typename Configuration>
 void ResourceManager<Configuration>::RemoveResourceRecord(ResourceId id)
 {
-  SCOPED_LOCK(m_Lock);
-
-  RDCASSERT(m_ResourceRecords.find(id) != m_ResourceRecords.end(), id);
-
-  m_ResourceRecords.erase(id);
+  bool existed = m_ResourceRecords.Erase(id);
+  RDCASSERT(existed, id);
 }
 
 template <typename Configuration>
@@ -1174,8 +1341,6 @@ void ResourceManager<Configuration>::DestroyResourceRecord(ResourceRecord *recor
 template <typename Configuration>
 bool ResourceManager<Configuration>::AddWrapper(WrappedResourceType wrap, RealResourceType real)
 {
-  SCOPED_LOCK(m_Lock);
-
   bool ret = true;
 
   if(wrap == (WrappedResourceType)RecordType::NullResource ||
@@ -1185,60 +1350,52 @@ bool ResourceManager<Configuration>::AddWrapper(WrappedResourceType wrap, RealRe
     ret = false;
   }
 
-  if(m_WrapperMap[real] != (WrappedResourceType)RecordType::NullResource)
+  if(m_WrapperMap.Set(real, wrap))
   {
     RDCERR("Overriding wrapper for resource");
     ret = false;
   }
 
-  m_WrapperMap[real] = wrap;
-
   return ret;
 }
 
 template <typename Configuration>
 void ResourceManager<Configuration>::RemoveWrapper(RealResourceType real)
 {
-  SCOPED_LOCK(m_Lock);
-
-  if(real == (RealResourceType)RecordType::NullResource || !HasWrapper(real))
+  if(real == (RealResourceType)RecordType::NullResource || !m_WrapperMap.Erase(real))
   {
     RDCERR(
         "Invalid state removing resource wrapper - real resource is NULL or doesn't have wrapper");
     return;
   }
-
-  m_WrapperMap.erase(m_WrapperMap.find(real));
 }
 
 template <typename Configuration>
 bool ResourceManager<Configuration>::HasWrapper(RealResourceType real)
 {
-  SCOPED_LOCK(m_Lock);
-
   if(real == (RealResourceType)RecordType::NullResource)
     return false;
 
-  return (m_WrapperMap.find(real) != m_WrapperMap.end());
+  return m_WrapperMap.Contains(real);
 }
 
 template <typename Configuration>
 typename Configuration::WrappedResourceType ResourceManager<Configuration>::GetWrapper(
     RealResourceType real)
 {
-  SCOPED_LOCK(m_Lock);
+  WrappedResourceType ret = (WrappedResourceType)RecordType::NullResource;
 
   if(real == (RealResourceType)RecordType::NullResource)
-    return (WrappedResourceType)RecordType::NullResource;
+    return ret;
 
-  if(real != (RealResourceType)RecordType::NullResource && !HasWrapper(real))
+  if(!m_WrapperMap.Find(real, ret))
   {
     RDCERR(
         "Invalid state removing resource wrapper - real resource isn't NULL and doesn't have "
         "wrapper");
   }
 
-  return m_WrapperMap[real];
+  return ret;
 }
 
 template <typename Configuration>
@@ -1251,8 +1408,8 @@ void ResourceManager<Configuration>::AddLiveResource(ResourceId origid, WrappedR
     RDCERR("Invalid state adding resource mapping - id is invalid or live pointer is NULL");
   }
 
-  m_OriginalIDs[GetID(livePtr)] = origid;
-  m_LiveIDs[origid] = GetID(livePtr);
+  m_OriginalIDs.Set(GetID(livePtr), origid);
+  m_LiveIDs.Set(origid, GetID(livePtr));
 
   if(m_LiveResourceMap.find(origid) != m_LiveResourceMap.end())
   {
@@ -1272,7 +1429,7 @@ bool ResourceManager<Configuration>::HasLiveResource(ResourceId origid)
   if(origid == ResourceId())
     return false;
 
-  return (m_Replacements.find(origid) != m_Replacements.end() ||
+  return (m_Replacements.Contains(origid) ||
           m_LiveResourceMap.find(origid) != m_LiveResourceMap.end());
 }
 
@@ -1287,8 +1444,9 @@ typename Configuration::WrappedResourceType ResourceManager<Configuration>::GetL
 
   RDCASSERT(HasLiveResource(origid), origid);
 
-  if(m_Replacements.find(origid) != m_Replacements.end())
-    return GetLiveResource(m_Replacements[origid]);
+  ResourceId replacement;
+  if(m_Replacements.Find(origid, replacement))
+    return GetLiveResource(replacement);
 
   if(m_LiveResourceMap.find(origid) != m_LiveResourceMap.end())
     return m_LiveResourceMap[origid];
@@ -1309,43 +1467,39 @@ void ResourceManager<Configuration>::EraseLiveResource(ResourceId origid)
 template <typename Configuration>
 void ResourceManager<Configuration>::AddCurrentResource(ResourceId id, WrappedResourceType res)
 {
-  SCOPED_LOCK(m_Lock);
-
-  RDCASSERT(m_CurrentResourceMap.find(id) == m_CurrentResourceMap.end(), id);
-  m_CurrentResourceMap[id] = res;
+  bool existed = m_CurrentResourceMap.Set(id, res);
+  RDCASSERT(!existed, id);
 }
 
 template <typename Configuration>
 bool ResourceManager<Configuration>::HasCurrentResource(ResourceId id)
 {
-  SCOPED_LOCK(m_Lock);
-
-  return m_CurrentResourceMap.find(id) != m_CurrentResourceMap.end();
+  return m_CurrentResourceMap.Contains(id);
 }
 
 template <typename Configuration>
 typename Configuration::WrappedResourceType ResourceManager<Configuration>::GetCurrentResource(
     ResourceId id)
 {
-  SCOPED_LOCK(m_Lock);
+  WrappedResourceType ret = (WrappedResourceType)RecordType::NullResource;
 
   if(id == ResourceId())
-    return (WrappedResourceType)RecordType::NullResource;
+    return ret;
 
-  if(m_Replacements.find(id) != m_Replacements.end())
-    return GetCurrentResource(m_Replacements[id]);
+  ResourceId replacement;
+  if(m_Replacements.Find(id, replacement))
+    return GetCurrentResource(replacement);
 
-  RDCASSERT(m_CurrentResourceMap.find(id) != m_CurrentResourceMap.end(), id);
-  return m_CurrentResourceMap[id];
+  bool found = m_CurrentResourceMap.Find(id, ret);
+  RDCASSERT(found, id);
+  return ret;
 }
 
 template <typename Configuration>
 void ResourceManager<Configuration>::ReleaseCurrentResource(ResourceId id)
 {
-  SCOPED_LOCK(m_Lock);
-
-  RDCASSERT(m_CurrentResourceMap.find(id) != m_CurrentResourceMap.end(), id);
-  m_CurrentResourceMap.erase(id);
+  bool existed = m_CurrentResourceMap.Erase(id);
+  RDCASSERT(existed, id);
 }
 
 template <typename Configuration>
@@ -1354,8 +1508,10 @@ ResourceId ResourceManager<Configuration>::GetOriginalID(ResourceId id)
   if(id == ResourceId())
     return id;
 
-  RDCASSERT(m_OriginalIDs.find(id) != m_OriginalIDs.end(), id);
-  return m_OriginalIDs[id];
+  ResourceId ret;
+  bool found = m_OriginalIDs.Find(id, ret);
+  RDCASSERT(found, id);
+  return ret;
 }
 
 template <typename Configuration>
@@ -1364,6 +1520,8 @@ ResourceId ResourceManager<Configuration>::GetLiveID(ResourceId id)
   if(id == ResourceId())
     return id;
 
-  RDCASSERT(m_LiveIDs.find(id) != m_LiveIDs.end(), id);
-  return m_LiveIDs[id];
+  ResourceId ret;
+  bool found = m_LiveIDs.Find(id, ret);
+  RDCASSERT(found, id);
+  return ret;
 }
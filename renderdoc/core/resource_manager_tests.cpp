@@ -0,0 +1,591 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017-2018 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "resource_manager.h"
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "3rdparty/catch/catch.hpp"
+
+// a minimal resource manager where the wrapped and real resources are just pointers, the wrapped
+// one pointing at the resource's ID.
+struct TestResourceRecord : public ResourceRecord
+{
+  enum
+  {
+    NullResource = 0
+  };
+
+  TestResourceRecord(ResourceId id) : ResourceRecord(id, true) {}
+};
+
+struct TestInitialContents
+{
+  template <typename Configuration>
+  void Free(ResourceManager<Configuration> *rm)
+  {
+  }
+};
+
+struct TestResourceManagerConfiguration
+{
+  typedef ResourceId *WrappedResourceType;
+  typedef void *RealResourceType;
+  typedef TestResourceRecord RecordType;
+  typedef TestInitialContents InitialContentData;
+};
+
+class TestResourceManager : public ResourceManager<TestResourceManagerConfiguration>
+{
+public:
+  ~TestResourceManager() { Shutdown(); }
+  std::map<ResourceId, FrameRefType> GetFrameReferences()
+  {
+    MergeFrameReferences();
+
+    SCOPED_LOCK(m_Lock);
+    return m_FrameReferencedResources;
+  }
+
+private:
+  ResourceId GetID(ResourceId *res) { return res ? *res : ResourceId(); }
+  bool ResourceTypeRelease(ResourceId *res) { return true; }
+  bool Force_InitialState(ResourceId *res, bool prepare) { return false; }
+  bool Need_InitialStateChunk(ResourceId *res) { return false; }
+  bool Prepare_InitialState(ResourceId *res) { return false; }
+  uint32_t GetSize_InitialState(ResourceId id, ResourceId *res) { return 0; }
+  bool Serialise_InitialState(WriteSerialiser &ser, ResourceId id, ResourceId *res)
+  {
+    return false;
+  }
+  void Create_InitialState(ResourceId id, ResourceId *live, bool hasData) {}
+  void Apply_InitialState(ResourceId *live, TestInitialContents initial) {}
+};
+
+struct TestResources
+{
+  TestResources(TestResourceManager &rm, size_t count) : m_RM(rm)
+  {
+    ids.resize(count);
+    reals.resize(count);
+
+    for(size_t i = 0; i < count; i++)
+    {
+      ids[i] = ResourceIDGen::GetNewUniqueID();
+      reals[i] = &reals[i];
+
+      rm.AddResourceRecord(ids[i]);
+      rm.AddCurrentResource(ids[i], &ids[i]);
+      rm.AddWrapper(&ids[i], reals[i]);
+    }
+  }
+
+  ~TestResources()
+  {
+    for(size_t i = 0; i < ids.size(); i++)
+    {
+      m_RM.RemoveWrapper(reals[i]);
+      m_RM.ReleaseCurrentResource(ids[i]);
+      m_RM.GetResourceRecord(ids[i])->Delete(&m_RM);
+    }
+  }
+
+  std::vector<ResourceId> ids;
+  std::vector<void *> reals;
+
+private:
+  TestResourceManager &m_RM;
+};
+
+TEST_CASE("Test concurrent hash map", "[threading][resourcemanager]")
+{
+  ConcurrentHashMap<uint32_t, uint32_t> map;
+
+  CHECK(map.Empty());
+
+  for(uint32_t i = 0; i < 1000; i++)
+    CHECK_FALSE(map.Set(i, i * 2));
+
+  CHECK(map.Size() == 1000);
+  CHECK(map.Set(10, 999));
+
+  uint32_t val = 0;
+  CHECK(map.Find(10, val));
+  CHECK(val == 999);
+  CHECK(map.Find(500, val));
+  CHECK(val == 1000);
+  CHECK_FALSE(map.Find(1000, val));
+
+  CHECK(map.Erase(500));
+  CHECK_FALSE(map.Erase(500));
+  CHECK_FALSE(map.Contains(500));
+  CHECK(map.Contains(501));
+
+  std::vector<std::pair<uint32_t, uint32_t>> contents = map.Snapshot();
+  CHECK(contents.size() == 999);
+
+  // the sorted snapshot is in key order regardless of which shards the keys landed in
+  std::vector<std::pair<uint32_t, uint32_t>> sorted = map.SortedSnapshot();
+  REQUIRE(sorted.size() == 999);
+  for(size_t i = 0; i + 1 < sorted.size(); i++)
+    CHECK(sorted[i].first < sorted[i + 1].first);
+  CHECK(sorted[10].first == 10);
+  CHECK(sorted[10].second == 999);
+
+  map.Clear();
+  CHECK(map.Empty());
+};
+
+TEST_CASE("Test resource lookups while resources are added and removed", "[resourcemanager]")
+{
+  TestResourceManager rm;
+
+  {
+    TestResources persistent(rm, 1000);
+
+    volatile int32_t finished = 0;
+    volatile int32_t errors = 0;
+
+    std::vector<Threading::ThreadHandle> threads;
+
+    for(int t = 0; t < 4; t++)
+    {
+      threads.push_back(Threading::CreateThread([&rm, &persistent, &finished, &errors, t]() {
+        uint32_t i = t;
+        while(Atomic::CmpExch32(&finished, 0, 0) == 0)
+        {
+          size_t idx = (i++ * 7919) % persistent.ids.size();
+
+          ResourceId id = persistent.ids[idx];
+
+          if(rm.GetWrapper(persistent.reals[idx]) != &persistent.ids[idx] ||
+             rm.GetCurrentResource(id) != &persistent.ids[idx] ||
+             rm.GetResourceRecord(id)->GetResourceID() != id)
+            Atomic::Inc32(&errors);
+        }
+      }));
+    }
+
+    // churn other resources in the same tables while the lookups are happening
+    for(int i = 0; i < 50; i++)
+      TestResources temp(rm, 200);
+
+    Atomic::Inc32(&finished);
+
+    for(Threading::ThreadHandle t : threads)
+    {
+      Threading::JoinThread(t);
+      Threading::CloseThread(t);
+    }
+
+    CHECK(errors == 0);
+  }
+
+  CHECK_FALSE(rm.HasResourceRecord(ResourceIDGen::GetNewUniqueID()));
+};
+
+TEST_CASE("Test frame references from multiple threads", "[resourcemanager]")
+{
+  TestResourceManager rm;
+
+  const uint32_t numThreads = 4;
+  const uint32_t resourcesPerThread = 100;
+  // enough references that each thread's log is drained while it's still referencing
+  const uint32_t refsPerThread = 100000;
+
+  TestResources shared(rm, 10);
+  TestResources owned(rm, numThreads * resourcesPerThread);
+
+  // the order of references between threads is arbitrary, so each thread writes to its own
+  // resources and only reads the shared ones. Then the expected result is just each thread's
+  // references applied in order.
+  std::vector<std::map<ResourceId, FrameRefType>> expected(numThreads);
+
+  std::vector<Threading::ThreadHandle> threads;
+
+  for(uint32_t t = 0; t < numThreads; t++)
+  {
+    threads.push_back(Threading::CreateThread([&rm, &shared, &owned, &expected, t]() {
+      const FrameRefType types[] = {eFrameRef_Unknown, eFrameRef_Read, eFrameRef_Write,
+                                    eFrameRef_ReadBeforeWrite};
+
+      for(uint32_t i = 0; i < refsPerThread; i++)
+      {
+        if((i % 10) == 0)
+        {
+          rm.MarkResourceFrameReferenced(shared.ids[(i / 10) % shared.ids.size()], eFrameRef_Read);
+          continue;
+        }
+
+        ResourceId id = owned.ids[t * resourcesPerThread + (i * 7919) % resourcesPerThread];
+        // mostly reads, so that a write changes the final state
+        FrameRefType refType = types[(i % 13) == 0 ? 2 : ((i % 37) == 0 ? 3 : (i % 2))];
+
+        rm.MarkResourceFrameReferenced(id, refType);
+        MarkReferenced(expected[t], id, refType);
+      }
+    }));
+  }
+
+  for(Threading::ThreadHandle t : threads)
+  {
+    Threading::JoinThread(t);
+    Threading::CloseThread(t);
+  }
+
+  std::map<ResourceId, FrameRefType> refs = rm.GetFrameReferences();
+
+  size_t expectedCount = shared.ids.size();
+  for(uint32_t t = 0; t < numThreads; t++)
+  {
+    expectedCount += expected[t].size();
+
+    for(auto it = expected[t].begin(); it != expected[t].end(); ++it)
+      CHECK((refs[it->first] == it->second));
+  }
+
+  for(ResourceId id : shared.ids)
+    CHECK((refs[id] == eFrameRef_ReadOnly));
+
+  CHECK(refs.size() == expectedCount);
+
+  // each referenced record holds exactly one reference for the frame, however many threads
+  // referenced it
+  for(auto it = refs.begin(); it != refs.end(); ++it)
+    CHECK(rm.GetResourceRecord(it->first)->GetRefCount() == 2);
+
+  rm.ClearReferencedResources();
+
+  for(auto it = refs.begin(); it != refs.end(); ++it)
+    CHECK(rm.GetResourceRecord(it->first)->GetRefCount() == 1);
+
+  CHECK(rm.GetFrameReferences().empty());
+
+  // references after clearing take a new record reference, even from a thread that referenced the
+  // resource before
+  rm.MarkResourceFrameReferenced(shared.ids[0], eFrameRef_Write);
+  rm.MarkResourceFrameReferenced(shared.ids[0], eFrameRef_Read);
+
+  refs = rm.GetFrameReferences();
+  CHECK(refs.size() == 1);
+  CHECK((refs[shared.ids[0]] == eFrameRef_ReadAndWrite));
+  CHECK(rm.GetResourceRecord(shared.ids[0])->GetRefCount() == 2);
+
+  rm.ClearReferencedResources();
+};
+
+TEST_CASE("Test frame reference logs of exited threads", "[resourcemanager]")
+{
+  const uint32_t numThreads = 8;
+  const uint32_t refsPerThread = 1000;
+
+  FrameRefLog logA, logB;
+
+  std::vector<ResourceId> ids(numThreads);
+  for(ResourceId &id : ids)
+    id = ResourceIDGen::GetNewUniqueID();
+
+  std::vector<Threading::ThreadHandle> threads;
+
+  for(uint32_t t = 0; t < numThreads; t++)
+  {
+    threads.push_back(Threading::CreateThread([&logA, &logB, &ids, t]() {
+      for(uint32_t i = 0; i < refsPerThread; i++)
+        logA.Log(ids[t], eFrameRef_Read, NULL);
+
+      logB.Log(ids[t], eFrameRef_Write, NULL);
+    }));
+  }
+
+  for(Threading::ThreadHandle t : threads)
+  {
+    Threading::JoinThread(t);
+    Threading::CloseThread(t);
+  }
+
+  CHECK(logA.NumThreadLogs() == numThreads);
+  CHECK(logB.NumThreadLogs() == numThreads);
+
+  // every entry logged before a thread exited is drained, and the thread's log is then freed
+  std::vector<FrameRefLog::Entry> entries;
+  logA.Drain(entries);
+
+  CHECK(entries.size() == numThreads * refsPerThread);
+  CHECK(logA.NumThreadLogs() == 0);
+
+  std::map<ResourceId, uint32_t> counts;
+  for(const FrameRefLog::Entry &e : entries)
+  {
+    counts[e.id]++;
+    CHECK((e.refType == eFrameRef_Read));
+  }
+
+  for(ResourceId id : ids)
+    CHECK(counts[id] == refsPerThread);
+
+  // the logs share a TLS slot, but each only sees its own entries
+  entries.clear();
+  logB.Drain(entries);
+
+  CHECK(entries.size() == numThreads);
+  CHECK(logB.NumThreadLogs() == 0);
+
+  for(const FrameRefLog::Entry &e : entries)
+    CHECK((e.refType == eFrameRef_Write));
+
+  // a live thread keeps its log, and logs to a destroyed FrameRefLog don't leak into a new one
+  {
+    FrameRefLog logC;
+    logC.Log(ids[0], eFrameRef_Read, NULL);
+    CHECK(logC.NumThreadLogs() == 1);
+  }
+
+  FrameRefLog logD;
+  logD.Log(ids[1], eFrameRef_Write, NULL);
+
+  entries.clear();
+  logD.Drain(entries);
+
+  REQUIRE(entries.size() == 1);
+  CHECK(entries[0].id == ids[1]);
+  CHECK(logD.NumThreadLogs() == 1);
+};
+
+TEST_CASE("Test merging record chunk lists in ID order", "[resourcemanager]")
+{
+  // the chunks are never dereferenced, so use the ID as a fake pointer to check the order
+  typedef std::vector<std::pair<int32_t, Chunk *>> ChunkList;
+
+  auto makeList = [](std::vector<int32_t> ids) {
+    ChunkList ret;
+    for(int32_t id : ids)
+      ret.push_back(std::make_pair(id, (Chunk *)(uintptr_t)id));
+    return ret;
+  };
+
+  auto mergedIDs = [](ChunkMergeList &list) {
+    std::vector<Chunk *> chunks;
+    list.Merge(chunks);
+
+    std::vector<int32_t> ret;
+    for(Chunk *c : chunks)
+      ret.push_back((int32_t)(uintptr_t)c);
+    return ret;
+  };
+
+  ChunkMergeList list;
+
+  SECTION("Empty")
+  {
+    list.Add(ChunkList());
+
+    CHECK(list.NumChunks() == 0);
+    CHECK(mergedIDs(list).empty());
+  };
+
+  SECTION("Single list")
+  {
+    list.Add(makeList({3, 5, 9, 10}));
+
+    CHECK((mergedIDs(list) == std::vector<int32_t>({3, 5, 9, 10})));
+  };
+
+  SECTION("Interleaved lists")
+  {
+    list.Add(makeList({1, 4, 5, 6, 20}));
+    list.Add(ChunkList());
+    list.Add(makeList({2, 3, 7, 8, 9, 10}));
+    list.Add(makeList({11, 12, 13}));
+    list.Add(makeList({14}));
+
+    CHECK(list.NumChunks() == 15);
+    CHECK((mergedIDs(list) ==
+           std::vector<int32_t>({1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 20})));
+  };
+
+  SECTION("Unsorted list")
+  {
+    list.Add(makeList({2, 9, 4}));
+    list.Add(makeList({1, 3, 10}));
+
+    CHECK((mergedIDs(list) == std::vector<int32_t>({1, 2, 3, 4, 9, 10})));
+  };
+
+  SECTION("Duplicate IDs")
+  {
+    list.Add(makeList({1, 2, 5}));
+    list.Add(makeList({2, 5, 6}));
+
+    CHECK((mergedIDs(list) == std::vector<int32_t>({1, 2, 5, 6})));
+  };
+
+  SECTION("Many lists")
+  {
+    // IDs handed out round-robin across lists, with some lists taking a long stretch in a row
+    std::vector<ChunkList> lists(17);
+    int32_t id = 1;
+    for(int32_t i = 0; i < 2000; i++)
+    {
+      ChunkList &l = lists[(i * 7 + i / 100) % lists.size()];
+      int32_t stretch = (i % 13 == 0) ? 20 : 1;
+      for(int32_t s = 0; s < stretch; s++, id++)
+        l.push_back(std::make_pair(id, (Chunk *)(uintptr_t)id));
+    }
+
+    for(const ChunkList &l : lists)
+      list.Add(l);
+
+    std::vector<int32_t> merged = mergedIDs(list);
+
+    CHECK(merged.size() == size_t(id - 1));
+
+    bool ordered = true;
+    for(size_t i = 0; i < merged.size(); i++)
+      ordered &= (merged[i] == int32_t(i + 1));
+    CHECK(ordered);
+  };
+};
+
+TEST_CASE("Test handing record chunks to a pending capture", "[resourcemanager]")
+{
+  const uint64_t baseChunks = Chunk::NumLiveChunks();
+
+  WriteSerialiser ser(new StreamWriter(StreamWriter::DefaultScratchSize), Ownership::Stream);
+
+  auto makeChunk = [&ser](uint32_t value) {
+    SCOPED_SERIALISE_CHUNK(1);
+    SERIALISE_ELEMENT(value);
+    return scope.Get();
+  };
+
+  // the frame's record is discarded after the capture, the other record lives on
+  TestResourceRecord frame(ResourceIDGen::GetNewUniqueID());
+  TestResourceRecord kept(ResourceIDGen::GetNewUniqueID());
+
+  Chunk *first = makeChunk(1);
+  Chunk *second = makeChunk(2);
+  Chunk *third = makeChunk(3);
+  // has the same ID as second so is dropped by the merge
+  Chunk *dropped = makeChunk(4);
+
+  frame.AddChunk(first, 1);
+  kept.AddChunk(second, 2);
+  frame.AddChunk(dropped, 2);
+  frame.AddChunk(third, 3);
+
+  ChunkMergeList recordlist;
+  kept.Insert(recordlist);
+  frame.Insert(recordlist);
+
+  std::vector<Chunk *> sortedChunks;
+  recordlist.Merge(sortedChunks);
+
+  REQUIRE(sortedChunks.size() == 3);
+
+  {
+    PendingCapture capture;
+
+    std::vector<Chunk *> released;
+    frame.ReleaseChunks(released);
+
+    CHECK(frame.NumChunks() == 0);
+    CHECK(released.size() == 3);
+
+    capture.AddFrameChunks(sortedChunks, released);
+
+    CHECK(released.empty());
+    REQUIRE(capture.frameChunks.size() == 3);
+
+    // released chunks are taken as-is, the kept record's chunk is copied
+    CHECK(capture.frameChunks[0] == first);
+    CHECK(capture.frameChunks[1] != second);
+    CHECK(capture.frameChunks[2] == third);
+
+    REQUIRE(capture.frameChunks[1]->GetLength() == second->GetLength());
+    CHECK(memcmp(capture.frameChunks[1]->GetData(), second->GetData(), second->GetLength()) == 0);
+
+    CHECK(capture.GetSize() == uint64_t(first->GetLength()) * 3);
+
+    // the dropped chunk has been freed already
+    CHECK(Chunk::NumLiveChunks() == baseChunks + 4);
+
+    CHECK(kept.NumChunks() == 1);
+  }
+
+  kept.DeleteChunks();
+
+  CHECK(Chunk::NumLiveChunks() == baseChunks);
+}
+
+TEST_CASE("Benchmark resource lookup throughput", "[.][benchmark][resourcemanager]")
+{
+  TestResourceManager rm;
+
+  TestResources resources(rm, 20000);
+
+  const uint32_t lookupsPerThread = 2000000;
+
+  for(uint32_t numThreads : {1U, 2U, 4U, 8U, 16U, 32U})
+  {
+    std::vector<Threading::ThreadHandle> threads;
+
+    volatile int32_t failed = 0;
+
+    PerformanceTimer timer;
+
+    for(uint32_t t = 0; t < numThreads; t++)
+    {
+      threads.push_back(Threading::CreateThread([&rm, &resources, &failed, t]() {
+        uint32_t idx = t * 1237;
+        for(uint32_t i = 0; i < lookupsPerThread; i += 2)
+        {
+          idx = (idx + 7919) % resources.ids.size();
+
+          if(rm.GetWrapper(resources.reals[idx]) == NULL ||
+             rm.GetResourceRecord(resources.ids[idx]) == NULL)
+            Atomic::Inc32(&failed);
+        }
+      }));
+    }
+
+    for(Threading::ThreadHandle t : threads)
+    {
+      Threading::JoinThread(t);
+      Threading::CloseThread(t);
+    }
+
+    double ms = timer.GetMilliseconds();
+
+    CHECK(failed == 0);
+
+    double totalLookups = double(lookupsPerThread) * numThreads;
+
+    RecordBenchmark(StringFormat::Fmt("%u threads", numThreads).c_str(),
+                    totalLookups / (ms * 1000.0), "M lookups/s");
+    RecordBenchmark(StringFormat::Fmt("%u threads per thread", numThreads).c_str(),
+                    totalLookups / (ms * 1000.0) / numThreads, "M lookups/s");
+  }
+};
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
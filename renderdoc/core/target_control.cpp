@@ -25,12 +25,13 @@
 
 #include "android/android.h"
 #include "api/replay/renderdoc_replay.h"
+#include "core/call_profiler.h"
 #include "core/core.h"
 #include "jpeg-compressor/jpgd.h"
 #include "os/os_specific.h"
 #include "serialise/serialiser.h"
 
-static const uint32_t TargetControlProtocolVersion = 4;
+static const uint32_t TargetControlProtocolVersion = 5;
 
 static bool IsProtocolVersionSupported(const uint32_t protocolVersion)
 {
@@ -42,6 +43,10 @@ static bool IsProtocolVersionSupported(const uint32_t protocolVersion)
   if(protocolVersion == 3)
     return true;
 
+  // 4 -> 5 added hooked call profiling packets
+  if(protocolVersion == 4)
+    return true;
+
   if(protocolVersion == TargetControlProtocolVersion)
     return true;
 
@@ -62,7 +67,9 @@ enum PacketType : uint32_t
   ePacket_NewChild,
   ePacket_CaptureProgress,
   ePacket_CycleActiveWindow,
-  ePacket_CapturableWindowCount
+  ePacket_CapturableWindowCount,
+  ePacket_SetCallProfiling,
+  ePacket_CallProfile,
 };
 
 DECLARE_REFLECTION_ENUM(PacketType);
@@ -85,6 +92,8 @@ std::string DoStringise(const PacketType &el)
     STRINGISE_ENUM_NAMED(ePacket_CaptureProgress, "Capture Progress");
     STRINGISE_ENUM_NAMED(ePacket_CycleActiveWindow, "Cycle Active Window");
     STRINGISE_ENUM_NAMED(ePacket_CapturableWindowCount, "Capturable Window Count");
+    STRINGISE_ENUM_NAMED(ePacket_SetCallProfiling, "Set Call Profiling");
+    STRINGISE_ENUM_NAMED(ePacket_CallProfile, "Call Profile");
   }
   END_ENUM_STRINGISE();
 }
@@ -140,6 +149,7 @@ void RenderDoc::TargetControlClientThread(uint32_t version, Network::Socket *cli
   std::map<RDCDriver, bool> drivers;
   float prevCaptureProgress = captureProgress;
   uint32_t prevWindows = 0;
+  bool callProfiling = false;
 
   while(client)
   {
@@ -346,6 +356,44 @@ void RenderDoc::TargetControlClientThread(uint32_t version, Network::Socket *cli
       {
         RenderDoc::Inst().CycleActiveWindow();
       }
+      else if(type == ePacket_SetCallProfiling)
+      {
+        bool enabled = false;
+
+        READ_DATA_SCOPE();
+        SERIALISE_ELEMENT(enabled);
+
+        callProfiling = enabled;
+        CallProfiler::SetEnabled(enabled);
+      }
+      else if(type == ePacket_CallProfile)
+      {
+        bool includeTrace = false;
+        bool reset = false;
+
+        {
+          READ_DATA_SCOPE();
+          SERIALISE_ELEMENT(includeTrace);
+          SERIALISE_ELEMENT(reset);
+        }
+
+        rdcarray<HookedCallProfile> calls = CallProfiler::GetProfile();
+        std::string trace;
+
+        // the target's filesystem may not be reachable from the client, so send the trace itself
+        if(includeTrace)
+          trace = CallProfiler::GetChromeTrace();
+
+        if(reset)
+          CallProfiler::Reset();
+
+        WRITE_DATA_SCOPE();
+        {
+          SCOPED_SERIALISE_CHUNK(ePacket_CallProfile);
+          SERIALISE_ELEMENT(calls);
+          SERIALISE_ELEMENT(trace);
+        }
+      }
 
       reader.EndChunk();
 
@@ -356,6 +404,10 @@ void RenderDoc::TargetControlClientThread(uint32_t version, Network::Socket *cli
 
   RenderDoc::Inst().SetProgressCallback<CaptureProgress>(RENDERDOC_ProgressCallback());
 
+  // don't leave the profiler's overhead behind once nobody can read it
+  if(callProfiling)
+    CallProfiler::SetEnabled(false);
+
   // give up our connection
   {
     SCOPED_LOCK(RenderDoc::Inst().m_SingleClientLock);
@@ -639,6 +691,35 @@ public:
       SAFE_DELETE(m_Socket);
   }
 
+  void SetCallProfiling(bool enabled)
+  {
+    if(m_Version < 5)
+      return;
+
+    WRITE_DATA_SCOPE();
+    SCOPED_SERIALISE_CHUNK(ePacket_SetCallProfiling);
+
+    SERIALISE_ELEMENT(enabled);
+
+    if(ser.IsErrored())
+      SAFE_DELETE(m_Socket);
+  }
+
+  void RequestCallProfile(bool includeTrace, bool reset)
+  {
+    if(m_Version < 5)
+      return;
+
+    WRITE_DATA_SCOPE();
+    SCOPED_SERIALISE_CHUNK(ePacket_CallProfile);
+
+    SERIALISE_ELEMENT(includeTrace);
+    SERIALISE_ELEMENT(reset);
+
+    if(ser.IsErrored())
+      SAFE_DELETE(m_Socket);
+  }
+
   TargetControlMessage ReceiveMessage(RENDERDOC_ProgressCallback progress)
   {
     TargetControlMessage msg;
@@ -825,6 +906,17 @@ public:
       reader.EndChunk();
       return msg;
     }
+    else if(type == ePacket_CallProfile)
+    {
+      msg.type = TargetControlMessageType::CallProfile;
+
+      READ_DATA_SCOPE();
+      SERIALISE_ELEMENT(msg.callProfile.calls).Named("Calls");
+      SERIALISE_ELEMENT(msg.callProfile.trace).Named("Trace");
+
+      reader.EndChunk();
+      return msg;
+    }
     else
     {
       RDCERR("Unexpected packed received: %d", type);
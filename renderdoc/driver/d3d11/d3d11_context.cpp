@@ -492,6 +492,11 @@ void WrappedID3D11DeviceContext::AttemptCapture()
     m_SuccessfulCapture = true;
     m_FailureReason = CaptureSucceeded;
 
+    // chunks recorded during the frame are all freed when it ends, so sub-allocate them. Deferred
+    // contexts can be recording on other threads so they're left alone.
+    if(GetType() == D3D11_DEVICE_CONTEXT_IMMEDIATE)
+      m_ScratchSerialiser.SetChunkArena(true);
+
     m_ContextRecord->LockChunks();
     while(m_ContextRecord->HasChunks())
     {
@@ -515,6 +520,9 @@ void WrappedID3D11DeviceContext::FinishCapture()
 
     m_SuccessfulCapture = false;
     m_FailureReason = CaptureSucceeded;
+
+    if(GetType() == D3D11_DEVICE_CONTEXT_IMMEDIATE)
+      m_ScratchSerialiser.SetChunkArena(false);
   }
 }
 
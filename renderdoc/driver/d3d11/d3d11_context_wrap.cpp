@@ -5108,7 +5108,7 @@ void WrappedID3D11DeviceContext::ExecuteCommandList(ID3D11CommandList *pCommandL
       RDCASSERT(cmdListRecord);
 
       // insert all the deferred chunks immediately following the execute chunk.
-      m_ContextRecord->AppendFrom(cmdListRecord);
+      m_ContextRecord->AppendFrom(cmdListRecord, m_ScratchSerialiser.GetChunkArena());
       cmdListRecord->AddResourceReferences(m_pDevice->GetResourceManager());
     }
 
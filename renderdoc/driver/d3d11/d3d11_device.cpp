@@ -1723,6 +1723,8 @@ bool WrappedID3D11Device::EndFrameCapture(void *dev, void *wnd)
       captureWriter = new StreamWriter(StreamWriter::InvalidStream);
     }
 
+    std::vector<uint64_t> chunkOffsets;
+
     {
       WriteSerialiser ser(captureWriter, Ownership::Stream);
 
@@ -1730,6 +1732,8 @@ bool WrappedID3D11Device::EndFrameCapture(void *dev, void *wnd)
 
       ser.SetUserData(GetResourceManager());
 
+      ser.SetChunkOffsetRecording(&chunkOffsets);
+
       {
         // remember to update this estimated chunk length if you add more parameters
         SCOPED_SERIALISE_CHUNK(SystemChunk::DriverInit, sizeof(D3D11InitParams) + 16);
@@ -1773,19 +1777,22 @@ bool WrappedID3D11Device::EndFrameCapture(void *dev, void *wnd)
 
         RDCDEBUG("Accumulating context resource list");
 
-        std::map<int32_t, Chunk *> recordlist;
+        ChunkMergeList recordlist;
         record->Insert(recordlist);
 
-        RDCDEBUG("Flushing %u records to file serialiser", (uint32_t)recordlist.size());
+        std::vector<Chunk *> sortedChunks;
+        recordlist.Merge(sortedChunks);
 
-        float num = float(recordlist.size());
+        RDCDEBUG("Flushing %u records to file serialiser", (uint32_t)sortedChunks.size());
+
+        float num = float(sortedChunks.size());
         float idx = 0.0f;
 
-        for(auto it = recordlist.begin(); it != recordlist.end(); ++it)
+        for(Chunk *chunk : sortedChunks)
         {
           RenderDoc::Inst().SetProgress(CaptureProgress::SerialiseFrameContents, idx / num);
           idx += 1.0f;
-          it->second->Write(ser);
+          chunk->Write(ser);
         }
 
         RDCDEBUG("Done");
@@ -1794,6 +1801,9 @@ bool WrappedID3D11Device::EndFrameCapture(void *dev, void *wnd)
       UnlockForChunkFlushing();
     }
 
+    if(rdc)
+      rdc->WriteChunkIndex(chunkOffsets);
+
     RenderDoc::Inst().FinishCaptureWriting(rdc, m_CapturedFrames.back().frameNumber);
 
     m_State = CaptureState::BackgroundCapturing;
@@ -1818,6 +1828,8 @@ bool WrappedID3D11Device::EndFrameCapture(void *dev, void *wnd)
 
     GetResourceManager()->FreeInitialContents();
 
+    GetResourceManager()->DetachChunksFromArena();
+
     return true;
   }
   else
@@ -1912,6 +1924,8 @@ bool WrappedID3D11Device::EndFrameCapture(void *dev, void *wnd)
       }
 
       GetResourceManager()->MarkUnwrittenResources();
+
+      GetResourceManager()->DetachChunksFromArena();
     }
     else
     {
@@ -160,7 +160,7 @@ struct D3D11ResourceRecord : public ResourceRecord
       SubResources[i]->SetDataPtr(ptr);
   }
 
-  void Insert(map<int32_t, Chunk *> &recordlist)
+  void Insert(ChunkMergeList &recordlist)
   {
     bool dataWritten = DataWritten;
 
@@ -176,7 +176,7 @@ struct D3D11ResourceRecord : public ResourceRecord
 
     if(!dataWritten)
     {
-      recordlist.insert(m_Chunks.begin(), m_Chunks.end());
+      recordlist.Add(m_Chunks);
 
       for(int i = 0; i < NumSubResources; i++)
         SubResources[i]->Insert(recordlist);
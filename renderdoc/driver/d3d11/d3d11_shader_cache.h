@@ -28,6 +28,7 @@
 #include <string>
 #include <vector>
 #include "api/replay/renderdoc_replay.h"
+#include "common/shader_cache.h"
 #include "driver/dx/official/d3d11_4.h"
 
 class WrappedID3D11Device;
@@ -50,10 +51,11 @@ public:
   void SetCaching(bool enabled) { m_CacheShaders = enabled; }
 private:
   static const uint32_t m_ShaderCacheMagic = 0xf000baba;
-  static const uint32_t m_ShaderCacheVersion = 3;
+  static const uint32_t m_ShaderCacheVersion = 4;
 
   ID3D11Device *m_pDevice = NULL;
 
-  bool m_ShaderCacheDirty = false, m_CacheShaders = false;
-  std::map<uint32_t, ID3DBlob *> m_ShaderCache;
+  bool m_CacheShaders = false;
+  ShaderCacheFile m_ShaderCacheFile;
+  std::map<uint64_t, ID3DBlob *> m_ShaderCache;
 };
\ No newline at end of file
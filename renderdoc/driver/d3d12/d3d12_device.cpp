@@ -1717,6 +1717,8 @@ bool WrappedID3D12Device::EndFrameCapture(void *dev, void *wnd)
     captureWriter = new StreamWriter(StreamWriter::InvalidStream);
   }
 
+  std::vector<uint64_t> chunkOffsets;
+
   {
     WriteSerialiser ser(captureWriter, Ownership::Stream);
 
@@ -1724,6 +1726,8 @@ bool WrappedID3D12Device::EndFrameCapture(void *dev, void *wnd)
 
     ser.SetUserData(GetResourceManager());
 
+    ser.SetChunkOffsetRecording(&chunkOffsets);
+
     {
       SCOPED_SERIALISE_CHUNK(SystemChunk::DriverInit, sizeof(D3D12InitParams));
 
@@ -1752,7 +1756,7 @@ bool WrappedID3D12Device::EndFrameCapture(void *dev, void *wnd)
     // in capframe (the transition is thread-protected) so nothing will be
     // pushed to the vector
 
-    map<int32_t, Chunk *> recordlist;
+    ChunkMergeList recordlist;
 
     for(auto it = queues.begin(); it != queues.end(); ++it)
     {
@@ -1765,14 +1769,14 @@ bool WrappedID3D12Device::EndFrameCapture(void *dev, void *wnd)
 
       for(size_t i = 0; i < cmdListRecords.size(); i++)
       {
-        uint32_t prevSize = (uint32_t)recordlist.size();
+        uint32_t prevSize = (uint32_t)recordlist.NumChunks();
         cmdListRecords[i]->Insert(recordlist);
 
         // prevent complaints in release that prevSize is unused
         (void)prevSize;
 
         RDCDEBUG("Adding %u chunks to file serialiser from command list %llu",
-                 (uint32_t)recordlist.size() - prevSize, cmdListRecords[i]->GetResourceID());
+                 (uint32_t)recordlist.NumChunks() - prevSize, cmdListRecords[i]->GetResourceID());
       }
 
       q->GetResourceRecord()->Insert(recordlist);
@@ -1780,22 +1784,28 @@ bool WrappedID3D12Device::EndFrameCapture(void *dev, void *wnd)
 
     m_FrameCaptureRecord->Insert(recordlist);
 
+    std::vector<Chunk *> sortedChunks;
+    recordlist.Merge(sortedChunks);
+
     RDCDEBUG("Flushing %u chunks to file serialiser from context record",
-             (uint32_t)recordlist.size());
+             (uint32_t)sortedChunks.size());
 
-    float num = float(recordlist.size());
+    float num = float(sortedChunks.size());
     float idx = 0.0f;
 
-    for(auto it = recordlist.begin(); it != recordlist.end(); ++it)
+    for(Chunk *chunk : sortedChunks)
     {
       RenderDoc::Inst().SetProgress(CaptureProgress::SerialiseFrameContents, idx / num);
       idx += 1.0f;
-      it->second->Write(ser);
+      chunk->Write(ser);
     }
 
     RDCDEBUG("Done");
   }
 
+  if(rdc)
+    rdc->WriteChunkIndex(chunkOffsets);
+
   RenderDoc::Inst().FinishCaptureWriting(rdc, m_CapturedFrames.back().frameNumber);
 
   SAFE_DELETE(m_HeaderChunk);
@@ -1811,6 +1821,8 @@ bool WrappedID3D12Device::EndFrameCapture(void *dev, void *wnd)
 
   GetResourceManager()->FreeInitialContents();
 
+  GetResourceManager()->DetachChunksFromArena();
+
   GetResourceManager()->FlushPendingDirty();
 
   FlushPendingDescriptorWrites();
@@ -2201,7 +2213,11 @@ WriteSerialiser &WrappedID3D12Device::GetThreadSerialiser()
 {
   WriteSerialiser *ser = (WriteSerialiser *)Threading::GetTLSValue(threadSerialiserTLSSlot);
   if(ser)
+  {
+    // sub-allocate chunks only while capturing a frame, since they're all freed when it ends.
+    ser->SetChunkArena(IsActiveCapturing(m_State));
     return *ser;
+  }
 
   // slow path, but rare
 
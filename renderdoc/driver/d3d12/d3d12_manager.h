@@ -548,7 +548,7 @@ struct D3D12ResourceRecord : public ResourceRecord
     cmdInfo->bundles.swap(bakedCommands->cmdInfo->bundles);
   }
 
-  void Insert(map<int32_t, Chunk *> &recordlist)
+  void Insert(ChunkMergeList &recordlist)
   {
     bool dataWritten = DataWritten;
 
@@ -563,7 +563,7 @@ struct D3D12ResourceRecord : public ResourceRecord
     }
 
     if(!dataWritten)
-      recordlist.insert(m_Chunks.begin(), m_Chunks.end());
+      recordlist.Add(m_Chunks);
   }
 
   D3D12ResourceType type;
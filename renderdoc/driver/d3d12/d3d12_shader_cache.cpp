@@ -45,7 +45,7 @@ struct D3D12BlobShaderCallbacks
       RDCFATAL("d3dcompiler.dll doesn't contain D3DCreateBlob");
   }
 
-  bool Create(uint32_t size, byte *data, ID3DBlob **ret) const
+  bool Create(uint32_t size, const byte *data, ID3DBlob **ret) const
   {
     RDCASSERT(ret);
 
@@ -72,39 +72,26 @@ struct D3D12BlobShaderCallbacks
 
 D3D12ShaderCache::D3D12ShaderCache()
 {
-  bool success = LoadShaderCache("d3dshaders.cache", m_ShaderCacheMagic, m_ShaderCacheVersion,
-                                 m_ShaderCache, D3D12ShaderCacheCallbacks);
-
-  // if we failed to load from the cache
-  m_ShaderCacheDirty = !success;
+  m_ShaderCacheFile.Open(FileIO::GetAppFolderFilename("d3dshaders.cache"), m_ShaderCacheMagic,
+                         m_ShaderCacheVersion);
 }
 
 D3D12ShaderCache::~D3D12ShaderCache()
 {
-  if(m_ShaderCacheDirty)
-  {
-    SaveShaderCache("d3dshaders.cache", m_ShaderCacheMagic, m_ShaderCacheVersion, m_ShaderCache,
-                    D3D12ShaderCacheCallbacks);
-  }
-  else
-  {
-    for(auto it = m_ShaderCache.begin(); it != m_ShaderCache.end(); ++it)
-      D3D12ShaderCacheCallbacks.Destroy(it->second);
-  }
+  DestroyShaderCache(m_ShaderCacheFile, m_ShaderCache, D3D12ShaderCacheCallbacks);
 }
 
 std::string D3D12ShaderCache::GetShaderBlob(const char *source, const char *entry,
                                             const uint32_t compileFlags, const char *profile,
                                             ID3DBlob **srcblob)
 {
-  uint32_t hash = strhash(source);
-  hash = strhash(entry, hash);
-  hash = strhash(profile, hash);
+  uint64_t hash = strhash64(source);
+  hash = strhash64(entry, hash);
+  hash = strhash64(profile, hash);
   hash ^= compileFlags;
 
-  if(m_ShaderCache.find(hash) != m_ShaderCache.end())
+  if(FindCachedShader(m_ShaderCacheFile, m_ShaderCache, hash, *srcblob, D3D12ShaderCacheCallbacks))
   {
-    *srcblob = m_ShaderCache[hash];
     (*srcblob)->AddRef();
     return "";
   }
@@ -156,9 +143,8 @@ std::string D3D12ShaderCache::GetShaderBlob(const char *source, const char *entr
 
   if(m_CacheShaders)
   {
-    m_ShaderCache[hash] = byteBlob;
     byteBlob->AddRef();
-    m_ShaderCacheDirty = true;
+    AddCachedShader(m_ShaderCacheFile, m_ShaderCache, hash, byteBlob, D3D12ShaderCacheCallbacks);
   }
 
   SAFE_RELEASE(errBlob);
@@ -26,6 +26,7 @@
 #pragma once
 
 #include "common/common.h"
+#include "core/call_profiler.h"
 #include "core/core.h"
 #include "maths/vec.h"
 
@@ -375,14 +376,19 @@ T CheckConstParam(T t);
   template bool WrappedOpenGL::CONCAT(Serialise_, func(ReadSerialiser &ser, ##__VA_ARGS__)); \
   template bool WrappedOpenGL::CONCAT(Serialise_, func(WriteSerialiser &ser, ##__VA_ARGS__));
 
-#define USE_SCRATCH_SERIALISER() WriteSerialiser &ser = m_ScratchSerialiser;
-
-#define SERIALISE_TIME_CALL(...)                                                                    \
-  m_ScratchSerialiser.ChunkMetadata().timestampMicro = RenderDoc::Inst().GetMicrosecondTimestamp(); \
-  __VA_ARGS__;                                                                                      \
-  m_ScratchSerialiser.ChunkMetadata().durationMicro =                                               \
-      RenderDoc::Inst().GetMicrosecondTimestamp() -                                                 \
-      m_ScratchSerialiser.ChunkMetadata().timestampMicro;
+#define USE_SCRATCH_SERIALISER() WriteSerialiser &ser = GetThreadSerialiser();
+
+#define SERIALISE_TIME_CALL(...)                                                          \
+  {                                                                                       \
+    WriteSerialiser &ser = GetThreadSerialiser();                                         \
+    ser.ChunkMetadata().timestampMicro = RenderDoc::Inst().GetMicrosecondTimestamp();     \
+    {                                                                                     \
+      SCOPED_DRIVER_PROFILE();                                                            \
+      __VA_ARGS__;                                                                        \
+    }                                                                                     \
+    ser.ChunkMetadata().durationMicro =                                                   \
+        RenderDoc::Inst().GetMicrosecondTimestamp() - ser.ChunkMetadata().timestampMicro; \
+  }
 
 // A handy macros to say "is the serialiser reading and we're doing replay-mode stuff?"
 // The reason we check both is that checking the first allows the compiler to eliminate the other
@@ -27,7 +27,6 @@
 #include <algorithm>
 #include "common/common.h"
 #include "driver/shaders/spirv/spirv_common.h"
-#include "jpeg-compressor/jpge.h"
 #include "serialise/rdcfile.h"
 #include "strings/string_utils.h"
 
@@ -491,8 +490,7 @@ void WrappedOpenGL::BuildGLESExtensions()
   std::sort(m_GLESExtensions.begin(), m_GLESExtensions.end());
 }
 
-WrappedOpenGL::WrappedOpenGL(GLPlatform &platform)
-    : m_Platform(platform), m_ScratchSerialiser(new StreamWriter(1024), Ownership::Stream)
+WrappedOpenGL::WrappedOpenGL(GLPlatform &platform) : m_Platform(platform)
 {
   if(RenderDoc::Inst().GetCrashHandler())
     RenderDoc::Inst().GetCrashHandler()->RegisterMemoryRegion(this, sizeof(WrappedOpenGL));
@@ -506,14 +504,7 @@ WrappedOpenGL::WrappedOpenGL(GLPlatform &platform)
 
   m_StructuredFile = &m_StoredStructuredData;
 
-  uint32_t flags = WriteSerialiser::ChunkDuration | WriteSerialiser::ChunkTimestamp |
-                   WriteSerialiser::ChunkThreadID;
-
-  if(RenderDoc::Inst().GetCaptureOptions().captureCallstacks)
-    flags |= WriteSerialiser::ChunkCallstack;
-
-  m_ScratchSerialiser.SetChunkMetadataRecording(flags);
-  m_ScratchSerialiser.SetVersion(GLInitParams::CurrentVersion);
+  m_ThreadSerialiserTLS = Threading::AllocateTLSSlot();
 
   m_SectionVersion = GLInitParams::CurrentVersion;
 
@@ -563,8 +554,6 @@ WrappedOpenGL::WrappedOpenGL(GLPlatform &platform)
 
   m_ResourceManager = new GLResourceManager(this);
 
-  m_ScratchSerialiser.SetUserData(GetResourceManager());
-
   m_DeviceResourceID =
       GetResourceManager()->RegisterResource(GLResource(NULL, eResSpecial, eSpecialResDevice));
   m_ContextResourceID =
@@ -813,10 +802,46 @@ WrappedOpenGL::~WrappedOpenGL()
 
   SAFE_DELETE(m_ResourceManager);
 
+  for(size_t i = 0; i < m_ThreadSerialisers.size(); i++)
+    delete m_ThreadSerialisers[i];
+
   if(RenderDoc::Inst().GetCrashHandler())
     RenderDoc::Inst().GetCrashHandler()->UnregisterMemoryRegion(this);
 }
 
+WriteSerialiser &WrappedOpenGL::GetThreadSerialiser()
+{
+  WriteSerialiser *ser = (WriteSerialiser *)Threading::GetTLSValue(m_ThreadSerialiserTLS);
+  if(ser)
+  {
+    // sub-allocate chunks only while capturing a frame, since they're all freed when it ends.
+    ser->SetChunkArena(IsActiveCapturing(m_State));
+    return *ser;
+  }
+
+  // slow path, but rare
+  ser = new WriteSerialiser(new StreamWriter(1024), Ownership::Stream);
+
+  uint32_t flags = WriteSerialiser::ChunkDuration | WriteSerialiser::ChunkTimestamp |
+                   WriteSerialiser::ChunkThreadID;
+
+  if(RenderDoc::Inst().GetCaptureOptions().captureCallstacks)
+    flags |= WriteSerialiser::ChunkCallstack;
+
+  ser->SetChunkMetadataRecording(flags);
+  ser->SetUserData(GetResourceManager());
+  ser->SetVersion(GLInitParams::CurrentVersion);
+
+  Threading::SetTLSValue(m_ThreadSerialiserTLS, (void *)ser);
+
+  {
+    SCOPED_LOCK(m_ThreadSerialisersLock);
+    m_ThreadSerialisers.push_back(ser);
+  }
+
+  return *ser;
+}
+
 ContextPair &WrappedOpenGL::GetCtx()
 {
   GLContextTLSData *ret = (GLContextTLSData *)Threading::GetTLSValue(m_CurCtxDataTLS);
@@ -842,6 +867,9 @@ GLResourceRecord *WrappedOpenGL::GetContextRecord()
 
 WrappedOpenGL::ContextData &WrappedOpenGL::GetCtxData()
 {
+  GLContextTLSData *data = (GLContextTLSData *)Threading::GetTLSValue(m_CurCtxDataTLS);
+  if(data && data->ctxData)
+    return *(ContextData *)data->ctxData;
   return m_ContextData[GetCtx().ctx];
 }
 
@@ -915,6 +943,13 @@ void WrappedOpenGL::DeleteContext(void *contextHandle)
     ctxdata.UnassociateWindow(wndHandle);
   }
 
+  // don't leave any thread pointing at the data we're about to erase
+  for(GLContextTLSData *tlsData : m_CtxDataVector)
+  {
+    if(tlsData->ctxData == &ctxdata)
+      tlsData->ctxData = NULL;
+  }
+
   m_ContextData.erase(contextHandle);
 }
 
@@ -981,14 +1016,18 @@ void WrappedOpenGL::CreateContext(GLWindowingData winData, void *shareContext,
   RenderDoc::Inst().AddDeviceFrameCapturer(ctxdata.ctx, this);
 
   // re-configure callstack capture, since WrappedOpenGL constructor may run too early
-  uint32_t flags = m_ScratchSerialiser.GetChunkMetadataRecording();
+  SCOPED_LOCK(m_ThreadSerialisersLock);
+  for(WriteSerialiser *ser : m_ThreadSerialisers)
+  {
+    uint32_t flags = ser->GetChunkMetadataRecording();
 
-  if(RenderDoc::Inst().GetCaptureOptions().captureCallstacks)
-    flags |= WriteSerialiser::ChunkCallstack;
-  else
-    flags &= ~WriteSerialiser::ChunkCallstack;
+    if(RenderDoc::Inst().GetCaptureOptions().captureCallstacks)
+      flags |= WriteSerialiser::ChunkCallstack;
+    else
+      flags &= ~WriteSerialiser::ChunkCallstack;
 
-  m_ScratchSerialiser.SetChunkMetadataRecording(flags);
+    ser->SetChunkMetadataRecording(flags);
+  }
 }
 
 void WrappedOpenGL::RegisterReplayContext(GLWindowingData winData, void *shareContext, bool core,
@@ -1156,6 +1195,8 @@ void WrappedOpenGL::ActivateContext(GLWindowingData winData)
 
         Threading::SetTLSValue(m_CurCtxDataTLS, tlsData);
       }
+
+      tlsData->ctxData = &ctxdata;
     }
 
     if(!ctxdata.built)
@@ -1799,7 +1840,7 @@ void WrappedOpenGL::StartFrameCapture(void *dev, void *wnd)
 
   SCOPED_LOCK(glLock);
 
-  m_State = CaptureState::ActiveCapturing;
+  BeginActiveCapture();
 
   m_AppControlledCapture = true;
 
@@ -1891,41 +1932,35 @@ bool WrappedOpenGL::EndFrameCapture(void *dev, void *wnd)
     if(bbim == NULL)
       bbim = SaveBackbufferImage();
 
-    RDCFile *rdc = RenderDoc::Inst().CreateRDC(GetDriverType(), m_CapturedFrames.back().frameNumber,
-                                               bbim->jpgbuf, bbim->len, bbim->thwidth,
-                                               bbim->thheight, FileType::JPG);
-
+    // everything up to the frame itself is serialised into memory here, and the frame's chunks
+    // are handed over. It's then compressed and written to disk along with the thumbnail on the
+    // capture writer thread, so the application can carry on.
+    PendingCapture *capture = new PendingCapture;
+    capture->driver = GetDriverType();
+    capture->frameNumber = m_CapturedFrames.back().frameNumber;
+    capture->sectionVersion = m_SectionVersion;
+    capture->thumbPixels = bbim->thpixels;
+    capture->thumbWidth = bbim->thwidth;
+    capture->thumbHeight = bbim->thheight;
+    capture->frameCapture = new StreamWriter(StreamWriter::DefaultScratchSize);
+
+    // the capture owns the pixels now
+    bbim->thpixels = NULL;
     SAFE_DELETE(bbim);
 
     for(auto it = m_BackbufferImages.begin(); it != m_BackbufferImages.end(); ++it)
       delete it->second;
     m_BackbufferImages.clear();
 
-    StreamWriter *captureWriter = NULL;
-
-    if(rdc)
     {
-      SectionProperties props;
+      WriteSerialiser ser(capture->frameCapture, Ownership::Nothing);
 
-      // Compress with LZ4 so that it's fast
-      props.flags = SectionFlags::LZ4Compressed;
-      props.version = m_SectionVersion;
-      props.type = SectionType::FrameCapture;
-
-      captureWriter = rdc->WriteSection(props);
-    }
-    else
-    {
-      captureWriter = new StreamWriter(StreamWriter::InvalidStream);
-    }
-
-    {
-      WriteSerialiser ser(captureWriter, Ownership::Stream);
-
-      ser.SetChunkMetadataRecording(m_ScratchSerialiser.GetChunkMetadataRecording());
+      ser.SetChunkMetadataRecording(GetThreadSerialiser().GetChunkMetadataRecording());
 
       ser.SetUserData(GetResourceManager());
 
+      ser.SetChunkOffsetRecording(&capture->chunkOffsets);
+
       {
         SCOPED_SERIALISE_CHUNK(SystemChunk::DriverInit, sizeof(GLInitParams) + 16);
 
@@ -1967,7 +2002,7 @@ bool WrappedOpenGL::EndFrameCapture(void *dev, void *wnd)
       {
         RDCDEBUG("Accumulating context resource list");
 
-        map<int32_t, Chunk *> recordlist;
+        ChunkMergeList recordlist;
         m_ContextRecord->Insert(recordlist);
 
         for(auto it = m_ContextData.begin(); it != m_ContextData.end(); ++it)
@@ -1984,23 +2019,32 @@ bool WrappedOpenGL::EndFrameCapture(void *dev, void *wnd)
           }
         }
 
-        RDCDEBUG("Flushing %u records to file serialiser", (uint32_t)recordlist.size());
+        std::vector<Chunk *> sortedChunks;
+        recordlist.Merge(sortedChunks);
 
-        float num = float(recordlist.size());
-        float idx = 0.0f;
+        RDCDEBUG("Handing %u records to the capture", (uint32_t)sortedChunks.size());
 
-        for(auto it = recordlist.begin(); it != recordlist.end(); ++it)
-        {
-          RenderDoc::Inst().SetProgress(CaptureProgress::SerialiseFrameContents, idx / num);
-          idx += 1.0f;
-          it->second->Write(ser);
-        }
+        RenderDoc::Inst().SetProgress(CaptureProgress::SerialiseFrameContents, 0.0f);
+
+        // the context records only hold this frame's chunks and are cleared at the start of the
+        // next capture, so their chunks can be given to the capture rather than copied.
+        std::vector<Chunk *> released;
+
+        m_ContextRecord->ReleaseChunks(released);
+
+        for(auto it = m_ContextData.begin(); it != m_ContextData.end(); ++it)
+          if(it->second.m_ContextDataRecord)
+            it->second.m_ContextDataRecord->ReleaseChunks(released);
+
+        capture->AddFrameChunks(sortedChunks, released);
+
+        RenderDoc::Inst().SetProgress(CaptureProgress::SerialiseFrameContents, 1.0f);
 
         RDCDEBUG("Done");
       }
     }
 
-    RenderDoc::Inst().FinishCaptureWriting(rdc, m_CapturedFrames.back().frameNumber);
+    RenderDoc::Inst().QueueCaptureWrite(capture);
 
     m_State = CaptureState::BackgroundCapturing;
 
@@ -2010,6 +2054,8 @@ bool WrappedOpenGL::EndFrameCapture(void *dev, void *wnd)
 
     GetResourceManager()->FreeInitialContents();
 
+    GetResourceManager()->DetachChunksFromArena();
+
     if(switchctx.ctx != prevctx.ctx)
     {
       m_Platform.MakeContextCurrent(prevctx);
@@ -2068,6 +2114,8 @@ bool WrappedOpenGL::EndFrameCapture(void *dev, void *wnd)
       m_State = CaptureState::BackgroundCapturing;
 
       GetResourceManager()->MarkUnwrittenResources();
+
+      GetResourceManager()->DetachChunksFromArena();
     }
     else
     {
@@ -2217,36 +2265,8 @@ WrappedOpenGL::BackbufferImage *WrappedOpenGL::SaveBackbufferImage()
     SAFE_DELETE_ARRAY(src);
   }
 
-  byte *jpgbuf = NULL;
-  int len = thwidth * thheight;
-
-  if(len > 0)
-  {
-    // jpge::compress_image_to_jpeg_file_in_memory requires at least 1024 bytes
-    len = len >= 1024 ? len : 1024;
-
-    jpgbuf = new byte[len];
-
-    jpge::params p;
-    p.m_quality = 80;
-
-    bool success =
-        jpge::compress_image_to_jpeg_file_in_memory(jpgbuf, len, thwidth, thheight, 3, thpixels, p);
-
-    if(!success)
-    {
-      RDCERR("Failed to compress to jpg");
-      SAFE_DELETE_ARRAY(jpgbuf);
-      thwidth = 0;
-      thheight = 0;
-    }
-  }
-
-  SAFE_DELETE_ARRAY(thpixels);
-
   BackbufferImage *bbim = new BackbufferImage();
-  bbim->jpgbuf = jpgbuf;
-  bbim->len = len;
+  bbim->thpixels = thpixels;
   bbim->thwidth = thwidth;
   bbim->thheight = thheight;
 
@@ -2402,10 +2422,25 @@ void WrappedOpenGL::ReleaseResource(GLResource res)
   }
 }
 
-void WrappedOpenGL::AttemptCapture()
+void WrappedOpenGL::BeginActiveCapture()
 {
+  // stop any more calls starting without the lock, then wait for those already running to finish
+  // before changing state. That way a lock-free call never sees the state change part way through,
+  // and any call starting after this will see we're capturing and take the lock.
+  Atomic::Inc32(&m_CaptureStarting);
+
+  for(GLContextTLSData *tlsData : m_CtxDataVector)
+    tlsData->lockFreeCalls.Wait();
+
   m_State = CaptureState::ActiveCapturing;
 
+  Atomic::Dec32(&m_CaptureStarting);
+}
+
+void WrappedOpenGL::AttemptCapture()
+{
+  BeginActiveCapture();
+
   m_DebugMessages.clear();
 
   {
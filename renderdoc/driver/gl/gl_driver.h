@@ -127,7 +127,11 @@ private:
   uint64_t m_SectionVersion;
   GLInitParams m_GlobalInitParams;
 
-  WriteSerialiser m_ScratchSerialiser;
+  uint64_t m_ThreadSerialiserTLS;
+
+  Threading::CriticalSection m_ThreadSerialisersLock;
+  std::vector<WriteSerialiser *> m_ThreadSerialisers;
+
   std::set<std::string> m_StringDB;
 
   StreamReader *m_FrameReader = NULL;
@@ -138,6 +142,12 @@ private:
   uint64_t m_CurCtxDataTLS;
   std::vector<GLContextTLSData *> m_CtxDataVector;
 
+  // non-zero while BeginActiveCapture is waiting for lock-free calls to finish
+  volatile int32_t m_CaptureStarting = 0;
+
+  // switches to active capturing, with glLock held
+  void BeginActiveCapture();
+
   uintptr_t m_ShareGroupID;
 
   std::vector<GLWindowingData> m_LastContexts;
@@ -459,12 +469,12 @@ private:
   void RenderOverlayText(float x, float y, const char *fmt, ...);
   void RenderOverlayStr(float x, float y, const char *str);
 
+  // RGB8 thumbnail pixels, compressed when the capture is written
   struct BackbufferImage
   {
-    BackbufferImage() : jpgbuf(NULL), len(0), thwidth(0), thheight(0) {}
-    ~BackbufferImage() { SAFE_DELETE_ARRAY(jpgbuf); }
-    byte *jpgbuf;
-    size_t len;
+    BackbufferImage() : thpixels(NULL), thwidth(0), thheight(0) {}
+    ~BackbufferImage() { SAFE_DELETE_ARRAY(thpixels); }
+    byte *thpixels;
     uint16_t thwidth;
     uint16_t thheight;
   };
@@ -500,13 +510,32 @@ public:
   GLResourceManager *GetResourceManager() { return m_ResourceManager; }
   CaptureState GetState() { return m_State; }
   GLReplay *GetReplay() { return &m_Replay; }
-  WriteSerialiser &GetSerialiser() { return m_ScratchSerialiser; }
+  WriteSerialiser &GetSerialiser() { return GetThreadSerialiser(); }
+  WriteSerialiser &GetThreadSerialiser();
   void SetDriverType(RDCDriver type) { m_DriverType = type; }
   bool isGLESMode() { return m_DriverType == RDCDriver::OpenGLES; }
   RDCDriver GetDriverType() { return m_DriverType; }
   ContextPair &GetCtx();
   GLResourceRecord *GetContextRecord();
 
+  // Hooked calls that only touch the current context's data unless a frame is being actively
+  // captured can skip glLock while background capturing. This returns the calling thread's data if
+  // the call can go ahead without the lock, or NULL if it must take it. Any non-NULL return must be
+  // passed to EndLockFreeCall once the call is complete, and until then the state stays at
+  // background capturing.
+  GLContextTLSData *BeginLockFreeCall()
+  {
+    GLContextTLSData *data = (GLContextTLSData *)Threading::GetTLSValue(m_CurCtxDataTLS);
+
+    // without cached context data GetCtxData() would have to look it up in the shared map
+    if(data == NULL || data->ctxData == NULL ||
+       !data->lockFreeCalls.Begin(m_CaptureStarting, m_State))
+      return NULL;
+
+    return data;
+  }
+  void EndLockFreeCall(GLContextTLSData *data) { data->lockFreeCalls.End(); }
+
   void *ShareCtx(void *ctx) { return ctx ? m_ContextData[ctx].shareGroup : NULL; }
   void SetStructuredExport(uint64_t sectionVersion)
   {
@@ -61,6 +61,118 @@ public:
   bool enabled = false;
 } glhook;
 
+// These hooked functions' wrappers do nothing but call the real function unless a frame is being
+// actively captured, apart from the binds that track the binding in the current context's data. In
+// the background they don't serialise anything, use gl_CurChunk, or touch driver-wide state other
+// than looking up records in the resource manager, which is safe without glLock. That means they
+// can skip glLock while background capturing, which is where most of an application's calls are
+// spent. Check a wrapper before adding it here, and remove it if its background behaviour ever
+// changes.
+//
+// Starting a capture waits for lock-free calls in progress while holding glLock, so nothing that can
+// block on another thread may be here - e.g. glClientWaitSync or keyed mutex acquires, which could
+// be waiting on work that thread can't submit without the lock.
+//
+// Uploads (glBufferSubData, glTexSubImage*, etc) and binds that record chunks or touch other
+// driver-wide state in the background (glBindBuffer, glBindTexture, etc) aren't here and still take
+// glLock. So does every call while a frame is being captured, since they all serialise into the
+// frame and mark resources as referenced - glLock isn't split per share group for that, as the
+// capture state is driver-wide.
+static const GLChunk lockFreeFunctions[] = {
+    GLChunk::glActiveTexture, GLChunk::glBindFramebuffer, GLChunk::glBindImageTexture,
+    GLChunk::glBindImageTextures, GLChunk::glBindProgramPipeline, GLChunk::glBindRenderbuffer,
+    GLChunk::glBindSampler, GLChunk::glBindSamplers, GLChunk::glBindVertexArray,
+    GLChunk::glBlendColor, GLChunk::glBlendEquation, GLChunk::glBlendEquationSeparate,
+    GLChunk::glBlendEquationSeparatei, GLChunk::glBlendEquationi, GLChunk::glBlendFunc,
+    GLChunk::glBlendFuncSeparate, GLChunk::glBlendFuncSeparatei, GLChunk::glBlendFunci,
+    GLChunk::glCheckFramebufferStatus, GLChunk::glCheckNamedFramebufferStatusEXT,
+    GLChunk::glClearColor, GLChunk::glClearDepth, GLChunk::glClearDepthf, GLChunk::glClearStencil,
+    GLChunk::glClipControl, GLChunk::glColorMask, GLChunk::glColorMaski, GLChunk::glCullFace,
+    GLChunk::glDepthBoundsEXT, GLChunk::glDepthFunc, GLChunk::glDepthMask, GLChunk::glDepthRange,
+    GLChunk::glDepthRangeArrayfvOES, GLChunk::glDepthRangeArrayv, GLChunk::glDepthRangeIndexed,
+    GLChunk::glDepthRangeIndexedfOES, GLChunk::glDepthRangef, GLChunk::glDisable,
+    GLChunk::glDisablei, GLChunk::glEnable, GLChunk::glEnablei, GLChunk::glFrontFace,
+    GLChunk::glGetAttribLocation, GLChunk::glGetDebugMessageLog, GLChunk::glGetError,
+    GLChunk::glGetFragDataIndex, GLChunk::glGetFragDataLocation, GLChunk::glGetGraphicsResetStatus,
+    GLChunk::glGetNamedStringARB, GLChunk::glGetNamedStringivARB,
+    GLChunk::glGetProgramResourceIndex, GLChunk::glGetProgramResourceLocation,
+    GLChunk::glGetProgramResourceLocationIndex, GLChunk::glGetSubroutineIndex,
+    GLChunk::glGetSubroutineUniformLocation, GLChunk::glGetUniformBlockIndex,
+    GLChunk::glGetUniformLocation, GLChunk::glHint, GLChunk::glInsertEventMarkerEXT,
+    GLChunk::glIsBuffer, GLChunk::glIsFramebuffer, GLChunk::glIsMemoryObjectEXT,
+    GLChunk::glIsNamedStringARB, GLChunk::glIsProgram, GLChunk::glIsProgramPipeline,
+    GLChunk::glIsQuery, GLChunk::glIsRenderbuffer, GLChunk::glIsSampler, GLChunk::glIsSemaphoreEXT,
+    GLChunk::glIsShader, GLChunk::glIsSync, GLChunk::glIsTexture, GLChunk::glIsTransformFeedback,
+    GLChunk::glIsVertexArray, GLChunk::glLineWidth, GLChunk::glLogicOp, GLChunk::glMinSampleShading,
+    GLChunk::glPatchParameterfv, GLChunk::glPatchParameteri, GLChunk::glPauseTransformFeedback,
+    GLChunk::glPixelStorei, GLChunk::glPointParameterf, GLChunk::glPointParameterfv,
+    GLChunk::glPointParameteri, GLChunk::glPointParameteriv, GLChunk::glPointSize,
+    GLChunk::glPolygonMode, GLChunk::glPolygonOffset, GLChunk::glPolygonOffsetClamp,
+    GLChunk::glPopDebugGroup, GLChunk::glPopGroupMarkerEXT, GLChunk::glPrimitiveBoundingBox,
+    GLChunk::glPrimitiveRestartIndex, GLChunk::glProvokingVertex, GLChunk::glPushDebugGroup,
+    GLChunk::glPushGroupMarkerEXT, GLChunk::glQueryCounter, GLChunk::glRasterSamplesEXT,
+    GLChunk::glReleaseKeyedMutexWin32EXT, GLChunk::glResumeTransformFeedback,
+    GLChunk::glSampleCoverage, GLChunk::glSampleMaski, GLChunk::glScissor, GLChunk::glScissorArrayv,
+    GLChunk::glSignalSemaphoreEXT, GLChunk::glStencilFunc, GLChunk::glStencilFuncSeparate,
+    GLChunk::glStencilMask, GLChunk::glStencilMaskSeparate, GLChunk::glStencilOp,
+    GLChunk::glStencilOpSeparate, GLChunk::glStringMarkerGREMEDY, GLChunk::glUniformSubroutinesuiv,
+    GLChunk::glUseProgram, GLChunk::glViewport, GLChunk::glViewportArrayv,
+    GLChunk::glWaitSemaphoreEXT, GLChunk::glWaitSync};
+
+struct LockFreeCalls
+{
+  LockFreeCalls()
+  {
+    for(GLChunk chunk : lockFreeFunctions)
+      lockFree[(uint32_t)chunk] = true;
+
+// aliases share the wrapper of the function they alias
+#define MarkLockFreeAlias(function, alias)  \
+  if(lockFree[(uint32_t)GLChunk::function]) \
+    lockFree[(uint32_t)GLChunk::alias] = true;
+
+    ForEachSupported(MarkLockFreeAlias);
+  }
+
+  bool lockFree[(uint32_t)GLChunk::Max] = {};
+} lockFreeCalls;
+
+// takes glLock for the duration of a hooked call, unless the call can safely go without it. That's
+// decided once, here, on the state the driver was in when the call started. A lock-free call never
+// sets gl_CurChunk, since another thread may be using it under the lock.
+class ScopedGLCallLock
+{
+public:
+  ScopedGLCallLock(GLChunk chunk)
+  {
+    if(lockFreeCalls.lockFree[(uint32_t)chunk] && glhook.driver)
+      m_LockFree = glhook.driver->BeginLockFreeCall();
+
+    if(m_LockFree == NULL)
+    {
+      glLock.Lock();
+      gl_CurChunk = chunk;
+    }
+  }
+  ~ScopedGLCallLock()
+  {
+    if(m_LockFree)
+    {
+      // the wrapper branched on the driver's state, which can't leave background capturing while
+      // a lock-free call is running
+      RDCASSERT(IsBackgroundCapturing(glhook.driver->GetState()));
+      glhook.driver->EndLockFreeCall(m_LockFree);
+    }
+    else
+    {
+      glLock.Unlock();
+    }
+  }
+
+private:
+  GLContextTLSData *m_LockFree = NULL;
+};
+
 #if ENABLED(RDOC_DEVEL)
 
 struct ScopedPrinter
@@ -86,16 +198,16 @@ int ScopedPrinter::depth = 0;
 // This checks that we're not infinite looping by calling our own hooks from ourselves. Mostly
 // useful on android where you can only debug by printf and the stack dumps are often corrupted when
 // the callstack overflows.
-#define SCOPED_GLCALL(funcname)    \
-  SCOPED_LOCK(glLock);             \
-  gl_CurChunk = GLChunk::funcname; \
+#define SCOPED_GLCALL(funcname)                                       \
+  SCOPED_CALL_PROFILE(STRINGIZE(funcname));                           \
+  ScopedGLCallLock CONCAT(scopedglcall, __LINE__)(GLChunk::funcname); \
   ScopedPrinter CONCAT(scopedprint, __LINE__)(STRINGIZE(funcname));
 
 #else
 
-#define SCOPED_GLCALL(funcname) \
-  SCOPED_LOCK(glLock);          \
-  gl_CurChunk = GLChunk::funcname;
+#define SCOPED_GLCALL(funcname)             \
+  SCOPED_CALL_PROFILE(STRINGIZE(funcname)); \
+  ScopedGLCallLock CONCAT(scopedglcall, __LINE__)(GLChunk::funcname);
 
 #endif
 
@@ -129,25 +241,116 @@ void EnableGLHooks()
 DefineSupportedHooks();
 DefineUnsupportedHooks();
 
-void *HookedGetProcAddress(const char *func, void *realFunc)
+// Loaders look up thousands of functions by name at startup, and some applications keep looking
+// them up every frame, so rather than comparing against every name in turn they're hashed into a
+// table the first time one is looked up.
+class HookedFunctionTable
 {
-#define CheckFunction(function, name)                    \
-  if(!strcmp(func, STRINGIZE(name)))                     \
-  {                                                      \
-    if(GL.function == NULL)                              \
-      GL.function = (decltype(GL.function))realFunc;     \
-    return (void *)&CONCAT(function, _renderdoc_hooked); \
+public:
+  HookedFunctionTable()
+  {
+#define AddSupported(function, name) \
+  Add(STRINGIZE(name), (void **)&GL.function, (void *)&CONCAT(function, _renderdoc_hooked), true)
+
+#define AddUnsupported(function)                                          \
+  Add(STRINGIZE(function), (void **)&CONCAT(unsupported_real_, function), \
+      (void *)&CONCAT(function, _renderdoc_hooked), false)
+
+    ForEachSupported(AddSupported);
+    ForEachUnsupported(AddUnsupported);
+
+    // keep the table at most half full so probe sequences stay short
+    size_t size = 1;
+    while(size < m_Functions.size() * 2)
+      size *= 2;
+
+    m_Mask = uint32_t(size - 1);
+    m_Slots.resize(size, uint32_t(EmptySlot));
+
+    for(uint32_t i = 0; i < (uint32_t)m_Functions.size(); i++)
+    {
+      uint32_t slot = m_Functions[i].hash & m_Mask;
+
+      // a name may be listed more than once, in which case the first takes precedence
+      while(m_Slots[slot] != EmptySlot && !Matches(m_Slots[slot], m_Functions[i]))
+        slot = (slot + 1) & m_Mask;
+
+      if(m_Slots[slot] == EmptySlot)
+        m_Slots[slot] = i;
+    }
+  }
+
+  void *Lookup(const char *func, void *realFunc) const
+  {
+    uint32_t hash = Hash(func);
+
+    for(uint32_t slot = hash & m_Mask; m_Slots[slot] != EmptySlot; slot = (slot + 1) & m_Mask)
+    {
+      const HookedFunction &f = m_Functions[m_Slots[slot]];
+
+      if(f.hash != hash || strcmp(f.name, func) != 0)
+        continue;
+
+      // keep any real pointer we already have for supported functions, since it may have come
+      // from the library directly. A NULL pointer is never useful, so it doesn't overwrite one.
+      if(realFunc && (!f.keepExisting || *f.real == NULL))
+        *f.real = realFunc;
+
+      return f.hook;
+    }
+
+    return NULL;
   }
 
-#define CheckUnsupported(function)                                               \
-  if(!strcmp(func, STRINGIZE(function)))                                         \
-  {                                                                              \
-    CONCAT(unsupported_real_, function) = (CONCAT(function, _hooktype))realFunc; \
-    return (void *)&CONCAT(function, _renderdoc_hooked);                         \
+  size_t NumFunctions() const { return m_Functions.size(); }
+  const char *GetName(size_t i) const { return m_Functions[i].name; }
+private:
+  struct HookedFunction
+  {
+    const char *name;
+    uint32_t hash;
+    void **real;
+    void *hook;
+    bool keepExisting;
+  };
+
+  static const uint32_t EmptySlot = ~0U;
+
+  // FNV-1a
+  static uint32_t Hash(const char *str)
+  {
+    uint32_t hash = 2166136261U;
+    for(; *str; str++)
+      hash = (hash ^ (uint8_t)*str) * 16777619U;
+    return hash;
+  }
+
+  void Add(const char *name, void **real, void *hook, bool keepExisting)
+  {
+    m_Functions.push_back({name, Hash(name), real, hook, keepExisting});
+  }
+
+  bool Matches(uint32_t slot, const HookedFunction &f) const
+  {
+    return m_Functions[slot].hash == f.hash && !strcmp(m_Functions[slot].name, f.name);
   }
 
-  ForEachSupported(CheckFunction);
-  ForEachUnsupported(CheckUnsupported);
+  std::vector<HookedFunction> m_Functions;
+  std::vector<uint32_t> m_Slots;
+  uint32_t m_Mask = 0;
+};
+
+static const HookedFunctionTable &GetHookedFunctions()
+{
+  static HookedFunctionTable table;
+  return table;
+}
+
+void *HookedGetProcAddress(const char *func, void *realFunc)
+{
+  void *hook = GetHookedFunctions().Lookup(func, realFunc);
+  if(hook)
+    return hook;
 
   // for any other function, if it's not a core or extension function we know about,
   // return the real function pointer as this may be something internal
@@ -226,4 +429,200 @@ void GLHook::RegisterHooks()
 
 #if ENABLED(RDOC_APPLE)
 #include "apple_gl_hook_defs.h"
-#endif
\ No newline at end of file
+#endif
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#undef None
+
+#include "3rdparty/catch/catch.hpp"
+#include "common/timing.h"
+
+// the lookup as it was before the table, comparing against every name in turn. Kept to check the
+// table against and to compare its speed.
+static void *LinearGetProcAddress(const char *func)
+{
+#define LinearCheckFunction(function, name) \
+  if(!strcmp(func, STRINGIZE(name)))        \
+    return (void *)&CONCAT(function, _renderdoc_hooked);
+
+#define LinearCheckUnsupported(function)  \
+  if(!strcmp(func, STRINGIZE(function))) \
+    return (void *)&CONCAT(function, _renderdoc_hooked);
+
+  ForEachSupported(LinearCheckFunction);
+  ForEachUnsupported(LinearCheckUnsupported);
+
+  return NULL;
+}
+
+// passing NULL as the real function leaves the dispatch table as it is, so these can be looked up
+// without affecting anything.
+TEST_CASE("Check GL function lookup", "[gl][hooks]")
+{
+  const HookedFunctionTable &table = GetHookedFunctions();
+
+  REQUIRE(table.NumFunctions() > 1000);
+
+  for(size_t i = 0; i < table.NumFunctions(); i++)
+  {
+    const char *name = table.GetName(i);
+    void *hook = HookedGetProcAddress(name, NULL);
+
+    if(hook == NULL || hook != LinearGetProcAddress(name))
+    {
+      FAIL("Looking up " << name << " didn't return its hook");
+    }
+  }
+
+  // unknown functions get the real function back
+  int dummy = 0;
+  CHECK(HookedGetProcAddress("glNotARealFunction", &dummy) == &dummy);
+  CHECK(HookedGetProcAddress("", &dummy) == &dummy);
+
+  // names must match exactly
+  CHECK(HookedGetProcAddress("glDrawArray", NULL) == NULL);
+  CHECK(HookedGetProcAddress("glDrawArraysX", NULL) == NULL);
+  CHECK(HookedGetProcAddress("gldrawarrays", NULL) == NULL);
+  CHECK(HookedGetProcAddress("glDrawArrays", NULL) == LinearGetProcAddress("glDrawArrays"));
+};
+
+TEST_CASE("Check lock-free GL calls", "[gl][hooks]")
+{
+  SECTION("Calls that can block don't skip the lock")
+  {
+    CHECK_FALSE(lockFreeCalls.lockFree[(uint32_t)GLChunk::glClientWaitSync]);
+    CHECK_FALSE(lockFreeCalls.lockFree[(uint32_t)GLChunk::glAcquireKeyedMutexWin32EXT]);
+    CHECK_FALSE(lockFreeCalls.lockFree[(uint32_t)GLChunk::glBufferSubData]);
+
+    // these record into the resource or touch driver-wide state in the background
+    CHECK_FALSE(lockFreeCalls.lockFree[(uint32_t)GLChunk::glBindBuffer]);
+    CHECK_FALSE(lockFreeCalls.lockFree[(uint32_t)GLChunk::glBindTexture]);
+
+    CHECK(lockFreeCalls.lockFree[(uint32_t)GLChunk::glViewport]);
+    CHECK(lockFreeCalls.lockFree[(uint32_t)GLChunk::glBindVertexArray]);
+    // aliases are lock-free along with the function they alias
+    CHECK(lockFreeCalls.lockFree[(uint32_t)GLChunk::glBlendFunciARB]);
+  };
+
+  SECTION("No lock-free call is in progress once capturing starts")
+  {
+    const int numThreads = 4;
+
+    GLLockFreeCalls calls[numThreads];
+    volatile int32_t captureStarting = 0;
+    CaptureState state = CaptureState::BackgroundCapturing;
+
+    volatile int32_t captureStarted = 0, done = 0;
+    volatile int32_t lockFreeAfterStart = 0, stateChanged = 0, lockFree = 0, locked = 0;
+
+    std::vector<Threading::ThreadHandle> threads;
+
+    for(int t = 0; t < numThreads; t++)
+    {
+      GLLockFreeCalls *threadCalls = &calls[t];
+
+      threads.push_back(Threading::CreateThread([&, threadCalls]() {
+        while(Atomic::CmpExch32(&done, 0, 0) == 0)
+        {
+          if(threadCalls->Begin(captureStarting, state))
+          {
+            // once the capture has waited for calls in progress, none can still be running
+            if(Atomic::CmpExch32(&captureStarted, 0, 0) != 0)
+              Atomic::Inc32(&lockFreeAfterStart);
+
+            // and a call in progress never sees the state change, as a wrapper branching on it
+            // part way through would
+            for(int i = 0; i < 16; i++)
+            {
+              if(!IsBackgroundCapturing(*(volatile CaptureState *)&state))
+                Atomic::Inc32(&stateChanged);
+              Threading::Sleep(0);
+            }
+
+            Atomic::Inc32(&lockFree);
+            threadCalls->End();
+          }
+          else
+          {
+            Atomic::Inc32(&locked);
+          }
+        }
+      }));
+    }
+
+    // let the threads get going lock-free, then switch to capturing the way BeginActiveCapture does
+    while(Atomic::CmpExch32(&lockFree, 0, 0) < 1000)
+      Threading::Sleep(0);
+
+    Atomic::Inc32(&captureStarting);
+
+    for(int t = 0; t < numThreads; t++)
+      calls[t].Wait();
+
+    state = CaptureState::ActiveCapturing;
+
+    Atomic::Dec32(&captureStarting);
+
+    Atomic::Inc32(&captureStarted);
+
+    while(Atomic::CmpExch32(&locked, 0, 0) < 1000)
+      Threading::Sleep(0);
+
+    Atomic::Inc32(&done);
+
+    for(Threading::ThreadHandle t : threads)
+    {
+      Threading::JoinThread(t);
+      Threading::CloseThread(t);
+    }
+
+    CHECK(lockFreeAfterStart == 0);
+    CHECK(stateChanged == 0);
+  };
+};
+
+// hidden behind [.] so it doesn't run with the normal tests. Run it with "[benchmark][hooks]".
+TEST_CASE("Benchmark GL function lookup", "[.][benchmark][gl][hooks]")
+{
+  const HookedFunctionTable &table = GetHookedFunctions();
+
+  const size_t numFunctions = table.NumFunctions();
+  const int iterations = 10;
+
+  // the one-off cost paid on the first lookup
+  PerformanceTimer timer;
+  for(int i = 0; i < iterations; i++)
+  {
+    HookedFunctionTable built;
+    (void)built;
+  }
+  double buildTime = timer.GetMilliseconds() / iterations;
+
+  // resolving every function we know about, as a loader does at startup. The results are summed
+  // so that neither lookup can be optimised away.
+  uintptr_t tableSum = 0, linearSum = 0;
+
+  timer.Restart();
+  for(int i = 0; i < iterations; i++)
+    for(size_t f = 0; f < numFunctions; f++)
+      tableSum += (uintptr_t)HookedGetProcAddress(table.GetName(f), NULL);
+  double tableTime = timer.GetMilliseconds() / iterations;
+
+  timer.Restart();
+  for(int i = 0; i < iterations; i++)
+    for(size_t f = 0; f < numFunctions; f++)
+      linearSum += (uintptr_t)LinearGetProcAddress(table.GetName(f));
+  double linearTime = timer.GetMilliseconds() / iterations;
+
+  CHECK(tableSum == linearSum);
+
+  RecordBenchmark("functions", double(numFunctions), "functions");
+  RecordBenchmark("build table", buildTime, "ms");
+  RecordBenchmark("resolve all with table", tableTime, "ms");
+  RecordBenchmark("resolve all comparing names", linearTime, "ms");
+  RecordBenchmark("lookup with table", tableTime * 1000000.0 / numFunctions, "ns/function");
+  RecordBenchmark("lookup comparing names", linearTime * 1000000.0 / numFunctions, "ns/function");
+};
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -96,43 +96,63 @@ public:
         m_GLResourceRecords.erase(m_GLResourceRecords.begin());
     }
 
-    m_CurrentResourceIds.clear();
+    {
+      SCOPED_WRITELOCK(m_NameLock);
+      m_CurrentResourceIds.clear();
+    }
 
     ResourceManager::Shutdown();
   }
 
   void DeleteContext(void *context)
   {
-    size_t count = 0;
-    for(auto it = m_CurrentResourceIds.begin(); it != m_CurrentResourceIds.end();)
+    std::vector<ResourceId> ids;
+    size_t remaining = 0;
+
     {
-      if(it->first.ContextShareGroup == context && it->first.Namespace != eResSpecial)
-      {
-        ++count;
-        ResourceId res = it->second;
-        MarkCleanResource(res);
-        if(HasResourceRecord(res))
-          GetResourceRecord(res)->Delete(this);
-        ReleaseCurrentResource(it->second);
-        it = m_CurrentResourceIds.erase(it);
-      }
-      else
+      SCOPED_WRITELOCK(m_NameLock);
+
+      for(auto it = m_CurrentResourceIds.begin(); it != m_CurrentResourceIds.end();)
       {
-        ++it;
+        if(it->first.ContextShareGroup == context && it->first.Namespace != eResSpecial)
+        {
+          ids.push_back(it->second);
+          it = m_CurrentResourceIds.erase(it);
+        }
+        else
+        {
+          ++it;
+        }
       }
+
+      remaining = m_CurrentResourceIds.size();
     }
-    RDCDEBUG("Removed %zu/%zu resources belonging to context/sharegroup %p", count,
-             m_CurrentResourceIds.size(), context);
+
+    // deleting records can remove them from m_GLResourceRecords, so this is done outside the lock
+    for(ResourceId res : ids)
+    {
+      MarkCleanResource(res);
+      if(HasResourceRecord(res))
+        GetResourceRecord(res)->Delete(this);
+      ReleaseCurrentResource(res);
+    }
+
+    RDCDEBUG("Removed %zu/%zu resources belonging to context/sharegroup %p", ids.size(),
+             ids.size() + remaining, context);
   }
 
   inline void RemoveResourceRecord(ResourceId id)
   {
-    for(auto it = m_GLResourceRecords.begin(); it != m_GLResourceRecords.end(); it++)
     {
-      if(it->second->GetResourceID() == id)
+      SCOPED_WRITELOCK(m_NameLock);
+
+      for(auto it = m_GLResourceRecords.begin(); it != m_GLResourceRecords.end(); it++)
       {
-        m_GLResourceRecords.erase(it);
-        break;
+        if(it->second->GetResourceID() == id)
+        {
+          m_GLResourceRecords.erase(it);
+          break;
+        }
       }
     }
 
@@ -142,7 +162,12 @@ public:
   ResourceId RegisterResource(GLResource res)
   {
     ResourceId id = ResourceIDGen::GetNewUniqueID();
-    m_CurrentResourceIds[res] = id;
+
+    {
+      SCOPED_WRITELOCK(m_NameLock);
+      m_CurrentResourceIds[res] = id;
+    }
+
     AddCurrentResource(id, res);
     return id;
   }
@@ -151,6 +176,8 @@ public:
 
   bool HasCurrentResource(GLResource res)
   {
+    SCOPED_READLOCK(m_NameLock);
+
     auto it = m_CurrentResourceIds.find(res);
     if(it != m_CurrentResourceIds.end())
       return true;
@@ -160,16 +187,26 @@ public:
 
   void UnregisterResource(GLResource res)
   {
-    auto it = m_CurrentResourceIds.find(res);
-    if(it != m_CurrentResourceIds.end())
+    ResourceId id;
+
     {
-      ReleaseCurrentResource(it->second);
-      m_CurrentResourceIds.erase(res);
+      SCOPED_WRITELOCK(m_NameLock);
+
+      auto it = m_CurrentResourceIds.find(res);
+      if(it == m_CurrentResourceIds.end())
+        return;
+
+      id = it->second;
+      m_CurrentResourceIds.erase(it);
     }
+
+    ReleaseCurrentResource(id);
   }
 
   ResourceId GetID(GLResource res)
   {
+    SCOPED_READLOCK(m_NameLock);
+
     auto it = m_CurrentResourceIds.find(res);
     if(it != m_CurrentResourceIds.end())
       return it->second;
@@ -181,7 +218,11 @@ public:
     GLResourceRecord *ret = ResourceManager::AddResourceRecord(id);
     GLResource res = GetCurrentResource(id);
 
-    m_GLResourceRecords[res] = ret;
+    {
+      SCOPED_WRITELOCK(m_NameLock);
+      m_GLResourceRecords[res] = ret;
+    }
+
     ret->Resource = res;
 
     return ret;
@@ -194,9 +235,13 @@ public:
 
   GLResourceRecord *GetResourceRecord(GLResource res)
   {
-    auto it = m_GLResourceRecords.find(res);
-    if(it != m_GLResourceRecords.end())
-      return it->second;
+    {
+      SCOPED_READLOCK(m_NameLock);
+
+      auto it = m_GLResourceRecords.find(res);
+      if(it != m_GLResourceRecords.end())
+        return it->second;
+    }
 
     return ResourceManager::GetResourceRecord(GetID(res));
   }
@@ -265,6 +310,9 @@ private:
   void Create_InitialState(ResourceId id, GLResource live, bool hasData);
   void Apply_InitialState(GLResource live, GLInitialContents initial);
 
+  // some binds look up records without glLock while background capturing, so these maps are
+  // locked separately
+  Threading::RWLock m_NameLock;
   map<GLResource, GLResourceRecord *> m_GLResourceRecords;
 
   map<GLResource, ResourceId> m_CurrentResourceIds;
@@ -435,7 +435,9 @@ void GLReplay::InitPostVSBuffers(uint32_t eventId)
     uint32_t numIndices =
         RDCMIN(uint32_t(idxdata.size() / drawcall->indexByteWidth), drawcall->numIndices);
 
-    // grab all unique vertex indices referenced
+    // remapped[i] becomes the position of index i in the unique set of referenced indices
+    vector<uint32_t> remapped(numIndices);
+
     for(uint32_t i = 0; i < numIndices; i++)
     {
       uint32_t i32 = 0;
@@ -446,38 +448,17 @@ void GLReplay::InitPostVSBuffers(uint32_t eventId)
       else if(drawcall->indexByteWidth == 4)
         i32 = idx32[i];
 
-      auto it = std::lower_bound(indices.begin(), indices.end(), i32);
-
-      if(it != indices.end() && *it == i32)
-        continue;
-
-      indices.insert(it, i32);
+      remapped[i] = i32;
     }
 
     // if we read out of bounds, we'll also have a 0 index being referenced
-    // (as 0 is read). Don't insert 0 if we already have 0 though
-    if(numIndices < drawcall->numIndices && (indices.empty() || indices[0] != 0))
-      indices.insert(indices.begin(), 0);
-
-    // An index buffer could be something like: 500, 501, 502, 501, 503, 502
-    // in which case we can't use the existing index buffer without filling 499 slots of vertex
-    // data with padding. Instead we rebase the indices based on the smallest vertex so it becomes
-    // 0, 1, 2, 1, 3, 2 and then that matches our stream-out'd buffer.
-    //
-    // Note that there could also be gaps, like: 500, 501, 502, 510, 511, 512
-    // which would become 0, 1, 2, 3, 4, 5 and so the old index buffer would no longer be valid.
-    // We just stream-out a tightly packed list of unique indices, and then remap the index buffer
-    // so that what did point to 500 points to 0 (accounting for rebasing), and what did point
-    // to 510 now points to 3 (accounting for the unique sort).
-
-    // we use a map here since the indices may be sparse. Especially considering if an index
-    // is 'invalid' like 0xcccccccc then we don't want an array of 3.4 billion entries.
-    map<uint32_t, size_t> indexRemap;
-    for(size_t i = 0; i < indices.size(); i++)
-    {
-      // by definition, this index will only appear once in indices[]
-      indexRemap[indices[i]] = i;
-    }
+    // (as 0 is read).
+    if(numIndices < drawcall->numIndices)
+      remapped.push_back(0);
+
+    // rebase the indices to point into a tightly packed stream-out of the unique indices. See
+    // CompactIndexBuffer for details.
+    CompactIndexBuffer(remapped, indices);
 
     // generate a temporary index buffer with our 'unique index set' indices,
     // so we can transform feedback each referenced vertex once
@@ -562,7 +543,7 @@ void GLReplay::InitPostVSBuffers(uint32_t eventId)
         if(stripRestartValue && idx8[i] == stripRestartValue)
           continue;
 
-        idx8[i] = uint8_t(indexRemap[idx8[i]]);
+        idx8[i] = uint8_t(remapped[i]);
       }
     }
     else if(drawcall->indexByteWidth == 2)
@@ -575,7 +556,7 @@ void GLReplay::InitPostVSBuffers(uint32_t eventId)
         if(stripRestartValue && idx16[i] == stripRestartValue)
           continue;
 
-        idx16[i] = uint16_t(indexRemap[idx16[i]]);
+        idx16[i] = uint16_t(remapped[i]);
       }
     }
     else
@@ -588,7 +569,7 @@ void GLReplay::InitPostVSBuffers(uint32_t eventId)
         if(stripRestartValue && idx32[i] == stripRestartValue)
           continue;
 
-        idx32[i] = uint32_t(indexRemap[idx32[i]]);
+        idx32[i] = uint32_t(remapped[i]);
       }
     }
 
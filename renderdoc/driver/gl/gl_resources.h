@@ -137,6 +137,16 @@ struct GLResource
 
 DECLARE_REFLECTION_STRUCT(GLResource);
 
+template <>
+struct ConcurrentHash<GLResource>
+{
+  size_t operator()(const GLResource &res) const
+  {
+    return std::hash<void *>()(res.ContextShareGroup) ^
+           std::hash<uint64_t>()((uint64_t(res.Namespace) << 32) | res.name);
+  }
+};
+
 struct ContextPair
 {
   void *ctx;
@@ -309,10 +319,46 @@ private:
   size_t ShadowSize;
 };
 
+// counts the hooked calls in progress on a thread that skipped glLock. See
+// WrappedOpenGL::BeginLockFreeCall
+struct GLLockFreeCalls
+{
+  // returns true if a call can go ahead without the lock, in which case End must be called once it's
+  // complete. The state is only read once no capture is starting, so it can't change until End -
+  // see WrappedOpenGL::BeginActiveCapture.
+  bool Begin(volatile int32_t &captureStarting, const CaptureState &state)
+  {
+    // this is a full barrier, so either a capture starting sees the call in progress and waits for
+    // it, or we see that it's starting here and fall back to locking.
+    Atomic::Inc32(&count);
+
+    if(Atomic::CmpExch32(&captureStarting, 0, 0) == 0 && IsBackgroundCapturing(state))
+      return true;
+
+    Atomic::Dec32(&count);
+    return false;
+  }
+  void End() { Atomic::Dec32(&count); }
+  // waits for any calls that began before the state changed to finish. Lock-free calls never block
+  // on other threads, so this doesn't wait long even with glLock held.
+  void Wait()
+  {
+    // the compare-exchange is a full barrier, so it can't read the count before the state changed
+    while(Atomic::CmpExch32(&count, 0, 0) != 0)
+      Threading::Sleep(0);
+  }
+
+  volatile int32_t count = 0;
+};
+
 struct GLContextTLSData
 {
   GLContextTLSData() {}
   GLContextTLSData(ContextPair p, GLResourceRecord *r) : ctxPair(p), ctxRecord(r) {}
   ContextPair ctxPair;
   GLResourceRecord *ctxRecord;
+  // the driver's ContextData for ctxPair.ctx, so it doesn't have to be looked up on every call
+  void *ctxData = NULL;
+  // the hooked calls in progress on this thread that didn't take the lock
+  GLLockFreeCalls lockFreeCalls;
 };
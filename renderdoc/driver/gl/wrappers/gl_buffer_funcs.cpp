@@ -2620,11 +2620,16 @@ void WrappedOpenGL::PersistentMapMemoryBarrier(const set<GLResourceRecord *> &ma
 
     RDCASSERT(record && record->Map.persistentPtr);
 
-    size_t diffStart = 0, diffEnd = 0;
-    bool found = FindDiffRange(record->GetShadowPtr(0), record->GetShadowPtr(1),
-                               (size_t)record->Length, diffStart, diffEnd);
-    if(found)
+    // flush each modified region on its own, so that scattered writes to a large buffer don't
+    // serialise everything between them
+    std::vector<std::pair<size_t, size_t> > ranges;
+    FindDiffRanges(record->GetShadowPtr(0), record->GetShadowPtr(1), (size_t)record->Length, 4096,
+                   ranges);
+
+    for(const std::pair<size_t, size_t> &range : ranges)
     {
+      size_t diffStart = range.first, diffEnd = range.second;
+
       // update the modified region in the 'comparison' shadow buffer for next check
       memcpy(record->GetShadowPtr(1) + diffStart, record->GetShadowPtr(0) + diffStart,
              diffEnd - diffStart);
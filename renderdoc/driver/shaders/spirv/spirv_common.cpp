@@ -61,6 +61,50 @@ void ShutdownSPIRVCompiler()
   }
 }
 
+// most modules fit in a handful of chunks this size
+static const size_t ArenaChunkSize = 64 * 1024;
+
+void *SPVArena::Alloc(size_t size, size_t align)
+{
+  if(!m_Chunks.empty())
+  {
+    Chunk &chunk = m_Chunks.back();
+    size_t offs = AlignUp(chunk.used, align);
+    if(offs + size <= chunk.size)
+    {
+      chunk.used = offs + size;
+      return chunk.data + offs;
+    }
+  }
+
+  // new allocations are aligned for any type
+  Chunk chunk;
+  chunk.size = RDCMAX(ArenaChunkSize, size);
+  chunk.data = new byte[chunk.size];
+  chunk.used = size;
+  m_Chunks.push_back(chunk);
+  return chunk.data;
+}
+
+void SPVArena::Clear()
+{
+  for(size_t i = m_Destructors.size(); i > 0; i--)
+    m_Destructors[i - 1].destroy(m_Destructors[i - 1].obj);
+  m_Destructors.clear();
+
+  for(Chunk &chunk : m_Chunks)
+    delete[] chunk.data;
+  m_Chunks.clear();
+}
+
+size_t SPVArena::GetReservedBytes() const
+{
+  size_t ret = 0;
+  for(const Chunk &chunk : m_Chunks)
+    ret += chunk.size;
+  return ret;
+}
+
 void SPIRVFillCBufferVariables(const rdcarray<ShaderConstant> &invars,
                                vector<ShaderVariable> &outvars, const bytebuf &data,
                                size_t baseOffset)
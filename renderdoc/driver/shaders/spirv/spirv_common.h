@@ -26,6 +26,7 @@
 
 #include <stdint.h>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 #include "3rdparty/glslang/SPIRV/spirv.hpp"
@@ -104,10 +105,79 @@ struct SPIRVPatchData
   Topology outTopo = Topology::Unknown;
 };
 
+// bump allocator that owns every object making up a parsed SPVModule. Parsing creates several
+// small objects per instruction, so rather than a heap allocation each they're packed into large
+// chunks and all freed together with the module. Pointers stay valid until Clear().
+class SPVArena
+{
+public:
+  SPVArena() = default;
+  ~SPVArena() { Clear(); }
+  SPVArena(const SPVArena &) = delete;
+  SPVArena &operator=(const SPVArena &) = delete;
+  SPVArena(SPVArena &&o) { *this = std::move(o); }
+  SPVArena &operator=(SPVArena &&o)
+  {
+    if(this != &o)
+    {
+      Clear();
+      m_Chunks.swap(o.m_Chunks);
+      m_Destructors.swap(o.m_Destructors);
+    }
+    return *this;
+  }
+
+  template <typename T>
+  T *New()
+  {
+    T *ret = new(Alloc(sizeof(T), alignof(T))) T();
+    if(!std::is_trivially_destructible<T>::value)
+      m_Destructors.push_back({ret, &Destroy<T>});
+    return ret;
+  }
+
+  // destroys all objects in reverse order of creation and frees the memory
+  void Clear();
+
+  // total bytes in chunks owned by the arena, used or not
+  size_t GetReservedBytes() const;
+
+private:
+  template <typename T>
+  static void Destroy(void *obj)
+  {
+    ((T *)obj)->~T();
+  }
+
+  void *Alloc(size_t size, size_t align);
+
+  struct Chunk
+  {
+    byte *data;
+    size_t size;
+    size_t used;
+  };
+
+  struct Destructor
+  {
+    void *obj;
+    void (*destroy)(void *);
+  };
+
+  std::vector<Chunk> m_Chunks;
+  std::vector<Destructor> m_Destructors;
+};
+
 struct SPVModule
 {
   SPVModule();
   ~SPVModule();
+  SPVModule(SPVModule &&) = default;
+  SPVModule &operator=(SPVModule &&) = default;
+
+  // owns all instructions and the data hanging off them. Declared first so that it's destroyed
+  // after the vectors below which point into it.
+  SPVArena arena;
 
   vector<uint32_t> spirv;
 
@@ -889,19 +889,6 @@ struct SPVInstruction
     source.col = source.line = 0;
   }
 
-  ~SPVInstruction()
-  {
-    SAFE_DELETE(ext);
-    SAFE_DELETE(entry);
-    SAFE_DELETE(op);
-    SAFE_DELETE(flow);
-    SAFE_DELETE(type);
-    SAFE_DELETE(func);
-    SAFE_DELETE(block);
-    SAFE_DELETE(constant);
-    SAFE_DELETE(var);
-  }
-
   spv::Op opcode;
   uint32_t id;
 
@@ -2134,9 +2121,7 @@ SPVModule::SPVModule()
 
 SPVModule::~SPVModule()
 {
-  for(size_t i = 0; i < operations.size(); i++)
-    delete operations[i];
-  operations.clear();
+  // instructions and their data are owned by the arena
 }
 
 SPVInstruction *SPVModule::GetByID(uint32_t id)
@@ -2148,7 +2133,7 @@ SPVInstruction *SPVModule::GetByID(uint32_t id)
   // an ID, it won't be in our list so we have to add a dummy instruction for it
   RDCWARN("Expected to find ID %u but didn't - returning dummy instruction", id);
 
-  operations.push_back(new SPVInstruction());
+  operations.push_back(arena.New<SPVInstruction>());
   SPVInstruction &op = *operations.back();
   op.opcode = spv::OpUnknown;
   op.id = id;
@@ -4738,12 +4723,20 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
   SPVFunction *curFunc = NULL;
   SPVBlock *curBlock = NULL;
 
+  // count the instructions up front so the operations list is allocated once
+  size_t numInstructions = 0;
+  for(size_t it = 5; it < spirvLength; numInstructions++)
+    it += RDCMAX(1U, spirv[it] >> spv::WordCountShift);
+  module.operations.reserve(numInstructions);
+
+  SPVArena &arena = module.arena;
+
   size_t it = 5;
   while(it < spirvLength)
   {
     uint16_t WordCount = spirv[it] >> spv::WordCountShift;
 
-    module.operations.push_back(new SPVInstruction());
+    module.operations.push_back(arena.New<SPVInstruction>());
     SPVInstruction &op = *module.operations.back();
 
     op.opcode = spv::Op(spirv[it] & spv::OpCodeMask);
@@ -4875,7 +4868,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpEntryPoint:
       {
-        op.entry = new SPVEntryPoint();
+        op.entry = arena.New<SPVEntryPoint>();
         op.entry->func = spirv[it + 2];
         op.entry->model = spv::ExecutionModel(spirv[it + 1]);
         op.entry->name = (const char *)&spirv[it + 3];
@@ -4909,7 +4902,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpExtInstImport:
       {
-        op.ext = new SPVExtInstSet();
+        op.ext = arena.New<SPVExtInstSet>();
         op.ext->setname = (const char *)&spirv[it + 2];
         op.ext->canonicalNames = NULL;
 
@@ -4935,7 +4928,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       // Type opcodes
       case spv::OpTypeVoid:
       {
-        op.type = new SPVTypeData();
+        op.type = arena.New<SPVTypeData>();
         op.type->type = SPVTypeData::eVoid;
 
         op.id = spirv[it + 1];
@@ -4944,7 +4937,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpTypeBool:
       {
-        op.type = new SPVTypeData();
+        op.type = arena.New<SPVTypeData>();
         op.type->type = SPVTypeData::eBool;
 
         op.id = spirv[it + 1];
@@ -4953,7 +4946,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpTypeInt:
       {
-        op.type = new SPVTypeData();
+        op.type = arena.New<SPVTypeData>();
         op.type->type = spirv[it + 3] ? SPVTypeData::eSInt : SPVTypeData::eUInt;
         op.type->bitCount = spirv[it + 2];
 
@@ -4963,7 +4956,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpTypeFloat:
       {
-        op.type = new SPVTypeData();
+        op.type = arena.New<SPVTypeData>();
         op.type->type = SPVTypeData::eFloat;
         op.type->bitCount = spirv[it + 2];
 
@@ -4973,7 +4966,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpTypeVector:
       {
-        op.type = new SPVTypeData();
+        op.type = arena.New<SPVTypeData>();
         op.type->type = SPVTypeData::eVector;
 
         SPVInstruction *baseTypeInst = module.GetByID(spirv[it + 2]);
@@ -4988,7 +4981,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpTypeMatrix:
       {
-        op.type = new SPVTypeData();
+        op.type = arena.New<SPVTypeData>();
         op.type->type = SPVTypeData::eMatrix;
 
         SPVInstruction *baseTypeInst = module.GetByID(spirv[it + 2]);
@@ -5006,7 +4999,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpTypeArray:
       {
-        op.type = new SPVTypeData();
+        op.type = arena.New<SPVTypeData>();
         op.type->type = SPVTypeData::eArray;
 
         SPVInstruction *baseTypeInst = module.GetByID(spirv[it + 2]);
@@ -5025,7 +5018,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpTypeRuntimeArray:
       {
-        op.type = new SPVTypeData();
+        op.type = arena.New<SPVTypeData>();
         op.type->type = SPVTypeData::eArray;
 
         SPVInstruction *baseTypeInst = module.GetByID(spirv[it + 2]);
@@ -5040,7 +5033,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpTypeStruct:
       {
-        op.type = new SPVTypeData();
+        op.type = arena.New<SPVTypeData>();
         op.type->type = SPVTypeData::eStruct;
         op.type->id = spirv[it + 1];
 
@@ -5062,7 +5055,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpTypePointer:
       {
-        op.type = new SPVTypeData();
+        op.type = arena.New<SPVTypeData>();
         op.type->type = SPVTypeData::ePointer;
 
         SPVInstruction *baseTypeInst = module.GetByID(spirv[it + 3]);
@@ -5077,7 +5070,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpTypeImage:
       {
-        op.type = new SPVTypeData();
+        op.type = arena.New<SPVTypeData>();
         op.type->type = SPVTypeData::eImage;
 
         SPVInstruction *baseTypeInst = module.GetByID(spirv[it + 2]);
@@ -5100,7 +5093,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpTypeSampler:
       {
-        op.type = new SPVTypeData();
+        op.type = arena.New<SPVTypeData>();
         op.type->type = SPVTypeData::eSampler;
 
         op.id = spirv[it + 1];
@@ -5109,7 +5102,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpTypeSampledImage:
       {
-        op.type = new SPVTypeData();
+        op.type = arena.New<SPVTypeData>();
         op.type->type = SPVTypeData::eSampledImage;
 
         SPVInstruction *baseTypeInst = module.GetByID(spirv[it + 2]);
@@ -5123,7 +5116,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpTypeFunction:
       {
-        op.type = new SPVTypeData();
+        op.type = arena.New<SPVTypeData>();
         op.type->type = SPVTypeData::eFunction;
 
         for(int i = 3; i < WordCount; i++)
@@ -5156,7 +5149,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.constant = new SPVConstant();
+        op.constant = arena.New<SPVConstant>();
         op.constant->specialized =
             (op.opcode == spv::OpSpecConstantTrue || op.opcode == spv::OpSpecConstantFalse);
         op.constant->type = typeInst->type;
@@ -5173,7 +5166,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.constant = new SPVConstant();
+        op.constant = arena.New<SPVConstant>();
         op.constant->type = typeInst->type;
 
         op.constant->u32 = 0;
@@ -5188,7 +5181,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.constant = new SPVConstant();
+        op.constant = arena.New<SPVConstant>();
         op.constant->specialized = op.opcode == spv::OpSpecConstant;
         op.constant->type = typeInst->type;
 
@@ -5215,7 +5208,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.constant = new SPVConstant();
+        op.constant = arena.New<SPVConstant>();
         op.constant->specialized = op.opcode == spv::OpSpecConstantComposite;
         op.constant->type = typeInst->type;
 
@@ -5237,7 +5230,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.constant = new SPVConstant();
+        op.constant = arena.New<SPVConstant>();
         op.constant->type = typeInst->type;
 
         op.constant->sampler.addressing = spv::SamplerAddressingMode(spirv[it + 3]);
@@ -5254,7 +5247,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.constant = new SPVConstant();
+        op.constant = arena.New<SPVConstant>();
         op.constant->specialized = true;
         op.constant->type = typeInst->type;
 
@@ -5283,7 +5276,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 4]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.func = new SPVFunction();
+        op.func = arena.New<SPVFunction>();
         op.func->retType = retTypeInst->type;
         op.func->funcType = typeInst->type;
         op.func->control = spv::FunctionControlMask(spirv[it + 3]);
@@ -5320,7 +5313,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.var = new SPVVariable();
+        op.var = arena.New<SPVVariable>();
         op.var->type = typeInst->type;
         op.var->storage = spv::StorageClass(spirv[it + 3]);
 
@@ -5345,7 +5338,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.var = new SPVVariable();
+        op.var = arena.New<SPVVariable>();
         op.var->type = typeInst->type;
         op.var->storage = spv::StorageClassFunction;
 
@@ -5360,7 +5353,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       // Branching/flow control
       case spv::OpLabel:
       {
-        op.block = new SPVBlock();
+        op.block = arena.New<SPVBlock>();
 
         RDCASSERT(curFunc);
 
@@ -5375,7 +5368,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       case spv::OpUnreachable:
       case spv::OpReturn:
       {
-        op.flow = new SPVFlowControl();
+        op.flow = arena.New<SPVFlowControl>();
 
         curBlock->exitFlow = &op;
         curBlock = NULL;
@@ -5383,7 +5376,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpReturnValue:
       {
-        op.flow = new SPVFlowControl();
+        op.flow = arena.New<SPVFlowControl>();
 
         op.flow->targets.push_back(spirv[it + 1]);
 
@@ -5393,7 +5386,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpBranch:
       {
-        op.flow = new SPVFlowControl();
+        op.flow = arena.New<SPVFlowControl>();
 
         op.flow->targets.push_back(spirv[it + 1]);
 
@@ -5403,7 +5396,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpBranchConditional:
       {
-        op.flow = new SPVFlowControl();
+        op.flow = arena.New<SPVFlowControl>();
 
         SPVInstruction *condInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(condInst);
@@ -5424,7 +5417,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpSwitch:
       {
-        op.flow = new SPVFlowControl();
+        op.flow = arena.New<SPVFlowControl>();
 
         SPVInstruction *condInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(condInst);
@@ -5451,7 +5444,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpSelectionMerge:
       {
-        op.flow = new SPVFlowControl();
+        op.flow = arena.New<SPVFlowControl>();
 
         op.flow->targets.push_back(spirv[it + 1]);
         op.flow->selControl = spv::SelectionControlMask(spirv[it + 2]);
@@ -5461,7 +5454,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       }
       case spv::OpLoopMerge:
       {
-        op.flow = new SPVFlowControl();
+        op.flow = arena.New<SPVFlowControl>();
 
         op.flow->targets.push_back(spirv[it + 1]);
         op.flow->loopControl = spv::LoopControlMask(spirv[it + 2]);
@@ -5476,7 +5469,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.op = new SPVOperation();
+        op.op = arena.New<SPVOperation>();
         op.op->type = typeInst->type;
 
         SPVInstruction *ptrInst = module.GetByID(spirv[it + 3]);
@@ -5497,7 +5490,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       case spv::OpStore:
       case spv::OpCopyMemory:
       {
-        op.op = new SPVOperation();
+        op.op = arena.New<SPVOperation>();
         op.op->type = NULL;
 
         SPVInstruction *ptrInst = module.GetByID(spirv[it + 1]);
@@ -5521,7 +5514,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.op = new SPVOperation();
+        op.op = arena.New<SPVOperation>();
         op.op->type = typeInst->type;
 
         for(int i = 3; i < WordCount; i += 2)
@@ -5550,7 +5543,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.op = new SPVOperation();
+        op.op = arena.New<SPVOperation>();
         op.op->type = typeInst->type;
 
         SPVInstruction *imageInst = module.GetByID(spirv[it + 3]);
@@ -5657,7 +5650,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
           default: break;
         }
 
-        op.op = new SPVOperation();
+        op.op = arena.New<SPVOperation>();
 
         if(op.opcode != spv::OpImageWrite)
         {
@@ -5905,7 +5898,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
 
         word++;
 
-        op.op = new SPVOperation();
+        op.op = arena.New<SPVOperation>();
         op.op->type = typeInst->type;
         op.op->mathop = mathop;
 
@@ -5944,7 +5937,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       {
         // these don't emit an ID, don't take a type, they are just
         // single operations
-        op.op = new SPVOperation();
+        op.op = arena.New<SPVOperation>();
         op.op->type = NULL;
 
         curBlock->instructions.push_back(&op);
@@ -5954,7 +5947,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       case spv::OpMemoryBarrier:
       {
         // these don't emit an ID, just have some properties
-        op.op = new SPVOperation();
+        op.op = arena.New<SPVOperation>();
         op.op->type = NULL;
 
         int word = 1;
@@ -5998,7 +5991,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.op = new SPVOperation();
+        op.op = arena.New<SPVOperation>();
         op.op->type = typeInst->type;
 
         {
@@ -6029,7 +6022,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + 1]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.op = new SPVOperation();
+        op.op = arena.New<SPVOperation>();
         op.op->type = typeInst->type;
 
         {
@@ -6065,7 +6058,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
         SPVInstruction *typeInst = module.GetByID(spirv[it + word]);
         RDCASSERT(typeInst && typeInst->type);
 
-        op.op = new SPVOperation();
+        op.op = arena.New<SPVOperation>();
         op.op->type = typeInst->type;
 
         word++;
@@ -6129,7 +6122,7 @@ void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module)
       {
         int word = 1;
 
-        op.op = new SPVOperation();
+        op.op = arena.New<SPVOperation>();
 
         // all atomic operations but store return a new ID of a given type
         if(op.opcode != spv::OpAtomicStore)
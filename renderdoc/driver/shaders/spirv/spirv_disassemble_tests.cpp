@@ -0,0 +1,339 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "common/common.h"
+#include "common/globalconfig.h"
+#include "common/timing.h"
+#include "data/glsl_shaders.h"
+#include "os/os_specific.h"
+#include "spirv_common.h"
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "3rdparty/catch/catch.hpp"
+
+struct ArenaTracked
+{
+  ArenaTracked() { order.push_back(this); }
+  ~ArenaTracked() { destroyed.push_back(this); }
+  std::string str = "a string long enough to need its own heap allocation";
+
+  static std::vector<ArenaTracked *> order;
+  static std::vector<ArenaTracked *> destroyed;
+};
+
+std::vector<ArenaTracked *> ArenaTracked::order;
+std::vector<ArenaTracked *> ArenaTracked::destroyed;
+
+TEST_CASE("Test SPIR-V arena allocation", "[spirv]")
+{
+  ArenaTracked::order.clear();
+  ArenaTracked::destroyed.clear();
+
+  SECTION("Objects are constructed, aligned and destroyed in reverse order")
+  {
+    {
+      SPVArena arena;
+
+      for(int i = 0; i < 5000; i++)
+      {
+        arena.New<uint8_t>();
+        ArenaTracked *obj = arena.New<ArenaTracked>();
+        CHECK(((uintptr_t)obj % alignof(ArenaTracked)) == 0);
+        CHECK(obj->str.size() > 0);
+
+        double *d = arena.New<double>();
+        CHECK(((uintptr_t)d % alignof(double)) == 0);
+        CHECK(*d == 0.0);
+      }
+
+      // more than one chunk was needed
+      CHECK(arena.GetReservedBytes() > 5000 * sizeof(ArenaTracked));
+      CHECK(ArenaTracked::destroyed.empty());
+    }
+
+    REQUIRE(ArenaTracked::destroyed.size() == ArenaTracked::order.size());
+
+    std::vector<ArenaTracked *> reversed(ArenaTracked::order.rbegin(), ArenaTracked::order.rend());
+    CHECK((ArenaTracked::destroyed == reversed));
+  };
+
+  SECTION("Moving transfers ownership")
+  {
+    SPVArena a;
+    ArenaTracked *obj = a.New<ArenaTracked>();
+
+    SPVArena b(std::move(a));
+    CHECK(a.GetReservedBytes() == 0);
+    CHECK(b.GetReservedBytes() > 0);
+
+    a.Clear();
+    CHECK(ArenaTracked::destroyed.empty());
+
+    b = SPVArena();
+    REQUIRE(ArenaTracked::destroyed.size() == 1);
+    CHECK(ArenaTracked::destroyed[0] == obj);
+  };
+};
+
+struct CorpusShader
+{
+  const char *name;
+  std::string source;
+  SPIRVShaderStage stage;
+  ShaderStage refStage;
+  const char *defines;
+};
+
+// compiles the built-in GLSL shaders as Vulkan SPIR-V, as a corpus of real modules
+static std::vector<std::pair<CorpusShader, std::vector<uint32_t> > > CompileCorpus()
+{
+  InitSPIRVCompiler();
+
+  const char *texDefines =
+      "#define SHADER_RESTYPE 1\n#define UINT_TEX 0\n#define SINT_TEX 0\n#define HISTOGRAM_UBOS\n";
+
+  CorpusShader shaders[] = {
+      {"blit.vert", GetEmbeddedResource(glsl_blit_vert), SPIRVShaderStage::Vertex,
+       ShaderStage::Vertex, ""},
+      {"checkerboard.frag", GetEmbeddedResource(glsl_checkerboard_frag),
+       SPIRVShaderStage::Fragment, ShaderStage::Fragment, ""},
+      {"texdisplay.frag", GetEmbeddedResource(glsl_texdisplay_frag), SPIRVShaderStage::Fragment,
+       ShaderStage::Fragment, ""},
+      {"mesh.vert", GetEmbeddedResource(glsl_mesh_vert), SPIRVShaderStage::Vertex,
+       ShaderStage::Vertex, ""},
+      {"mesh.geom", GetEmbeddedResource(glsl_mesh_geom), SPIRVShaderStage::Geometry,
+       ShaderStage::Geometry, ""},
+      {"mesh.frag", GetEmbeddedResource(glsl_mesh_frag), SPIRVShaderStage::Fragment,
+       ShaderStage::Fragment, ""},
+      {"mesh.comp", GetEmbeddedResource(glsl_mesh_comp), SPIRVShaderStage::Compute,
+       ShaderStage::Compute, ""},
+      {"trisize.geom", GetEmbeddedResource(glsl_trisize_geom), SPIRVShaderStage::Geometry,
+       ShaderStage::Geometry, ""},
+      {"minmaxtile.comp", GetEmbeddedResource(glsl_minmaxtile_comp), SPIRVShaderStage::Compute,
+       ShaderStage::Compute, texDefines},
+      {"minmaxresult.comp", GetEmbeddedResource(glsl_minmaxresult_comp),
+       SPIRVShaderStage::Compute, ShaderStage::Compute, texDefines},
+      {"histogram.comp", GetEmbeddedResource(glsl_histogram_comp), SPIRVShaderStage::Compute,
+       ShaderStage::Compute, texDefines},
+      {"quadresolve.frag", GetEmbeddedResource(glsl_quadresolve_frag),
+       SPIRVShaderStage::Fragment, ShaderStage::Fragment, ""},
+      {"array2ms.comp", GetEmbeddedResource(glsl_array2ms_comp), SPIRVShaderStage::Compute,
+       ShaderStage::Compute, ""},
+  };
+
+  std::vector<std::pair<CorpusShader, std::vector<uint32_t> > > ret;
+
+  for(const CorpusShader &shader : shaders)
+  {
+    std::vector<std::string> sources;
+    GenerateGLSLShader(sources, eShaderVulkan, shader.defines, shader.source, 430);
+
+    SPIRVCompilationSettings settings;
+    settings.stage = shader.stage;
+    settings.lang = SPIRVSourceLanguage::VulkanGLSL;
+
+    std::vector<uint32_t> spirv;
+    std::string errors = CompileSPIRV(settings, sources, spirv);
+
+    INFO(shader.name << ": " << errors);
+    CHECK(!spirv.empty());
+
+    if(!spirv.empty())
+      ret.push_back(std::make_pair(shader, spirv));
+  }
+
+  return ret;
+}
+
+static void Reflect(const SPVModule &module, ShaderStage stage, ShaderReflection &refl)
+{
+  ShaderBindpointMapping mapping;
+  SPIRVPatchData patchData;
+  module.MakeReflection(stage, "main", refl, mapping, patchData);
+}
+
+TEST_CASE("Test parsing built-in shaders", "[spirv]")
+{
+  std::vector<std::pair<CorpusShader, std::vector<uint32_t> > > corpus = CompileCorpus();
+
+  REQUIRE(!corpus.empty());
+
+  for(auto &shader : corpus)
+  {
+    INFO(shader.first.name);
+
+    SPVModule module;
+    ParseSPIRV(shader.second.data(), shader.second.size(), module);
+
+    CHECK(!module.operations.empty());
+    CHECK(module.arena.GetReservedBytes() > 0);
+    CHECK((module.EntryPoints() == std::vector<std::string>({"main"})));
+
+    std::string disasm = module.Disassemble("main");
+    CHECK(disasm.find("main") != std::string::npos);
+
+    ShaderReflection refl;
+    Reflect(module, shader.first.refStage, refl);
+    CHECK(refl.stage == shader.first.refStage);
+
+    // disassembly updates the module as it goes, so compare against a fresh parse
+    SPVModule reparsed;
+    ParseSPIRV(shader.second.data(), shader.second.size(), reparsed);
+
+    CHECK(disasm == reparsed.Disassemble("main"));
+
+    // moving a module takes its arena along, so everything it points to stays valid
+    SPVModule moved(std::move(module));
+    CHECK(module.operations.empty());
+
+    ShaderReflection refl2;
+    Reflect(moved, shader.first.refStage, refl2);
+    CHECK(refl.readOnlyResources.size() == refl2.readOnlyResources.size());
+    CHECK(refl.readWriteResources.size() == refl2.readWriteResources.size());
+    CHECK(refl.constantBlocks.size() == refl2.constantBlocks.size());
+    CHECK(refl.inputSignature.size() == refl2.inputSignature.size());
+    CHECK(refl.outputSignature.size() == refl2.outputSignature.size());
+  }
+};
+
+// Shaders from real applications are typically much larger than our built-in ones, so the
+// built-in corpus mostly measures fixed per-module costs. To benchmark representative modules, set
+// RENDERDOC_SPIRV_CORPUS to a directory of .spv files - e.g. saved from captures' shader modules.
+static std::vector<std::pair<std::string, std::vector<uint32_t> > > LoadBenchmarkCorpus()
+{
+  std::vector<std::pair<std::string, std::vector<uint32_t> > > ret;
+
+  const char *dir = Process::GetEnvVariable("RENDERDOC_SPIRV_CORPUS");
+
+  if(dir && dir[0])
+  {
+    for(const PathEntry &entry : FileIO::GetFilesInDirectory(dir))
+    {
+      std::string filename = entry.filename.c_str();
+
+      if(entry.flags & PathProperty::Directory)
+        continue;
+      if(filename.size() < 4 || filename.substr(filename.size() - 4) != ".spv")
+        continue;
+
+      std::vector<unsigned char> bytes;
+      if(!FileIO::slurp((std::string(dir) + "/" + filename).c_str(), bytes) || bytes.size() < 20 ||
+         (bytes.size() % sizeof(uint32_t)) != 0)
+        continue;
+
+      std::vector<uint32_t> spirv(bytes.size() / sizeof(uint32_t));
+      memcpy(spirv.data(), bytes.data(), bytes.size());
+
+      if(spirv[0] != spv::MagicNumber)
+        continue;
+
+      ret.push_back(std::make_pair(filename, spirv));
+    }
+
+    WARN("Benchmarking " << ret.size() << " modules from " << dir);
+  }
+  else
+  {
+    for(auto &shader : CompileCorpus())
+      ret.push_back(std::make_pair(std::string(shader.first.name), shader.second));
+
+    WARN("Benchmarking the built-in shaders only, which aren't representative of application "
+         "shaders. Set RENDERDOC_SPIRV_CORPUS to a directory of .spv files from captures.");
+  }
+
+  return ret;
+}
+
+// Hidden behind [.] so it doesn't run with the normal tests. Run it with "[benchmark][spirv]".
+TEST_CASE("Benchmark parsing SPIR-V modules", "[.][benchmark][spirv]")
+{
+  std::vector<std::pair<std::string, std::vector<uint32_t> > > corpus = LoadBenchmarkCorpus();
+
+  REQUIRE(!corpus.empty());
+
+  const int iterations = 50;
+
+  size_t numInstructions = 0;
+  size_t arenaBytes = 0;
+  double parseTime = 0.0, reflectTime = 0.0, disasmTime = 0.0;
+
+  for(int i = 0; i < iterations; i++)
+  {
+    for(auto &shader : corpus)
+    {
+      PerformanceTimer timer;
+
+      SPVModule *module = new SPVModule;
+      ParseSPIRV(shader.second.data(), shader.second.size(), *module);
+
+      parseTime += timer.GetMicroseconds();
+
+      if(i == 0)
+      {
+        numInstructions += module->operations.size();
+        arenaBytes += module->arena.GetReservedBytes();
+      }
+
+      std::vector<std::string> entries = module->EntryPoints();
+      std::string entry = entries.empty() ? "main" : entries[0];
+
+      timer.Restart();
+
+      ShaderReflection refl;
+      ShaderBindpointMapping mapping;
+      SPIRVPatchData patchData;
+      module->MakeReflection(module->StageForEntry(entry), entry, refl, mapping, patchData);
+
+      reflectTime += timer.GetMicroseconds();
+
+      timer.Restart();
+
+      module->Disassemble(entry);
+
+      disasmTime += timer.GetMicroseconds();
+
+      // freeing the module is part of the parse cost
+      timer.Restart();
+
+      delete module;
+
+      parseTime += timer.GetMicroseconds();
+    }
+  }
+
+  double numModules = double(iterations * corpus.size());
+
+  RecordBenchmark("corpus modules", double(corpus.size()), "modules");
+  RecordBenchmark("corpus instructions", double(numInstructions), "instructions");
+  RecordBenchmark("arena size", double(arenaBytes) / double(numInstructions), "bytes/instruction");
+  RecordBenchmark("parse and free", parseTime / numModules, "us/module");
+  RecordBenchmark("parse and free per instruction",
+                  parseTime * 1000.0 / (double(numInstructions) * iterations),
+                  "ns/instruction");
+  RecordBenchmark("reflect", reflectTime / numModules, "us/module");
+  RecordBenchmark("disassemble", disasmTime / numModules, "us/module");
+};
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
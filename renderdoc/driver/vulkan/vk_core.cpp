@@ -24,7 +24,6 @@
 
 #include "vk_core.h"
 #include "driver/ihv/amd/amd_rgp.h"
-#include "jpeg-compressor/jpge.h"
 #include "maths/formatpacking.h"
 #include "serialise/rdcfile.h"
 #include "strings/string_utils.h"
@@ -121,6 +120,11 @@ WrappedVulkan::WrappedVulkan() : m_RenderState(this, &m_CreationInfo)
   tempMemoryTLSSlot = Threading::AllocateTLSSlot();
   debugMessageSinkTLSSlot = Threading::AllocateTLSSlot();
 
+  // this is opt-in, since while pages are write protected the application can't pass pointers into
+  // its maps to system calls that would write to them - they fail instead of faulting.
+  const char *writeWatch = Process::GetEnvVariable("RENDERDOC_VULKAN_WRITE_WATCH_MAPS");
+  m_WriteWatchMaps = WriteWatch::IsSupported() && writeWatch && writeWatch[0] == '1';
+
   m_RootEventID = 1;
   m_RootDrawcallID = 1;
   m_FirstEventID = 0;
@@ -518,7 +522,11 @@ WriteSerialiser &WrappedVulkan::GetThreadSerialiser()
 {
   WriteSerialiser *ser = (WriteSerialiser *)Threading::GetTLSValue(threadSerialiserTLSSlot);
   if(ser)
+  {
+    // sub-allocate chunks only while capturing a frame, since they're all freed when it ends.
+    ser->SetChunkArena(IsActiveCapturing(m_State));
     return *ser;
+  }
 
   // slow path, but rare
   ser = new WriteSerialiser(new StreamWriter(1024), Ownership::Stream);
@@ -1362,6 +1370,7 @@ bool WrappedVulkan::EndFrameCapture(void *dev, void *wnd)
         FreeAlignedBuffer((*it)->memMapState->refData);
         (*it)->memMapState->refData = NULL;
         (*it)->memMapState->needRefData = false;
+        StopWriteWatch(*(*it)->memMapState);
       }
     }
   }
@@ -1644,59 +1653,27 @@ bool WrappedVulkan::EndFrameCapture(void *dev, void *wnd)
     GetResourceManager()->ReleaseWrappedResource(readbackBuf);
   }
 
-  byte *jpgbuf = NULL;
-  int len = thwidth * thheight;
-
-  if(wnd)
-  {
-    jpgbuf = new byte[len];
-
-    jpge::params p;
-    p.m_quality = 80;
-
-    bool success =
-        jpge::compress_image_to_jpeg_file_in_memory(jpgbuf, len, thwidth, thheight, 3, thpixels, p);
-
-    if(!success)
-    {
-      RDCERR("Failed to compress to jpg");
-      SAFE_DELETE_ARRAY(jpgbuf);
-      thwidth = 0;
-      thheight = 0;
-    }
-  }
-
-  RDCFile *rdc = RenderDoc::Inst().CreateRDC(RDCDriver::Vulkan, m_CapturedFrames.back().frameNumber,
-                                             jpgbuf, len, thwidth, thheight, FileType::JPG);
+  // everything up to the frame itself is serialised into memory here, and the frame's chunks are
+  // handed over. It's then compressed and written to disk along with the thumbnail on the capture
+  // writer thread, so the application can carry on.
+  PendingCapture *capture = new PendingCapture;
+  capture->driver = RDCDriver::Vulkan;
+  capture->frameNumber = m_CapturedFrames.back().frameNumber;
+  capture->sectionVersion = m_SectionVersion;
+  capture->thumbPixels = thpixels;
+  capture->thumbWidth = thwidth;
+  capture->thumbHeight = thheight;
+  capture->frameCapture = new StreamWriter(StreamWriter::DefaultScratchSize);
 
-  SAFE_DELETE_ARRAY(jpgbuf);
-  SAFE_DELETE_ARRAY(thpixels);
-
-  StreamWriter *captureWriter = NULL;
-
-  if(rdc)
   {
-    SectionProperties props;
-
-    // Compress with LZ4 so that it's fast
-    props.flags = SectionFlags::LZ4Compressed;
-    props.version = m_SectionVersion;
-    props.type = SectionType::FrameCapture;
-
-    captureWriter = rdc->WriteSection(props);
-  }
-  else
-  {
-    captureWriter = new StreamWriter(StreamWriter::InvalidStream);
-  }
-
-  {
-    WriteSerialiser ser(captureWriter, Ownership::Stream);
+    WriteSerialiser ser(capture->frameCapture, Ownership::Nothing);
 
     ser.SetChunkMetadataRecording(GetThreadSerialiser().GetChunkMetadataRecording());
 
     ser.SetUserData(GetResourceManager());
 
+    ser.SetChunkOffsetRecording(&capture->chunkOffsets);
+
     {
       SCOPED_SERIALISE_CHUNK(SystemChunk::DriverInit, m_InitParams.GetSerialiseSize());
 
@@ -1729,7 +1706,7 @@ bool WrappedVulkan::EndFrameCapture(void *dev, void *wnd)
       RDCDEBUG("Flushing %u command buffer records to file serialiser",
                (uint32_t)m_CmdBufferRecords.size());
 
-      std::map<int32_t, Chunk *> recordlist;
+      ChunkMergeList recordlist;
 
       // ensure all command buffer records within the frame evne if recorded before, but
       // otherwise order must be preserved (vs. queue submits and desc set updates)
@@ -1738,29 +1715,39 @@ bool WrappedVulkan::EndFrameCapture(void *dev, void *wnd)
         m_CmdBufferRecords[i]->Insert(recordlist);
 
         RDCDEBUG("Adding %u chunks to file serialiser from command buffer %llu",
-                 (uint32_t)recordlist.size(), m_CmdBufferRecords[i]->GetResourceID());
+                 (uint32_t)recordlist.NumChunks(), m_CmdBufferRecords[i]->GetResourceID());
       }
 
       m_FrameCaptureRecord->Insert(recordlist);
 
-      RDCDEBUG("Flushing %u chunks to file serialiser from context record",
-               (uint32_t)recordlist.size());
+      std::vector<Chunk *> sortedChunks;
+      recordlist.Merge(sortedChunks);
 
-      float num = float(recordlist.size());
-      float idx = 0.0f;
+      RDCDEBUG("Handing %u chunks to the capture from context record",
+               (uint32_t)sortedChunks.size());
 
-      for(auto it = recordlist.begin(); it != recordlist.end(); ++it)
-      {
-        RenderDoc::Inst().SetProgress(CaptureProgress::SerialiseFrameContents, idx / num);
-        idx += 1.0f;
-        it->second->Write(ser);
-      }
+      RenderDoc::Inst().SetProgress(CaptureProgress::SerialiseFrameContents, 0.0f);
+
+      // the frame capture record is cleared at the start of the next capture, and command buffers
+      // that only this frame still references are deleted below, so their chunks can be given to
+      // the capture rather than copied.
+      std::vector<Chunk *> released;
+
+      m_FrameCaptureRecord->ReleaseChunks(released);
+
+      for(size_t i = 0; i < m_CmdBufferRecords.size(); i++)
+        if(m_CmdBufferRecords[i]->GetRefCount() == 1)
+          m_CmdBufferRecords[i]->ReleaseChunks(released);
+
+      capture->AddFrameChunks(sortedChunks, released);
+
+      RenderDoc::Inst().SetProgress(CaptureProgress::SerialiseFrameContents, 1.0f);
 
       RDCDEBUG("Done");
     }
   }
 
-  RenderDoc::Inst().FinishCaptureWriting(rdc, m_CapturedFrames.back().frameNumber);
+  RenderDoc::Inst().QueueCaptureWrite(capture);
 
   SAFE_DELETE(m_HeaderChunk);
 
@@ -1778,6 +1765,8 @@ bool WrappedVulkan::EndFrameCapture(void *dev, void *wnd)
 
   GetResourceManager()->FreeInitialContents();
 
+  GetResourceManager()->DetachChunksFromArena();
+
   GetResourceManager()->FlushPendingDirty();
 
   FreeAllMemory(MemoryScope::InitialContents);
@@ -3419,7 +3408,10 @@ void WrappedVulkan::AddUsage(VulkanDrawcallTreeNode &drawNode, vector<DebugMessa
     const vector<BakedCmdBufferInfo::CmdBufferState::DescriptorAndOffsets> &descSets =
         (shad == 5 ? state.computeDescSets : state.graphicsDescSets);
 
-    RDCASSERT(sh.mapping);
+    ShaderBindpointMapping *mapping = sh.GetMapping();
+    ShaderReflection *refl = sh.GetReflection();
+
+    RDCASSERT(mapping);
 
     struct ResUsageType
     {
@@ -3429,9 +3421,9 @@ void WrappedVulkan::AddUsage(VulkanDrawcallTreeNode &drawNode, vector<DebugMessa
     };
 
     ResUsageType types[] = {
-        ResUsageType(sh.mapping->readOnlyResources, ResourceUsage::VS_Resource),
-        ResUsageType(sh.mapping->readWriteResources, ResourceUsage::VS_RWResource),
-        ResUsageType(sh.mapping->constantBlocks, ResourceUsage::VS_Constants),
+        ResUsageType(mapping->readOnlyResources, ResourceUsage::VS_Resource),
+        ResUsageType(mapping->readWriteResources, ResourceUsage::VS_RWResource),
+        ResUsageType(mapping->constantBlocks, ResourceUsage::VS_Constants),
     };
 
     DebugMessage msg;
@@ -3449,7 +3441,7 @@ void WrappedVulkan::AddUsage(VulkanDrawcallTreeNode &drawNode, vector<DebugMessa
           continue;
 
         // ignore push constants
-        if(t == 2 && !sh.refl->constantBlocks[i].bufferBacked)
+        if(t == 2 && !refl->constantBlocks[i].bufferBacked)
           continue;
 
         int32_t bindset = types[t].bindmap[i].bindset;
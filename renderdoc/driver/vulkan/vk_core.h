@@ -26,6 +26,7 @@
 
 #include <vector>
 #include "common/timing.h"
+#include "core/call_profiler.h"
 #include "replay/replay_driver.h"
 #include "serialise/serialiser.h"
 #include "vk_common.h"
@@ -166,7 +167,10 @@ struct VulkanDrawcallTreeNode
   {                                                                                       \
     WriteSerialiser &ser = GetThreadSerialiser();                                         \
     ser.ChunkMetadata().timestampMicro = RenderDoc::Inst().GetMicrosecondTimestamp();     \
-    __VA_ARGS__;                                                                          \
+    {                                                                                     \
+      SCOPED_DRIVER_PROFILE();                                                            \
+      __VA_ARGS__;                                                                        \
+    }                                                                                     \
     ser.ChunkMetadata().durationMicro =                                                   \
         RenderDoc::Inst().GetMicrosecondTimestamp() - ser.ChunkMetadata().timestampMicro; \
   }
@@ -698,6 +702,12 @@ private:
   vector<VkResourceRecord *> m_CoherentMaps;
   Threading::CriticalSection m_CoherentMapsLock;
 
+  // if set, coherent maps are write watched while capturing instead of being compared against a
+  // full copy on each submit.
+  bool m_WriteWatchMaps = false;
+
+  void StopWriteWatch(MemMapState &state);
+
   // used both on capture and replay side to track image layouts. Only locked
   // in capture
   map<ResourceId, ImageLayouts> m_ImageLayouts;
@@ -24,6 +24,7 @@
 
 #include "vk_info.h"
 #include "3rdparty/glslang/SPIRV/spirv.hpp"
+#include "common/worker_pool.h"
 
 void DescSetLayout::Init(VulkanResourceManager *resourceMan, VulkanCreationInfo &info,
                          const VkDescriptorSetLayoutCreateInfo *pCreateInfo)
@@ -166,10 +167,11 @@ void VulkanCreationInfo::Pipeline::Init(VulkanResourceManager *resourceMan, Vulk
     shad.module = id;
     shad.entryPoint = pCreateInfo->pStages[i].pName;
 
-    ShaderModule::Reflection &reflData = info.m_ShaderModule[id].m_Reflections[shad.entryPoint];
+    ShaderModule &module = info.m_ShaderModule[id];
+    ShaderModule::Reflection &reflData = module.m_Reflections[shad.entryPoint];
 
-    reflData.Init(resourceMan, id, info.m_ShaderModule[id].spirv, shad.entryPoint,
-                  pCreateInfo->pStages[i].stage);
+    reflData.Init(resourceMan, id, module, shad.entryPoint, pCreateInfo->pStages[i].stage,
+                  &info.m_ReflectionQueue);
 
     if(pCreateInfo->pStages[i].pSpecializationInfo)
     {
@@ -186,9 +188,7 @@ void VulkanCreationInfo::Pipeline::Init(VulkanResourceManager *resourceMan, Vulk
       }
     }
 
-    shad.refl = &reflData.refl;
-    shad.mapping = &reflData.mapping;
-    shad.patchData = &reflData.patchData;
+    shad.reflData = &reflData;
   }
 
   if(pCreateInfo->pVertexInputState)
@@ -424,10 +424,11 @@ void VulkanCreationInfo::Pipeline::Init(VulkanResourceManager *resourceMan, Vulk
     shad.module = id;
     shad.entryPoint = pCreateInfo->stage.pName;
 
-    ShaderModule::Reflection &reflData = info.m_ShaderModule[id].m_Reflections[shad.entryPoint];
+    ShaderModule &module = info.m_ShaderModule[id];
+    ShaderModule::Reflection &reflData = module.m_Reflections[shad.entryPoint];
 
-    reflData.Init(resourceMan, id, info.m_ShaderModule[id].spirv, shad.entryPoint,
-                  pCreateInfo->stage.stage);
+    reflData.Init(resourceMan, id, module, shad.entryPoint, pCreateInfo->stage.stage,
+                  &info.m_ReflectionQueue);
 
     if(pCreateInfo->stage.pSpecializationInfo)
     {
@@ -444,9 +445,7 @@ void VulkanCreationInfo::Pipeline::Init(VulkanResourceManager *resourceMan, Vulk
       }
     }
 
-    shad.refl = &reflData.refl;
-    shad.mapping = &reflData.mapping;
-    shad.patchData = &reflData.patchData;
+    shad.reflData = &reflData;
   }
 
   topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
@@ -797,29 +796,129 @@ void VulkanCreationInfo::ShaderModule::Init(VulkanResourceManager *resourceMan,
   }
 }
 
+// states of a ShaderModule::Reflection
+static const int32_t ReflectionReady = 0;
+static const int32_t ReflectionQueued = 1;
+static const int32_t ReflectionRunning = 2;
+
 void VulkanCreationInfo::ShaderModule::Reflection::Init(VulkanResourceManager *resourceMan,
-                                                        ResourceId id, const SPVModule &spv,
+                                                        ResourceId id, ShaderModule &shaderModule,
                                                         const std::string &entry,
-                                                        VkShaderStageFlagBits stage)
+                                                        VkShaderStageFlagBits stage,
+                                                        ReflectionQueue *queue)
 {
   if(entryPoint.empty())
   {
     entryPoint = entry;
     stageIndex = StageIndex(stage);
+    module = &shaderModule;
+    originalId = resourceMan->GetOriginalID(id);
+
+    if(queue)
+    {
+      this->queue = queue;
+      state = ReflectionQueued;
+      queue->Push(this);
+    }
+    else
+    {
+      state = ReflectionRunning;
+      Generate();
+    }
+  }
+}
+
+bool VulkanCreationInfo::ShaderModule::Reflection::Claim()
+{
+  return Atomic::CmpExch32(&state, ReflectionQueued, ReflectionRunning) == ReflectionQueued;
+}
+
+void VulkanCreationInfo::ShaderModule::Reflection::Generate()
+{
+  {
+    SCOPED_LOCK(module->lock);
+    module->spirv.MakeReflection(ShaderStage(stageIndex), entryPoint, refl, mapping, patchData);
+  }
+
+  refl.resourceId = originalId;
+  refl.entryPoint = entryPoint;
+
+  const SPVModule &spv = module->spirv;
+
+  if(!spv.spirv.empty())
+  {
+    refl.encoding = ShaderEncoding::SPIRV;
+    refl.rawBytes.assign((byte *)spv.spirv.data(), spv.spirv.size() * sizeof(uint32_t));
+  }
+
+  Atomic::CmpExch32(&state, ReflectionRunning, ReflectionReady);
+
+  if(queue)
+    queue->Finished();
+}
+
+void VulkanCreationInfo::ShaderModule::Reflection::Wait()
+{
+  if(Claim())
+  {
+    Generate();
+    return;
+  }
+
+  // a worker is busy with it if it's not ready yet
+  if(queue && Atomic::CmpExch32(&state, ReflectionReady, ReflectionReady) != ReflectionReady)
+    queue->WaitFor(this);
+}
 
-    spv.MakeReflection(ShaderStage(stageIndex), entryPoint, refl, mapping, patchData);
+VulkanCreationInfo::ReflectionQueue::~ReflectionQueue()
+{
+  // anything still queued is abandoned, nothing is waiting on it
+  WorkerPool::Get().Cancel(this);
+}
 
-    refl.resourceId = resourceMan->GetOriginalID(id);
-    refl.entryPoint = entryPoint;
+void VulkanCreationInfo::ReflectionQueue::Push(ShaderModule::Reflection *refl)
+{
+  WorkerPool::Get().Run(
+      [refl]() {
+        // it may have already been generated by a thread that needed it before we got to it
+        if(refl->Claim())
+          refl->Generate();
+      },
+      this);
+}
 
-    if(!spv.spirv.empty())
+void VulkanCreationInfo::ReflectionQueue::WaitFor(ShaderModule::Reflection *refl)
+{
+  for(;;)
+  {
     {
-      refl.encoding = ShaderEncoding::SPIRV;
-      refl.rawBytes.assign((byte *)spv.spirv.data(), spv.spirv.size() * sizeof(uint32_t));
+      SCOPED_LOCK(m_Lock);
+
+      // checked under the lock, so Finished() can't miss us after it's ready
+      if(Atomic::CmpExch32(&refl->state, ReflectionReady, ReflectionReady) == ReflectionReady)
+        return;
+
+      m_Waiters++;
     }
+
+    // woken whenever any reflection finishes, so check again
+    m_ReflectionFinished.WaitForWake();
   }
 }
 
+void VulkanCreationInfo::ReflectionQueue::Finished()
+{
+  uint32_t waiters = 0;
+
+  {
+    SCOPED_LOCK(m_Lock);
+    std::swap(waiters, m_Waiters);
+  }
+
+  if(waiters > 0)
+    m_ReflectionFinished.Wake(waiters);
+}
+
 void VulkanCreationInfo::DescSetPool::Init(VulkanResourceManager *resourceMan,
                                            VulkanCreationInfo &info,
                                            const VkDescriptorPoolCreateInfo *pCreateInfo)
@@ -110,6 +110,77 @@ struct DescUpdateTemplate
 
 struct VulkanCreationInfo
 {
+  class ReflectionQueue;
+
+  struct ShaderModule
+  {
+    void Init(VulkanResourceManager *resourceMan, VulkanCreationInfo &info,
+              const VkShaderModuleCreateInfo *pCreateInfo);
+
+    SPVModule spirv;
+
+    string unstrippedPath;
+
+    // reflection and disassembly both cache names inside the SPVModule, so they can't run on it
+    // concurrently
+    Threading::CriticalSection lock;
+
+    struct Reflection
+    {
+      uint32_t stageIndex;
+      string entryPoint;
+      string disassembly;
+      ShaderReflection refl;
+      ShaderBindpointMapping mapping;
+      SPIRVPatchData patchData;
+
+      // if a queue is given the reflection is generated on one of its workers, and Wait() must be
+      // called before refl, mapping or patchData are used.
+      void Init(VulkanResourceManager *resourceMan, ResourceId id, ShaderModule &module,
+                const std::string &entry, VkShaderStageFlagBits stage,
+                ReflectionQueue *queue = NULL);
+
+      // waits for the reflection to be generated, or generates it on this thread if no worker has
+      // started on it yet.
+      void Wait();
+
+      // claims a queued reflection to be generated by the calling thread. Fails if another thread
+      // has already claimed it.
+      bool Claim();
+      void Generate();
+
+      ShaderModule *module = NULL;
+      // the queue it was generated on, if any
+      ReflectionQueue *queue = NULL;
+      ResourceId originalId;
+      volatile int32_t state = 0;
+    };
+    map<string, Reflection> m_Reflections;
+  };
+  map<ResourceId, ShaderModule> m_ShaderModule;
+
+  // Generates shader reflection on the WorkerPool while the capture is loading, so the pipelines
+  // that use each shader don't have to wait for it.
+  class ReflectionQueue
+  {
+  public:
+    ~ReflectionQueue();
+
+    void Push(ShaderModule::Reflection *refl);
+
+    // blocks until a worker has finished generating refl
+    void WaitFor(ShaderModule::Reflection *refl);
+    // wakes any threads waiting in WaitFor(), once a reflection is ready
+    void Finished();
+
+  private:
+    Threading::CriticalSection m_Lock;
+
+    Threading::Semaphore m_ReflectionFinished;
+    // the number of threads in WaitFor(), protected by m_Lock
+    uint32_t m_Waiters = 0;
+  };
+
   struct Pipeline
   {
     void Init(VulkanResourceManager *resourceMan, VulkanCreationInfo &info,
@@ -131,12 +202,34 @@ struct VulkanCreationInfo
     // VkPipelineShaderStageCreateInfo
     struct Shader
     {
-      Shader() : refl(NULL), mapping(NULL), patchData(NULL) {}
+      Shader() : reflData(NULL) {}
       ResourceId module;
       string entryPoint;
-      ShaderReflection *refl;
-      ShaderBindpointMapping *mapping;
-      SPIRVPatchData *patchData;
+      ShaderModule::Reflection *reflData;
+
+      // the reflection may still be being generated, so these wait for it. NULL if the stage is
+      // unused.
+      ShaderReflection *GetReflection() const
+      {
+        if(!reflData)
+          return NULL;
+        reflData->Wait();
+        return &reflData->refl;
+      }
+      ShaderBindpointMapping *GetMapping() const
+      {
+        if(!reflData)
+          return NULL;
+        reflData->Wait();
+        return &reflData->mapping;
+      }
+      SPIRVPatchData *GetPatchData() const
+      {
+        if(!reflData)
+          return NULL;
+        reflData->Wait();
+        return &reflData->patchData;
+      }
 
       vector<SpecConstant> specialization;
     };
@@ -408,31 +501,6 @@ struct VulkanCreationInfo
   };
   map<ResourceId, ImageView> m_ImageView;
 
-  struct ShaderModule
-  {
-    void Init(VulkanResourceManager *resourceMan, VulkanCreationInfo &info,
-              const VkShaderModuleCreateInfo *pCreateInfo);
-
-    SPVModule spirv;
-
-    string unstrippedPath;
-
-    struct Reflection
-    {
-      uint32_t stageIndex;
-      string entryPoint;
-      string disassembly;
-      ShaderReflection refl;
-      ShaderBindpointMapping mapping;
-      SPIRVPatchData patchData;
-
-      void Init(VulkanResourceManager *resourceMan, ResourceId id, const SPVModule &spv,
-                const std::string &entry, VkShaderStageFlagBits stage);
-    };
-    map<string, Reflection> m_Reflections;
-  };
-  map<ResourceId, ShaderModule> m_ShaderModule;
-
   struct DescSetPool
   {
     void Init(VulkanResourceManager *resourceMan, VulkanCreationInfo &info,
@@ -454,4 +522,7 @@ struct VulkanCreationInfo
 
   // just contains the queueFamilyIndex (after remapping)
   map<ResourceId, uint32_t> m_Queue;
+
+  // declared last so the workers are stopped before anything they reference is destroyed
+  ReflectionQueue m_ReflectionQueue;
 };
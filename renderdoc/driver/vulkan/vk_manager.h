@@ -193,15 +193,15 @@ public:
     // we just have to leak ourselves.
     RDCASSERT(m_LiveResourceMap.empty());
     RDCASSERT(m_InitialContents.empty());
-    RDCASSERT(m_ResourceRecords.empty());
-    RDCASSERT(m_CurrentResourceMap.empty());
-    RDCASSERT(m_WrapperMap.empty());
+    RDCASSERT(m_ResourceRecords.Empty());
+    RDCASSERT(m_CurrentResourceMap.Empty());
+    RDCASSERT(m_WrapperMap.Empty());
 
     m_LiveResourceMap.clear();
     m_InitialContents.clear();
-    m_ResourceRecords.clear();
-    m_CurrentResourceMap.clear();
-    m_WrapperMap.clear();
+    m_ResourceRecords.Clear();
+    m_CurrentResourceMap.Clear();
+    m_WrapperMap.Clear();
   }
 
   template <typename realtype>
@@ -303,9 +303,9 @@ public:
   {
     ResourceId id = GetResID(obj);
 
-    auto origit = m_OriginalIDs.find(id);
-    if(origit != m_OriginalIDs.end())
-      EraseLiveResource(origit->second);
+    ResourceId origid;
+    if(m_OriginalIDs.Find(id, origid))
+      EraseLiveResource(origid);
 
     if(IsReplayMode(m_State))
       ResourceManager::RemoveWrapper(ToTypedHandle(Unwrap(obj)));
@@ -1300,7 +1300,7 @@ void VulkanReplay::FetchVSOut(uint32_t eventId)
   const VulkanCreationInfo::ShaderModule &moduleInfo =
       creationInfo.m_ShaderModule[pipeInfo.shaders[0].module];
 
-  ShaderReflection *refl = pipeInfo.shaders[0].refl;
+  ShaderReflection *refl = pipeInfo.shaders[0].GetReflection();
 
   // no outputs from this shader? unexpected but theoretically possible (dummy VS before
   // tessellation maybe). Just fill out an empty data set
@@ -1739,7 +1739,9 @@ void VulkanReplay::FetchVSOut(uint32_t eventId)
     if(drawcall->baseVertex < 0)
       idxclamp = uint32_t(-drawcall->baseVertex);
 
-    // grab all unique vertex indices referenced
+    // remapped[i] becomes the position of index i in the unique set of referenced indices
+    std::vector<uint32_t> remapped(numIndices);
+
     for(uint32_t i = 0; i < numIndices; i++)
     {
       uint32_t i32 = index16 ? uint32_t(idx16[i]) : idx32[i];
@@ -1755,46 +1757,23 @@ void VulkanReplay::FetchVSOut(uint32_t eventId)
       // we clamp to maxIdx here, to avoid any invalid indices like 0xffffffff
       // from filtering through. Worst case we index to the end of the vertex
       // buffers which is generally much more reasonable
-      i32 = RDCMIN(maxIdx, i32);
-
-      auto it = std::lower_bound(indices.begin(), indices.end(), i32);
-
-      if(it != indices.end() && *it == i32)
-        continue;
-
-      indices.insert(it, i32);
+      remapped[i] = RDCMIN(maxIdx, i32);
     }
 
     // if we read out of bounds, we'll also have a 0 index being referenced
-    // (as 0 is read). Don't insert 0 if we already have 0 though
-    if(numIndices < drawcall->numIndices && (indices.empty() || indices[0] != 0))
-      indices.insert(indices.begin(), 0);
+    // (as 0 is read).
+    if(numIndices < drawcall->numIndices)
+      remapped.push_back(0);
+
+    // rebase the indices to point into a tightly packed stream-out of the unique indices. See
+    // CompactIndexBuffer for details.
+    CompactIndexBuffer(remapped, indices);
 
     maxIndex = indices.back();
 
     // set numVerts
     numVerts = (uint32_t)indices.size();
 
-    // An index buffer could be something like: 500, 501, 502, 501, 503, 502
-    // in which case we can't use the existing index buffer without filling 499 slots of vertex
-    // data with padding. Instead we rebase the indices based on the smallest vertex so it becomes
-    // 0, 1, 2, 1, 3, 2 and then that matches our stream-out'd buffer.
-    //
-    // Note that there could also be gaps, like: 500, 501, 502, 510, 511, 512
-    // which would become 0, 1, 2, 3, 4, 5 and so the old index buffer would no longer be valid.
-    // We just stream-out a tightly packed list of unique indices, and then remap the index buffer
-    // so that what did point to 500 points to 0 (accounting for rebasing), and what did point
-    // to 510 now points to 3 (accounting for the unique sort).
-
-    // we use a map here since the indices may be sparse. Especially considering if an index
-    // is 'invalid' like 0xcccccccc then we don't want an array of 3.4 billion entries.
-    map<uint32_t, size_t> indexRemap;
-    for(size_t i = 0; i < indices.size(); i++)
-    {
-      // by definition, this index will only appear once in indices[]
-      indexRemap[indices[i]] = i;
-    }
-
     // create buffer with unique 0-based indices
     VkBufferCreateInfo bufInfo = {
         VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
@@ -1859,18 +1838,10 @@ void VulkanReplay::FetchVSOut(uint32_t eventId)
       if(i32 == (index16 ? 0xffff : 0xffffffff))
         continue;
 
-      // apply baseVertex but clamp to 0 (don't allow index to become negative)
-      if(i32 < idxclamp)
-        i32 = 0;
-      else if(drawcall->baseVertex < 0)
-        i32 -= idxclamp;
-      else if(drawcall->baseVertex > 0)
-        i32 += drawcall->baseVertex;
-
       if(index16)
-        idx16[i] = uint16_t(indexRemap[i32]);
+        idx16[i] = uint16_t(remapped[i]);
       else
-        idx32[i] = uint32_t(indexRemap[i32]);
+        idx32[i] = remapped[i];
     }
 
     bufInfo.size = (VkDeviceSize)idxdata.size();
@@ -2261,7 +2232,7 @@ void VulkanReplay::FetchVSOut(uint32_t eventId)
     m_pDriver->vkUpdateDescriptorSets(dev, numWrites, descWrites, 0, NULL);
   }
 
-  ConvertToMeshOutputCompute(*refl, *pipeInfo.shaders[0].patchData,
+  ConvertToMeshOutputCompute(*refl, *pipeInfo.shaders[0].GetPatchData(),
                              pipeInfo.shaders[0].entryPoint.c_str(), attrInstDivisor, drawcall,
                              numVerts, numViews, modSpirv, bufStride);
 
@@ -2611,21 +2582,21 @@ void VulkanReplay::FetchTessGSOut(uint32_t eventId)
   int stageIndex = 3;
 
   // if there is no such shader bound, try tessellation
-  if(!pipeInfo.shaders[stageIndex].refl)
+  if(!pipeInfo.shaders[stageIndex].reflData)
     stageIndex = 2;
 
   // if still nothing, do vertex
-  if(!pipeInfo.shaders[stageIndex].refl)
+  if(!pipeInfo.shaders[stageIndex].reflData)
     stageIndex = 0;
 
-  ShaderReflection *lastRefl = pipeInfo.shaders[stageIndex].refl;
+  ShaderReflection *lastRefl = pipeInfo.shaders[stageIndex].GetReflection();
 
   RDCASSERT(lastRefl);
 
   uint32_t primitiveMultiplier = 1;
 
   // transform feedback expands strips to lists
-  switch(pipeInfo.shaders[stageIndex].patchData->outTopo)
+  switch(pipeInfo.shaders[stageIndex].GetPatchData()->outTopo)
   {
     case Topology::PointList:
       m_PostVS.Data[eventId].gsout.topo = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
@@ -2637,7 +2608,7 @@ void VulkanReplay::FetchTessGSOut(uint32_t eventId)
       break;
     default:
       RDCERR("Unexpected output topology %s",
-             ToStr(pipeInfo.shaders[stageIndex].patchData->outTopo).c_str());
+             ToStr(pipeInfo.shaders[stageIndex].GetPatchData()->outTopo).c_str());
     // deliberate fallthrough
     case Topology::TriangleList:
     case Topology::TriangleStrip:
@@ -2679,7 +2650,7 @@ void VulkanReplay::FetchTessGSOut(uint32_t eventId)
   uint32_t xfbStride = 0;
 
   // adds XFB annotations in order of the output signature (with the position first)
-  AddXFBAnnotations(*lastRefl, *pipeInfo.shaders[stageIndex].patchData,
+  AddXFBAnnotations(*lastRefl, *pipeInfo.shaders[stageIndex].GetPatchData(),
                     pipeInfo.shaders[stageIndex].entryPoint.c_str(), modSpirv, xfbStride);
 
   // create vertex shader with modified code
@@ -315,10 +315,13 @@ rdcarray<ShaderEntryPoint> VulkanReplay::GetShaderEntryPoints(ResourceId shader)
   if(shad == m_pDriver->m_CreationInfo.m_ShaderModule.end())
     return {};
 
-  std::vector<std::string> entries = shad->second.spirv.EntryPoints();
-
   rdcarray<ShaderEntryPoint> ret;
 
+  // the module may be being reflected on a worker thread
+  SCOPED_LOCK(shad->second.lock);
+
+  std::vector<std::string> entries = shad->second.spirv.EntryPoints();
+
   for(const std::string &e : entries)
     ret.push_back({e, shad->second.spirv.StageForEntry(e)});
 
@@ -335,11 +338,15 @@ ShaderReflection *VulkanReplay::GetShader(ResourceId shader, ShaderEntryPoint en
     return NULL;
   }
 
-  shad->second.m_Reflections[entry.name].Init(GetResourceManager(), shader, shad->second.spirv,
-                                              entry.name,
-                                              VkShaderStageFlagBits(1 << uint32_t(entry.stage)));
+  VulkanCreationInfo::ShaderModule::Reflection &reflData = shad->second.m_Reflections[entry.name];
+
+  reflData.Init(GetResourceManager(), shader, shad->second, entry.name,
+                VkShaderStageFlagBits(1 << uint32_t(entry.stage)));
+
+  // if reflection was queued while loading, this is where we first need it
+  reflData.Wait();
 
-  return &shad->second.m_Reflections[entry.name].refl;
+  return &reflData.refl;
 }
 
 vector<string> VulkanReplay::GetDisassemblyTargets()
@@ -375,7 +382,10 @@ string VulkanReplay::DisassembleShader(ResourceId pipeline, const ShaderReflecti
     std::string &disasm = it->second.m_Reflections[refl->entryPoint.c_str()].disassembly;
 
     if(disasm.empty())
+    {
+      SCOPED_LOCK(it->second.lock);
       disasm = it->second.spirv.Disassemble(refl->entryPoint.c_str());
+    }
 
     return disasm;
   }
@@ -839,10 +849,11 @@ void VulkanReplay::SavePipelineState()
       stage.entryPoint = p.shaders[i].entryPoint;
 
       stage.stage = ShaderStage::Compute;
-      if(p.shaders[i].mapping)
-        stage.bindpointMapping = *p.shaders[i].mapping;
-      if(p.shaders[i].refl)
-        stage.reflection = p.shaders[i].refl;
+      if(p.shaders[i].reflData)
+      {
+        stage.bindpointMapping = *p.shaders[i].GetMapping();
+        stage.reflection = p.shaders[i].GetReflection();
+      }
 
       stage.specialization.resize(p.shaders[i].specialization.size());
       for(size_t s = 0; s < p.shaders[i].specialization.size(); s++)
@@ -915,10 +926,11 @@ void VulkanReplay::SavePipelineState()
       stages[i]->entryPoint = p.shaders[i].entryPoint;
 
       stages[i]->stage = StageFromIndex(i);
-      if(p.shaders[i].mapping)
-        stages[i]->bindpointMapping = *p.shaders[i].mapping;
-      if(p.shaders[i].refl)
-        stages[i]->reflection = p.shaders[i].refl;
+      if(p.shaders[i].reflData)
+      {
+        stages[i]->bindpointMapping = *p.shaders[i].GetMapping();
+        stages[i]->reflection = p.shaders[i].GetReflection();
+      }
 
       stages[i]->specialization.resize(p.shaders[i].specialization.size());
       for(size_t s = 0; s < p.shaders[i].specialization.size(); s++)
@@ -1526,8 +1538,11 @@ void VulkanReplay::FillCBufferVariables(ResourceId shader, string entryPoint, ui
     return;
   }
 
-  ShaderReflection &refl = it->second.m_Reflections[entryPoint].refl;
-  ShaderBindpointMapping &mapping = it->second.m_Reflections[entryPoint].mapping;
+  VulkanCreationInfo::ShaderModule::Reflection &reflData = it->second.m_Reflections[entryPoint];
+  reflData.Wait();
+
+  ShaderReflection &refl = reflData.refl;
+  ShaderBindpointMapping &mapping = reflData.mapping;
 
   if(cbufSlot >= (uint32_t)refl.constantBlocks.count())
   {
@@ -141,6 +141,13 @@ struct TypedRealHandle
   bool operator!=(const TypedRealHandle o) const { return !(*this == o); }
 };
 
+template <>
+struct ConcurrentHash<TypedRealHandle>
+{
+  // only the handle is hashed, since NULL handles compare equal regardless of type
+  size_t operator()(const TypedRealHandle &h) const { return std::hash<uint64_t>()(h.real.handle); }
+};
+
 struct WrappedVkNonDispRes : public WrappedVkRes
 {
   template <typename T>
@@ -975,7 +982,8 @@ struct MemMapState
         mapFlushed(false),
         mapCoherent(false),
         mappedPtr(NULL),
-        refData(NULL)
+        refData(NULL),
+        writeWatchPtr(NULL)
   {
   }
   VkDeviceSize mapOffset, mapSize;
@@ -984,6 +992,9 @@ struct MemMapState
   bool mapCoherent;
   byte *mappedPtr;
   byte *refData;
+  // if the mapped range is write watched, this is where the watch starts. The pages written since
+  // the last flush are tracked, so there's no need for refData
+  byte *writeWatchPtr;
 };
 
 struct AttachmentInfo
@@ -94,7 +94,7 @@ RDCCOMPILE_ASSERT(ARRAY_COUNT(builtinShaders) == arraydim<BuiltinShader>(),
 
 struct VulkanBlobShaderCallbacks
 {
-  bool Create(uint32_t size, byte *data, SPIRVBlob *ret) const
+  bool Create(uint32_t size, const byte *data, SPIRVBlob *ret) const
   {
     RDCASSERT(ret);
 
@@ -117,11 +117,8 @@ struct VulkanBlobShaderCallbacks
 VulkanShaderCache::VulkanShaderCache(WrappedVulkan *driver)
 {
   // Load shader cache, if present
-  bool success = LoadShaderCache("vkshaders.cache", m_ShaderCacheMagic, m_ShaderCacheVersion,
-                                 m_ShaderCache, VulkanShaderCacheCallbacks);
-
-  // if we failed to load from the cache
-  m_ShaderCacheDirty = !success;
+  m_ShaderCacheFile.Open(FileIO::GetAppFolderFilename("vkshaders.cache"), m_ShaderCacheMagic,
+                         m_ShaderCacheVersion);
 
   m_pDriver = driver;
   m_Device = driver->GetDev();
@@ -206,16 +203,7 @@ VulkanShaderCache::VulkanShaderCache(WrappedVulkan *driver)
 
 VulkanShaderCache::~VulkanShaderCache()
 {
-  if(m_ShaderCacheDirty)
-  {
-    SaveShaderCache("vkshaders.cache", m_ShaderCacheMagic, m_ShaderCacheVersion, m_ShaderCache,
-                    VulkanShaderCacheCallbacks);
-  }
-  else
-  {
-    for(auto it = m_ShaderCache.begin(); it != m_ShaderCache.end(); ++it)
-      VulkanShaderCacheCallbacks.Destroy(it->second);
-  }
+  DestroyShaderCache(m_ShaderCacheFile, m_ShaderCache, VulkanShaderCacheCallbacks);
 
   for(size_t i = 0; i < ARRAY_COUNT(m_BuiltinShaderModules); i++)
     m_pDriver->vkDestroyShaderModule(m_Device, m_BuiltinShaderModules[i], NULL);
@@ -227,20 +215,17 @@ std::string VulkanShaderCache::GetSPIRVBlob(const SPIRVCompilationSettings &sett
 {
   RDCASSERT(sources.size() > 0);
 
-  uint32_t hash = strhash(sources[0].c_str());
+  uint64_t hash = strhash64(sources[0].c_str());
   for(size_t i = 1; i < sources.size(); i++)
-    hash = strhash(sources[i].c_str(), hash);
+    hash = strhash64(sources[i].c_str(), hash);
 
   char typestr[3] = {'a', 'a', 0};
   typestr[0] += (char)settings.stage;
   typestr[1] += (char)settings.lang;
-  hash = strhash(typestr, hash);
+  hash = strhash64(typestr, hash);
 
-  if(m_ShaderCache.find(hash) != m_ShaderCache.end())
-  {
-    outBlob = m_ShaderCache[hash];
+  if(FindCachedShader(m_ShaderCacheFile, m_ShaderCache, hash, outBlob, VulkanShaderCacheCallbacks))
     return "";
-  }
 
   SPIRVBlob spirv = new std::vector<uint32_t>();
   std::string errors = CompileSPIRV(settings, sources, *spirv);
@@ -262,8 +247,7 @@ std::string VulkanShaderCache::GetSPIRVBlob(const SPIRVCompilationSettings &sett
 
   if(m_CacheShaders)
   {
-    m_ShaderCache[hash] = spirv;
-    m_ShaderCacheDirty = true;
+    AddCachedShader(m_ShaderCacheFile, m_ShaderCache, hash, spirv, VulkanShaderCacheCallbacks);
   }
 
   return errors;
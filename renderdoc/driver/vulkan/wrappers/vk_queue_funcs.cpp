@@ -926,54 +926,87 @@ VkResult WrappedVulkan::vkQueueSubmit(VkQueue queue, uint32_t submitCount,
           continue;
         }
 
-        size_t diffStart = 0, diffEnd = 0;
-        bool found = true;
+        std::vector<std::pair<size_t, size_t> > ranges;
+
+        if(state.writeWatchPtr)
+        {
+          // only the pages written since the last flush can have changed. They're watched again
+          // before being returned, so anything written while they're serialised below is caught
+          // next time.
+          WriteWatch::GetDirtyRanges(state.writeWatchPtr, ranges);
+        }
+        else
+        {
+          byte *mapStart = state.mappedPtr + (size_t)state.mapOffset;
 
 // enabled as this is necessary for programs with very large coherent mappings
 // (> 1GB) as otherwise more than a couple of vkQueueSubmit calls leads to vast
 // memory allocation. There might still be bugs lurking in here though
 #if 1
-        // this causes vkFlushMappedMemoryRanges call to allocate and copy to refData
-        // from serialised buffer. We want to copy *precisely* the serialised data,
-        // otherwise there is a gap in time between serialising out a snapshot of
-        // the buffer and whenever we then copy into the ref data, e.g. below.
-        // during this time, data could be written to the buffer and it won't have
-        // been caught in the serialised snapshot, and if it doesn't change then
-        // it *also* won't be caught in any future FindDiffRange() calls.
-        //
-        // Likewise once refData is allocated, the call below will also update it
-        // with the data serialised out for the same reason.
-        //
-        // Note: it's still possible that data is being written to by the
-        // application while it's being serialised out in the snapshot below. That
-        // is OK, since the application is responsible for ensuring it's not writing
-        // data that would be needed by the GPU in this submit. As long as the
-        // refdata we use for future use is identical to what was serialised, we
-        // shouldn't miss anything
-        state.needRefData = true;
-
-        // if we have a previous set of data, compare.
-        // otherwise just serialise it all
-        if(state.refData)
-          found = FindDiffRange((byte *)state.mappedPtr, state.refData, (size_t)state.mapSize,
-                                diffStart, diffEnd);
-        else
+          // this causes vkFlushMappedMemoryRanges call to allocate and copy to refData
+          // from serialised buffer. We want to copy *precisely* the serialised data,
+          // otherwise there is a gap in time between serialising out a snapshot of
+          // the buffer and whenever we then copy into the ref data, e.g. below.
+          // during this time, data could be written to the buffer and it won't have
+          // been caught in the serialised snapshot, and if it doesn't change then
+          // it *also* won't be caught in any future FindDiffRanges() calls.
+          //
+          // Likewise once refData is allocated, the call below will also update it
+          // with the data serialised out for the same reason.
+          //
+          // Note: it's still possible that data is being written to by the
+          // application while it's being serialised out in the snapshot below. That
+          // is OK, since the application is responsible for ensuring it's not writing
+          // data that would be needed by the GPU in this submit. As long as the
+          // refdata we use for future use is identical to what was serialised, we
+          // shouldn't miss anything
+          state.needRefData = true;
+
+          // if we have a previous set of data, compare. otherwise just serialise it all.
+          // Writes are often scattered through a large map, so each changed range is flushed on
+          // its own rather than everything between the first and last change. Short gaps are
+          // still merged since each range costs a chunk.
+          if(state.refData)
+            FindDiffRanges(mapStart, state.refData, (size_t)state.mapSize, 4096, ranges);
+          else
 #endif
-          diffEnd = (size_t)state.mapSize;
+            ranges.push_back(std::make_pair((size_t)0, (size_t)state.mapSize));
+
+          // the first time we serialise all of the map, so start watching it before then. Any write
+          // from the snapshot onwards is caught, and there's no need to keep the snapshot.
+          if(!state.refData && m_WriteWatchMaps)
+          {
+            if(WriteWatch::Watch(mapStart, (size_t)state.mapSize))
+            {
+              state.writeWatchPtr = mapStart;
+              state.needRefData = false;
+            }
+            else
+            {
+              RDCWARN("Couldn't write watch map of %llu, comparing against a copy instead",
+                      record->GetResourceID());
+            }
+          }
+        }
 
-        if(found)
+        if(!ranges.empty())
         {
           // MULTIDEVICE should find the device for this queue.
           // MULTIDEVICE only want to flush maps associated with this queue
           VkDevice dev = GetDev();
 
           {
-            RDCLOG("Persistent map flush forced for %llu (%llu -> %llu)", record->GetResourceID(),
-                   (uint64_t)diffStart, (uint64_t)diffEnd);
-            VkMappedMemoryRange range = {VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, NULL,
-                                         (VkDeviceMemory)(uint64_t)record->Resource,
-                                         state.mapOffset + diffStart, diffEnd - diffStart};
-            vkFlushMappedMemoryRanges(dev, 1, &range);
+            RDCLOG("Persistent map flush forced for %llu (%llu -> %llu, %zu ranges)",
+                   record->GetResourceID(), (uint64_t)ranges.front().first,
+                   (uint64_t)ranges.back().second, ranges.size());
+
+            std::vector<VkMappedMemoryRange> flushRanges;
+            for(const std::pair<size_t, size_t> &r : ranges)
+              flushRanges.push_back({VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, NULL,
+                                     (VkDeviceMemory)(uint64_t)record->Resource,
+                                     state.mapOffset + r.first, r.second - r.first});
+
+            vkFlushMappedMemoryRanges(dev, (uint32_t)flushRanges.size(), flushRanges.data());
             state.mapFlushed = false;
           }
 
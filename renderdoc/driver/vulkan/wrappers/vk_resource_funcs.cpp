@@ -494,6 +494,9 @@ void WrappedVulkan::vkFreeMemory(VkDevice device, VkDeviceMemory memory,
       wrapped->record->memMapState->refData = NULL;
     }
 
+    if(wrapped->record->memMapState)
+      StopWriteWatch(*wrapped->record->memMapState);
+
     {
       SCOPED_LOCK(m_CoherentMapsLock);
 
@@ -605,6 +608,15 @@ bool WrappedVulkan::Serialise_vkUnmapMemory(SerialiserType &ser, VkDevice device
   return true;
 }
 
+void WrappedVulkan::StopWriteWatch(MemMapState &state)
+{
+  if(state.writeWatchPtr)
+  {
+    WriteWatch::Unwatch(state.writeWatchPtr);
+    state.writeWatchPtr = NULL;
+  }
+}
+
 void WrappedVulkan::vkUnmapMemory(VkDevice device, VkDeviceMemory mem)
 {
   if(IsCaptureMode(m_State))
@@ -666,6 +678,8 @@ void WrappedVulkan::vkUnmapMemory(VkDevice device, VkDeviceMemory mem)
     FreeAlignedBuffer(state.refData);
     state.refData = NULL;
 
+    StopWriteWatch(state);
+
     if(state.mapCoherent)
     {
       SCOPED_LOCK(m_CoherentMapsLock);
@@ -733,8 +747,8 @@ bool WrappedVulkan::Serialise_vkFlushMappedMemoryRanges(SerialiserType &ser, VkD
   {
     if(!state->refData)
     {
-      // if we're in this case, the range should be for the whole memory region.
-      RDCASSERT(MemRange.offset == 0 && memRangeSize == state->mapSize);
+      // if we're in this case, the range should be for the whole mapped region.
+      RDCASSERT(MemRange.offset == state->mapOffset && memRangeSize == state->mapSize);
 
       // allocate ref data so we can compare next time to minimise serialised data
       state->refData = AllocAlignedBuffer((size_t)state->mapSize);
@@ -747,7 +761,13 @@ bool WrappedVulkan::Serialise_vkFlushMappedMemoryRanges(SerialiserType &ser, VkD
 
     const byte *serialisedData = ser.GetWriter()->GetData() + offs;
 
-    memcpy(state->refData, serialisedData, (size_t)memRangeSize);
+    // the ref data covers the mapped region, which may not start at the beginning of the memory
+    if(MemRange.offset >= state->mapOffset &&
+       MemRange.offset + memRangeSize <= state->mapOffset + state->mapSize)
+      memcpy(state->refData + (size_t)(MemRange.offset - state->mapOffset), serialisedData,
+             (size_t)memRangeSize);
+    else
+      RDCERR("Flushed range is outside of the mapped region");
   }
 
   return true;
@@ -0,0 +1,455 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "formatconvert.h"
+#include <string.h>
+#include "common/common.h"
+#include "formatpacking.h"
+
+// SSE2 is always available on x64, and on x86 when the compiler has been told it can use it
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SSE_CONVERSION OPTION_ON
+#include <emmintrin.h>
+#else
+#define SSE_CONVERSION OPTION_OFF
+#endif
+
+namespace
+{
+// converts each of the N components of every texel with conv, and fills in the missing ones
+template <typename T, uint32_t N, typename Conv>
+void ConvertComponents(const byte *src, uint32_t count, float *dst, Conv conv)
+{
+  const T *in = (const T *)src;
+
+  for(uint32_t i = 0; i < count; i++)
+  {
+    dst[0] = conv(in[0]);
+    dst[1] = N > 1 ? conv(in[1]) : 0.0f;
+    dst[2] = N > 2 ? conv(in[2]) : 0.0f;
+    dst[3] = N > 3 ? conv(in[3]) : 1.0f;
+
+    in += N;
+    dst += 4;
+  }
+}
+
+template <typename T, typename Conv>
+void ConvertComponents(uint32_t compCount, const byte *src, uint32_t count, float *dst, Conv conv)
+{
+  switch(compCount)
+  {
+    case 1: ConvertComponents<T, 1>(src, count, dst, conv); break;
+    case 2: ConvertComponents<T, 2>(src, count, dst, conv); break;
+    case 3: ConvertComponents<T, 3>(src, count, dst, conv); break;
+    case 4: ConvertComponents<T, 4>(src, count, dst, conv); break;
+    default: break;
+  }
+}
+
+// any format we don't have a specialised loop for goes component by component
+void ConvertGeneric(const ResourceFormat &fmt, const byte *src, uint32_t count, float *dst)
+{
+  uint32_t stride = GetTexelStride(fmt);
+
+  for(uint32_t i = 0; i < count; i++)
+  {
+    dst[0] = dst[1] = dst[2] = 0.0f;
+    dst[3] = 1.0f;
+
+    for(uint32_t c = 0; c < fmt.compCount && c < 4; c++)
+      dst[c] = ConvertComponent(fmt, src + fmt.compByteWidth * c);
+
+    src += stride;
+    dst += 4;
+  }
+}
+
+float UNorm8(uint8_t u) { return float(u) / 255.0f; }
+float SRGB8(uint8_t u) { return SRGB8_lookuptable[u]; }
+float SNorm8(int8_t i) { return i == -128 ? -1.0f : float(i) / 127.0f; }
+float UNorm16(uint16_t u) { return float(u) / 65535.0f; }
+float SNorm16(int16_t i) { return i == -32768 ? -1.0f : float(i) / 32767.0f; }
+float Half(uint16_t u) { return ConvertFromHalf(u); }
+float Float32(float f) { return f; }
+template <typename T>
+float Integer(T t)
+{
+  return float(t);
+}
+
+#if ENABLED(SSE_CONVERSION)
+
+// each of these converts as many whole blocks of texels as it can, and returns how many texels it
+// converted. The remainder is left for the scalar loop.
+
+uint32_t ConvertRGBA8UNormSSE(const byte *src, uint32_t count, float *dst)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128 scale = _mm_set1_ps(255.0f);
+
+  uint32_t i = 0;
+  for(; i + 4 <= count; i += 4)
+  {
+    __m128i texels = _mm_loadu_si128((const __m128i *)(src + i * 4));
+    __m128i lo = _mm_unpacklo_epi8(texels, zero);
+    __m128i hi = _mm_unpackhi_epi8(texels, zero);
+
+    float *out = dst + i * 4;
+    _mm_storeu_ps(out + 0, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), scale));
+    _mm_storeu_ps(out + 4, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), scale));
+    _mm_storeu_ps(out + 8, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), scale));
+    _mm_storeu_ps(out + 12, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), scale));
+  }
+
+  return i;
+}
+
+uint32_t ConvertRGBA16UNormSSE(const byte *src, uint32_t count, float *dst)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128 scale = _mm_set1_ps(65535.0f);
+
+  uint32_t i = 0;
+  for(; i + 2 <= count; i += 2)
+  {
+    __m128i texels = _mm_loadu_si128((const __m128i *)(src + i * 8));
+
+    float *out = dst + i * 4;
+    _mm_storeu_ps(out + 0, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(texels, zero)), scale));
+    _mm_storeu_ps(out + 4, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(texels, zero)), scale));
+  }
+
+  return i;
+}
+
+// converts four halfs in the low 16 bits of each lane. Exact for normals and denormals, and unlike
+// ConvertFromHalf it keeps the sign of zero and returns infinity rather than NaN for infinities.
+__m128 HalfToFloatSSE(__m128i h)
+{
+  const __m128i expMantMask = _mm_set1_epi32(0x7fff);
+  // 2^112 - scales the half exponent bias up to the float exponent bias
+  const __m128 magic = _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23));
+  const __m128i maxFinite = _mm_set1_epi32(0x7bff);
+  const __m128i infNanExp = _mm_set1_epi32(255 << 23);
+
+  __m128i expMant = _mm_and_si128(h, expMantMask);
+  __m128i sign = _mm_slli_epi32(_mm_xor_si128(h, expMant), 16);
+
+  __m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(expMant, 13)), magic);
+
+  __m128i infNan = _mm_and_si128(_mm_cmpgt_epi32(expMant, maxFinite), infNanExp);
+
+  return _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, infNan)));
+}
+
+uint32_t ConvertRGBA16FloatSSE(const byte *src, uint32_t count, float *dst)
+{
+  const __m128i zero = _mm_setzero_si128();
+
+  uint32_t i = 0;
+  for(; i + 2 <= count; i += 2)
+  {
+    __m128i texels = _mm_loadu_si128((const __m128i *)(src + i * 8));
+
+    float *out = dst + i * 4;
+    _mm_storeu_ps(out + 0, HalfToFloatSSE(_mm_unpacklo_epi16(texels, zero)));
+    _mm_storeu_ps(out + 4, HalfToFloatSSE(_mm_unpackhi_epi16(texels, zero)));
+  }
+
+  return i;
+}
+
+uint32_t ConvertR10G10B10A2UNormSSE(const byte *src, uint32_t count, float *dst)
+{
+  const __m128i mask = _mm_set1_epi32(0x3ff);
+  const __m128 scale = _mm_set1_ps(1023.0f);
+  const __m128 alphaScale = _mm_set1_ps(3.0f);
+
+  uint32_t i = 0;
+  for(; i + 4 <= count; i += 4)
+  {
+    __m128i texels = _mm_loadu_si128((const __m128i *)(src + i * 4));
+
+    // unpack each component across four texels, then transpose back to RGBA per texel
+    __m128 r = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(texels, mask)), scale);
+    __m128 g = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(texels, 10), mask)), scale);
+    __m128 b = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(texels, 20), mask)), scale);
+    __m128 a = _mm_div_ps(_mm_cvtepi32_ps(_mm_srli_epi32(texels, 30)), alphaScale);
+
+    _MM_TRANSPOSE4_PS(r, g, b, a);
+
+    float *out = dst + i * 4;
+    _mm_storeu_ps(out + 0, r);
+    _mm_storeu_ps(out + 4, g);
+    _mm_storeu_ps(out + 8, b);
+    _mm_storeu_ps(out + 12, a);
+  }
+
+  return i;
+}
+
+#endif    // ENABLED(SSE_CONVERSION)
+
+void ConvertRegular(const ResourceFormat &fmt, const byte *src, uint32_t count, float *dst)
+{
+  uint32_t done = 0;
+
+  const uint32_t compCount = fmt.compCount;
+  const CompType compType = fmt.compType;
+
+  if(fmt.compByteWidth == 4)
+  {
+    if(compType == CompType::Float || compType == CompType::Depth)
+    {
+      if(compCount == 4)
+        memcpy(dst, src, count * sizeof(float) * 4);
+      else
+        ConvertComponents<float>(compCount, src, count, dst, Float32);
+    }
+    else if(compType == CompType::UInt || compType == CompType::UScaled)
+    {
+      ConvertComponents<uint32_t>(compCount, src, count, dst, Integer<uint32_t>);
+    }
+    else if(compType == CompType::SInt || compType == CompType::SScaled)
+    {
+      ConvertComponents<int32_t>(compCount, src, count, dst, Integer<int32_t>);
+    }
+    else
+    {
+      ConvertGeneric(fmt, src, count, dst);
+    }
+  }
+  else if(fmt.compByteWidth == 2)
+  {
+    if(compType == CompType::Float)
+    {
+#if ENABLED(SSE_CONVERSION)
+      if(compCount == 4)
+        done = ConvertRGBA16FloatSSE(src, count, dst);
+#endif
+      ConvertComponents<uint16_t>(compCount, src + done * 8, count - done, dst + done * 4, Half);
+    }
+    else if(compType == CompType::UNorm || compType == CompType::Depth)
+    {
+#if ENABLED(SSE_CONVERSION)
+      if(compCount == 4)
+        done = ConvertRGBA16UNormSSE(src, count, dst);
+#endif
+      ConvertComponents<uint16_t>(compCount, src + done * 8, count - done, dst + done * 4, UNorm16);
+    }
+    else if(compType == CompType::SNorm)
+    {
+      ConvertComponents<int16_t>(compCount, src, count, dst, SNorm16);
+    }
+    else if(compType == CompType::UInt || compType == CompType::UScaled)
+    {
+      ConvertComponents<uint16_t>(compCount, src, count, dst, Integer<uint16_t>);
+    }
+    else if(compType == CompType::SInt || compType == CompType::SScaled)
+    {
+      ConvertComponents<int16_t>(compCount, src, count, dst, Integer<int16_t>);
+    }
+    else
+    {
+      ConvertGeneric(fmt, src, count, dst);
+    }
+  }
+  else if(fmt.compByteWidth == 1)
+  {
+    if(compType == CompType::UNorm && fmt.srgbCorrected)
+    {
+      ConvertComponents<uint8_t>(compCount, src, count, dst, SRGB8);
+    }
+    else if(compType == CompType::UNorm)
+    {
+#if ENABLED(SSE_CONVERSION)
+      if(compCount == 4)
+        done = ConvertRGBA8UNormSSE(src, count, dst);
+#endif
+      ConvertComponents<uint8_t>(compCount, src + done * 4, count - done, dst + done * 4, UNorm8);
+    }
+    else if(compType == CompType::SNorm)
+    {
+      ConvertComponents<int8_t>(compCount, src, count, dst, SNorm8);
+    }
+    else if(compType == CompType::UInt || compType == CompType::UScaled)
+    {
+      ConvertComponents<uint8_t>(compCount, src, count, dst, Integer<uint8_t>);
+    }
+    else if(compType == CompType::SInt || compType == CompType::SScaled)
+    {
+      ConvertComponents<int8_t>(compCount, src, count, dst, Integer<int8_t>);
+    }
+    else
+    {
+      ConvertGeneric(fmt, src, count, dst);
+    }
+  }
+  else
+  {
+    // 64-bit and 24-bit depth components are rare enough to not be worth specialising
+    ConvertGeneric(fmt, src, count, dst);
+  }
+}
+
+// packed formats unpack the whole texel at once with the functions in formatpacking.h
+template <typename T, typename Unpack>
+void ConvertPacked(const byte *src, uint32_t count, float *dst, Unpack unpack)
+{
+  const T *in = (const T *)src;
+
+  for(uint32_t i = 0; i < count; i++)
+  {
+    Vec4f v = unpack(in[i]);
+
+    dst[0] = v.x;
+    dst[1] = v.y;
+    dst[2] = v.z;
+    dst[3] = v.w;
+    dst += 4;
+  }
+}
+};
+
+uint32_t GetTexelStride(const ResourceFormat &fmt)
+{
+  switch(fmt.type)
+  {
+    case ResourceFormatType::R10G10B10A2:
+    case ResourceFormatType::R11G11B10: return 4;
+    case ResourceFormatType::R5G6B5:
+    case ResourceFormatType::R5G5B5A1:
+    case ResourceFormatType::R4G4B4A4: return 2;
+    default: break;
+  }
+
+  uint32_t stride = fmt.compCount * fmt.compByteWidth;
+
+  // 24-bit depth still has a stride of 4 bytes.
+  if(fmt.compType == CompType::Depth && stride == 3)
+    stride = 4;
+
+  return stride;
+}
+
+void ConvertRowToRGBA32F(const ResourceFormat &fmt, const byte *src, uint32_t count, float *dst)
+{
+  switch(fmt.type)
+  {
+    case ResourceFormatType::Regular: ConvertRegular(fmt, src, count, dst); break;
+    case ResourceFormatType::R10G10B10A2:
+    {
+      if(fmt.compType == CompType::SNorm)
+      {
+        ConvertPacked<uint32_t>(src, count, dst, ConvertFromR10G10B10A2SNorm);
+      }
+      else
+      {
+        uint32_t done = 0;
+#if ENABLED(SSE_CONVERSION)
+        done = ConvertR10G10B10A2UNormSSE(src, count, dst);
+#endif
+        ConvertPacked<uint32_t>(src + done * 4, count - done, dst + done * 4,
+                                ConvertFromR10G10B10A2);
+      }
+      break;
+    }
+    case ResourceFormatType::R11G11B10:
+      ConvertPacked<uint32_t>(src, count, dst, [](uint32_t data) {
+        Vec3f v = ConvertFromR11G11B10(data);
+        return Vec4f(v.x, v.y, v.z, 1.0f);
+      });
+      break;
+    case ResourceFormatType::R5G6B5:
+      ConvertPacked<uint16_t>(src, count, dst, [](uint16_t data) {
+        Vec3f v = ConvertFromB5G6R5(data);
+        return Vec4f(v.x, v.y, v.z, 1.0f);
+      });
+      break;
+    case ResourceFormatType::R5G5B5A1:
+      ConvertPacked<uint16_t>(src, count, dst, ConvertFromB5G5R5A1);
+      break;
+    case ResourceFormatType::R4G4B4A4:
+      ConvertPacked<uint16_t>(src, count, dst, ConvertFromB4G4R4A4);
+      break;
+    default: ConvertGeneric(fmt, src, count, dst); break;
+  }
+}
+
+void BlendRowRGBA8ToRGB8(const byte *src, uint32_t count, const Vec4f &background, byte *dst)
+{
+  uint32_t i = 0;
+
+#if ENABLED(SSE_CONVERSION)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128 scale = _mm_set1_ps(255.0f);
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 bg = _mm_setr_ps(background.x, background.y, background.z, 0.0f);
+
+  for(; i + 4 <= count; i += 4)
+  {
+    __m128i texels = _mm_loadu_si128((const __m128i *)(src + i * 4));
+    __m128i lo = _mm_unpacklo_epi8(texels, zero);
+    __m128i hi = _mm_unpackhi_epi8(texels, zero);
+
+    __m128i unpacked[4] = {
+        _mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+        _mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero),
+    };
+
+    for(int t = 0; t < 4; t++)
+    {
+      __m128 pixel = _mm_div_ps(_mm_cvtepi32_ps(unpacked[t]), scale);
+      __m128 alpha = _mm_shuffle_ps(pixel, pixel, _MM_SHUFFLE(3, 3, 3, 3));
+
+      pixel = _mm_add_ps(_mm_mul_ps(pixel, alpha), _mm_mul_ps(bg, _mm_sub_ps(one, alpha)));
+
+      unpacked[t] = _mm_cvttps_epi32(_mm_mul_ps(pixel, scale));
+    }
+
+    byte rgba[16];
+    _mm_storeu_si128((__m128i *)rgba,
+                     _mm_packus_epi16(_mm_packs_epi32(unpacked[0], unpacked[1]),
+                                      _mm_packs_epi32(unpacked[2], unpacked[3])));
+
+    for(int t = 0; t < 4; t++)
+      memcpy(dst + (i + t) * 3, rgba + t * 4, 3);
+  }
+#endif
+
+  const float *bgcol = &background.x;
+
+  for(; i < count; i++)
+  {
+    float a = float(src[i * 4 + 3]) / 255.0f;
+
+    for(int c = 0; c < 3; c++)
+    {
+      float pixel = float(src[i * 4 + c]) / 255.0f;
+      pixel = pixel * a + bgcol[c] * (1.0f - a);
+      dst[i * 3 + c] = byte(pixel * 255.0f);
+    }
+  }
+}
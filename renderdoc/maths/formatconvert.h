@@ -0,0 +1,43 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include "api/replay/renderdoc_replay.h"
+#include "vec.h"
+
+// Row-at-a-time conversions for texel data, used when saving textures. The format is looked at
+// once per row to pick a loop specialised for it, instead of branching on the format for every
+// component of every texel. Common formats have SSE2 paths on x86.
+
+// the number of bytes between consecutive texels of fmt in the data read by ConvertRowToRGBA32F
+uint32_t GetTexelStride(const ResourceFormat &fmt);
+
+// converts count texels of fmt to RGBA floats with the same results as ConvertComponent. Missing
+// components are set to 0 for RGB and 1 for alpha. The components are left in memory order, so
+// BGRA formats still need to be swizzled.
+void ConvertRowToRGBA32F(const ResourceFormat &fmt, const byte *src, uint32_t count, float *dst);
+
+// blends count RGBA8 texels over a background colour by their alpha, and writes the RGB8 result.
+void BlendRowRGBA8ToRGB8(const byte *src, uint32_t count, const Vec4f &background, byte *dst);
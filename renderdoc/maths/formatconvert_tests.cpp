@@ -0,0 +1,254 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "formatconvert.h"
+#include "common/globalconfig.h"
+#include "formatpacking.h"
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "3rdparty/catch/catch.hpp"
+
+// not a multiple of any SIMD block size, so the scalar remainder is tested too
+static const uint32_t numTexels = 37;
+
+static std::vector<byte> RandomTexels(uint32_t stride)
+{
+  std::vector<byte> ret(numTexels * stride);
+
+  uint32_t seed = 0x1234567;
+  for(byte &b : ret)
+  {
+    seed = seed * 1103515245 + 12345;
+    b = byte(seed >> 16);
+  }
+
+  return ret;
+}
+
+static bool SameFloat(float a, float b)
+{
+  // NaN payloads aren't preserved through conversion, only NaN-ness
+  return a == b || (a != a && b != b);
+}
+
+TEST_CASE("Test row conversion matches per-component conversion", "[formatconvert]")
+{
+  struct TestFormat
+  {
+    CompType compType;
+    uint8_t compByteWidth;
+    bool srgb;
+  };
+
+  TestFormat formats[] = {
+      {CompType::UNorm, 1, false}, {CompType::UNorm, 1, true},   {CompType::SNorm, 1, false},
+      {CompType::UInt, 1, false},  {CompType::SInt, 1, false},   {CompType::UNorm, 2, false},
+      {CompType::SNorm, 2, false}, {CompType::Float, 2, false},  {CompType::UInt, 2, false},
+      {CompType::SInt, 2, false},  {CompType::Depth, 2, false},  {CompType::Float, 4, false},
+      {CompType::UInt, 4, false},  {CompType::SInt, 4, false},   {CompType::Depth, 4, false},
+      {CompType::Float, 8, false}, {CompType::UScaled, 1, false}, {CompType::SScaled, 2, false},
+  };
+
+  for(const TestFormat &test : formats)
+  {
+    for(uint8_t compCount = 1; compCount <= 4; compCount++)
+    {
+      ResourceFormat fmt;
+      fmt.type = ResourceFormatType::Regular;
+      fmt.compType = test.compType;
+      fmt.compByteWidth = test.compByteWidth;
+      fmt.compCount = compCount;
+      fmt.srgbCorrected = test.srgb;
+
+      INFO("compType " << (uint32_t)fmt.compType << " width " << (uint32_t)fmt.compByteWidth
+                       << " count " << (uint32_t)compCount << " srgb " << test.srgb);
+
+      uint32_t stride = GetTexelStride(fmt);
+      CHECK(stride == uint32_t(compCount * test.compByteWidth));
+
+      std::vector<byte> src = RandomTexels(stride);
+
+      // ConvertFromHalf maps infinities to NaN, so keep halfs finite
+      if(fmt.compType == CompType::Float && fmt.compByteWidth == 2)
+      {
+        for(size_t i = 1; i < src.size(); i += 2)
+          src[i] &= ~0x40;
+      }
+
+      std::vector<float> converted(numTexels * 4);
+      ConvertRowToRGBA32F(fmt, src.data(), numTexels, converted.data());
+
+      for(uint32_t t = 0; t < numTexels; t++)
+      {
+        for(uint32_t c = 0; c < 4; c++)
+        {
+          float expected = c == 3 ? 1.0f : 0.0f;
+          if(c < compCount)
+            expected = ConvertComponent(fmt, src.data() + t * stride + c * fmt.compByteWidth);
+
+          CHECK(SameFloat(converted[t * 4 + c], expected));
+        }
+      }
+    }
+  }
+};
+
+TEST_CASE("Test row conversion of packed formats", "[formatconvert]")
+{
+  ResourceFormat fmt;
+  fmt.compCount = 4;
+  fmt.compByteWidth = 1;
+  fmt.compType = CompType::UNorm;
+
+  std::vector<float> converted(numTexels * 4);
+
+  SECTION("R10G10B10A2")
+  {
+    fmt.type = ResourceFormatType::R10G10B10A2;
+
+    CHECK(GetTexelStride(fmt) == 4);
+
+    std::vector<byte> src = RandomTexels(4);
+    const uint32_t *packed = (const uint32_t *)src.data();
+
+    ConvertRowToRGBA32F(fmt, src.data(), numTexels, converted.data());
+
+    for(uint32_t t = 0; t < numTexels; t++)
+    {
+      Vec4f v = ConvertFromR10G10B10A2(packed[t]);
+      CHECK(converted[t * 4 + 0] == v.x);
+      CHECK(converted[t * 4 + 1] == v.y);
+      CHECK(converted[t * 4 + 2] == v.z);
+      CHECK(converted[t * 4 + 3] == v.w);
+    }
+
+    fmt.compType = CompType::SNorm;
+
+    ConvertRowToRGBA32F(fmt, src.data(), numTexels, converted.data());
+
+    for(uint32_t t = 0; t < numTexels; t++)
+    {
+      Vec4f v = ConvertFromR10G10B10A2SNorm(packed[t]);
+      CHECK(converted[t * 4 + 0] == v.x);
+      CHECK(converted[t * 4 + 1] == v.y);
+      CHECK(converted[t * 4 + 2] == v.z);
+      CHECK(converted[t * 4 + 3] == v.w);
+    }
+  };
+
+  SECTION("R11G11B10")
+  {
+    fmt.type = ResourceFormatType::R11G11B10;
+
+    CHECK(GetTexelStride(fmt) == 4);
+
+    std::vector<byte> src = RandomTexels(4);
+    const uint32_t *packed = (const uint32_t *)src.data();
+
+    ConvertRowToRGBA32F(fmt, src.data(), numTexels, converted.data());
+
+    for(uint32_t t = 0; t < numTexels; t++)
+    {
+      Vec3f v = ConvertFromR11G11B10(packed[t]);
+      CHECK(SameFloat(converted[t * 4 + 0], v.x));
+      CHECK(SameFloat(converted[t * 4 + 1], v.y));
+      CHECK(SameFloat(converted[t * 4 + 2], v.z));
+      CHECK(converted[t * 4 + 3] == 1.0f);
+    }
+  };
+
+  SECTION("16-bit packed")
+  {
+    std::vector<byte> src = RandomTexels(2);
+    const uint16_t *packed = (const uint16_t *)src.data();
+
+    fmt.type = ResourceFormatType::R5G6B5;
+    CHECK(GetTexelStride(fmt) == 2);
+
+    ConvertRowToRGBA32F(fmt, src.data(), numTexels, converted.data());
+
+    for(uint32_t t = 0; t < numTexels; t++)
+    {
+      Vec3f v = ConvertFromB5G6R5(packed[t]);
+      CHECK(converted[t * 4 + 0] == v.x);
+      CHECK(converted[t * 4 + 1] == v.y);
+      CHECK(converted[t * 4 + 2] == v.z);
+      CHECK(converted[t * 4 + 3] == 1.0f);
+    }
+
+    fmt.type = ResourceFormatType::R5G5B5A1;
+    ConvertRowToRGBA32F(fmt, src.data(), numTexels, converted.data());
+
+    for(uint32_t t = 0; t < numTexels; t++)
+    {
+      Vec4f v = ConvertFromB5G5R5A1(packed[t]);
+      CHECK(converted[t * 4 + 0] == v.x);
+      CHECK(converted[t * 4 + 3] == v.w);
+    }
+
+    fmt.type = ResourceFormatType::R4G4B4A4;
+    ConvertRowToRGBA32F(fmt, src.data(), numTexels, converted.data());
+
+    for(uint32_t t = 0; t < numTexels; t++)
+    {
+      Vec4f v = ConvertFromB4G4R4A4(packed[t]);
+      CHECK(converted[t * 4 + 0] == v.x);
+      CHECK(converted[t * 4 + 3] == v.w);
+    }
+  };
+};
+
+TEST_CASE("Test blending rows to a background", "[formatconvert]")
+{
+  std::vector<byte> src = RandomTexels(4);
+
+  // fully transparent and fully opaque texels
+  src[3] = 0;
+  src[7] = 255;
+
+  Vec4f background(0.25f, 0.5f, 0.75f);
+
+  std::vector<byte> blended(numTexels * 3);
+  BlendRowRGBA8ToRGB8(src.data(), numTexels, background, blended.data());
+
+  for(uint32_t t = 0; t < numTexels; t++)
+  {
+    float a = float(src[t * 4 + 3]) / 255.0f;
+
+    byte expected[3] = {
+        byte((float(src[t * 4 + 0]) / 255.0f * a + background.x * (1.0f - a)) * 255.0f),
+        byte((float(src[t * 4 + 1]) / 255.0f * a + background.y * (1.0f - a)) * 255.0f),
+        byte((float(src[t * 4 + 2]) / 255.0f * a + background.z * (1.0f - a)) * 255.0f),
+    };
+
+    CHECK(blended[t * 3 + 0] == expected[0]);
+    CHECK(blended[t * 3 + 1] == expected[1]);
+    CHECK(blended[t * 3 + 2] == expected[2]);
+  }
+
+  CHECK(blended[0] == byte(0.25f * 255.0f));
+};
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -131,14 +131,39 @@ public:
   data m_Data;
 };
 
+template <class data>
+class SemaphoreTemplate
+{
+public:
+  SemaphoreTemplate();
+  ~SemaphoreTemplate();
+
+  // wake up to numToWake waiting threads. If fewer threads are waiting, the remainder will be woken
+  // immediately the next time they call WaitForWake()
+  void Wake(uint32_t numToWake);
+  void WaitForWake();
+
+  // no copying
+  SemaphoreTemplate &operator=(const SemaphoreTemplate &other) = delete;
+  SemaphoreTemplate(const SemaphoreTemplate &other) = delete;
+
+  data m_Data;
+};
+
 void Init();
 void Shutdown();
 uint64_t AllocateTLSSlot();
 
+// allocates a TLS slot as above. When a thread exits with a non-NULL value in the slot, destructor
+// is called with that value on the exiting thread. Threads still running at shutdown aren't.
+typedef void (*TLSDestructor)(void *value);
+uint64_t AllocateTLSSlot(TLSDestructor destructor);
+
 void *GetTLSValue(uint64_t slot);
 void SetTLSValue(uint64_t slot, void *value);
 
-// must typedef CriticalSectionTemplate<X> CriticalSection
+// must typedef CriticalSectionTemplate<X> CriticalSection, RWLockTemplate<Y> RWLock and
+// SemaphoreTemplate<Z> Semaphore
 
 typedef uint64_t ThreadHandle;
 ThreadHandle CreateThread(std::function<void()> entryFunc);
@@ -147,6 +172,9 @@ void JoinThread(ThreadHandle handle);
 void CloseThread(ThreadHandle handle);
 void Sleep(uint32_t milliseconds);
 
+// number of logical processors available to run threads on. Always at least 1
+uint32_t NumberOfCores();
+
 // kind of windows specific, to handle this case:
 // http://blogs.msdn.com/b/oldnewthing/archive/2013/11/05/10463645.aspx
 void KeepModuleAlive();
@@ -309,6 +337,12 @@ bool feof(FILE *f);
 
 int fclose(FILE *f);
 
+// maps the first length bytes of an open file read-only into memory. Returns NULL if the file
+// can't be mapped, in which case the caller should fall back to reading through the FILE *. The
+// mapping stays valid after the FILE * is closed, until it's unmapped.
+const byte *mmapfile(FILE *f, uint64_t length);
+void munmapfile(const byte *data, uint64_t length);
+
 // functions for atomically appending to a log that may be in use in multiple
 // processes
 bool logfile_open(const char *filename);
@@ -434,6 +468,24 @@ uint64_t GetMachineIdent();
 string MakeMachineIdentString(uint64_t ident);
 };
 
+// tracks CPU writes to memory at page granularity, by write-protecting it and catching the fault
+// on the first write to each page. Only available where IsSupported() returns true
+namespace WriteWatch
+{
+bool IsSupported();
+size_t GetPageSize();
+
+// starts tracking writes to [base, base+size). base must be page aligned, and no page can already
+// be watched. Returns false if the range can't be watched
+bool Watch(void *base, size_t size);
+void Unwatch(void *base);
+
+// returns the [start, end) byte ranges within a watched range that have been written since it
+// was watched or last queried, and watches them again. Writes that happen after their page has
+// been returned will be caught by the next query
+void GetDirtyRanges(void *base, std::vector<std::pair<size_t, size_t> > &ranges);
+};
+
 namespace Bits
 {
 inline uint32_t CountLeadingZeroes(uint32_t value);
@@ -0,0 +1,168 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "common/threading.h"
+#include "os/os_specific.h"
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "3rdparty/catch/catch.hpp"
+
+TEST_CASE("Test write watching", "[writewatch]")
+{
+  if(!WriteWatch::IsSupported())
+    return;
+
+  const size_t page = WriteWatch::GetPageSize();
+  const size_t numPages = 16;
+
+  byte *mem = AllocAlignedBuffer(page * numPages, page);
+  memset(mem, 0, page * numPages);
+
+  std::vector<std::pair<size_t, size_t> > ranges;
+
+  SECTION("Only written pages are reported, and they're watched again afterwards")
+  {
+    // watch slightly less than the full pages, the last range is clamped to it
+    const size_t size = page * numPages - 100;
+
+    REQUIRE(WriteWatch::Watch(mem, size));
+
+    WriteWatch::GetDirtyRanges(mem, ranges);
+    CHECK(ranges.empty());
+
+    mem[page * 2 + 5] = 1;
+    mem[page * 3] = 1;
+    mem[page * 9 + page - 1] = 1;
+    mem[page * 15] = 1;
+
+    // reads don't count
+    CHECK(mem[page * 7] == 0);
+
+    WriteWatch::GetDirtyRanges(mem, ranges);
+
+    REQUIRE(ranges.size() == 3);
+    CHECK((ranges[0] == std::make_pair(page * 2, page * 4)));
+    CHECK((ranges[1] == std::make_pair(page * 9, page * 10)));
+    CHECK((ranges[2] == std::make_pair(page * 15, size)));
+
+    WriteWatch::GetDirtyRanges(mem, ranges);
+    CHECK(ranges.empty());
+
+    mem[page * 3 + 1] = 2;
+
+    WriteWatch::GetDirtyRanges(mem, ranges);
+
+    REQUIRE(ranges.size() == 1);
+    CHECK((ranges[0] == std::make_pair(page * 3, page * 4)));
+
+    WriteWatch::Unwatch(mem);
+
+    // writes after unwatching go through as normal
+    mem[page * 4] = 3;
+    CHECK(mem[page * 4] == 3);
+  };
+
+  SECTION("Overlapping and unaligned ranges can't be watched")
+  {
+    CHECK_FALSE(WriteWatch::Watch(mem + 1, page));
+
+    REQUIRE(WriteWatch::Watch(mem, page * 4));
+    CHECK_FALSE(WriteWatch::Watch(mem + page * 2, page * 4));
+    CHECK(WriteWatch::Watch(mem + page * 4, page * 4));
+
+    WriteWatch::Unwatch(mem);
+    WriteWatch::Unwatch(mem + page * 4);
+
+    CHECK(WriteWatch::Watch(mem, page * numPages));
+    WriteWatch::Unwatch(mem);
+  };
+
+  SECTION("Writes racing with queries are never lost")
+  {
+    REQUIRE(WriteWatch::Watch(mem, page * numPages));
+
+    // a copy kept up to date only from the reported ranges, as a capture would
+    std::vector<byte> shadow(mem, mem + page * numPages);
+
+    volatile int32_t stop = 0;
+
+    Threading::ThreadHandle writer = Threading::CreateThread([mem, page, numPages, &stop]() {
+      for(uint32_t i = 0; stop == 0; i++)
+        mem[(i % numPages) * page + (i / numPages) % page] = byte(i & 0xff);
+    });
+
+    for(int i = 0; i < 2000; i++)
+    {
+      WriteWatch::GetDirtyRanges(mem, ranges);
+      for(const std::pair<size_t, size_t> &r : ranges)
+        memcpy(shadow.data() + r.first, mem + r.first, r.second - r.first);
+    }
+
+    Atomic::Inc32(&stop);
+    Threading::JoinThread(writer);
+    Threading::CloseThread(writer);
+
+    WriteWatch::GetDirtyRanges(mem, ranges);
+    for(const std::pair<size_t, size_t> &r : ranges)
+      memcpy(shadow.data() + r.first, mem + r.first, r.second - r.first);
+
+    CHECK(memcmp(shadow.data(), mem, page * numPages) == 0);
+
+    WriteWatch::Unwatch(mem);
+  };
+
+  SECTION("Ranges can be unwatched and reused while other ranges are written")
+  {
+    REQUIRE(WriteWatch::Watch(mem, page * 4));
+
+    volatile int32_t stop = 0;
+
+    Threading::ThreadHandle writer = Threading::CreateThread([mem, page, &stop]() {
+      for(uint32_t i = 0; stop == 0; i++)
+        mem[(i % 4) * page] = byte(i & 0xff);
+    });
+
+    for(int i = 0; i < 2000; i++)
+    {
+      size_t pages = 1 + (i % 8);
+      REQUIRE(WriteWatch::Watch(mem + page * 8, page * pages));
+      mem[page * 8] = 1;
+      WriteWatch::GetDirtyRanges(mem + page * 8, ranges);
+      REQUIRE(ranges.size() == 1);
+      CHECK(ranges[0].first == 0);
+      WriteWatch::Unwatch(mem + page * 8);
+    }
+
+    Atomic::Inc32(&stop);
+    Threading::JoinThread(writer);
+    Threading::CloseThread(writer);
+
+    WriteWatch::Unwatch(mem);
+  };
+
+  FreeAlignedBuffer(mem);
+};
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -157,3 +157,28 @@ const char *Process::GetEnvVariable(const char *name)
 
   return settingsOutput.c_str();
 }
+
+// write watching isn't implemented on this platform
+bool WriteWatch::IsSupported()
+{
+  return false;
+}
+
+size_t WriteWatch::GetPageSize()
+{
+  return 4096;
+}
+
+bool WriteWatch::Watch(void *base, size_t size)
+{
+  return false;
+}
+
+void WriteWatch::Unwatch(void *base)
+{
+}
+
+void WriteWatch::GetDirtyRanges(void *base, std::vector<std::pair<size_t, size_t> > &ranges)
+{
+  ranges.clear();
+}
@@ -22,7 +22,10 @@
  * THE SOFTWARE.
  ******************************************************************************/
 
+#include <signal.h>
+#include <sys/mman.h>
 #include <unistd.h>
+#include "common/threading.h"
 #include "os/os_specific.h"
 
 extern char **environ;
@@ -137,4 +140,283 @@ bool OSUtility::DebuggerPresent()
 const char *Process::GetEnvVariable(const char *name)
 {
   return getenv(name);
-}
\ No newline at end of file
+}
+
+// Watched ranges are kept in a fixed table so that the fault handler can search it without
+// allocating or locking. Entries are only added and removed under watchLock.
+//
+// The fault handler may be running on another thread at any time, and may have loaded an entry
+// just before it was removed. So entries are never freed: an unwatched entry goes on a free list
+// to be reused by a later range that fits in its dirty array. The array's capacity never changes,
+// and the handler checks against it, so a stale handler can at worst mark a page dirty that
+// didn't need it.
+struct WatchedRange
+{
+  // one flag per page, set by the fault handler when the page is first written. Never freed
+  volatile int32_t *dirty;
+  size_t capacity;
+
+  byte *base;
+  // the size requested, and the size of all the pages it covers
+  size_t length;
+  size_t size;
+  size_t numPages;
+};
+
+static const int MaxWatchedRanges = 256;
+static WatchedRange *volatile watchedRanges[MaxWatchedRanges] = {};
+static std::vector<WatchedRange *> freeWatchedRanges;
+static Threading::CriticalSection watchLock;
+static struct sigaction prevSegvAction;
+static bool segvHandlerInstalled = false;
+static size_t pageSize = 0;
+
+// the last fault on each thread that didn't hit a watched range. See below
+static __thread void *lastUnknownFault = NULL;
+
+static void WriteWatchFaultHandler(int signum, siginfo_t *info, void *context)
+{
+  byte *addr = (byte *)info->si_addr;
+
+  // a write to a protected page is an access error, anything else can't be ours
+  if(info->si_code == SEGV_ACCERR)
+  {
+    for(int i = 0; i < MaxWatchedRanges; i++)
+    {
+      WatchedRange *range = watchedRanges[i];
+      __sync_synchronize();
+
+      if(range == NULL)
+        continue;
+
+      byte *base = range->base;
+
+      if(addr >= base && addr < base + range->size)
+      {
+        size_t page = size_t(addr - base) / pageSize;
+
+        // only possible if the range was reused while we were looking at it
+        if(page >= range->capacity)
+          break;
+
+        // allow writes before marking the page dirty. A query clears the flag before protecting
+        // the page again, so whichever order the two happen in the page can't end up writable with
+        // its flag clear.
+        mprotect(base + page * pageSize, pageSize, PROT_READ | PROT_WRITE);
+        Atomic::CmpExch32(&range->dirty[page], 0, 1);
+
+        lastUnknownFault = NULL;
+        return;
+      }
+    }
+
+    // the range may have been unwatched since the fault. That makes the page writable before it's
+    // removed from the table, so try the access again once before deciding it's not ours.
+    if(lastUnknownFault != addr)
+    {
+      lastUnknownFault = addr;
+      return;
+    }
+  }
+
+  lastUnknownFault = NULL;
+
+  // not ours, pass it on to whoever was handling faults before
+  if(prevSegvAction.sa_flags & SA_SIGINFO)
+  {
+    prevSegvAction.sa_sigaction(signum, info, context);
+  }
+  else if(prevSegvAction.sa_handler != SIG_DFL && prevSegvAction.sa_handler != SIG_IGN)
+  {
+    prevSegvAction.sa_handler(signum);
+  }
+  else
+  {
+    // this fault is fatal, the same as it would have been without us. Restore the previous action
+    // and raise it again so the process terminates with the right signal, since returning would
+    // just fault again. Our handler is only removed on this path, when nothing can run after it.
+    sigaction(signum, &prevSegvAction, NULL);
+    raise(signum);
+  }
+}
+
+bool WriteWatch::IsSupported()
+{
+  return true;
+}
+
+size_t WriteWatch::GetPageSize()
+{
+  if(pageSize == 0)
+    pageSize = (size_t)sysconf(_SC_PAGE_SIZE);
+
+  return pageSize;
+}
+
+static int FindWatchedRange(void *base)
+{
+  for(int i = 0; i < MaxWatchedRanges; i++)
+    if(watchedRanges[i] && watchedRanges[i]->base == base)
+      return i;
+
+  return -1;
+}
+
+bool WriteWatch::Watch(void *base, size_t size)
+{
+  size_t page = GetPageSize();
+
+  if(base == NULL || size == 0 || ((uintptr_t)base % page) != 0)
+    return false;
+
+  SCOPED_LOCK(watchLock);
+
+  if(!segvHandlerInstalled)
+  {
+    struct sigaction action = {};
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    action.sa_sigaction = &WriteWatchFaultHandler;
+
+    if(sigaction(SIGSEGV, &action, &prevSegvAction) != 0)
+    {
+      RDCERR("Couldn't install write watch fault handler: %s", strerror(errno));
+      return false;
+    }
+
+    segvHandlerInstalled = true;
+  }
+
+  size_t numPages = (size + page - 1) / page;
+  byte *start = (byte *)base;
+  byte *end = start + numPages * page;
+
+  int slot = -1;
+
+  for(int i = 0; i < MaxWatchedRanges; i++)
+  {
+    WatchedRange *other = watchedRanges[i];
+
+    if(other == NULL)
+    {
+      if(slot < 0)
+        slot = i;
+      continue;
+    }
+
+    // pages can't be shared, or unwatching one range would stop watching the other
+    if(start < other->base + other->size && other->base < end)
+      return false;
+  }
+
+  if(slot < 0)
+  {
+    RDCWARN("Too many ranges are being write watched, can't watch %p", base);
+    return false;
+  }
+
+  // reuse the smallest free entry that's big enough, or make a new one
+  WatchedRange *range = NULL;
+  size_t freeIdx = 0;
+
+  for(size_t i = 0; i < freeWatchedRanges.size(); i++)
+  {
+    WatchedRange *r = freeWatchedRanges[i];
+    if(r->capacity >= numPages && (range == NULL || r->capacity < range->capacity))
+    {
+      range = r;
+      freeIdx = i;
+    }
+  }
+
+  if(range)
+  {
+    freeWatchedRanges.erase(freeWatchedRanges.begin() + freeIdx);
+    for(size_t p = 0; p < numPages; p++)
+      range->dirty[p] = 0;
+  }
+  else
+  {
+    range = new WatchedRange;
+    range->capacity = numPages;
+    range->dirty = new int32_t[numPages]();
+  }
+
+  range->base = start;
+  range->length = size;
+  range->size = numPages * page;
+  range->numPages = numPages;
+
+  // publish the range before protecting it, so that the first write finds it
+  __sync_synchronize();
+  watchedRanges[slot] = range;
+  __sync_synchronize();
+
+  if(mprotect(start, range->size, PROT_READ) != 0)
+  {
+    RDCWARN("Couldn't write protect %p: %s", base, strerror(errno));
+
+    watchedRanges[slot] = NULL;
+    freeWatchedRanges.push_back(range);
+    return false;
+  }
+
+  return true;
+}
+
+void WriteWatch::Unwatch(void *base)
+{
+  SCOPED_LOCK(watchLock);
+
+  int slot = FindWatchedRange(base);
+
+  if(slot < 0)
+    return;
+
+  WatchedRange *range = watchedRanges[slot];
+
+  // restore access first, so nothing can fault on the range once we stop looking for it
+  mprotect(range->base, range->size, PROT_READ | PROT_WRITE);
+
+  watchedRanges[slot] = NULL;
+  __sync_synchronize();
+
+  // a handler may still be using it, so it's kept to be reused rather than freed
+  freeWatchedRanges.push_back(range);
+}
+
+void WriteWatch::GetDirtyRanges(void *base, std::vector<std::pair<size_t, size_t> > &ranges)
+{
+  ranges.clear();
+
+  SCOPED_LOCK(watchLock);
+
+  int slot = FindWatchedRange(base);
+
+  if(slot < 0)
+    return;
+
+  WatchedRange *range = watchedRanges[slot];
+
+  for(size_t p = 0; p < range->numPages;)
+  {
+    if(!range->dirty[p])
+    {
+      p++;
+      continue;
+    }
+
+    size_t first = p;
+
+    // clear each flag before the page is protected again. A write in between won't fault, but it
+    // has already happened by the time the caller reads the page, so it isn't lost. If the handler
+    // is making the page writable at the same time, it sets the flag after, so the page is
+    // reported again next time.
+    for(; p < range->numPages && range->dirty[p]; p++)
+      Atomic::CmpExch32(&range->dirty[p], 1, 0);
+
+    mprotect(range->base + first * pageSize, (p - first) * pageSize, PROT_READ);
+
+    ranges.push_back(std::make_pair(first * pageSize, RDCMIN(p * pageSize, range->length)));
+  }
+}
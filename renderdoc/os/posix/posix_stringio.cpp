@@ -32,6 +32,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/file.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <time.h>
@@ -465,6 +466,28 @@ int fclose(FILE *f)
   return ::fclose(f);
 }
 
+const byte *mmapfile(FILE *f, uint64_t length)
+{
+  if(length == 0 || length != (uint64_t)(size_t)length)
+    return NULL;
+
+  void *ret = ::mmap(NULL, (size_t)length, PROT_READ, MAP_PRIVATE, ::fileno(f), 0);
+
+  if(ret == MAP_FAILED)
+  {
+    RDCWARN("Couldn't map file: errno %d", errno);
+    return NULL;
+  }
+
+  return (const byte *)ret;
+}
+
+void munmapfile(const byte *data, uint64_t length)
+{
+  if(data)
+    ::munmap((void *)data, (size_t)length);
+}
+
 bool exists(const char *filename)
 {
   struct ::stat st;
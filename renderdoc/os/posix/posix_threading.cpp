@@ -22,6 +22,7 @@
  * THE SOFTWARE.
  ******************************************************************************/
 
+#include <algorithm>
 #include <time.h>
 #include <unistd.h>
 #include "os/os_specific.h"
@@ -151,6 +152,43 @@ void RWLock::ReadUnlock()
   pthread_rwlock_unlock(&m_Data.rwlock);
 }
 
+template <>
+Semaphore::SemaphoreTemplate()
+{
+  pthread_mutex_init(&m_Data.lock, NULL);
+  pthread_cond_init(&m_Data.cond, NULL);
+  m_Data.count = 0;
+}
+
+template <>
+Semaphore::~SemaphoreTemplate()
+{
+  pthread_cond_destroy(&m_Data.cond);
+  pthread_mutex_destroy(&m_Data.lock);
+}
+
+template <>
+void Semaphore::Wake(uint32_t numToWake)
+{
+  pthread_mutex_lock(&m_Data.lock);
+  m_Data.count += numToWake;
+  if(numToWake == 1)
+    pthread_cond_signal(&m_Data.cond);
+  else
+    pthread_cond_broadcast(&m_Data.cond);
+  pthread_mutex_unlock(&m_Data.lock);
+}
+
+template <>
+void Semaphore::WaitForWake()
+{
+  pthread_mutex_lock(&m_Data.lock);
+  while(m_Data.count == 0)
+    pthread_cond_wait(&m_Data.cond, &m_Data.lock);
+  m_Data.count--;
+  pthread_mutex_unlock(&m_Data.lock);
+}
+
 struct ThreadInitData
 {
   std::function<void()> entryFunc;
@@ -181,28 +219,51 @@ struct TLSData
 
 static CriticalSection *m_TLSListLock = NULL;
 static vector<TLSData *> *m_TLSList = NULL;
+// the destructor for each slot that has one, protected by m_TLSListLock
+static vector<TLSDestructor> *m_TLSDestructors = NULL;
+
+static void ThreadExited(void *value)
+{
+  TLSData *slots = (TLSData *)value;
+
+  vector<TLSDestructor> destructors;
+
+  m_TLSListLock->Lock();
+  destructors = *m_TLSDestructors;
+  m_TLSList->erase(std::remove(m_TLSList->begin(), m_TLSList->end(), slots), m_TLSList->end());
+  m_TLSListLock->Unlock();
+
+  for(size_t i = 0; i < slots->data.size() && i < destructors.size(); i++)
+    if(slots->data[i] && destructors[i])
+      destructors[i](slots->data[i]);
+
+  delete slots;
+}
 
 void Init()
 {
-  int err = pthread_key_create(&OSTLSHandle, NULL);
+  int err = pthread_key_create(&OSTLSHandle, &ThreadExited);
   if(err != 0)
     RDCFATAL("Can't allocate OS TLS slot");
 
   m_TLSListLock = new CriticalSection();
   m_TLSList = new vector<TLSData *>();
+  m_TLSDestructors = new vector<TLSDestructor>();
 
   CacheDebuggerPresent();
 }
 
 void Shutdown()
 {
+  // stop any more threads being notified before tidying up
+  pthread_key_delete(OSTLSHandle);
+
   for(size_t i = 0; i < m_TLSList->size(); i++)
     delete m_TLSList->at(i);
 
   delete m_TLSList;
+  delete m_TLSDestructors;
   delete m_TLSListLock;
-
-  pthread_key_delete(OSTLSHandle);
 }
 
 // allocate a TLS slot in our per-thread vectors with an atomic increment.
@@ -213,6 +274,19 @@ uint64_t AllocateTLSSlot()
   return Atomic::Inc64(&nextTLSSlot);
 }
 
+uint64_t AllocateTLSSlot(TLSDestructor destructor)
+{
+  uint64_t slot = AllocateTLSSlot();
+
+  m_TLSListLock->Lock();
+  if(m_TLSDestructors->size() < slot)
+    m_TLSDestructors->resize((size_t)slot);
+  m_TLSDestructors->at((size_t)slot - 1) = destructor;
+  m_TLSListLock->Unlock();
+
+  return slot;
+}
+
 // look up our per-thread vector.
 void *GetTLSValue(uint64_t slot)
 {
@@ -293,4 +367,10 @@ void Sleep(uint32_t milliseconds)
 {
   usleep(milliseconds * 1000);
 }
+
+uint32_t NumberOfCores()
+{
+  long ret = sysconf(_SC_NPROCESSORS_ONLN);
+  return ret > 0 ? (uint32_t)ret : 1;
+}
 };
@@ -1628,4 +1628,28 @@ uint32_t Process::GetCurrentPID()
 void Process::Shutdown()
 {
   // nothing to do
-}
\ No newline at end of file
+}
+// write watching isn't implemented on this platform
+bool WriteWatch::IsSupported()
+{
+  return false;
+}
+
+size_t WriteWatch::GetPageSize()
+{
+  return 4096;
+}
+
+bool WriteWatch::Watch(void *base, size_t size)
+{
+  return false;
+}
+
+void WriteWatch::Unwatch(void *base)
+{
+}
+
+void WriteWatch::GetDirtyRanges(void *base, std::vector<std::pair<size_t, size_t> > &ranges)
+{
+  ranges.clear();
+}
@@ -665,6 +665,38 @@ int fclose(FILE *f)
   return ::fclose(f);
 }
 
+const byte *mmapfile(FILE *f, uint64_t length)
+{
+  if(length == 0 || length != (uint64_t)(SIZE_T)length)
+    return NULL;
+
+  HANDLE file = (HANDLE)::_get_osfhandle(::_fileno(f));
+
+  HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+  if(mapping == NULL)
+  {
+    RDCWARN("Couldn't create file mapping: %d", GetLastError());
+    return NULL;
+  }
+
+  void *ret = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, (SIZE_T)length);
+
+  if(ret == NULL)
+    RDCWARN("Couldn't map view of file: %d", GetLastError());
+
+  // the view keeps the mapping object alive, we don't need the handle anymore
+  CloseHandle(mapping);
+
+  return (const byte *)ret;
+}
+
+void munmapfile(const byte *data, uint64_t length)
+{
+  if(data)
+    UnmapViewOfFile(data);
+}
+
 static HANDLE logHandle = NULL;
 
 bool logfile_open(const char *filename)
@@ -23,6 +23,7 @@
  * THE SOFTWARE.
  ******************************************************************************/
 
+#include <algorithm>
 #include <time.h>
 #include "os/os_specific.h"
 
@@ -145,6 +146,26 @@ void RWLock::ReadUnlock()
   ReleaseSRWLockShared(&m_Data);
 }
 
+Semaphore::SemaphoreTemplate()
+{
+  m_Data = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+}
+
+Semaphore::~SemaphoreTemplate()
+{
+  CloseHandle(m_Data);
+}
+
+void Semaphore::Wake(uint32_t numToWake)
+{
+  ReleaseSemaphore(m_Data, (LONG)numToWake, NULL);
+}
+
+void Semaphore::WaitForWake()
+{
+  WaitForSingleObject(m_Data, INFINITE);
+}
+
 struct ThreadInitData
 {
   std::function<void()> entryFunc;
@@ -166,6 +187,8 @@ static DWORD __stdcall sThreadInit(void *init)
 // to not exhaust OS slots, we only allocate one that points
 // to our own array
 DWORD OSTLSHandle;
+// TLS has no exit notification, so the same data is also stored in an FLS slot with a callback
+DWORD OSFLSHandle;
 int64_t nextTLSSlot = 0;
 
 struct TLSData
@@ -175,6 +198,33 @@ struct TLSData
 
 static CriticalSection *m_TLSListLock = NULL;
 static vector<TLSData *> *m_TLSList = NULL;
+// the destructor for each slot that has one, protected by m_TLSListLock
+static vector<TLSDestructor> *m_TLSDestructors = NULL;
+static bool m_TLSShutdown = false;
+
+static void WINAPI ThreadExited(void *value)
+{
+  TLSData *slots = (TLSData *)value;
+
+  // FlsFree calls this for every thread, but Shutdown frees everything itself
+  if(slots == NULL || m_TLSShutdown)
+    return;
+
+  vector<TLSDestructor> destructors;
+
+  m_TLSListLock->Lock();
+  destructors = *m_TLSDestructors;
+  m_TLSList->erase(std::remove(m_TLSList->begin(), m_TLSList->end(), slots), m_TLSList->end());
+  m_TLSListLock->Unlock();
+
+  TlsSetValue(OSTLSHandle, NULL);
+
+  for(size_t i = 0; i < slots->data.size() && i < destructors.size(); i++)
+    if(slots->data[i] && destructors[i])
+      destructors[i](slots->data[i]);
+
+  delete slots;
+}
 
 void Init()
 {
@@ -182,12 +232,21 @@ void Init()
   if(OSTLSHandle == TLS_OUT_OF_INDEXES)
     RDCFATAL("Can't allocate OS TLS slot");
 
+  OSFLSHandle = FlsAlloc(&ThreadExited);
+  if(OSFLSHandle == FLS_OUT_OF_INDEXES)
+    RDCFATAL("Can't allocate OS FLS slot");
+
   m_TLSListLock = new CriticalSection();
   m_TLSList = new vector<TLSData *>();
+  m_TLSDestructors = new vector<TLSDestructor>();
 }
 
 void Shutdown()
 {
+  m_TLSShutdown = true;
+
+  FlsFree(OSFLSHandle);
+
   if(m_TLSList)
   {
     for(size_t i = 0; i < m_TLSList->size(); i++)
@@ -195,6 +254,7 @@ void Shutdown()
   }
 
   delete m_TLSList;
+  delete m_TLSDestructors;
   delete m_TLSListLock;
 
   TlsFree(OSTLSHandle);
@@ -208,6 +268,19 @@ uint64_t AllocateTLSSlot()
   return Atomic::Inc64(&nextTLSSlot);
 }
 
+uint64_t AllocateTLSSlot(TLSDestructor destructor)
+{
+  uint64_t slot = AllocateTLSSlot();
+
+  m_TLSListLock->Lock();
+  if(m_TLSDestructors->size() < slot)
+    m_TLSDestructors->resize((size_t)slot);
+  m_TLSDestructors->at((size_t)slot - 1) = destructor;
+  m_TLSListLock->Unlock();
+
+  return slot;
+}
+
 // look up our per-thread vector.
 void *GetTLSValue(uint64_t slot)
 {
@@ -230,6 +303,7 @@ void SetTLSValue(uint64_t slot, void *value)
     {
       slots = new TLSData;
       TlsSetValue(OSTLSHandle, slots);
+      FlsSetValue(OSFLSHandle, slots);
 
       // in the case where this thread is entirely new, we globally lock so we can
       // store its data for shutdown (as we might not get notified of every thread
@@ -293,4 +367,11 @@ void Sleep(uint32_t milliseconds)
 {
   ::Sleep((DWORD)milliseconds);
 }
+
+uint32_t NumberOfCores()
+{
+  SYSTEM_INFO info = {};
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors > 0 ? (uint32_t)info.dwNumberOfProcessors : 1;
+}
 };
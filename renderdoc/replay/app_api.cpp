@@ -72,13 +72,19 @@ static const char *GetCaptureFilePathTemplate()
   return RenderDoc::Inst().GetCaptureFileTemplate();
 }
 
+// captures are written in the background, but applications using the API expect a capture to be
+// available as soon as EndFrameCapture returns.
 static uint32_t GetNumCaptures()
 {
+  RenderDoc::Inst().FlushCaptureWrites();
+
   return (uint32_t)RenderDoc::Inst().GetCaptures().size();
 }
 
 static uint32_t GetCapture(uint32_t idx, char *filename, uint32_t *pathlength, uint64_t *timestamp)
 {
+  RenderDoc::Inst().FlushCaptureWrites();
+
   vector<CaptureData> caps = RenderDoc::Inst().GetCaptures();
 
   if(idx >= (uint32_t)caps.size())
@@ -106,6 +112,9 @@ static uint32_t GetCapture(uint32_t idx, char *filename, uint32_t *pathlength, u
 
 static void SetCaptureFileComments(const char *filePath, const char *comments)
 {
+  // the capture may still be being written
+  RenderDoc::Inst().FlushCaptureWrites();
+
   std::string path;
   if(filePath == NULL || filePath[0] == 0)
   {
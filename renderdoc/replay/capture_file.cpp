@@ -140,6 +140,10 @@ public:
     // decompile to structured data on demand.
     InitStructuredData();
 
+    // the structured data leaves the library here, so it can't rely on buffers that are loaded on
+    // demand from the capture - callers such as python only see SDFile::buffers.
+    m_StructuredData.LoadAllBuffers();
+
     return m_StructuredData;
   }
 
@@ -154,10 +158,12 @@ public:
 
     m_StructuredData.buffers.reserve(file.buffers.size());
 
-    for(bytebuf *buf : file.buffers)
-      m_StructuredData.buffers.push_back(new bytebuf(*buf));
+    for(size_t i = 0; i < file.buffers.size(); i++)
+      m_StructuredData.buffers.push_back(new bytebuf(file.GetBuffer(i)));
   }
 
+  bytebuf GetChunkContents(uint32_t chunkIndex);
+
   Thumbnail GetThumbnail(FileType type, uint32_t maxsize);
 
   // ICaptureAccess
@@ -344,7 +350,14 @@ void CaptureFile::InitStructuredData(RENDERDOC_ProgressCallback progress /*= REN
     RenderDoc::Inst().SetProgressCallback<LoadProgress>(progress);
 
     if(proc)
+    {
       proc(m_RDC, m_StructuredData);
+
+      // buffers are read from the capture on demand
+      LazyStructuredBuffers *lazy = LazyStructuredBuffers::Get(m_StructuredData);
+      if(lazy)
+        lazy->SetCapture(m_RDC);
+    }
     else
       RDCERR("Can't get structured data for driver %s", m_RDC->GetDriverName().c_str());
 
@@ -434,7 +447,8 @@ ReplayStatus CaptureFile::Convert(const char *filename, const char *filetype, co
     {
       InitStructuredData(fetchProgress);
 
-      return exporter(filename, *m_RDC, GetStructuredData(), exportProgress);
+      // exporters go through SDFile::GetBuffer, so the buffers can stay in the capture until needed
+      return exporter(filename, *m_RDC, m_StructuredData, exportProgress);
     }
   }
 
@@ -736,6 +750,43 @@ bytebuf CaptureFile::GetSectionContents(int index)
   return ret;
 }
 
+bytebuf CaptureFile::GetChunkContents(uint32_t chunkIndex)
+{
+  bytebuf ret;
+
+  if(!m_RDC)
+    return ret;
+
+  uint64_t offset = 0, length = 0;
+
+  if(!m_RDC->GetChunkRange(chunkIndex, offset, length))
+  {
+    if(m_RDC->GetChunkIndex().chunkOffsets.empty())
+      RDCWARN("Capture has no chunk index, can't fetch chunk %u", chunkIndex);
+    return ret;
+  }
+
+  StreamReader *reader = m_RDC->ReadSection(m_RDC->SectionIndex(SectionType::FrameCapture));
+
+  bool success = false;
+
+  if(offset + length <= reader->GetSize() && reader->SetOffset(offset))
+  {
+    ret.resize((size_t)length);
+    success = reader->Read(ret.data(), length);
+  }
+
+  delete reader;
+
+  if(!success)
+  {
+    RDCERR("Couldn't read chunk %u at %llu from capture", chunkIndex, offset);
+    ret.clear();
+  }
+
+  return ret;
+}
+
 bool CaptureFile::WriteSection(const SectionProperties &props, const bytebuf &contents)
 {
   StreamWriter *writer = m_RDC->WriteSection(props);
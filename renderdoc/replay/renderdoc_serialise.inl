@@ -73,6 +73,32 @@ void DoSerialise(SerialiserType &ser, PathEntry &el)
   SIZE_CHECK(32);
 }
 
+template <class SerialiserType>
+void DoSerialise(SerialiserType &ser, RemoteSession &el)
+{
+  SERIALISE_MEMBER(clientAddress);
+  SERIALISE_MEMBER(captureFile);
+  SERIALISE_MEMBER(sessionId);
+  SERIALISE_MEMBER(connectedSeconds);
+  SERIALISE_MEMBER(current);
+
+  SIZE_CHECK(48);
+}
+
+template <class SerialiserType>
+void DoSerialise(SerialiserType &ser, HookedCallProfile &el)
+{
+  SERIALISE_MEMBER(name);
+  SERIALISE_MEMBER(backgroundCalls);
+  SERIALISE_MEMBER(backgroundWrapperMicroseconds);
+  SERIALISE_MEMBER(backgroundDriverMicroseconds);
+  SERIALISE_MEMBER(capturingCalls);
+  SERIALISE_MEMBER(capturingWrapperMicroseconds);
+  SERIALISE_MEMBER(capturingDriverMicroseconds);
+
+  SIZE_CHECK(72);
+}
+
 template <class SerialiserType>
 void DoSerialise(SerialiserType &ser, SectionProperties &el)
 {
@@ -2146,6 +2172,8 @@ void DoSerialise(SerialiserType &ser, VKPipe::State &el)
 
 INSTANTIATE_SERIALISE_TYPE(ExecuteResult)
 INSTANTIATE_SERIALISE_TYPE(PathEntry)
+INSTANTIATE_SERIALISE_TYPE(RemoteSession)
+INSTANTIATE_SERIALISE_TYPE(HookedCallProfile)
 INSTANTIATE_SERIALISE_TYPE(SectionProperties)
 INSTANTIATE_SERIALISE_TYPE(EnvironmentModification)
 INSTANTIATE_SERIALISE_TYPE(CaptureOptions)
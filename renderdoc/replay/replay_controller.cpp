@@ -31,6 +31,7 @@
 #include "driver/ihv/amd/amd_rgp.h"
 #include "jpeg-compressor/jpgd.h"
 #include "jpeg-compressor/jpge.h"
+#include "maths/formatconvert.h"
 #include "maths/formatpacking.h"
 #include "os/os_specific.h"
 #include "serialise/rdcfile.h"
@@ -1118,44 +1119,43 @@ bool ReplayController::SaveTexture(const TextureSave &saveData, const char *path
   {
     byte *nonalpha = new byte[td.width * td.height * 3];
 
+    // the background colours are constant, so gamma correct them once up front
+    Vec4f cols[3] = {
+        Vec4f(sd.alphaCol.x, sd.alphaCol.y, sd.alphaCol.z),
+        RenderDoc::Inst().LightCheckerboardColor(), RenderDoc::Inst().DarkCheckerboardColor(),
+    };
+
+    for(Vec4f &col : cols)
+    {
+      col.x = powf(col.x, 1.0f / 2.2f);
+      col.y = powf(col.y, 1.0f / 2.2f);
+      col.z = powf(col.z, 1.0f / 2.2f);
+    }
+
     for(uint32_t y = 0; y < td.height; y++)
     {
-      for(uint32_t x = 0; x < td.width; x++)
-      {
-        byte r = subdata[0][(y * td.width + x) * 4 + 0];
-        byte g = subdata[0][(y * td.width + x) * 4 + 1];
-        byte b = subdata[0][(y * td.width + x) * 4 + 2];
-        byte a = subdata[0][(y * td.width + x) * 4 + 3];
+      const byte *src = subdata[0] + y * td.width * 4;
+      byte *dst = nonalpha + y * td.width * 3;
 
-        if(sd.alpha != AlphaMapping::Discard)
+      if(sd.alpha == AlphaMapping::Discard)
+      {
+        for(uint32_t x = 0; x < td.width; x++)
+          memcpy(dst + x * 3, src + x * 4, 3);
+      }
+      else if(sd.alpha == AlphaMapping::BlendToCheckerboard)
+      {
+        // blend each run of texels within one checkerboard square at a time
+        for(uint32_t x = 0; x < td.width; x += 64)
         {
-          Vec4f col = Vec4f(sd.alphaCol.x, sd.alphaCol.y, sd.alphaCol.z);
-          if(sd.alpha == AlphaMapping::BlendToCheckerboard)
-          {
-            bool lightSquare = ((x / 64) % 2) == ((y / 64) % 2);
-            col = lightSquare ? RenderDoc::Inst().LightCheckerboardColor()
-                              : RenderDoc::Inst().DarkCheckerboardColor();
-          }
-
-          col.x = powf(col.x, 1.0f / 2.2f);
-          col.y = powf(col.y, 1.0f / 2.2f);
-          col.z = powf(col.z, 1.0f / 2.2f);
-
-          FloatVector pixel = FloatVector(float(r) / 255.0f, float(g) / 255.0f, float(b) / 255.0f,
-                                          float(a) / 255.0f);
+          bool lightSquare = ((x / 64) % 2) == ((y / 64) % 2);
 
-          pixel.x = pixel.x * pixel.w + col.x * (1.0f - pixel.w);
-          pixel.y = pixel.y * pixel.w + col.y * (1.0f - pixel.w);
-          pixel.z = pixel.z * pixel.w + col.z * (1.0f - pixel.w);
-
-          r = byte(pixel.x * 255.0f);
-          g = byte(pixel.y * 255.0f);
-          b = byte(pixel.z * 255.0f);
+          BlendRowRGBA8ToRGB8(src + x * 4, RDCMIN(64U, td.width - x), cols[lightSquare ? 1 : 2],
+                              dst + x * 3);
         }
-
-        nonalpha[(y * td.width + x) * 3 + 0] = r;
-        nonalpha[(y * td.width + x) * 3 + 1] = g;
-        nonalpha[(y * td.width + x) * 3 + 2] = b;
+      }
+      else
+      {
+        BlendRowRGBA8ToRGB8(src, td.width, cols[0], dst);
       }
     }
 
@@ -1308,60 +1308,26 @@ bool ReplayController::SaveTexture(const TextureSave &saveData, const char *path
       if(saveFmt.compType == CompType::Typeless)
         saveFmt.compType = saveFmt.compByteWidth == 4 ? CompType::Float : CompType::UNorm;
 
-      uint32_t pixStride = saveFmt.compCount * saveFmt.compByteWidth;
+      uint32_t pixStride = GetTexelStride(saveFmt);
 
-      // 24-bit depth still has a stride of 4 bytes.
-      if(saveFmt.compType == CompType::Depth && pixStride == 3)
-        pixStride = 4;
+      // HDR converts straight into the output, EXR needs a row to split into planes
+      std::vector<float> rowData;
+      if(fldata == NULL)
+        rowData.resize(td.width * 4);
 
       for(uint32_t y = 0; y < td.height; y++)
       {
-        for(uint32_t x = 0; x < td.width; x++)
-        {
-          float r = 0.0f;
-          float g = 0.0f;
-          float b = 0.0f;
-          float a = 1.0f;
-
-          if(saveFmt.type == ResourceFormatType::R10G10B10A2)
-          {
-            uint32_t *u32 = (uint32_t *)srcData;
-
-            Vec4f vec = ConvertFromR10G10B10A2(*u32);
-
-            r = vec.x;
-            g = vec.y;
-            b = vec.z;
-            a = vec.w;
-
-            srcData += 4;
-          }
-          else if(saveFmt.type == ResourceFormatType::R11G11B10)
-          {
-            uint32_t *u32 = (uint32_t *)srcData;
-
-            Vec3f vec = ConvertFromR11G11B10(*u32);
+        float *row = fldata ? fldata + y * td.width * 4 : rowData.data();
 
-            r = vec.x;
-            g = vec.y;
-            b = vec.z;
-            a = 1.0f;
+        ConvertRowToRGBA32F(saveFmt, srcData, td.width, row);
+        srcData += td.width * pixStride;
 
-            srcData += 4;
-          }
-          else
-          {
-            if(saveFmt.compCount >= 1)
-              r = ConvertComponent(saveFmt, srcData + saveFmt.compByteWidth * 0);
-            if(saveFmt.compCount >= 2)
-              g = ConvertComponent(saveFmt, srcData + saveFmt.compByteWidth * 1);
-            if(saveFmt.compCount >= 3)
-              b = ConvertComponent(saveFmt, srcData + saveFmt.compByteWidth * 2);
-            if(saveFmt.compCount >= 4)
-              a = ConvertComponent(saveFmt, srcData + saveFmt.compByteWidth * 3);
-
-            srcData += pixStride;
-          }
+        for(uint32_t x = 0; x < td.width; x++)
+        {
+          float r = row[x * 4 + 0];
+          float g = row[x * 4 + 1];
+          float b = row[x * 4 + 2];
+          float a = row[x * 4 + 3];
 
           if(saveFmt.bgraOrder)
             std::swap(r, b);
@@ -259,6 +259,87 @@ void PatchLineStripIndexBuffer(const DrawcallDescription *draw, uint8_t *idx8, u
 #undef IDX_VALUE
 }
 
+void CompactIndexBuffer(std::vector<uint32_t> &indices, std::vector<uint32_t> &uniqueIndices)
+{
+  uniqueIndices.clear();
+
+  if(indices.empty())
+    return;
+
+  uint32_t minIdx = ~0U, maxIdx = 0;
+  for(uint32_t idx : indices)
+  {
+    minIdx = RDCMIN(minIdx, idx);
+    maxIdx = RDCMAX(maxIdx, idx);
+  }
+
+  const uint64_t range = uint64_t(maxIdx - minIdx) + 1;
+
+  // most index buffers reference a fairly dense range of vertices, so a table over the whole range
+  // maps each vertex directly to its unique position. Indices can also be sparse or garbage (like
+  // 0xcccccccc), in which case the table would be huge, so fall back to sorting instead.
+  if(range <= RDCMAX(uint64_t(indices.size()) * 4, uint64_t(0x10000)))
+  {
+    const uint32_t unused = ~0U;
+
+    std::vector<uint32_t> remap((size_t)range, unused);
+    for(uint32_t idx : indices)
+      remap[idx - minIdx] = 0;
+
+    // walking the table in order gives the unique indices already sorted
+    for(size_t v = 0; v < remap.size(); v++)
+    {
+      if(remap[v] != unused)
+      {
+        remap[v] = (uint32_t)uniqueIndices.size();
+        uniqueIndices.push_back(minIdx + uint32_t(v));
+      }
+    }
+
+    for(uint32_t &idx : indices)
+      idx = remap[idx - minIdx];
+
+    return;
+  }
+
+  // radix sort the indices relative to minIdx, with their positions in the low 32 bits so they can
+  // be written back once the unique position is known. Only as many 8-bit digits as the range
+  // needs are sorted.
+  std::vector<uint64_t> keys(indices.size()), sorted(indices.size());
+  for(size_t i = 0; i < indices.size(); i++)
+    keys[i] = (uint64_t(indices[i] - minIdx) << 32) | uint64_t(i);
+
+  for(uint32_t shift = 32; shift < 64 && ((range - 1) >> (shift - 32)) != 0; shift += 8)
+  {
+    size_t offsets[256] = {};
+    for(uint64_t key : keys)
+      offsets[(key >> shift) & 0xff]++;
+
+    size_t total = 0;
+    for(size_t &offs : offsets)
+    {
+      size_t count = offs;
+      offs = total;
+      total += count;
+    }
+
+    for(uint64_t key : keys)
+      sorted[offsets[(key >> shift) & 0xff]++] = key;
+
+    keys.swap(sorted);
+  }
+
+  for(size_t i = 0; i < keys.size(); i++)
+  {
+    uint32_t idx = minIdx + uint32_t(keys[i] >> 32);
+
+    if(uniqueIndices.empty() || uniqueIndices.back() != idx)
+      uniqueIndices.push_back(idx);
+
+    indices[keys[i] & 0xffffffff] = uint32_t(uniqueIndices.size() - 1);
+  }
+}
+
 uint64_t CalcMeshOutputSize(uint64_t curSize, uint64_t requiredOutput)
 {
   // resize exponentially up to 256MB to avoid repeated resizes
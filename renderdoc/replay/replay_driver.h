@@ -234,6 +234,13 @@ void SetupDrawcallPointers(std::vector<DrawcallDescription *> &drawcallTable,
 void PatchLineStripIndexBuffer(const DrawcallDescription *draw, uint8_t *idx8, uint16_t *idx16,
                                uint32_t *idx32, std::vector<uint32_t> &patchedIndices);
 
+// An index buffer could be something like: 500, 501, 502, 501, 503, 502 or have gaps like
+// 500, 501, 502, 510, 511, 512. When streaming out post-transform data, only the unique vertices
+// referenced are transformed into a tightly packed buffer. This fills uniqueIndices with the
+// unique values in indices in ascending order, and replaces each index with the position of its
+// value in uniqueIndices, so the example above becomes 0, 1, 2, 3, 4, 5. Runs in linear time.
+void CompactIndexBuffer(std::vector<uint32_t> &indices, std::vector<uint32_t> &uniqueIndices);
+
 uint64_t CalcMeshOutputSize(uint64_t curSize, uint64_t requiredOutput);
 
 // simple cache for when we need buffer data for highlighting
@@ -0,0 +1,178 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "replay_driver.h"
+#include "common/timing.h"
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include <algorithm>
+#include "3rdparty/catch/catch.hpp"
+
+// the straightforward version of CompactIndexBuffer, to check against
+static void SortedCompact(const std::vector<uint32_t> &indices, std::vector<uint32_t> &remapped,
+                          std::vector<uint32_t> &uniqueIndices)
+{
+  uniqueIndices = indices;
+  std::sort(uniqueIndices.begin(), uniqueIndices.end());
+  uniqueIndices.erase(std::unique(uniqueIndices.begin(), uniqueIndices.end()), uniqueIndices.end());
+
+  remapped.resize(indices.size());
+  for(size_t i = 0; i < indices.size(); i++)
+    remapped[i] = uint32_t(std::lower_bound(uniqueIndices.begin(), uniqueIndices.end(), indices[i]) -
+                           uniqueIndices.begin());
+}
+
+// a grid of quads like a terrain patch, each vertex shared by up to six triangles
+static std::vector<uint32_t> GridIndices(uint32_t width, uint32_t baseVertex)
+{
+  std::vector<uint32_t> ret;
+  ret.reserve(width * width * 6);
+
+  for(uint32_t y = 0; y < width; y++)
+  {
+    for(uint32_t x = 0; x < width; x++)
+    {
+      uint32_t v = baseVertex + y * (width + 1) + x;
+      uint32_t quad[] = {v, v + 1, v + width + 1, v + 1, v + width + 2, v + width + 1};
+      ret.insert(ret.end(), quad, quad + 6);
+    }
+  }
+
+  return ret;
+}
+
+// indices scattered over the whole 32-bit range, with each value used several times
+static std::vector<uint32_t> SparseIndices(uint32_t count)
+{
+  std::vector<uint32_t> ret(count);
+
+  uint32_t seed = 0x1234567;
+  for(uint32_t i = 0; i < count; i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    ret[i] = ((seed >> 8) % (count / 4)) * 0x9E3779B1U;
+  }
+
+  return ret;
+}
+
+TEST_CASE("Test compacting index buffers", "[replay][indices]")
+{
+  std::vector<uint32_t> indices, uniqueIndices;
+
+  SECTION("Empty")
+  {
+    CompactIndexBuffer(indices, uniqueIndices);
+
+    CHECK(indices.empty());
+    CHECK(uniqueIndices.empty());
+  };
+
+  SECTION("Gaps are packed")
+  {
+    indices = {500, 501, 502, 510, 511, 512, 502, 510};
+
+    CompactIndexBuffer(indices, uniqueIndices);
+
+    CHECK((uniqueIndices == std::vector<uint32_t>({500, 501, 502, 510, 511, 512})));
+    CHECK((indices == std::vector<uint32_t>({0, 1, 2, 3, 4, 5, 2, 3})));
+  };
+
+  SECTION("Garbage indices")
+  {
+    indices = {0xcccccccc, 3, 0xffffffff, 1, 3, 0xcccccccc, 0};
+
+    CompactIndexBuffer(indices, uniqueIndices);
+
+    CHECK((uniqueIndices == std::vector<uint32_t>({0, 1, 3, 0xcccccccc, 0xffffffff})));
+    CHECK((indices == std::vector<uint32_t>({3, 2, 4, 1, 2, 3, 0})));
+  };
+
+  SECTION("Matches sorting")
+  {
+    std::vector<std::vector<uint32_t>> inputs = {
+        GridIndices(50, 0), GridIndices(50, 100000), SparseIndices(10000),
+    };
+
+    // dense enough for a table, but spread wider than the number of indices
+    std::vector<uint32_t> spread = GridIndices(20, 0);
+    for(uint32_t &idx : spread)
+      idx *= 3;
+    inputs.push_back(spread);
+
+    for(const std::vector<uint32_t> &input : inputs)
+    {
+      std::vector<uint32_t> expectedRemap, expectedUnique;
+      SortedCompact(input, expectedRemap, expectedUnique);
+
+      indices = input;
+      CompactIndexBuffer(indices, uniqueIndices);
+
+      CHECK((uniqueIndices == expectedUnique));
+      CHECK((indices == expectedRemap));
+    }
+  };
+};
+
+// run with "[benchmark][indices]" and optionally --benchmark-out <file> to get the results as JSON.
+TEST_CASE("Benchmark compacting index buffers", "[.][benchmark][replay][indices]")
+{
+  struct
+  {
+    const char *name;
+    std::vector<uint32_t> indices;
+  } inputs[] = {
+      // around 6 million indices each, like a large terrain or foliage draw
+      {"grid", GridIndices(1000, 0)},
+      {"grid rebased", GridIndices(1000, 5000000)},
+      {"sparse", SparseIndices(6000000)},
+  };
+
+  for(auto &input : inputs)
+  {
+    std::vector<uint32_t> indices = input.indices, uniqueIndices;
+
+    PerformanceTimer timer;
+    CompactIndexBuffer(indices, uniqueIndices);
+    double ms = timer.GetMilliseconds();
+
+    RecordBenchmark(StringFormat::Fmt("compact %s", input.name).c_str(),
+                    double(input.indices.size()) / (ms * 1000.0), "Mindices/s");
+
+    std::vector<uint32_t> expectedRemap, expectedUnique;
+
+    timer.Restart();
+    SortedCompact(input.indices, expectedRemap, expectedUnique);
+    ms = timer.GetMilliseconds();
+
+    RecordBenchmark(StringFormat::Fmt("sort and search %s", input.name).c_str(),
+                    double(input.indices.size()) / (ms * 1000.0), "Mindices/s");
+
+    CHECK((uniqueIndices == expectedUnique));
+    CHECK((indices == expectedRemap));
+  }
+};
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -26,14 +26,9 @@
 #include "common/common.h"
 #include "serialise/rdcfile.h"
 
-ReplayStatus exportChrome(const char *filename, const RDCFile &rdc, const SDFile &structData,
-                          RENDERDOC_ProgressCallback progress)
+// also used by the call profiler, which sends its trace over target control instead of to a file
+std::string ChromeTraceJSON(const SDFile &structData, RENDERDOC_ProgressCallback progress)
 {
-  FILE *f = FileIO::fopen(filename, "w");
-
-  if(!f)
-    return ReplayStatus::FileIOFailed;
-
   std::string str;
 
   // add header, customise this as needed.
@@ -85,6 +80,19 @@ ReplayStatus exportChrome(const char *filename, const RDCFile &rdc, const SDFile
   // end trace events
   str += "\n  ]\n}";
 
+  return str;
+}
+
+ReplayStatus exportChrome(const char *filename, const RDCFile &rdc, const SDFile &structData,
+                          RENDERDOC_ProgressCallback progress)
+{
+  FILE *f = FileIO::fopen(filename, "w");
+
+  if(!f)
+    return ReplayStatus::FileIOFailed;
+
+  std::string str = ChromeTraceJSON(structData, progress);
+
   FileIO::fwrite(str.data(), 1, str.size(), f);
 
   FileIO::fclose(f);
@@ -715,8 +715,7 @@ static ReplayStatus XML2Structured(const char *xml, const bytebuf &thumbBytes,
 }
 
 static ReplayStatus Buffers2ZIP(const std::string &filename, const RDCFile &file,
-                                const StructuredBufferList &buffers,
-                                RENDERDOC_ProgressCallback progress)
+                                const SDFile &structData, RENDERDOC_ProgressCallback progress)
 {
   std::string zipFile = filename;
   zipFile.erase(zipFile.size() - 4);    // remove the .xml, leave only the .zip
@@ -732,12 +731,13 @@ static ReplayStatus Buffers2ZIP(const std::string &filename, const RDCFile &file
     return ReplayStatus::FileIOFailed;
   }
 
-  for(size_t i = 0; i < buffers.size(); i++)
+  for(size_t i = 0; i < structData.buffers.size(); i++)
   {
-    mz_zip_writer_add_mem(&zip, GetBufferName(i).c_str(), buffers[i]->data(), buffers[i]->size(), 2);
+    const bytebuf &buf = structData.GetBuffer(i);
+    mz_zip_writer_add_mem(&zip, GetBufferName(i).c_str(), buf.data(), buf.size(), 2);
 
     if(progress)
-      progress(BufferProgress(float(i) / float(buffers.size())));
+      progress(BufferProgress(float(i) / float(structData.buffers.size())));
   }
 
   const RDCThumb &th = file.GetThumbnail();
@@ -834,7 +834,7 @@ ReplayStatus importXMLZ(const char *filename, StreamReader &reader, RDCFile *rdc
 ReplayStatus exportXMLZ(const char *filename, const RDCFile &rdc, const SDFile &structData,
                         RENDERDOC_ProgressCallback progress)
 {
-  ReplayStatus ret = Buffers2ZIP(filename, rdc, structData.buffers, progress);
+  ReplayStatus ret = Buffers2ZIP(filename, rdc, structData, progress);
 
   if(ret != ReplayStatus::Succeeded)
     return ret;
@@ -22,7 +22,11 @@
  * THE SOFTWARE.
  ******************************************************************************/
 
+#include "api/replay/renderdoc_replay.h"
+#include "common/timing.h"
 #include "lz4io.h"
+#include "parallelio.h"
+#include "rdcfile.h"
 #include "serialiser.h"
 #include "zstdio.h"
 
@@ -190,4 +194,440 @@ TEST_CASE("Test ZSTD compression/decompression", "[streamio][zstd]")
   delete[] randomData;
 };
 
+TEST_CASE("Test parallel compression/decompression", "[streamio][lz4][zstd]")
+{
+  // use an odd size so that the last job and the last block are both partial
+  const uint64_t dataSize = 5 * 1024 * 1024 + 1234;
+
+  byte *inputData = new byte[(size_t)dataSize];
+
+  // mix of incompressible and highly compressible runs
+  for(uint64_t i = 0; i < dataSize; i++)
+    inputData[i] = ((i / 4096) % 3) == 0 ? byte(rand() & 0xff) : byte(i / 8192);
+
+  byte *readData = new byte[(size_t)dataSize];
+
+  for(BlockCodec codec : {BlockCodec::LZ4, BlockCodec::Zstd})
+  {
+    for(uint32_t numThreads : {1U, 3U, 8U})
+    {
+      StreamWriter buf(StreamWriter::DefaultScratchSize);
+
+      std::vector<uint64_t> blockOffsets;
+
+      {
+        ParallelCompressor *comp =
+            new ParallelCompressor(&buf, Ownership::Nothing, codec, numThreads);
+        StreamWriter writer(comp, Ownership::Stream);
+
+        // write in irregular sizes to exercise blocks and jobs being split across writes
+        uint64_t offs = 0;
+        uint64_t writeSize = 1;
+        while(offs < dataSize)
+        {
+          uint64_t size = RDCMIN(writeSize, dataSize - offs);
+          writer.Write(inputData + offs, size);
+          offs += size;
+          writeSize = (writeSize * 7 + 13) % (700 * 1024);
+        }
+
+        CHECK(writer.GetOffset() == dataSize);
+
+        writer.Finish();
+
+        CHECK_FALSE(writer.IsErrored());
+
+        blockOffsets = comp->GetBlockOffsets();
+
+        CHECK(blockOffsets.size() ==
+              size_t((dataSize + comp->GetBlockSize() - 1) / comp->GetBlockSize()));
+      }
+
+      CHECK(buf.GetOffset() < dataSize);
+
+      // every block should start with its own compressed size, leading to the next block
+      for(size_t i = 0; i + 1 < blockOffsets.size(); i++)
+      {
+        uint32_t compSize = 0;
+        memcpy(&compSize, buf.GetData() + blockOffsets[i], sizeof(compSize));
+        CHECK(blockOffsets[i] + sizeof(compSize) + compSize == blockOffsets[i + 1]);
+      }
+
+      // the output must be readable by the regular stream decompressors
+      StreamReader *compReader = new StreamReader(buf.GetData(), buf.GetOffset());
+
+      Decompressor *decomp = NULL;
+      if(codec == BlockCodec::LZ4)
+        decomp = new LZ4Decompressor(compReader, Ownership::Stream);
+      else
+        decomp = new ZSTDDecompressor(compReader, Ownership::Stream);
+
+      StreamReader reader(decomp, dataSize, Ownership::Stream);
+
+      memset(readData, 0, (size_t)dataSize);
+      reader.Read(readData, dataSize);
+      CHECK_FALSE(memcmp(readData, inputData, (size_t)dataSize));
+
+      CHECK_FALSE(reader.IsErrored());
+      CHECK(reader.AtEnd());
+    }
+  }
+
+  delete[] readData;
+  delete[] inputData;
+};
+
+TEST_CASE("Test seeking in block compressed streams", "[streamio][lz4][zstd]")
+{
+  const uint64_t dataSize = 3 * 1024 * 1024 + 567;
+
+  byte *inputData = new byte[(size_t)dataSize];
+
+  for(uint64_t i = 0; i < dataSize; i++)
+    inputData[i] = ((i / 4096) % 3) == 0 ? byte(rand() & 0xff) : byte(i / 8192);
+
+  for(BlockCodec codec : {BlockCodec::LZ4, BlockCodec::Zstd})
+  {
+    StreamWriter buf(StreamWriter::DefaultScratchSize);
+
+    uint64_t blockSize = 0;
+    std::vector<uint64_t> blockOffsets;
+
+    {
+      ParallelCompressor *comp = new ParallelCompressor(&buf, Ownership::Nothing, codec, 2);
+      StreamWriter writer(comp, Ownership::Stream);
+
+      writer.Write(inputData, dataSize);
+      writer.Finish();
+
+      blockSize = comp->GetBlockSize();
+      blockOffsets = comp->GetBlockOffsets();
+    }
+
+    auto makeReader = [&](bool indexed) {
+      StreamReader *compReader = new StreamReader(buf.GetData(), buf.GetOffset());
+
+      Decompressor *decomp = NULL;
+      if(codec == BlockCodec::LZ4)
+        decomp = new LZ4Decompressor(compReader, Ownership::Stream);
+      else
+        decomp = new ZSTDDecompressor(compReader, Ownership::Stream);
+
+      if(indexed)
+        decomp->SetBlockIndex(blockSize, blockOffsets);
+
+      return new StreamReader(decomp, dataSize, Ownership::Stream);
+    };
+
+    byte readData[1000];
+
+    // seeking with a block index
+    {
+      StreamReader *reader = makeReader(true);
+
+      // backwards and forwards, across blocks, within the current window, on block boundaries and
+      // right up to the end
+      std::vector<uint64_t> offsets = {dataSize - 1000,    blockSize * 3,  10,
+                                       blockSize * 3 - 4,  blockSize * 3 + 50,
+                                       blockSize * 20 + 1, blockSize * 2 + 17,
+                                       dataSize / 2,       0};
+
+      for(uint64_t offs : offsets)
+      {
+        CHECK(reader->SetOffset(offs));
+        CHECK(reader->GetOffset() == offs);
+
+        reader->Read(readData, sizeof(readData));
+        CHECK_FALSE(memcmp(readData, inputData + offs, sizeof(readData)));
+      }
+
+      CHECK_FALSE(reader->IsErrored());
+
+      delete reader;
+    }
+
+    // seeking without a block index
+    {
+      StreamReader *reader = makeReader(false);
+
+      // forward seeks still work by decompressing up to the offset
+      CHECK(reader->SetOffset(blockSize * 5 + 3));
+      reader->Read(readData, sizeof(readData));
+      CHECK_FALSE(memcmp(readData, inputData + blockSize * 5 + 3, sizeof(readData)));
+
+      // but going back past what's buffered is impossible
+      CHECK_FALSE(reader->SetOffset(10));
+
+      CHECK_FALSE(reader->IsErrored());
+
+      delete reader;
+    }
+  }
+
+  delete[] inputData;
+};
+
+TEST_CASE("Test capture file chunk index", "[streamio][rdcfile]")
+{
+  std::string filename = FileIO::GetTempFolderFilename() + "/renderdoc_chunkindex_test.rdc";
+
+  const uint32_t numChunks = 5000;
+
+  std::vector<uint64_t> chunkOffsets;
+
+  // write enough chunks with varying sizes to span many compressed blocks, some directly and some
+  // pre-recorded the way resource records are.
+  {
+    RDCFile rdc;
+    rdc.SetData(RDCDriver::Vulkan, "Vulkan", 0, NULL);
+    rdc.Create(filename.c_str());
+
+    REQUIRE((rdc.ErrorCode() == ContainerError::NoError));
+
+    SectionProperties props;
+    props.flags = SectionFlags::LZ4Compressed;
+    props.type = SectionType::FrameCapture;
+
+    WriteSerialiser scratch(new StreamWriter(1024), Ownership::Stream);
+
+    {
+      WriteSerialiser ser(rdc.WriteSection(props), Ownership::Stream);
+
+      ser.SetChunkOffsetRecording(&chunkOffsets);
+
+      for(uint32_t i = 0; i < numChunks; i++)
+      {
+        std::vector<uint32_t> payload(i % 700, i);
+
+        if(i % 3 == 0)
+        {
+          Chunk *chunk = NULL;
+
+          {
+            WriteSerialiser &ser = scratch;
+            SCOPED_SERIALISE_CHUNK(1 + (i % 100));
+            SERIALISE_ELEMENT(i);
+            SERIALISE_ELEMENT(payload);
+            chunk = scope.Get();
+          }
+
+          chunk->Write(ser);
+          delete chunk;
+        }
+        else
+        {
+          // chunk lengths can't be patched in a compressed stream, so give an upper bound
+          SCOPED_SERIALISE_CHUNK(1 + (i % 100), uint32_t(64 + payload.size() * sizeof(uint32_t)));
+          SERIALISE_ELEMENT(i);
+          SERIALISE_ELEMENT(payload);
+        }
+      }
+    }
+
+    REQUIRE(chunkOffsets.size() == numChunks);
+
+    rdc.WriteChunkIndex(chunkOffsets);
+
+    CHECK(rdc.GetChunkIndex().chunkOffsets == chunkOffsets);
+  }
+
+  {
+    RDCFile rdc;
+    rdc.Open(filename.c_str());
+
+    REQUIRE((rdc.ErrorCode() == ContainerError::NoError));
+
+    const RDCChunkIndex &chunkIndex = rdc.GetChunkIndex();
+
+    CHECK(chunkIndex.chunkOffsets == chunkOffsets);
+    CHECK(chunkIndex.blockSize > 0);
+    CHECK(chunkIndex.blockOffsets.size() > 10);
+
+    StreamReader *reader = rdc.ReadSection(rdc.SectionIndex(SectionType::FrameCapture));
+
+    // read chunks in a scattered order, to seek back and forth in the compressed data
+    for(uint32_t c = 0; c < 200; c++)
+    {
+      uint32_t chunk = (c * 2741) % numChunks;
+
+      REQUIRE(reader->SetOffset(chunkIndex.chunkOffsets[chunk]));
+
+      ReadSerialiser ser(reader, Ownership::Nothing);
+
+      uint32_t chunkID = ser.ReadChunk<uint32_t>();
+
+      CHECK(chunkID == 1 + (chunk % 100));
+
+      uint32_t i = 0;
+      std::vector<uint32_t> payload;
+      SERIALISE_ELEMENT(i);
+      SERIALISE_ELEMENT(payload);
+
+      ser.EndChunk();
+
+      CHECK(i == chunk);
+      CHECK(payload == std::vector<uint32_t>(chunk % 700, chunk));
+    }
+
+    CHECK_FALSE(reader->IsErrored());
+
+    // the range of each chunk runs up to the next one, and the last to the end of the section
+    uint64_t offset = 0, length = 0;
+
+    REQUIRE(rdc.GetChunkRange(5, offset, length));
+    CHECK(offset == chunkOffsets[5]);
+    CHECK(length == chunkOffsets[6] - chunkOffsets[5]);
+
+    REQUIRE(rdc.GetChunkRange(numChunks - 1, offset, length));
+    CHECK(offset + length == reader->GetSize());
+
+    CHECK_FALSE(rdc.GetChunkRange(numChunks, offset, length));
+
+    // appending a section unmaps the file, but the open reader keeps its mapping alive
+    {
+      SectionProperties props;
+      props.type = SectionType::Notes;
+      props.version = 1;
+
+      StreamWriter *w = rdc.WriteSection(props);
+      w->Write("notes", 5);
+      delete w;
+
+      REQUIRE((rdc.ErrorCode() == ContainerError::NoError));
+    }
+
+    uint32_t chunk = numChunks - 1;
+
+    REQUIRE(reader->SetOffset(chunkOffsets[chunk]));
+
+    {
+      ReadSerialiser ser(reader, Ownership::Nothing);
+
+      CHECK(ser.ReadChunk<uint32_t>() == 1 + (chunk % 100));
+
+      uint32_t i = 0;
+      SERIALISE_ELEMENT(i);
+
+      ser.SkipCurrentChunk();
+
+      CHECK(i == chunk);
+    }
+
+    CHECK_FALSE(reader->IsErrored());
+
+    delete reader;
+  }
+
+  // single chunks can be fetched through the capture file interface
+  {
+    ICaptureFile *file = RENDERDOC_OpenCaptureFile();
+
+    REQUIRE((file->OpenFile(filename.c_str(), "rdc", RENDERDOC_ProgressCallback()) ==
+             ReplayStatus::Succeeded));
+
+    for(uint32_t chunk : {0U, 1U, 2U, numChunks / 2, numChunks - 1})
+    {
+      bytebuf contents = file->GetChunkContents(chunk);
+
+      REQUIRE_FALSE(contents.empty());
+
+      ReadSerialiser ser(new StreamReader(contents.data(), contents.size()), Ownership::Stream);
+
+      CHECK(ser.ReadChunk<uint32_t>() == 1 + (chunk % 100));
+
+      uint32_t i = 0;
+      std::vector<uint32_t> payload;
+      SERIALISE_ELEMENT(i);
+      SERIALISE_ELEMENT(payload);
+
+      ser.EndChunk();
+
+      CHECK(i == chunk);
+      CHECK(payload == std::vector<uint32_t>(chunk % 700, chunk));
+      CHECK_FALSE(ser.IsErrored());
+    }
+
+    CHECK(file->GetChunkContents(numChunks).empty());
+
+    file->Shutdown();
+  }
+
+  FileIO::Delete(filename.c_str());
+};
+
+TEST_CASE("Benchmark parallel compression throughput", "[.][benchmark][streamio][lz4][zstd]")
+{
+  // roughly capture-like data: long compressible runs with some noise mixed in
+  const uint64_t dataSize = 128 * 1024 * 1024;
+
+  byte *inputData = new byte[(size_t)dataSize];
+
+  for(uint64_t i = 0; i < dataSize; i++)
+    inputData[i] = ((i / 1024) % 4) == 0 ? byte(rand() & 0xff) : byte((i * 13) / 4096);
+
+  const uint32_t numThreads = RDCMIN(Threading::NumberOfCores(), 8U);
+
+  RecordBenchmark("parallel threads", double(numThreads), "threads");
+
+  for(BlockCodec codec : {BlockCodec::LZ4, BlockCodec::Zstd})
+  {
+    const char *name = codec == BlockCodec::LZ4 ? "LZ4" : "Zstd";
+
+    double serialTime = 0.0, parallelTime = 0.0;
+    uint64_t serialSize = 0, parallelSize = 0;
+
+    {
+      StreamWriter buf(StreamWriter::DefaultScratchSize);
+
+      PerformanceTimer timer;
+
+      {
+        Compressor *comp = NULL;
+        if(codec == BlockCodec::LZ4)
+          comp = new LZ4Compressor(&buf, Ownership::Nothing);
+        else
+          comp = new ZSTDCompressor(&buf, Ownership::Nothing);
+
+        StreamWriter writer(comp, Ownership::Stream);
+        writer.Write(inputData, dataSize);
+        writer.Finish();
+      }
+
+      serialTime = timer.GetMilliseconds();
+      serialSize = buf.GetOffset();
+    }
+
+    {
+      StreamWriter buf(StreamWriter::DefaultScratchSize);
+
+      PerformanceTimer timer;
+
+      {
+        StreamWriter writer(new ParallelCompressor(&buf, Ownership::Nothing, codec, numThreads),
+                            Ownership::Stream);
+        writer.Write(inputData, dataSize);
+        writer.Finish();
+      }
+
+      parallelTime = timer.GetMilliseconds();
+      parallelSize = buf.GetOffset();
+    }
+
+    const double MB = double(dataSize) / (1024.0 * 1024.0);
+
+    RecordBenchmark(StringFormat::Fmt("%s serial", name).c_str(), MB / (serialTime / 1000.0),
+                    "MB/s");
+    RecordBenchmark(StringFormat::Fmt("%s serial ratio", name).c_str(),
+                    double(dataSize) / double(serialSize), "x");
+    RecordBenchmark(StringFormat::Fmt("%s parallel", name).c_str(),
+                    MB / (parallelTime / 1000.0), "MB/s");
+    RecordBenchmark(StringFormat::Fmt("%s parallel ratio", name).c_str(),
+                    double(dataSize) / double(parallelSize), "x");
+    RecordBenchmark(StringFormat::Fmt("%s parallel speedup", name).c_str(),
+                    serialTime / parallelTime, "x");
+  }
+
+  delete[] inputData;
+};
+
 #endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -24,8 +24,6 @@
 
 #include "lz4io.h"
 
-static const uint64_t lz4BlockSize = 64 * 1024;
-
 LZ4Compressor::LZ4Compressor(StreamWriter *write, Ownership own) : Compressor(write, own)
 {
   m_Page[0] = AllocAlignedBuffer(lz4BlockSize);
@@ -246,6 +244,14 @@ bool LZ4Decompressor::Read(void *data, uint64_t numBytes)
   return success;
 }
 
+void LZ4Decompressor::Reset()
+{
+  m_PageOffset = 0;
+  m_PageLength = 0;
+
+  LZ4_setStreamDecode(&m_LZ4Decomp, NULL, 0);
+}
+
 bool LZ4Decompressor::FillPage0()
 {
   // swap pages
@@ -27,6 +27,10 @@
 #include "lz4/lz4.h"
 #include "streamio.h"
 
+// size of the uncompressed pages that are compressed as one LZ4 block. The decompressor relies on
+// no block decompressing to more than this
+static const uint64_t lz4BlockSize = 64 * 1024;
+
 class LZ4Compressor : public Compressor
 {
 public:
@@ -55,6 +59,9 @@ public:
   bool Recompress(Compressor *comp);
   bool Read(void *data, uint64_t numBytes);
 
+protected:
+  void Reset();
+
 private:
   bool FillPage0();
 
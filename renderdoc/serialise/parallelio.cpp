@@ -0,0 +1,244 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017-2018 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "parallelio.h"
+#include "common/worker_pool.h"
+#include "lz4io.h"
+#include "zstdio.h"
+
+// how many blocks are batched into a single job for a worker to compress
+static const uint64_t blocksPerJob = 16;
+
+// compression level for each zstd frame, matches ZSTDCompressor
+static const int zstdLevel = 7;
+
+ParallelCompressor::ParallelCompressor(StreamWriter *write, Ownership own, BlockCodec codec,
+                                       uint32_t parallelism)
+    : Compressor(write, own)
+{
+  m_Codec = codec;
+
+  if(m_Codec == BlockCodec::LZ4)
+  {
+    m_BlockSize = lz4BlockSize;
+    m_BlockBound = LZ4_COMPRESSBOUND(lz4BlockSize);
+  }
+  else
+  {
+    m_BlockSize = zstdBlockSize;
+    m_BlockBound = ZSTD_compressBound(zstdBlockSize);
+  }
+
+  m_JobSize = m_BlockSize * blocksPerJob;
+
+  m_BaseOffset = m_Write->GetOffset();
+
+  parallelism = RDCMAX(parallelism, 1U);
+
+  // keep twice as many jobs as can be compressing at once so that the caller can fill new jobs
+  // while the workers are busy with the previous set.
+  m_Jobs.resize(parallelism * 2);
+  for(Job *&job : m_Jobs)
+  {
+    job = new Job;
+    job->input = AllocAlignedBuffer(m_JobSize);
+    job->output = AllocAlignedBuffer((sizeof(uint32_t) + m_BlockBound) * blocksPerJob);
+
+    if(m_Codec == BlockCodec::LZ4)
+      job->lz4State = AllocAlignedBuffer(LZ4_sizeofState());
+    else
+      job->zstdContext = ZSTD_createCCtx();
+  }
+}
+
+ParallelCompressor::~ParallelCompressor()
+{
+  // jobs that were never retired may still be compressing
+  WorkerPool::Get().Wait(this);
+
+  for(Job *job : m_Jobs)
+  {
+    FreeAlignedBuffer(job->input);
+    FreeAlignedBuffer(job->output);
+    FreeAlignedBuffer(job->lz4State);
+    ZSTD_freeCCtx((ZSTD_CCtx *)job->zstdContext);
+    delete job;
+  }
+}
+
+bool ParallelCompressor::Write(const void *data, uint64_t numBytes)
+{
+  if(m_Errored)
+    return false;
+
+  const byte *src = (const byte *)data;
+
+  while(numBytes > 0)
+  {
+    Job *job = m_Jobs[m_CurrentJob];
+
+    // copy whatever will fit in this job
+    uint64_t partialBytes = RDCMIN(m_JobSize - job->inputSize, numBytes);
+    memcpy(job->input + job->inputSize, src, (size_t)partialBytes);
+
+    job->inputSize += partialBytes;
+    numBytes -= partialBytes;
+    src += partialBytes;
+
+    // once the job is full, kick it off and move to the next one
+    if(job->inputSize == m_JobSize && !SubmitJob())
+      return false;
+  }
+
+  return true;
+}
+
+bool ParallelCompressor::Finish()
+{
+  if(m_Errored)
+    return false;
+
+  // kick off the last partial job, if there is one
+  if(m_Jobs[m_CurrentJob]->inputSize > 0 && !SubmitJob())
+    return false;
+
+  // the current job is never in flight after a submit, so starting from it and wrapping around
+  // visits the outstanding jobs from oldest to newest.
+  for(size_t i = 0; i < m_Jobs.size(); i++)
+  {
+    Job *job = m_Jobs[(m_CurrentJob + i) % m_Jobs.size()];
+
+    if(job->inFlight && !RetireJob(job))
+      return false;
+  }
+
+  return true;
+}
+
+bool ParallelCompressor::SubmitJob()
+{
+  Job *job = m_Jobs[m_CurrentJob];
+
+  job->inFlight = true;
+  job->error = false;
+
+  WorkerPool::Get().Run(
+      [this, job]() {
+        job->error = !CompressJob(job);
+        job->complete.Wake(1);
+      },
+      this);
+
+  m_CurrentJob = (m_CurrentJob + 1) % m_Jobs.size();
+
+  // if the next job in the ring is still being compressed, we have to wait for it - and write it
+  // out - before we can refill it.
+  job = m_Jobs[m_CurrentJob];
+
+  if(job->inFlight)
+    return RetireJob(job);
+
+  return true;
+}
+
+bool ParallelCompressor::RetireJob(Job *job)
+{
+  job->complete.WaitForWake();
+  job->inFlight = false;
+
+  if(job->error)
+  {
+    RDCERR("Error compressing job of %llu bytes", job->inputSize);
+    m_Errored = true;
+    return false;
+  }
+
+  uint64_t offs = m_Write->GetOffset() - m_BaseOffset;
+  for(uint32_t size : job->blockSizes)
+  {
+    m_BlockOffsets.push_back(offs);
+    offs += size;
+  }
+
+  bool success = m_Write->Write(job->output, job->outputSize);
+
+  job->inputSize = 0;
+  job->outputSize = 0;
+  job->blockSizes.clear();
+
+  if(!success)
+    m_Errored = true;
+
+  return success;
+}
+
+bool ParallelCompressor::CompressJob(Job *job)
+{
+  job->outputSize = 0;
+  job->blockSizes.clear();
+
+  for(uint64_t inOffs = 0; inOffs < job->inputSize; inOffs += m_BlockSize)
+  {
+    uint64_t blockSize = RDCMIN(m_BlockSize, job->inputSize - inOffs);
+
+    const byte *src = job->input + inOffs;
+    byte *dst = job->output + job->outputSize + sizeof(uint32_t);
+
+    uint32_t compSize = 0;
+
+    if(m_Codec == BlockCodec::LZ4)
+    {
+      int ret = LZ4_compress_fast_extState(job->lz4State, (const char *)src, (char *)dst,
+                                           (int)blockSize, (int)m_BlockBound, 1);
+
+      if(ret <= 0)
+      {
+        RDCERR("Error compressing: %i", ret);
+        return false;
+      }
+
+      compSize = (uint32_t)ret;
+    }
+    else
+    {
+      size_t ret = ZSTD_compressCCtx((ZSTD_CCtx *)job->zstdContext, dst, (size_t)m_BlockBound, src,
+                                     (size_t)blockSize, zstdLevel);
+
+      if(ZSTD_isError(ret))
+      {
+        RDCERR("Error compressing: %s", ZSTD_getErrorName(ret));
+        return false;
+      }
+
+      compSize = (uint32_t)ret;
+    }
+
+    memcpy(job->output + job->outputSize, &compSize, sizeof(uint32_t));
+
+    job->outputSize += sizeof(uint32_t) + compSize;
+    job->blockSizes.push_back(uint32_t(sizeof(uint32_t) + compSize));
+  }
+
+  return true;
+}
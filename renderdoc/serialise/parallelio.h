@@ -0,0 +1,100 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017-2018 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include "common/threading.h"
+#include "streamio.h"
+
+enum class BlockCodec
+{
+  LZ4,
+  Zstd,
+};
+
+// A compressor that splits the incoming stream into fixed-size pages and compresses each one
+// independently on the shared WorkerPool. Pages are batched into jobs to amortise the
+// synchronisation, and completed jobs are written to the underlying stream strictly in submission
+// order on the thread calling Write()/Finish(). parallelism is how many jobs can be compressing at
+// once, and is usually the number of workers in the pool.
+//
+// Since no page references any data from previous pages, the output is laid out exactly as
+// LZ4Compressor/ZSTDCompressor lay theirs out - a 32-bit compressed size followed by the compressed
+// data - so it can be read back with the normal LZ4Decompressor/ZSTDDecompressor.
+class ParallelCompressor : public Compressor
+{
+public:
+  ParallelCompressor(StreamWriter *write, Ownership own, BlockCodec codec, uint32_t parallelism);
+  ~ParallelCompressor();
+
+  bool Write(const void *data, uint64_t numBytes);
+  bool Finish();
+
+  // the uncompressed size of each block. Every block except the last is exactly this size
+  uint64_t GetBlockSize() const { return m_BlockSize; }
+  // the offset of each block's header in the compressed stream, relative to where the underlying
+  // writer was when this compressor was created. Only complete once Finish() has been called.
+  const std::vector<uint64_t> &GetBlockOffsets() const { return m_BlockOffsets; }
+private:
+  struct Job
+  {
+    byte *input = NULL;
+    uint64_t inputSize = 0;
+
+    byte *output = NULL;
+    uint64_t outputSize = 0;
+
+    // compressed size of each block in output, including its size header
+    std::vector<uint32_t> blockSizes;
+
+    // each job has its own compression state, since it's only ever compressed by one worker at a
+    // time
+    byte *lz4State = NULL;
+    void *zstdContext = NULL;
+
+    bool inFlight = false;
+    bool error = false;
+
+    Threading::Semaphore complete;
+  };
+
+  bool SubmitJob();
+  bool RetireJob(Job *job);
+
+  bool CompressJob(Job *job);
+
+  BlockCodec m_Codec;
+  uint64_t m_BlockSize;
+  uint64_t m_BlockBound;
+  uint64_t m_JobSize;
+
+  // ring of jobs, filled in order and retired in the same order
+  std::vector<Job *> m_Jobs;
+  size_t m_CurrentJob = 0;
+
+  uint64_t m_BaseOffset;
+  std::vector<uint64_t> m_BlockOffsets;
+
+  bool m_Errored = false;
+};
@@ -28,7 +28,9 @@
 #include "3rdparty/stb/stb_image.h"
 #include "api/replay/version.h"
 #include "common/dds_readwrite.h"
+#include "common/worker_pool.h"
 #include "lz4io.h"
+#include "parallelio.h"
 #include "zstdio.h"
 
 // not provided by tinyexr, just do by hand
@@ -127,6 +129,22 @@ bool is_exr_file(FILE *f)
  // binary form, other sections can follow in any order
  Section sections[];
 
+ The optional chunk index section (SectionType::ChunkIndex) is stored uncompressed:
+
+ ChunkIndex
+ {
+   uint64_t frameCompressedLength;   // the lengths and flags of the frame capture section when the
+   uint64_t frameUncompressedLength; // index was written. If they don't match the frame capture
+   uint32_t frameFlags;              // in the file, the index is stale and is ignored.
+   uint32_t zero;
+
+   uint64_t blockSize; // uncompressed size of each independently compressed block, 0 if none
+   uint64_t numBlocks;
+   uint64_t blockOffsets[numBlocks]; // offset of each block within the frame capture's data
+   uint64_t numChunks;
+   uint64_t chunkOffsets[numChunks]; // uncompressed offset of each chunk within the frame capture
+ }
+
 */
 
 static const uint32_t MAGIC_HEADER = MAKE_FOURCC('R', 'D', 'O', 'C');
@@ -204,6 +222,17 @@ struct BinarySectionHeader
   // char name[sectionNameLength];
   // byte data[sectionLength];
 };
+
+struct ChunkIndexHeader
+{
+  uint64_t frameCompressedLength;
+  uint64_t frameUncompressedLength;
+  SectionFlags frameFlags;
+  uint32_t zero;
+  uint64_t blockSize;
+};
+
+static const uint64_t ChunkIndexVersion = 1;
 };
 
 #define SETERROR(error, ...)                        \
@@ -221,11 +250,66 @@ struct BinarySectionHeader
 
 RDCFile::~RDCFile()
 {
+  if(m_Thumb.pixels && !IsMapped(m_Thumb.pixels))
+    delete[] m_Thumb.pixels;
+
+  m_Thumb.pixels = NULL;
+
+  UnmapFile();
+
   if(m_File)
     FileIO::fclose(m_File);
+}
 
-  if(m_Thumb.pixels)
-    delete[] m_Thumb.pixels;
+void RDCFile::MapFile()
+{
+#if ENABLED(RDOC_X64)
+  if(m_File == NULL || m_MappedData)
+    return;
+
+  uint64_t prevPos = FileIO::ftell64(m_File);
+  FileIO::fseek64(m_File, 0, SEEK_END);
+  uint64_t fileSize = FileIO::ftell64(m_File);
+  FileIO::fseek64(m_File, prevPos, SEEK_SET);
+
+  m_MappedData = FileIO::mmapfile(m_File, fileSize);
+  if(m_MappedData)
+  {
+    m_MappedSize = fileSize;
+    m_Mapping = new Mapping({m_MappedData, m_MappedSize, 1});
+  }
+#endif
+}
+
+void RDCFile::ReleaseMapping(Mapping *mapping)
+{
+  if(Atomic::Dec32(&mapping->refcount) == 0)
+  {
+    FileIO::munmapfile(mapping->data, mapping->size);
+    delete mapping;
+  }
+}
+
+void RDCFile::UnmapFile()
+{
+  if(m_MappedData == NULL)
+    return;
+
+  // the thumbnail may be pointing into the mapping, take a copy before it goes away
+  if(IsMapped(m_Thumb.pixels))
+  {
+    byte *pixels = new byte[m_Thumb.len];
+    memcpy(pixels, m_Thumb.pixels, m_Thumb.len);
+    m_Thumb.pixels = pixels;
+  }
+
+  // readers from ReadSection may still be using the mapping, in which case the last of them will
+  // unmap it when it's closed.
+  ReleaseMapping(m_Mapping);
+
+  m_Mapping = NULL;
+  m_MappedData = NULL;
+  m_MappedSize = 0;
 }
 
 void RDCFile::Open(const char *path)
@@ -276,6 +360,16 @@ void RDCFile::Open(const char *path)
     }
   }
 
+  MapFile();
+
+  if(m_MappedData)
+  {
+    StreamReader reader(StreamReader::ExternalMemory, m_MappedData, m_MappedSize);
+
+    Init(reader);
+    return;
+  }
+
   FileIO::fseek64(m_File, 0, SEEK_END);
   uint64_t fileSize = FileIO::ftell64(m_File);
   FileIO::fseek64(m_File, 0, SEEK_SET);
@@ -345,8 +439,21 @@ void RDCFile::Init(StreamReader &reader)
     RETURNERROR(ContainerError::Corrupt, "Thumbnail byte length invalid: %u", thumb.length);
   }
 
-  byte *thumbData = new byte[thumb.length];
-  reader.Read(thumbData, thumb.length);
+  // when reading from the mapped file the thumbnail is used in place, otherwise we read a copy
+  byte *thumbData = NULL;
+  const byte *thumbPixels = NULL;
+
+  if(m_MappedData)
+  {
+    thumbPixels = m_MappedData + reader.GetOffset();
+    reader.SkipBytes(thumb.length);
+  }
+  else
+  {
+    thumbData = new byte[thumb.length];
+    thumbPixels = thumbData;
+    reader.Read(thumbData, thumb.length);
+  }
 
   if(reader.IsErrored())
   {
@@ -392,7 +499,7 @@ void RDCFile::Init(StreamReader &reader)
 
   if(m_Thumb.len > 0 && m_Thumb.width > 0 && m_Thumb.height > 0)
   {
-    m_Thumb.pixels = thumbData;
+    m_Thumb.pixels = thumbPixels;
     thumbData = NULL;
   }
 
@@ -581,8 +688,34 @@ void RDCFile::Init(StreamReader &reader)
     RETURNERROR(ContainerError::Corrupt, "Capture file doesn't have a frame capture");
   }
 
+  LoadChunkIndex();
+
   int index = SectionIndex(SectionType::ExtendedThumbnail);
-  if(index >= 0)
+  if(index >= 0 && m_MappedData &&
+     !(m_Sections[index].flags & (SectionFlags::LZ4Compressed | SectionFlags::ZstdCompressed)))
+  {
+    // uncompressed, so we can point straight at the pixels in the mapped file
+    const SectionLocation &loc = m_SectionLocations[index];
+    ExtThumbnailHeader thumbHeader;
+
+    if(loc.diskLength >= sizeof(thumbHeader))
+    {
+      memcpy(&thumbHeader, m_MappedData + loc.dataOffset, sizeof(thumbHeader));
+
+      if(thumbHeader.len <= loc.diskLength - sizeof(thumbHeader) &&
+         thumbHeader.format < (uint32_t)FileType::Count)
+      {
+        m_Thumb.width = thumbHeader.width;
+        m_Thumb.height = thumbHeader.height;
+        m_Thumb.len = thumbHeader.len;
+        m_Thumb.format = (FileType)thumbHeader.format;
+        if(!IsMapped(m_Thumb.pixels))
+          delete[] m_Thumb.pixels;
+        m_Thumb.pixels = m_MappedData + loc.dataOffset + sizeof(thumbHeader);
+      }
+    }
+  }
+  else if(index >= 0)
   {
     StreamReader *thumbReader = ReadSection(index);
     if(thumbReader)
@@ -598,7 +731,8 @@ void RDCFile::Init(StreamReader &reader)
           m_Thumb.height = thumbHeader.height;
           m_Thumb.len = thumbHeader.len;
           m_Thumb.format = (FileType)thumbHeader.format;
-          delete[] m_Thumb.pixels;
+          if(!IsMapped(m_Thumb.pixels))
+            delete[] m_Thumb.pixels;
           m_Thumb.pixels = thumbData;
         }
         else
@@ -612,11 +746,133 @@ void RDCFile::Init(StreamReader &reader)
   }
 }
 
+void RDCFile::LoadChunkIndex()
+{
+  m_ChunkIndex = RDCChunkIndex();
+
+  int index = SectionIndex(SectionType::ChunkIndex);
+  int frameIndex = SectionIndex(SectionType::FrameCapture);
+
+  if(index < 0 || frameIndex < 0 || m_Sections[index].version != ChunkIndexVersion)
+    return;
+
+  const SectionProperties &frameProps = m_Sections[frameIndex];
+
+  StreamReader *reader = ReadSection(index);
+
+  ChunkIndexHeader header = {};
+  reader->Read(header);
+
+  // if the frame capture has been rewritten since the index was written, the offsets are useless
+  if(header.frameCompressedLength != frameProps.compressedSize ||
+     header.frameUncompressedLength != frameProps.uncompressedSize ||
+     header.frameFlags != frameProps.flags)
+  {
+    RDCWARN("Ignoring stale chunk index");
+    delete reader;
+    return;
+  }
+
+  RDCChunkIndex chunkIndex;
+  chunkIndex.blockSize = header.blockSize;
+
+  for(std::vector<uint64_t> *offsets : {&chunkIndex.blockOffsets, &chunkIndex.chunkOffsets})
+  {
+    uint64_t count = 0;
+    reader->Read(count);
+
+    if(reader->IsErrored() || count > (reader->GetSize() - reader->GetOffset()) / sizeof(uint64_t))
+    {
+      RDCERR("Corrupt chunk index, ignoring");
+      delete reader;
+      return;
+    }
+
+    offsets->resize((size_t)count);
+    reader->Read(offsets->data(), count * sizeof(uint64_t));
+  }
+
+  if(!reader->IsErrored())
+    m_ChunkIndex = chunkIndex;
+
+  delete reader;
+}
+
+bool RDCFile::GetChunkRange(uint32_t chunkIndex, uint64_t &offset, uint64_t &length) const
+{
+  const std::vector<uint64_t> &chunkOffsets = m_ChunkIndex.chunkOffsets;
+
+  int frameIndex = SectionIndex(SectionType::FrameCapture);
+
+  if(frameIndex < 0 || chunkIndex >= chunkOffsets.size())
+    return false;
+
+  // each chunk ends where the next begins, and the last at the end of the section
+  uint64_t end = chunkIndex + 1 < chunkOffsets.size() ? chunkOffsets[chunkIndex + 1]
+                                                      : m_Sections[frameIndex].uncompressedSize;
+
+  offset = chunkOffsets[chunkIndex];
+
+  if(offset >= end)
+    return false;
+
+  length = end - offset;
+  return true;
+}
+
+void RDCFile::WriteChunkIndex(const std::vector<uint64_t> &chunkOffsets)
+{
+  int frameIndex = SectionIndex(SectionType::FrameCapture);
+
+  if(frameIndex < 0 || m_Error != ContainerError::NoError)
+    return;
+
+  const SectionProperties &frameProps = m_Sections[frameIndex];
+
+  // without a block table a compressed frame capture can't be seeked, so the index is pointless.
+  // In-memory sections are stored uncompressed regardless of their flags.
+  const SectionFlags compressionFlags = SectionFlags::LZ4Compressed | SectionFlags::ZstdCompressed;
+  bool compressed = m_File && (frameProps.flags & compressionFlags);
+
+  if(compressed && m_ChunkIndex.blockSize == 0)
+    return;
+
+  ChunkIndexHeader header = {};
+  header.frameCompressedLength = frameProps.compressedSize;
+  header.frameUncompressedLength = frameProps.uncompressedSize;
+  header.frameFlags = frameProps.flags;
+  header.blockSize = m_ChunkIndex.blockSize;
+
+  SectionProperties props = {};
+  props.type = SectionType::ChunkIndex;
+  props.version = ChunkIndexVersion;
+
+  StreamWriter *w = WriteSection(props);
+
+  w->Write(header);
+
+  uint64_t count = m_ChunkIndex.blockOffsets.size();
+  w->Write(count);
+  w->Write(m_ChunkIndex.blockOffsets.data(), count * sizeof(uint64_t));
+
+  count = chunkOffsets.size();
+  w->Write(count);
+  w->Write(chunkOffsets.data(), count * sizeof(uint64_t));
+
+  w->Finish();
+
+  delete w;
+
+  m_ChunkIndex.chunkOffsets = chunkOffsets;
+}
+
 bool RDCFile::CopyFileTo(const char *filename)
 {
   if(!m_File)
     return false;
 
+  UnmapFile();
+
   // remember our position and close the file
   uint64_t prevPos = FileIO::ftell64(m_File);
   FileIO::fclose(m_File);
@@ -632,6 +888,8 @@ bool RDCFile::CopyFileTo(const char *filename)
   m_File = FileIO::fopen(m_Filename.c_str(), "rb");
   FileIO::fseek64(m_File, prevPos, SEEK_SET);
 
+  MapFile();
+
   return success;
 }
 
@@ -788,7 +1046,11 @@ StreamReader *RDCFile::ReadSection(int index) const
   if(m_File == NULL)
   {
     if(index < (int)m_MemorySections.size())
-      return new StreamReader(m_MemorySections[index]);
+    {
+      StreamReader *reader = new StreamReader(m_MemorySections[index]);
+      reader->SetSourceSection(index);
+      return reader;
+    }
 
     RDCERR("Section %d is not available in memory.", index);
     return new StreamReader(StreamReader::InvalidStream);
@@ -796,27 +1058,58 @@ StreamReader *RDCFile::ReadSection(int index) const
 
   const SectionProperties &props = m_Sections[index];
   SectionLocation offsetSize = m_SectionLocations[index];
-  FileIO::fseek64(m_File, offsetSize.dataOffset, SEEK_SET);
 
-  StreamReader *fileReader = new StreamReader(m_File, offsetSize.diskLength, Ownership::Nothing);
+  StreamReader *fileReader = NULL;
 
-  StreamReader *compReader = NULL;
+  if(m_MappedData)
+  {
+    if(offsetSize.dataOffset + offsetSize.diskLength > m_MappedSize)
+    {
+      RDCERR("Section %d extends past the end of the file.", index);
+      return new StreamReader(StreamReader::InvalidStream);
+    }
 
-  if(props.flags & SectionFlags::LZ4Compressed)
+    // read straight out of the mapped file. Uncompressed sections need no copies at all, and
+    // compressed sections only copy into the decompressor.
+    fileReader = new StreamReader(StreamReader::ExternalMemory, m_MappedData + offsetSize.dataOffset,
+                                  offsetSize.diskLength);
+
+    // keep the mapping alive as long as the reader, even if the file is unmapped before then
+    Mapping *mapping = m_Mapping;
+    Atomic::Inc32(&mapping->refcount);
+    fileReader->AddCloseCallback([mapping]() { ReleaseMapping(mapping); });
+  }
+  else
   {
-    // the user will delete the compressed reader, and then it will delete the compressor and the
-    // file reader
-    compReader = new StreamReader(new LZ4Decompressor(fileReader, Ownership::Stream),
-                                  props.uncompressedSize, Ownership::Stream);
+    FileIO::fseek64(m_File, offsetSize.dataOffset, SEEK_SET);
+
+    fileReader = new StreamReader(m_File, offsetSize.diskLength, Ownership::Nothing);
   }
+
+  Decompressor *decompressor = NULL;
+
+  // the user will delete the compressed reader, and then it will delete the compressor and the
+  // file reader
+  if(props.flags & SectionFlags::LZ4Compressed)
+    decompressor = new LZ4Decompressor(fileReader, Ownership::Stream);
   else if(props.flags & SectionFlags::ZstdCompressed)
+    decompressor = new ZSTDDecompressor(fileReader, Ownership::Stream);
+
+  StreamReader *compReader = NULL;
+
+  if(decompressor)
   {
-    compReader = new StreamReader(new ZSTDDecompressor(fileReader, Ownership::Stream),
-                                  props.uncompressedSize, Ownership::Stream);
+    // let the frame capture seek to individual blocks if we have an index for them
+    if(props.type == SectionType::FrameCapture && m_ChunkIndex.blockSize > 0)
+      decompressor->SetBlockIndex(m_ChunkIndex.blockSize, m_ChunkIndex.blockOffsets);
+
+    compReader = new StreamReader(decompressor, props.uncompressedSize, Ownership::Stream);
   }
 
   // if we're compressing return that writer, otherwise return the file writer directly
-  return compReader ? compReader : fileReader;
+  StreamReader *reader = compReader ? compReader : fileReader;
+  reader->SetSourceSection(index);
+  return reader;
 }
 
 StreamWriter *RDCFile::WriteSection(const SectionProperties &props)
@@ -843,6 +1136,12 @@ StreamWriter *RDCFile::WriteSection(const SectionProperties &props)
     return w;
   }
 
+  // we're about to modify the file. Readers still open from the mapping keep it alive, which is
+  // fine when appending a section but not when an existing section is moved or overwritten.
+  int32_t liveReaders = m_Mapping ? m_Mapping->refcount - 1 : 0;
+
+  UnmapFile();
+
   // re-open the file as read-write
   {
     uint64_t offs = FileIO::ftell64(m_File);
@@ -899,6 +1198,9 @@ StreamWriter *RDCFile::WriteSection(const SectionProperties &props)
 
   if(SectionIndex(type) >= 0 || SectionIndex(name.c_str()) >= 0)
   {
+    RDCASSERTMSG("Existing section rewritten while section readers are open", liveReaders == 0,
+                 liveReaders);
+
     if(type == SectionType::FrameCapture || name == ToStr(SectionType::FrameCapture))
     {
       // simple case - if there are no other sections then we can just overwrite the existing frame
@@ -1125,17 +1427,49 @@ StreamWriter *RDCFile::WriteSection(const SectionProperties &props)
 
   StreamWriter *compWriter = NULL;
 
+  // the frame capture dominates the file size, so compress it on the worker pool. The blocks are
+  // compatible with the normal decompressors so this doesn't affect how it's read back.
+  uint32_t numThreads = (uint32_t)WorkerPool::Get().NumWorkers();
+  bool parallel = (type == SectionType::FrameCapture);
+  ParallelCompressor *parallelComp = NULL;
+
   if(props.flags & SectionFlags::LZ4Compressed)
   {
     // the user will delete the compressed writer, and then it will delete the compressor and the
     // file writer
-    compWriter =
-        new StreamWriter(new LZ4Compressor(fileWriter, Ownership::Stream), Ownership::Stream);
+    if(parallel)
+      compWriter = new StreamWriter(
+          parallelComp = new ParallelCompressor(fileWriter, Ownership::Stream, BlockCodec::LZ4,
+                                                numThreads),
+          Ownership::Stream);
+    else
+      compWriter =
+          new StreamWriter(new LZ4Compressor(fileWriter, Ownership::Stream), Ownership::Stream);
   }
   else if(props.flags & SectionFlags::ZstdCompressed)
   {
-    compWriter =
-        new StreamWriter(new ZSTDCompressor(fileWriter, Ownership::Stream), Ownership::Stream);
+    if(parallel)
+      compWriter = new StreamWriter(
+          parallelComp = new ParallelCompressor(fileWriter, Ownership::Stream, BlockCodec::Zstd,
+                                                numThreads),
+          Ownership::Stream);
+    else
+      compWriter =
+          new StreamWriter(new ZSTDCompressor(fileWriter, Ownership::Stream), Ownership::Stream);
+  }
+
+  // any chunk index belongs to the previous frame capture
+  if(type == SectionType::FrameCapture)
+    m_ChunkIndex = RDCChunkIndex();
+
+  // the compressor has been finished by the time the writer is closed, so the block table is
+  // complete. Keep it to write out in the chunk index.
+  if(parallelComp)
+  {
+    compWriter->AddCloseCallback([this, parallelComp]() {
+      m_ChunkIndex.blockSize = parallelComp->GetBlockSize();
+      m_ChunkIndex.blockOffsets = parallelComp->GetBlockOffsets();
+    });
   }
 
   uint64_t dataOffset = FileIO::ftell64(m_File);
@@ -1197,6 +1531,8 @@ StreamWriter *RDCFile::WriteSection(const SectionProperties &props)
     // re-open the file and re-seek
     m_File = FileIO::fopen(m_Filename.c_str(), "rb");
     FileIO::fseek64(m_File, prevPos, SEEK_SET);
+
+    MapFile();
   });
 
   // if we're compressing return that writer, otherwise return the file writer directly
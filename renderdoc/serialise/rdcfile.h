@@ -55,6 +55,18 @@ struct ExtThumbnailHeader
   uint32_t format;
 };
 
+struct RDCChunkIndex
+{
+  // the uncompressed size of each independently compressed block in the frame capture, or 0 if the
+  // frame capture can't be seeked by block.
+  uint64_t blockSize = 0;
+  // the offset of each compressed block within the frame capture section's data
+  std::vector<uint64_t> blockOffsets;
+  // the uncompressed offset where each chunk starts in the frame capture. This is the same order as
+  // the chunks in the structured data, so APIEvent::chunkIndex can be used to look up an event.
+  std::vector<uint64_t> chunkOffsets;
+};
+
 class RDCFile
 {
 public:
@@ -84,6 +96,7 @@ public:
 
   ContainerError ErrorCode() const { return m_Error; }
   std::string ErrorString() const { return m_ErrorString; }
+  const std::string &GetFilename() const { return m_Filename; }
   RDCDriver GetDriver() const { return m_Driver; }
   const std::string &GetDriverName() const { return m_DriverName; }
   uint64_t GetMachineIdent() const { return m_MachineIdent; }
@@ -95,17 +108,59 @@ public:
   StreamReader *ReadSection(int index) const;
   StreamWriter *WriteSection(const SectionProperties &props);
 
+  // writes the chunk index for the frame capture section that was just written, given the offset
+  // where each chunk started (see WriteSerialiser::SetChunkOffsetRecording).
+  void WriteChunkIndex(const std::vector<uint64_t> &chunkOffsets);
+
+  // the chunk index for the frame capture, with no chunk offsets if the capture doesn't have one.
+  // The frame capture reader from ReadSection can SetOffset() to any chunk offset, and will only
+  // decompress from the block containing it.
+  //
+  // Replaying or structuring a capture reads every chunk in order, so only single chunk and lazy
+  // buffer reads use the index.
+  const RDCChunkIndex &GetChunkIndex() const { return m_ChunkIndex; }
+
+  // returns the uncompressed range of a chunk in the frame capture from the chunk index, or false
+  // if there is no index or the chunk is out of range.
+  bool GetChunkRange(uint32_t chunkIndex, uint64_t &offset, uint64_t &length) const;
+
   // Only valid if GetDriver returns RDCDriver::Image, passes over the underlying FILE * for use
   // loading the image directly, since the RDC container isn't there to read from a section.
   FILE *StealImageFileHandle(std::string &filename);
 
 private:
   void Init(StreamReader &reader);
+  void LoadChunkIndex();
+
+  // on 64-bit the whole file is mapped while it's open for read, so that sections and thumbnails
+  // can be read in place without going through the FILE *. Writing to the file unmaps it first.
+  //
+  // The mapping is reference counted - each reader returned from ReadSection holds a reference, so
+  // the memory stays valid for any reader still alive when the file is unmapped.
+  struct Mapping
+  {
+    const byte *data;
+    uint64_t size;
+    int32_t refcount;
+  };
+
+  static void ReleaseMapping(Mapping *mapping);
+
+  void MapFile();
+  void UnmapFile();
+  bool IsMapped(const byte *ptr) const
+  {
+    return m_MappedData && ptr >= m_MappedData && ptr < m_MappedData + m_MappedSize;
+  }
 
   FILE *m_File = NULL;
   std::string m_Filename;
   std::vector<byte> m_Buffer;
 
+  Mapping *m_Mapping = NULL;
+  const byte *m_MappedData = NULL;
+  uint64_t m_MappedSize = 0;
+
   SectionProperties m_CurrentWritingProps;
 
   uint32_t m_SerVer = 0;
@@ -115,6 +170,8 @@ private:
   uint64_t m_MachineIdent = 0;
   RDCThumb m_Thumb;
 
+  RDCChunkIndex m_ChunkIndex;
+
   ContainerError m_Error = ContainerError::NoError;
   std::string m_ErrorString;
 
@@ -29,12 +29,72 @@
 #include "core/core.h"
 #include "strings/string_utils.h"
 
-#if !defined(RELEASE)
-
 int64_t Chunk::m_LiveChunks = 0;
 int64_t Chunk::m_TotalMem = 0;
 
-#endif
+/////////////////////////////////////////////////////////////
+// Chunk allocator
+
+int64_t ChunkAllocator::m_LivePages = 0;
+
+// the header lives at the start of the page's own allocation
+struct ChunkPage
+{
+  int32_t refCount;
+  uint64_t used;
+};
+
+// keep sub-allocations aligned the same as a separate AllocAlignedBuffer would be, since buffers
+// serialised into chunks are aligned relative to the start of the chunk
+static const uint64_t ChunkPageAlignment = 64;
+static const uint64_t ChunkPageHeaderSize = AlignUp<uint64_t>(sizeof(ChunkPage), ChunkPageAlignment);
+
+// anything larger than this is allocated separately, so a page is never mostly wasted.
+static const uint64_t MaxChunkPageAllocation = ChunkAllocator::PageSize / 8;
+
+ChunkAllocator::~ChunkAllocator()
+{
+  // chunks allocated from the current page keep it alive after we're gone
+  if(m_Page)
+    Release(m_Page);
+}
+
+byte *ChunkAllocator::Allocate(uint64_t size, ChunkPage *&page)
+{
+  if(size > MaxChunkPageAllocation)
+    return NULL;
+
+  size = AlignUp(size, ChunkPageAlignment);
+
+  if(m_Page == NULL || m_Page->used + size > PageSize)
+  {
+    if(m_Page)
+      Release(m_Page);
+
+    m_Page = (ChunkPage *)AllocAlignedBuffer(PageSize, ChunkPageAlignment);
+    m_Page->refCount = 1;
+    m_Page->used = ChunkPageHeaderSize;
+
+    Atomic::Inc64(&m_LivePages);
+  }
+
+  byte *ret = (byte *)m_Page + m_Page->used;
+  m_Page->used += size;
+
+  Atomic::Inc32(&m_Page->refCount);
+
+  page = m_Page;
+  return ret;
+}
+
+void ChunkAllocator::Release(ChunkPage *page)
+{
+  if(Atomic::Dec32(&page->refCount) == 0)
+  {
+    FreeAlignedBuffer((byte *)page);
+    Atomic::Dec64(&m_LivePages);
+  }
+}
 
 /////////////////////////////////////////////////////////////
 // Read Serialiser functions
@@ -162,7 +222,15 @@ void Serialiser<SerialiserMode::Reading>::SkipCurrentChunk()
 
     uint64_t chunkBytes = m_ChunkMetadata.length - readBytes;
 
-    if(ExportStructure() && m_ExportBuffers)
+    if(ExportStructure() && m_ExportBuffers && LazyExportBuffers())
+    {
+      SDObject &current = *m_StructureStack.back();
+
+      AddLazyBuffer(*current.data.children.back(), m_Read->GetSourceOffset(), chunkBytes);
+
+      m_Read->SkipBytes(chunkBytes);
+    }
+    else if(ExportStructure() && m_ExportBuffers)
     {
       SDObject &current = *m_StructureStack.back();
 
@@ -246,6 +314,8 @@ Serialiser<SerialiserMode::Writing>::~Serialiser()
     m_Write->Finish();
     delete m_Write;
   }
+
+  SAFE_DELETE(m_ChunkArena);
 }
 
 template <>
@@ -264,6 +334,8 @@ uint32_t Serialiser<SerialiserMode::Writing>::BeginChunk(uint32_t chunkID, uint3
     // chunk index needs to be valid
     RDCASSERT(chunkID > 0);
 
+    RecordChunkOffset();
+
     {
       uint32_t c = chunkID & ChunkIndexMask;
       RDCASSERT(chunkID <= ChunkIndexMask);
@@ -461,10 +533,9 @@ void Serialiser<SerialiserMode::Writing>::WriteStructuredFile(const SDFile &file
       RDCASSERT(chunk.data.children.size() == 1);
 
       size_t bufID = (size_t)chunk.data.children[0]->data.basic.u;
-      byte *ptr = m_StructuredFile->buffers[bufID]->data();
-      size_t len = m_StructuredFile->buffers[bufID]->size();
+      const bytebuf &buf = m_StructuredFile->GetBuffer(bufID);
 
-      ser->GetWriter()->Write(ptr, len);
+      ser->GetWriter()->Write(buf.data(), buf.size());
     }
     else
     {
@@ -650,8 +721,9 @@ void DoSerialise(SerialiserType &ser, SDObject *el)
     case SDBasic::Buffer:
     {
       size_t bufID = (size_t)el->data.basic.u;
-      byte *buf = file.buffers[bufID]->data();
-      uint64_t size = file.buffers[bufID]->size();
+      const bytebuf &contents = file.GetBuffer(bufID);
+      byte *buf = (byte *)contents.data();
+      uint64_t size = contents.size();
       ser.Serialise("", buf, size);
       break;
     }
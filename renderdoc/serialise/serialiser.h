@@ -30,6 +30,7 @@
 #include <vector>
 #include "api/replay/renderdoc_replay.h"
 #include "streamio.h"
+#include "structured_buffers.h"
 
 // function to deallocate anything from a serialise. Default impl
 // does no deallocation of anything.
@@ -82,6 +83,44 @@ enum class SerialiserMode
 
 struct CompressedFileIO;
 
+struct ChunkPage;
+
+// Bump allocator for chunk payloads. Without it every recorded chunk is its own allocation (and
+// every duplicate of it another), which is tens of thousands of allocations on the application's
+// threads for each captured frame.
+//
+// Payloads are sub-allocated from fixed size pages. A page is reference counted by the chunks in
+// it, as well as by the allocator while it's the page being filled, and is freed as soon as the
+// count reaches 0. Chunks recorded during a frame capture are then freed in bulk when the capture
+// ends and the frame's records are cleared. Any chunk that lives longer is copied out of its page
+// with Chunk::DetachFromArena, so it doesn't keep the whole page alive.
+//
+// Allocating is not thread-safe, so an allocator should be owned by something only used on one
+// thread at a time like a serialiser. Releasing a page can happen on any thread.
+class ChunkAllocator
+{
+public:
+  ChunkAllocator() = default;
+  ~ChunkAllocator();
+
+  ChunkAllocator(const ChunkAllocator &) = delete;
+  ChunkAllocator &operator=(const ChunkAllocator &) = delete;
+
+  static const uint64_t PageSize = 256 * 1024;
+
+  // returns the payload and the page it's allocated in, or NULL if the size is too large to be
+  // worth sub-allocating, in which case it should be allocated separately.
+  byte *Allocate(uint64_t size, ChunkPage *&page);
+  static void Release(ChunkPage *page);
+
+  static uint64_t NumLivePages() { return m_LivePages; }
+  static uint64_t TotalMem() { return m_LivePages * PageSize; }
+private:
+  ChunkPage *m_Page = NULL;
+
+  static int64_t m_LivePages;
+};
+
 template <SerialiserMode sertype>
 class Serialiser
 {
@@ -123,6 +162,25 @@ public:
   void *GetUserData() { return m_pUserData; }
   void SetUserData(void *userData) { m_pUserData = userData; }
   void SetStringDatabase(std::set<std::string> *db) { m_ExtStringDB = db; }
+  // if set, the stream offset where each chunk starts is appended to offsets as chunks are written.
+  // Used to build the chunk index for a capture file.
+  void SetChunkOffsetRecording(std::vector<uint64_t> *offsets) { m_ChunkOffsets = offsets; }
+  // called for chunks written pre-serialised rather than through BeginChunk
+  void RecordChunkOffset()
+  {
+    if(m_ChunkOffsets)
+      m_ChunkOffsets->push_back(m_Write->GetOffset());
+  }
+  // while enabled, chunks created from this serialiser have their payloads sub-allocated from an
+  // arena owned by the serialiser. See ChunkAllocator
+  void SetChunkArena(bool enabled)
+  {
+    if(enabled && !m_ChunkArena)
+      m_ChunkArena = new ChunkAllocator();
+    else if(!enabled)
+      SAFE_DELETE(m_ChunkArena);
+  }
+  ChunkAllocator *GetChunkArena() { return m_ChunkArena; }
   // jumps to the byte after the current chunk, can be called any time after BeginChunk
   void SkipCurrentChunk();
 
@@ -149,6 +207,9 @@ public:
   //////////////////////////////////////////
   // Public serialisation interface
 
+  // if includeBuffers is set, buffers are saved in the structured file. When reading from a
+  // capture section they aren't copied, only their location is recorded so that they can be read
+  // on demand - see LazyStructuredBuffers.
   void ConfigureStructuredExport(ChunkLookup lookup, bool includeBuffers)
   {
     m_ChunkLookup = lookup;
@@ -258,6 +319,7 @@ public:
     }
 
     byte *tempAlloc = NULL;
+    uint64_t sourceOffset = 0;
 
     {
       if(IsWriting())
@@ -290,7 +352,7 @@ public:
         // if we're exporting the buffers, make sure to always alloc space to read the data, so we
         // can save it out, even if the external code has no use for it and has asked for no
         // allocation.
-        if(el == NULL && ExportStructure() && m_ExportBuffers)
+        if(el == NULL && ExportStructure() && m_ExportBuffers && !LazyExportBuffers())
         {
           if(byteSize > 0)
             el = tempAlloc = AllocAlignedBuffer(byteSize);
@@ -299,6 +361,8 @@ public:
         }
 #endif
 
+        sourceOffset = m_Read->GetSourceOffset();
+
         m_Read->Read(el, byteSize);
       }
     }
@@ -309,14 +373,21 @@ public:
       {
         SDObject &obj = *m_StructureStack.back();
 
-        obj.data.basic.u = m_StructuredFile->buffers.size();
+        if(LazyExportBuffers())
+        {
+          AddLazyBuffer(obj, sourceOffset, byteSize);
+        }
+        else
+        {
+          obj.data.basic.u = m_StructuredFile->buffers.size();
 
-        bytebuf *alloc = new bytebuf;
-        alloc->resize((size_t)byteSize);
-        if(el)
-          memcpy(alloc->data(), el, (size_t)byteSize);
+          bytebuf *alloc = new bytebuf;
+          alloc->resize((size_t)byteSize);
+          if(el)
+            memcpy(alloc->data(), el, (size_t)byteSize);
 
-        m_StructuredFile->buffers.push_back(alloc);
+          m_StructuredFile->buffers.push_back(alloc);
+        }
       }
 
       m_StructureStack.pop_back();
@@ -337,6 +408,7 @@ public:
                         SerialiserFlags flags = SerialiserFlags::NoFlags)
   {
     uint64_t count = (uint64_t)el.size();
+    uint64_t sourceOffset = 0;
 
     {
       m_InternalElement = true;
@@ -382,6 +454,8 @@ public:
 
         el.resize((size_t)count);
 
+        sourceOffset = m_Read->GetSourceOffset();
+
         m_Read->Read(el.data(), count);
       }
     }
@@ -392,12 +466,19 @@ public:
       {
         SDObject &obj = *m_StructureStack.back();
 
-        obj.data.basic.u = m_StructuredFile->buffers.size();
+        if(LazyExportBuffers())
+        {
+          AddLazyBuffer(obj, sourceOffset, count);
+        }
+        else
+        {
+          obj.data.basic.u = m_StructuredFile->buffers.size();
 
-        bytebuf *alloc = new bytebuf;
-        alloc->assign(el);
+          bytebuf *alloc = new bytebuf;
+          alloc->assign(el);
 
-        m_StructuredFile->buffers.push_back(alloc);
+          m_StructuredFile->buffers.push_back(alloc);
+        }
       }
 
       m_StructureStack.pop_back();
@@ -410,6 +491,7 @@ public:
                         SerialiserFlags flags = SerialiserFlags::NoFlags)
   {
     uint64_t count = (uint64_t)el.size();
+    uint64_t sourceOffset = 0;
 
     {
       m_InternalElement = true;
@@ -455,6 +537,8 @@ public:
 
         el.resize((size_t)count);
 
+        sourceOffset = m_Read->GetSourceOffset();
+
         m_Read->Read(el.data(), count);
       }
     }
@@ -465,13 +549,20 @@ public:
       {
         SDObject &obj = *m_StructureStack.back();
 
-        obj.data.basic.u = m_StructuredFile->buffers.size();
+        if(LazyExportBuffers())
+        {
+          AddLazyBuffer(obj, sourceOffset, count);
+        }
+        else
+        {
+          obj.data.basic.u = m_StructuredFile->buffers.size();
 
-        bytebuf *alloc = new bytebuf;
-        alloc->resize((size_t)count);
-        memcpy(alloc->data(), el.data(), alloc->size());
+          bytebuf *alloc = new bytebuf;
+          alloc->resize((size_t)count);
+          memcpy(alloc->data(), el.data(), alloc->size());
 
-        m_StructuredFile->buffers.push_back(alloc);
+          m_StructuredFile->buffers.push_back(alloc);
+        }
       }
 
       m_StructureStack.pop_back();
@@ -1220,6 +1311,9 @@ public:
 
     byte *structBuf = NULL;
 
+    // ensure byte alignment
+    m_Read->AlignTo<ChunkAlignment>();
+
     if(ExportStructure())
     {
       if(m_StructureStack.empty())
@@ -1238,7 +1332,11 @@ public:
       obj.type.basetype = SDBasic::Buffer;
       obj.type.byteSize = totalSize;
 
-      if(m_ExportBuffers)
+      if(m_ExportBuffers && LazyExportBuffers())
+      {
+        AddLazyBuffer(obj, m_Read->GetSourceOffset(), totalSize);
+      }
+      else if(m_ExportBuffers)
       {
         obj.data.basic.u = m_StructuredFile->buffers.size();
 
@@ -1252,9 +1350,6 @@ public:
       m_StructureStack.pop_back();
     }
 
-    // ensure byte alignment
-    m_Read->AlignTo<ChunkAlignment>();
-
     if(totalSize > 0)
     {
       // copy 1MB at a time
@@ -1589,8 +1684,26 @@ private:
   uint64_t m_LastChunkOffset = 0;
   uint64_t m_ChunkFixup = 0;
 
+  // See SetChunkOffsetRecording
+  std::vector<uint64_t> *m_ChunkOffsets = NULL;
+
+  // See SetChunkArena
+  ChunkAllocator *m_ChunkArena = NULL;
+
   bool m_ExportStructured = false;
   bool m_ExportBuffers = false;
+
+  // buffers can be loaded lazily if we can find them again in the capture we're reading from
+  bool LazyExportBuffers() { return IsReading() && m_Read->GetSourceSection() >= 0; }
+  void AddLazyBuffer(SDObject &obj, uint64_t sourceOffset, uint64_t byteSize)
+  {
+    obj.data.basic.u = m_StructuredFile->buffers.size();
+    m_StructuredFile->buffers.push_back(new bytebuf);
+
+    LazyStructuredBuffers *lazy =
+        LazyStructuredBuffers::Get(*m_StructuredFile, m_Read->GetSourceSection());
+    lazy->AddBuffer((size_t)obj.data.basic.u, sourceOffset, byteSize);
+  }
   bool m_InternalElement = false;
   SDFile m_StructData;
   SDFile *m_StructuredFile = &m_StructData;
@@ -1738,12 +1851,13 @@ class Chunk
 public:
   ~Chunk()
   {
-    FreeAlignedBuffer(m_Data);
+    if(m_Page)
+      ChunkAllocator::Release(m_Page);
+    else
+      FreeAlignedBuffer(m_Data);
 
-#if !defined(RELEASE)
     Atomic::Dec64(&m_LiveChunks);
     Atomic::ExchAdd64(&m_TotalMem, -int64_t(m_Length));
-#endif
   }
 
   template <typename ChunkType>
@@ -1751,13 +1865,8 @@ public:
   {
     return (ChunkType)m_ChunkType;
   }
-#if !defined(RELEASE)
   static uint64_t NumLiveChunks() { return m_LiveChunks; }
   static uint64_t TotalMem() { return m_TotalMem; }
-#else
-  static uint64_t NumLiveChunks() { return 0; }
-  static uint64_t TotalMem() { return 0; }
-#endif
 
   // grab current contents of the serialiser into this chunk
   Chunk(Serialiser<SerialiserMode::Writing> &ser, uint32_t chunkType)
@@ -1768,39 +1877,53 @@ public:
 
     m_ChunkType = chunkType;
 
-    m_Data = AllocAlignedBuffer(m_Length);
+    AllocateData(ser.GetChunkArena());
 
     memcpy(m_Data, ser.GetWriter()->GetData(), (size_t)m_Length);
 
     ser.GetWriter()->Rewind();
 
-#if !defined(RELEASE)
     Atomic::Inc64(&m_LiveChunks);
     Atomic::ExchAdd64(&m_TotalMem, int64_t(m_Length));
-#endif
   }
 
   byte *GetData() const { return m_Data; }
-  Chunk *Duplicate()
+  uint32_t GetLength() const { return m_Length; }
+  // the copy's payload is sub-allocated from arena, if it's specified
+  Chunk *Duplicate(ChunkAllocator *arena = NULL)
   {
     Chunk *ret = new Chunk();
     ret->m_Length = m_Length;
     ret->m_ChunkType = m_ChunkType;
 
-    ret->m_Data = AllocAlignedBuffer(m_Length);
+    ret->AllocateData(arena);
 
     memcpy(ret->m_Data, m_Data, (size_t)m_Length);
 
-#if !defined(RELEASE)
     Atomic::Inc64(&m_LiveChunks);
     Atomic::ExchAdd64(&m_TotalMem, int64_t(m_Length));
-#endif
 
     return ret;
   }
 
+  // if the payload is sub-allocated from an arena page, moves it into its own allocation so the page
+  // can be freed. Not thread-safe against anything else reading the chunk.
+  void DetachFromArena()
+  {
+    if(!m_Page)
+      return;
+
+    byte *data = AllocAlignedBuffer(m_Length);
+    memcpy(data, m_Data, (size_t)m_Length);
+
+    ChunkAllocator::Release(m_Page);
+    m_Page = NULL;
+    m_Data = data;
+  }
+
   void Write(Serialiser<SerialiserMode::Writing> &ser)
   {
+    ser.RecordChunkOffset();
     ser.GetWriter()->Write((const void *)m_Data, (size_t)m_Length);
   }
 
@@ -1809,6 +1932,14 @@ private:
   Chunk(const Chunk &) = delete;
   Chunk &operator=(const Chunk &) = delete;
 
+  void AllocateData(ChunkAllocator *arena)
+  {
+    m_Data = arena ? arena->Allocate(m_Length, m_Page) : NULL;
+
+    if(!m_Data)
+      m_Data = AllocAlignedBuffer(m_Length);
+  }
+
   friend class ScopedChunk;
 
   uint32_t m_ChunkType;
@@ -1816,9 +1947,10 @@ private:
   uint32_t m_Length;
   byte *m_Data;
 
-#if !defined(RELEASE)
+  // the arena page m_Data is allocated in, or NULL if it was allocated by itself
+  ChunkPage *m_Page = NULL;
+
   static int64_t m_LiveChunks, m_TotalMem;
-#endif
 };
 
 #ifndef SERIALISER_IMPL
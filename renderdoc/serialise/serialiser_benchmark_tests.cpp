@@ -0,0 +1,353 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "common/timing.h"
+#include "lz4io.h"
+#include "parallelio.h"
+#include "serialiser.h"
+#include "zstdio.h"
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "3rdparty/catch/catch.hpp"
+
+// These are all hidden behind [.] so they don't run with the normal tests. Run them with
+// "[benchmark][serialiser]" and optionally --benchmark-out <file> to get the results as JSON.
+
+static const uint64_t streamDataSize = 64 * 1024 * 1024;
+
+// roughly capture-like data: long compressible runs with some noise mixed in
+static std::vector<byte> StreamBenchmarkData()
+{
+  std::vector<byte> ret((size_t)streamDataSize);
+
+  uint32_t seed = 0x1234567;
+  for(size_t i = 0; i < ret.size(); i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    ret[i] = ((i / 1024) % 4) == 0 ? byte(seed >> 16) : byte((i * 13) / 4096);
+  }
+
+  return ret;
+}
+
+static double MBPerSecond(uint64_t size, double ms)
+{
+  return (double(size) / (1024.0 * 1024.0)) / (ms / 1000.0);
+}
+
+// writes the data in pieces of writeSize, as the serialiser does for individual elements, and
+// returns the time taken in milliseconds
+static double WriteInPieces(StreamWriter &writer, const std::vector<byte> &data, size_t writeSize)
+{
+  PerformanceTimer timer;
+
+  for(size_t offs = 0; offs < data.size(); offs += writeSize)
+    writer.Write(data.data() + offs, RDCMIN(writeSize, data.size() - offs));
+
+  writer.Finish();
+
+  return timer.GetMilliseconds();
+}
+
+static double ReadInPieces(StreamReader &reader, std::vector<byte> &data, size_t readSize)
+{
+  PerformanceTimer timer;
+
+  for(size_t offs = 0; offs < data.size(); offs += readSize)
+    reader.Read(data.data() + offs, RDCMIN(readSize, data.size() - offs));
+
+  return timer.GetMilliseconds();
+}
+
+TEST_CASE("Benchmark stream throughput", "[.][benchmark][serialiser][streamio]")
+{
+  const std::vector<byte> inputData = StreamBenchmarkData();
+  std::vector<byte> readData(inputData.size());
+
+  const std::string filename = FileIO::GetTempFolderFilename() + "/renderdoc_stream_benchmark";
+
+  // small pieces are the common case when serialising, large are for buffer contents
+  for(size_t pieceSize : {size_t(64), size_t(1024 * 1024)})
+  {
+    const char *suffix = pieceSize == 64 ? "small" : "large";
+
+    {
+      StreamWriter writer(StreamWriter::DefaultScratchSize);
+
+      double ms = WriteInPieces(writer, inputData, pieceSize);
+      RecordBenchmark(StringFormat::Fmt("memory write %s", suffix).c_str(),
+                      MBPerSecond(streamDataSize, ms), "MB/s");
+
+      StreamReader reader(writer.GetData(), writer.GetOffset());
+
+      ms = ReadInPieces(reader, readData, pieceSize);
+      RecordBenchmark(StringFormat::Fmt("memory read %s", suffix).c_str(),
+                      MBPerSecond(streamDataSize, ms), "MB/s");
+
+      CHECK(readData == inputData);
+    }
+
+    {
+      {
+        StreamWriter writer(FileIO::fopen(filename.c_str(), "wb"), Ownership::Stream);
+
+        double ms = WriteInPieces(writer, inputData, pieceSize);
+        RecordBenchmark(StringFormat::Fmt("file write %s", suffix).c_str(),
+                        MBPerSecond(streamDataSize, ms), "MB/s");
+      }
+
+      {
+        StreamReader reader(FileIO::fopen(filename.c_str(), "rb"));
+
+        double ms = ReadInPieces(reader, readData, pieceSize);
+        RecordBenchmark(StringFormat::Fmt("file read %s", suffix).c_str(),
+                        MBPerSecond(streamDataSize, ms), "MB/s");
+      }
+
+      CHECK(readData == inputData);
+
+      FileIO::Delete(filename.c_str());
+    }
+
+    for(BlockCodec codec : {BlockCodec::LZ4, BlockCodec::Zstd})
+    {
+      const char *name = codec == BlockCodec::LZ4 ? "LZ4" : "Zstd";
+
+      StreamWriter buf(StreamWriter::DefaultScratchSize);
+
+      {
+        Compressor *comp = NULL;
+        if(codec == BlockCodec::LZ4)
+          comp = new LZ4Compressor(&buf, Ownership::Nothing);
+        else
+          comp = new ZSTDCompressor(&buf, Ownership::Nothing);
+
+        StreamWriter writer(comp, Ownership::Stream);
+
+        double ms = WriteInPieces(writer, inputData, pieceSize);
+        RecordBenchmark(StringFormat::Fmt("%s write %s", name, suffix).c_str(),
+                        MBPerSecond(streamDataSize, ms), "MB/s");
+      }
+
+      RecordBenchmark(StringFormat::Fmt("%s ratio %s", name, suffix).c_str(),
+                      double(streamDataSize) / double(buf.GetOffset()), "x");
+
+      {
+        StreamReader *compReader = new StreamReader(buf.GetData(), buf.GetOffset());
+
+        Decompressor *decomp = NULL;
+        if(codec == BlockCodec::LZ4)
+          decomp = new LZ4Decompressor(compReader, Ownership::Stream);
+        else
+          decomp = new ZSTDDecompressor(compReader, Ownership::Stream);
+
+        StreamReader reader(decomp, streamDataSize, Ownership::Stream);
+
+        double ms = ReadInPieces(reader, readData, pieceSize);
+        RecordBenchmark(StringFormat::Fmt("%s read %s", name, suffix).c_str(),
+                        MBPerSecond(streamDataSize, ms), "MB/s");
+      }
+
+      CHECK(readData == inputData);
+    }
+  }
+};
+
+// something shaped like the parameters to a typical API call - handles, some scalars, a couple
+// of small arrays and a struct array.
+struct BenchmarkViewport
+{
+  float x, y, width, height, minDepth, maxDepth;
+};
+
+DECLARE_REFLECTION_STRUCT(BenchmarkViewport);
+
+template <class SerialiserType>
+void DoSerialise(SerialiserType &ser, BenchmarkViewport &el)
+{
+  SERIALISE_MEMBER(x);
+  SERIALISE_MEMBER(y);
+  SERIALISE_MEMBER(width);
+  SERIALISE_MEMBER(height);
+  SERIALISE_MEMBER(minDepth);
+  SERIALISE_MEMBER(maxDepth);
+}
+
+struct BenchmarkCallParams
+{
+  uint64_t device = 0;
+  uint64_t commandBuffer = 0;
+  uint32_t vertexCount = 0;
+  uint32_t instanceCount = 0;
+  uint32_t firstVertex = 0;
+  uint32_t firstInstance = 0;
+  std::vector<uint64_t> descriptorSets;
+  std::vector<uint32_t> dynamicOffsets;
+  std::vector<BenchmarkViewport> viewports;
+  std::string marker;
+};
+
+DECLARE_REFLECTION_STRUCT(BenchmarkCallParams);
+
+template <class SerialiserType>
+void DoSerialise(SerialiserType &ser, BenchmarkCallParams &el)
+{
+  SERIALISE_MEMBER(device);
+  SERIALISE_MEMBER(commandBuffer);
+  SERIALISE_MEMBER(vertexCount);
+  SERIALISE_MEMBER(instanceCount);
+  SERIALISE_MEMBER(firstVertex);
+  SERIALISE_MEMBER(firstInstance);
+  SERIALISE_MEMBER(descriptorSets);
+  SERIALISE_MEMBER(dynamicOffsets);
+  SERIALISE_MEMBER(viewports);
+  SERIALISE_MEMBER(marker);
+}
+
+static BenchmarkCallParams MakeCallParams(uint32_t i)
+{
+  BenchmarkCallParams ret;
+  ret.device = 0x1000;
+  ret.commandBuffer = 0x2000 + (i % 16);
+  ret.vertexCount = 3 * i;
+  ret.instanceCount = 1;
+  ret.firstVertex = i;
+  ret.firstInstance = 0;
+  ret.descriptorSets = {0x3000 + i, 0x4000 + i, 0x5000};
+  ret.dynamicOffsets = {256 * i, 0};
+  ret.viewports = {{0.0f, 0.0f, 1920.0f, 1080.0f, 0.0f, 1.0f}};
+  ret.marker = "Draw Opaque";
+  return ret;
+}
+
+static std::string BenchmarkChunkName(uint32_t)
+{
+  return "BenchmarkChunk";
+}
+
+static const uint32_t numBenchmarkCalls = 200000;
+
+TEST_CASE("Benchmark serialising API call parameters", "[.][benchmark][serialiser]")
+{
+  std::vector<BenchmarkCallParams> calls;
+  for(uint32_t i = 0; i < numBenchmarkCalls; i++)
+    calls.push_back(MakeCallParams(i));
+
+  StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
+
+  {
+    WriteSerialiser ser(buf, Ownership::Nothing);
+
+    PerformanceTimer timer;
+
+    for(BenchmarkCallParams &params : calls)
+    {
+      SERIALISE_ELEMENT(params);
+    }
+
+    RecordBenchmark("write params", timer.GetMicroseconds() * 1000.0 / numBenchmarkCalls,
+                    "ns/call");
+  }
+
+  RecordBenchmark("params size", double(buf->GetOffset()) / numBenchmarkCalls, "bytes/call");
+
+  {
+    ReadSerialiser ser(new StreamReader(buf->GetData(), buf->GetOffset()), Ownership::Stream);
+
+    PerformanceTimer timer;
+
+    for(uint32_t i = 0; i < numBenchmarkCalls; i++)
+    {
+      BenchmarkCallParams params;
+      SERIALISE_ELEMENT(params);
+    }
+
+    RecordBenchmark("read params", timer.GetMicroseconds() * 1000.0 / numBenchmarkCalls,
+                    "ns/call");
+
+    CHECK_FALSE(ser.IsErrored());
+  }
+
+  delete buf;
+};
+
+TEST_CASE("Benchmark chunk round-trip", "[.][benchmark][serialiser]")
+{
+  std::vector<BenchmarkCallParams> calls;
+  for(uint32_t i = 0; i < numBenchmarkCalls; i++)
+    calls.push_back(MakeCallParams(i));
+
+  StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
+
+  {
+    WriteSerialiser ser(buf, Ownership::Nothing);
+
+    PerformanceTimer timer;
+
+    for(uint32_t i = 0; i < numBenchmarkCalls; i++)
+    {
+      SCOPED_SERIALISE_CHUNK(1 + (i % 100));
+      SERIALISE_ELEMENT(calls[i]);
+    }
+
+    RecordBenchmark("write chunk", timer.GetMicroseconds() * 1000.0 / numBenchmarkCalls,
+                    "ns/chunk");
+  }
+
+  for(bool structured : {false, true})
+  {
+    ReadSerialiser ser(new StreamReader(buf->GetData(), buf->GetOffset()), Ownership::Stream);
+
+    if(structured)
+      ser.ConfigureStructuredExport(&BenchmarkChunkName, false);
+
+    uint32_t mismatches = 0;
+
+    PerformanceTimer timer;
+
+    for(uint32_t i = 0; i < numBenchmarkCalls; i++)
+    {
+      uint32_t chunk = ser.ReadChunk<uint32_t>();
+
+      BenchmarkCallParams params;
+      SERIALISE_ELEMENT(params);
+
+      ser.EndChunk();
+
+      if(chunk != 1 + (i % 100))
+        mismatches++;
+    }
+
+    RecordBenchmark(structured ? "read chunk with structured export" : "read chunk",
+                    timer.GetMicroseconds() * 1000.0 / numBenchmarkCalls, "ns/chunk");
+
+    CHECK(mismatches == 0);
+    CHECK_FALSE(ser.IsErrored());
+  }
+
+  delete buf;
+};
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
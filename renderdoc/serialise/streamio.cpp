@@ -38,6 +38,26 @@ Decompressor::~Decompressor()
     delete m_Read;
 }
 
+bool Decompressor::SeekToBlock(uint64_t offset, uint64_t &blockStart)
+{
+  if(m_BlockSize == 0)
+    return false;
+
+  uint64_t block = offset / m_BlockSize;
+
+  if(block >= m_BlockOffsets.size())
+    return false;
+
+  if(!m_Read->SetOffset(m_BlockOffsets[block]))
+    return false;
+
+  Reset();
+
+  blockStart = block * m_BlockSize;
+
+  return true;
+}
+
 static const uint64_t initialBufferSize = 64 * 1024;
 const byte StreamWriter::empty[128] = {};
 
@@ -61,6 +81,16 @@ StreamReader::StreamReader(const std::vector<byte> &buffer)
   m_Ownership = Ownership::Nothing;
 }
 
+StreamReader::StreamReader(StreamExternalType, const byte *buffer, uint64_t bufferSize)
+{
+  m_InputSize = m_BufferSize = bufferSize;
+  m_BufferHead = m_BufferBase = (byte *)buffer;
+
+  m_ExternalBuffer = true;
+
+  m_Ownership = Ownership::Nothing;
+}
+
 StreamReader::StreamReader(StreamInvalidType)
 {
   m_InputSize = 0;
@@ -114,6 +144,7 @@ StreamReader::StreamReader(FILE *file, uint64_t fileSize, Ownership own)
 
   m_File = file;
   m_InputSize = fileSize;
+  m_FileBaseOffset = FileIO::ftell64(file);
 
   m_BufferSize = initialBufferSize;
   m_BufferHead = m_BufferBase = AllocAlignedBuffer(m_BufferSize);
@@ -155,6 +186,9 @@ StreamReader::StreamReader(StreamReader *reader, uint64_t bufferSize)
   m_InputSize = m_BufferSize = bufferSize;
   m_BufferHead = m_BufferBase = AllocAlignedBuffer(m_BufferSize);
 
+  m_SourceSection = reader->GetSourceSection();
+  m_SourceBaseOffset = reader->GetSourceOffset();
+
   reader->Read(m_BufferBase, bufferSize);
 
   m_Ownership = Ownership::Nothing;
@@ -178,7 +212,8 @@ StreamReader::~StreamReader()
   for(StreamCloseCallback cb : m_Callbacks)
     cb();
 
-  FreeAlignedBuffer(m_BufferBase);
+  if(!m_ExternalBuffer)
+    FreeAlignedBuffer(m_BufferBase);
 
   if(m_Ownership == Ownership::Stream)
   {
@@ -190,15 +225,64 @@ StreamReader::~StreamReader()
   }
 }
 
-void StreamReader::SetOffset(uint64_t offs)
+bool StreamReader::SetOffset(uint64_t offs)
 {
   if(m_File || m_Decompressor)
   {
-    RDCERR("File and decompress stream readers do not support seeking");
-    return;
+    if(!m_BufferBase)
+      return false;
+
+    if(offs > m_InputSize)
+    {
+      RDCERR("Seeking to %llu past the end of the stream (%llu)", offs, m_InputSize);
+      return false;
+    }
+
+    uint64_t curOffs = GetOffset();
+
+    // everything in the buffer from the head onwards is valid. Decompressed data behind the head is
+    // valid too, but file data might not be if we've skipped past it with a seek.
+    uint64_t windowStart = m_Decompressor ? m_ReadOffset : curOffs;
+    uint64_t windowEnd = m_ReadOffset + m_BufferSize;
+
+    if(offs >= windowStart && offs <= windowEnd)
+    {
+      m_BufferHead = m_BufferBase + (offs - m_ReadOffset);
+      return true;
+    }
+
+    if(m_File)
+    {
+      FileIO::fseek64(m_File, m_FileBaseOffset + offs, SEEK_SET);
+
+      m_ReadOffset = offs;
+      m_BufferHead = m_BufferBase;
+
+      return ReadFromExternal(0, RDCMIN(m_BufferSize, m_InputSize - offs));
+    }
+
+    uint64_t blockStart = 0;
+    if(m_Decompressor->SeekToBlock(offs, blockStart))
+    {
+      m_ReadOffset = blockStart;
+      m_BufferHead = m_BufferBase;
+
+      if(!ReadFromExternal(0, RDCMIN(m_BufferSize, m_InputSize - blockStart)))
+        return false;
+
+      return Read(NULL, offs - blockStart);
+    }
+
+    // without a block index the only option is to decompress everything up to the offset
+    if(offs >= curOffs)
+      return Read(NULL, offs - curOffs);
+
+    RDCERR("Can't seek backwards in a compressed stream without a block index");
+    return false;
   }
 
   m_BufferHead = m_BufferBase + offs;
+  return true;
 }
 
 bool StreamReader::Reserve(uint64_t numBytes)
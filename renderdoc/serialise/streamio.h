@@ -61,9 +61,28 @@ public:
   virtual bool Recompress(Compressor *comp) = 0;
   virtual bool Read(void *data, uint64_t numBytes) = 0;
 
+  // if the compressed data is made of independently compressed blocks that are all blockSize bytes
+  // uncompressed (see ParallelCompressor), this gives the offset of each block in the underlying
+  // stream so that the decompressor can seek.
+  void SetBlockIndex(uint64_t blockSize, const std::vector<uint64_t> &blockOffsets)
+  {
+    m_BlockSize = blockSize;
+    m_BlockOffsets = blockOffsets;
+  }
+
+  // moves to the start of the block containing the uncompressed offset, and returns the
+  // uncompressed offset where that block starts. Fails if there's no block index.
+  bool SeekToBlock(uint64_t offset, uint64_t &blockStart);
+
 protected:
+  // throw away any decompressed data and history, ready to start decompressing a new block
+  virtual void Reset() = 0;
+
   StreamReader *m_Read;
   Ownership m_Ownership;
+
+  uint64_t m_BlockSize = 0;
+  std::vector<uint64_t> m_BlockOffsets;
 };
 
 class StreamReader
@@ -77,9 +96,16 @@ public:
   {
     DummyStream
   };
+  enum StreamExternalType
+  {
+    ExternalMemory
+  };
 
   StreamReader(StreamInvalidType);
   StreamReader(StreamDummyType);
+  // reads directly from memory owned by someone else (e.g. a mapped file) without copying. The
+  // memory must remain valid for the lifetime of the reader.
+  StreamReader(StreamExternalType, const byte *buffer, uint64_t bufferSize);
   StreamReader(const byte *buffer, uint64_t bufferSize);
   StreamReader(const std::vector<byte> &buffer);
 
@@ -92,9 +118,18 @@ public:
   ~StreamReader();
 
   bool IsErrored() { return m_HasError; }
-  void SetOffset(uint64_t offs);
+  // file and decompressor readers can seek anywhere within the window they've buffered. Outside of
+  // it, file readers seek the file and decompressor readers seek to the nearest block if the
+  // decompressor has a block index, otherwise they can only skip forward.
+  bool SetOffset(uint64_t offs);
 
   inline uint64_t GetOffset() { return m_BufferHead - m_BufferBase + m_ReadOffset; }
+  // readers for a capture file section know which section they're reading, and readers created
+  // from another reader inherit that along with where in the section their data started. This lets
+  // data be found again in the capture after the reader has gone.
+  void SetSourceSection(int section) { m_SourceSection = section; }
+  int GetSourceSection() { return m_SourceSection; }
+  uint64_t GetSourceOffset() { return m_SourceBaseOffset + GetOffset(); }
   inline uint64_t GetSize() { return m_InputSize; }
   inline bool AtEnd()
   {
@@ -233,6 +268,13 @@ private:
   // the offset in the file/decompressor that corresponds to the start of m_BufferBase
   uint64_t m_ReadOffset = 0;
 
+  // the position in the file where this reader starts
+  uint64_t m_FileBaseOffset = 0;
+
+  // see SetSourceSection
+  int m_SourceSection = -1;
+  uint64_t m_SourceBaseOffset = 0;
+
   // flag indicating if an error has been encountered and the stream is now invalid
   bool m_HasError = false;
 
@@ -240,6 +282,9 @@ private:
   // structured serialiser to 'read' pre-existing data.
   bool m_Dummy = false;
 
+  // flag indicating m_BufferBase is external memory that we must not free.
+  bool m_ExternalBuffer = false;
+
   // do we own the file/compressor? are we responsible for
   // cleaning it up?
   Ownership m_Ownership;
@@ -438,9 +483,11 @@ private:
 
     if(bufferSize < newSize)
     {
-      // reallocate to a conservative size, don't 'double and allocate'
+      // reallocate to a conservative size, don't 'double and allocate'. Once the buffer is large
+      // grow it by half each time though, so that serialising a whole frame into memory isn't
+      // quadratic in the number of reallocations.
       while(bufferSize < newSize)
-        bufferSize += 128 * 1024;
+        bufferSize += RDCMAX(uint64_t(128 * 1024), bufferSize / 2);
 
       byte *newBuf = AllocAlignedBuffer(bufferSize);
 
@@ -94,6 +94,81 @@ TEST_CASE("Test basic stream I/O operations", "[streamio]")
   CHECK(reader.IsErrored());
 };
 
+TEST_CASE("Test stream I/O reading from external memory", "[streamio]")
+{
+  std::vector<uint32_t> data;
+  for(uint32_t i = 0; i < 1024; i++)
+    data.push_back(i * 3);
+
+  const uint64_t dataSize = data.size() * sizeof(uint32_t);
+
+  SECTION("Read in place from memory")
+  {
+    StreamReader reader(StreamReader::ExternalMemory, (const byte *)data.data(), dataSize);
+
+    CHECK(reader.GetSize() == dataSize);
+
+    uint32_t test = 0;
+    reader.Read(test);
+    CHECK(test == 0);
+    reader.Read(test);
+    CHECK(test == 3);
+
+    reader.SkipBytes(100 * sizeof(uint32_t));
+    reader.Read(test);
+    CHECK(test == 102 * 3);
+
+    reader.SetOffset(1000 * sizeof(uint32_t));
+    reader.Read(test);
+    CHECK(test == 1000 * 3);
+
+    CHECK_FALSE(reader.IsErrored());
+
+    reader.SkipBytes(23 * sizeof(uint32_t));
+
+    CHECK(reader.AtEnd());
+
+    // reading off the end errors, but must leave the external memory alone
+    reader.Read(test);
+    CHECK(test == 0);
+
+    CHECK(reader.IsErrored());
+    CHECK(data[1023] == 1023 * 3);
+  };
+
+  SECTION("Read from a mapped file")
+  {
+    std::string filename = FileIO::GetTempFolderFilename() + "/renderdoc_mmap_test.bin";
+
+    REQUIRE(FileIO::dump(filename.c_str(), data.data(), (size_t)dataSize));
+
+    FILE *f = FileIO::fopen(filename.c_str(), "rb");
+    REQUIRE(f);
+
+    const byte *mapped = FileIO::mmapfile(f, dataSize);
+
+    // the mapping must outlive the file handle
+    FileIO::fclose(f);
+
+    REQUIRE(mapped);
+
+    {
+      StreamReader reader(StreamReader::ExternalMemory, mapped + 512 * sizeof(uint32_t),
+                          dataSize - 512 * sizeof(uint32_t));
+
+      std::vector<uint32_t> readback(512);
+      reader.Read(readback.data(), 512 * sizeof(uint32_t));
+
+      CHECK_FALSE(reader.IsErrored());
+      CHECK(reader.AtEnd());
+      CHECK(memcmp(readback.data(), data.data() + 512, 512 * sizeof(uint32_t)) == 0);
+    }
+
+    FileIO::munmapfile(mapped, dataSize);
+    FileIO::Delete(filename.c_str());
+  };
+};
+
 TEST_CASE("Test stream I/O operations over the network", "[streamio][network]")
 {
   uint16_t port = 8235;
@@ -0,0 +1,187 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "structured_buffers.h"
+#include "rdcfile.h"
+
+LazyStructuredBuffers *LazyStructuredBuffers::Get(SDFile &file, int section)
+{
+  if(file.GetBufferSource() == NULL)
+    file.SetBufferSource(new LazyStructuredBuffers(section));
+
+  return Get(file);
+}
+
+LazyStructuredBuffers *LazyStructuredBuffers::Get(SDFile &file)
+{
+  // this is the only buffer source, files never have any other kind
+  return static_cast<LazyStructuredBuffers *>(file.GetBufferSource());
+}
+
+LazyStructuredBuffers::~LazyStructuredBuffers()
+{
+  SAFE_DELETE(m_RDC);
+}
+
+bool LazyStructuredBuffers::SetCapture(const RDCFile *rdc)
+{
+  SCOPED_LOCK(m_Lock);
+
+  SAFE_DELETE(m_RDC);
+
+  // a capture in memory can't be reopened, so load every buffer from it now and never evict them
+  if(rdc->GetFilename().empty())
+  {
+    m_Budget = ~0ULL;
+
+    bool success = true;
+
+    for(auto it = m_Locations.begin(); it != m_Locations.end(); ++it)
+    {
+      if(m_Cache.find(it->first) != m_Cache.end())
+        continue;
+
+      CachedBuffer &cached = m_Cache[it->first];
+
+      if(!Load(rdc, it->second, cached.data))
+      {
+        m_Cache.erase(it->first);
+        success = false;
+        continue;
+      }
+
+      m_LRU.push_front(it->first);
+      cached.lru = m_LRU.begin();
+      m_LoadedSize += cached.data.size();
+    }
+
+    return success;
+  }
+
+  // otherwise open our own copy of the capture, so that buffers can be loaded after rdc is closed
+  m_RDC = new RDCFile;
+  m_RDC->Open(rdc->GetFilename().c_str());
+
+  if(m_RDC->ErrorCode() != ContainerError::NoError)
+  {
+    RDCERR("Couldn't reopen capture to load structured buffers: %s",
+           m_RDC->ErrorString().c_str());
+    SAFE_DELETE(m_RDC);
+    return false;
+  }
+
+  return true;
+}
+
+void LazyStructuredBuffers::AddBuffer(size_t idx, uint64_t offset, uint64_t length)
+{
+  SCOPED_LOCK(m_Lock);
+
+  m_Locations[idx] = {offset, length};
+}
+
+bool LazyStructuredBuffers::GetBuffer(size_t idx, bytebuf &data)
+{
+  SCOPED_LOCK(m_Lock);
+
+  auto loc = m_Locations.find(idx);
+
+  // buffers that were stored in full are returned as-is
+  if(loc == m_Locations.end())
+    return false;
+
+  auto it = m_Cache.find(idx);
+
+  if(it != m_Cache.end())
+  {
+    m_LRU.splice(m_LRU.begin(), m_LRU, it->second.lru);
+    data = it->second.data;
+    return true;
+  }
+
+  Evict(loc->second.length);
+
+  CachedBuffer &cached = m_Cache[idx];
+
+  if(!Load(m_RDC, loc->second, cached.data))
+  {
+    m_Cache.erase(idx);
+    data.clear();
+    return true;
+  }
+
+  m_LRU.push_front(idx);
+  cached.lru = m_LRU.begin();
+  m_LoadedSize += cached.data.size();
+
+  data = cached.data;
+  return true;
+}
+
+bool LazyStructuredBuffers::Load(const RDCFile *rdc, const Location &loc, bytebuf &data)
+{
+  if(rdc == NULL)
+  {
+    RDCERR("No capture to load structured buffer from");
+    return false;
+  }
+
+  // open a new reader for each load, since reading buffers out of order needs to seek backwards.
+  // With a chunk index only the block containing the buffer is decompressed.
+  StreamReader *reader = rdc->ReadSection(m_Section);
+
+  bool success = true;
+
+  if(!reader->SetOffset(loc.offset))
+  {
+    RDCERR("Couldn't seek to structured buffer at %llu", loc.offset);
+    success = false;
+  }
+  else
+  {
+    data.resize((size_t)loc.length);
+
+    if(!reader->Read(data.data(), loc.length) || reader->IsErrored())
+    {
+      RDCERR("Couldn't read %llu byte structured buffer at %llu", loc.length, loc.offset);
+      success = false;
+    }
+  }
+
+  delete reader;
+
+  return success;
+}
+
+void LazyStructuredBuffers::Evict(uint64_t incoming)
+{
+  while(!m_LRU.empty() && m_LoadedSize + incoming > m_Budget)
+  {
+    auto it = m_Cache.find(m_LRU.back());
+
+    m_LoadedSize -= it->second.data.size();
+    m_Cache.erase(it);
+    m_LRU.pop_back();
+  }
+}
@@ -0,0 +1,96 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <list>
+#include <map>
+#include "api/replay/renderdoc_replay.h"
+#include "os/os_specific.h"
+
+class RDCFile;
+
+// When structured data is exported from a capture with its buffers, copying every buffer out of
+// the capture as it's read would keep all of them in memory at once. Instead the serialiser
+// records where each buffer is in its section and leaves an empty placeholder in SDFile::buffers.
+// The buffer is read back from the capture the first time it's accessed with SDFile::GetBuffer.
+//
+// Loaded buffers are cached, and once they total more than the budget the least recently used
+// ones are evicted. Buffers are returned by copy so eviction never invalidates a caller's data.
+//
+// The SDFile owns this, and this owns its own copy of the capture opened from the same file, so
+// the structured data can outlive the capture it was read from.
+class LazyStructuredBuffers : public ISDBufferSource
+{
+public:
+  static const uint64_t DefaultBudget = 256 * 1024 * 1024;
+
+  LazyStructuredBuffers(int section) : m_Section(section) {}
+  ~LazyStructuredBuffers();
+
+  // returns file's lazy buffers, creating them for the given section if it doesn't have any
+  static LazyStructuredBuffers *Get(SDFile &file, int section);
+  // returns file's lazy buffers, or NULL if it doesn't have any
+  static LazyStructuredBuffers *Get(SDFile &file);
+
+  // records that buffer idx is length bytes at offset in the section
+  void AddBuffer(size_t idx, uint64_t offset, uint64_t length);
+
+  // sets the capture to read buffers from. It's opened again from its file, or if it's only in
+  // memory every buffer is loaded immediately, so rdc doesn't have to outlive this object.
+  // Returns false if the buffers can't be read.
+  bool SetCapture(const RDCFile *rdc);
+  void SetBudget(uint64_t budget) { m_Budget = budget; }
+  uint64_t GetLoadedSize() { return m_LoadedSize; }
+  bool GetBuffer(size_t idx, bytebuf &data);
+
+private:
+  struct Location
+  {
+    uint64_t offset;
+    uint64_t length;
+  };
+
+  struct CachedBuffer
+  {
+    bytebuf data;
+    std::list<size_t>::iterator lru;
+  };
+
+  bool Load(const RDCFile *rdc, const Location &loc, bytebuf &data);
+  void Evict(uint64_t incoming);
+
+  int m_Section;
+  RDCFile *m_RDC = NULL;
+
+  uint64_t m_Budget = DefaultBudget;
+  uint64_t m_LoadedSize = 0;
+
+  std::map<size_t, Location> m_Locations;
+  std::map<size_t, CachedBuffer> m_Cache;
+  // most recently used at the front
+  std::list<size_t> m_LRU;
+
+  Threading::CriticalSection m_Lock;
+};
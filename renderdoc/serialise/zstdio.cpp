@@ -25,7 +25,6 @@
 #define ZSTD_STATIC_LINKING_ONLY
 #include "zstdio.h"
 
-static const uint64_t zstdBlockSize = 128 * 1024;
 static const uint64_t compressBlockSize = ZSTD_compressBound(zstdBlockSize);
 
 ZSTDCompressor::ZSTDCompressor(StreamWriter *write, Ownership own) : Compressor(write, own)
@@ -286,6 +285,12 @@ bool ZSTDDecompressor::Read(void *data, uint64_t numBytes)
   return success;
 }
 
+void ZSTDDecompressor::Reset()
+{
+  m_PageOffset = 0;
+  m_PageLength = 0;
+}
+
 bool ZSTDDecompressor::FillPage()
 {
   uint32_t compSize = 0;
@@ -27,6 +27,10 @@
 #include "zstd/zstd.h"
 #include "streamio.h"
 
+// size of the uncompressed pages that are compressed as one zstd frame. The decompressor relies on
+// no frame decompressing to more than this
+static const uint64_t zstdBlockSize = 128 * 1024;
+
 class ZSTDCompressor : public Compressor
 {
 public:
@@ -57,6 +61,9 @@ public:
   bool Recompress(Compressor *comp);
   bool Read(void *data, uint64_t numBytes);
 
+protected:
+  void Reset();
+
 private:
   bool FillPage();
 
@@ -48,6 +48,22 @@ uint32_t strhash(const char *str, uint32_t seed)
   return hash;
 }
 
+uint64_t strhash64(const char *str, uint64_t seed)
+{
+  if(str == NULL)
+    return seed;
+
+  uint64_t hash = seed;
+
+  for(; *str; str++)
+  {
+    hash ^= (uint8_t)*str;
+    hash *= 1099511628211ULL;
+  }
+
+  return hash;
+}
+
 // since tolower is int -> int, this warns below. make a char -> char alternative
 char toclower(char c)
 {
@@ -162,6 +178,24 @@ TEST_CASE("String hashing", "[string]")
 
     CHECK(partial == complete);
   };
+
+  SECTION("64-bit hashing")
+  {
+    CHECK(strhash64("foobar") == strhash64("foobar"));
+    CHECK(strhash64("foobar") != strhash64("blah"));
+    CHECK(strhash64("test1") != strhash64("test2"));
+    CHECK(strhash64("foobar", 1) != strhash64("foobar", 2));
+
+    // known FNV-1a values
+    CHECK(strhash64("") == 0xcbf29ce484222325ULL);
+    CHECK(strhash64("a") == 0xaf63dc4c8601ec8cULL);
+    CHECK(strhash64("foobar") == 0x85944171f73967e8ULL);
+
+    uint64_t partial = strhash64("test of a long");
+    partial = strhash64(" string for strhash64", partial);
+
+    CHECK(partial == strhash64("test of a long string for strhash64"));
+  };
 };
 
 TEST_CASE("String manipulation", "[string]")